@@ -0,0 +1,141 @@
+#ifndef AGENTRING_INCLUDED
+#define AGENTRING_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// AGENTRING
+//
+// The request ring shared between WinSpy and the agent thread it leaves
+// running in a target process (see RemoteAgent.c).  It lives in a file
+// mapping that both processes have a view of.
+//
+// WinSpy is the only producer and the agent the only consumer.  iHead and
+// iTail are free-running counters; WinSpy only ever writes iHead and the
+// agent only ever writes iTail, so a slot belongs to WinSpy until it posts
+// it and to the agent until the agent completes it.  Several requests can
+// be posted before the agent is woken up, and it serves everything pending
+// before it replies, so a batch costs one round trip.
+//
+// Each side reads the other's counter with ReadAcquire before it touches a
+// slot, and publishes its own with WriteRelease once it's done with one.
+// volatile alone doesn't order anything on ARM, where WinSpy is built with
+// /volatile:iso.
+//
+// Both halves are inline functions in here, so the protocol is in one
+// place and can be tested in a single process (tests/AgentRingTest.c).
+// The agent's half gets inlined into the agent, since only the agent's own
+// code is copied into the target, and RemoteAgent.c defines
+// AGENTRING_AGENT_CODE to put it next to the agent in case it isn't.
+//
+
+#define AGENT_RING_SLOTS    32              // Must be a power of two
+#define AGENT_MAX_TEXT      200
+
+#define AGENT_QUERY_WNDPROC 0x0001
+#define AGENT_QUERY_CLASS   0x0002
+#define AGENT_QUERY_TEXT    0x0004
+
+typedef struct
+{
+    // Request, filled in by WinSpy
+    HWND        hwnd;
+    HINSTANCE   hInst;                      // Module that registered the class
+    ATOM        atom;
+    BOOL        fUnicode;                   // Use the W or A flavor of the class functions
+    UINT        fQuery;                     // AGENT_QUERY_xxx
+
+    // Response, filled in by the agent
+    UINT        fAnswered;                  // The AGENT_QUERY_xxx bits that succeeded
+    WNDPROC     wndproc;
+    WNDCLASSEXW wc;
+    WCHAR       szText[AGENT_MAX_TEXT];
+}
+AGENTSLOT;
+
+typedef struct
+{
+    volatile LONG   iHead;                  // Requests posted so far
+    volatile LONG   iTail;                  // Requests completed so far
+    volatile LONG   fQuit;                  // Set by WinSpy to make the agent exit
+    AGENTSLOT       rgSlots[AGENT_RING_SLOTS];
+}
+AGENTRING;
+
+#ifndef AGENTRING_AGENT_CODE
+#define AGENTRING_AGENT_CODE
+#endif
+
+static __forceinline void AgentRing_Init(AGENTRING *pRing)
+{
+    ZeroMemory(pRing, sizeof(AGENTRING));
+}
+
+//
+// WinSpy's side.  BeginRequest returns the slot for the next request, or
+// NULL when the ring is full.  PostRequest hands it to the agent and
+// returns the sequence number to wait for.  Any number of requests can be
+// posted before the agent is woken.
+//
+static __forceinline AGENTSLOT *AgentRing_BeginRequest(AGENTRING *pRing)
+{
+    LONG iHead = pRing->iHead;
+
+    // The agent has finished with a slot once iTail says so.
+    if (iHead - ReadAcquire(&pRing->iTail) >= AGENT_RING_SLOTS)
+        return NULL;
+
+    return &pRing->rgSlots[iHead & (AGENT_RING_SLOTS - 1)];
+}
+
+static __forceinline LONG AgentRing_PostRequest(AGENTRING *pRing)
+{
+    LONG iSeq = pRing->iHead;
+
+    // The slot contents have to get there before the new head does.
+    WriteRelease(&pRing->iHead, iSeq + 1);
+
+    return iSeq;
+}
+
+static __forceinline BOOL AgentRing_IsComplete(const AGENTRING *pRing, LONG iSeq)
+{
+    return ReadAcquire(&pRing->iTail) - iSeq > 0;
+}
+
+static __forceinline AGENTSLOT *AgentRing_GetSlot(AGENTRING *pRing, LONG iSeq)
+{
+    return &pRing->rgSlots[iSeq & (AGENT_RING_SLOTS - 1)];
+}
+
+//
+// The agent's side.  NextRequest returns the oldest pending request, or
+// NULL when nothing is pending; the agent answers it in place and calls
+// CompleteRequest, and keeps going until NextRequest runs dry, so a batch
+// is served in one wakeup.
+//
+AGENTRING_AGENT_CODE
+static __forceinline AGENTSLOT *AgentRing_NextRequest(AGENTRING *pRing)
+{
+    LONG iTail = pRing->iTail;
+
+    if (iTail == ReadAcquire(&pRing->iHead))
+        return NULL;
+
+    return &pRing->rgSlots[iTail & (AGENT_RING_SLOTS - 1)];
+}
+
+AGENTRING_AGENT_CODE
+static __forceinline void AgentRing_CompleteRequest(AGENTRING *pRing)
+{
+    // The answer has to get there before the new tail does.
+    WriteRelease(&pRing->iTail, pRing->iTail + 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
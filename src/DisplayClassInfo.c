@@ -15,8 +15,11 @@
 
 #include "WinSpy.h"
 
+#include <malloc.h>
+
 #include "resource.h"
 #include "Utils.h"
+#include "ProcessInfoCache.h"
 
 void VerboseClassName(WCHAR ach[], size_t cch, WORD atom)
 {
@@ -176,6 +179,77 @@ HandleLookupType BrushLookup2[NUM_BRUSH_STYLES + NUM_STKBR_STYLES];
 
 #define NUM_BRUSH2_LOOKUP ARRAYSIZE(BrushLookup2)
 
+//
+//  Reverse lookup from a stock handle to its entry in one of the tables
+//  above.  Several names can share a handle (IDI_ERROR and IDI_HAND, for
+//  instance), in which case the first one in the table wins.
+//
+#define HANDLE_MAP_SLOTS 64
+
+typedef struct
+{
+    HANDLE handle;
+    int    index;   // Index into the list + 1, or 0 for an empty slot
+} HandleMapSlot;
+
+typedef struct
+{
+    HandleLookupType *list;
+    HandleMapSlot     slots[HANDLE_MAP_SLOTS];
+} HandleMap;
+
+static_assert(NUM_BRUSH2_LOOKUP < HANDLE_MAP_SLOTS / 2, "Handle map too small");
+
+HandleMap IconMap;
+HandleMap CursorMap;
+HandleMap BrushMap;
+
+static size_t HashHandle(HANDLE handle)
+{
+    ULONGLONG key = (ULONG_PTR)handle;
+
+    key *= 0x9E3779B97F4A7C15ull;
+
+    return (size_t)(key >> 17) & (HANDLE_MAP_SLOTS - 1);
+}
+
+static void BuildHandleMap(HandleMap *map, HandleLookupType *list, int items)
+{
+    int i;
+
+    ZeroMemory(map, sizeof(*map));
+    map->list = list;
+
+    for (i = 0; i < items; i++)
+    {
+        size_t slot = HashHandle(list[i].handle);
+
+        while (map->slots[slot].index != 0 && map->slots[slot].handle != list[i].handle)
+            slot = (slot + 1) & (HANDLE_MAP_SLOTS - 1);
+
+        if (map->slots[slot].index == 0)
+        {
+            map->slots[slot].handle = list[i].handle;
+            map->slots[slot].index  = i + 1;
+        }
+    }
+}
+
+static int LookupHandle(const HandleMap *map, HANDLE handle)
+{
+    size_t slot = HashHandle(handle);
+
+    while (map->slots[slot].index != 0)
+    {
+        if (map->slots[slot].handle == handle)
+            return map->slots[slot].index - 1;
+
+        slot = (slot + 1) & (HANDLE_MAP_SLOTS - 1);
+    }
+
+    return -1;
+}
+
 //
 //  Prepare the resource lookup tables by obtaining the
 //  internal handle values for all stock objects.
@@ -200,6 +274,10 @@ void InitStockStyleLists()
         BrushLookup2[i + NUM_BRUSH_STYLES].handle = GetStockObject(StkBrLookup[i].value);
         BrushLookup2[i + NUM_BRUSH_STYLES].szName = StkBrLookup[i].szName;
     }
+
+    BuildHandleMap(&IconMap,   IconLookup,   NUM_ICON_LOOKUP);
+    BuildHandleMap(&CursorMap, CursorLookup, NUM_CURSOR_LOOKUP);
+    BuildHandleMap(&BrushMap,  BrushLookup2, NUM_BRUSH2_LOOKUP);
 }
 
 //
@@ -228,19 +306,16 @@ int PrintHandle(WCHAR *ach, size_t cch, ULONG_PTR value)
 }
 
 //
-//  Lookup the specified value in the handle list
+//  Lookup the specified value in the handle map (which can be NULL)
 //
-int FormatHandle(WCHAR *ach, size_t cch, HandleLookupType *handlelist, int items, ULONG_PTR matchthis)
+int FormatHandle(WCHAR *ach, size_t cch, const HandleMap *map, ULONG_PTR matchthis)
 {
-    int i;
+    int i = map ? LookupHandle(map, (HANDLE)matchthis) : -1;
 
-    for (i = 0; i < items; i++)
+    if (i != -1)
     {
-        if (handlelist[i].handle == (HANDLE)matchthis)
-        {
-            wcscpy_s(ach, cch, handlelist[i].szName);
-            return i;
-        }
+        wcscpy_s(ach, cch, map->list[i].szName);
+        return i;
     }
 
     if (matchthis == 0 || (HANDLE)matchthis == INVALID_HANDLE_VALUE)
@@ -251,23 +326,36 @@ int FormatHandle(WCHAR *ach, size_t cch, HandleLookupType *handlelist, int items
     return -1;
 }
 
-void FillBytesList(
-    HWND hwndDlg,
+//
+//  One piece of a window's or class's extra bytes, as read by ReadBytesList.
+//
+typedef struct
+{
+    int      offset;
+    int      cb;
+    LONG_PTR value;
+    DWORD    dwError;
+} BytesChunk;
+
+//
+//  Reads the extra bytes in the biggest pieces the Get* functions allow.
+//  rgChunks must have room for numBytes entries.  Returns the number of
+//  chunks read.
+//
+int ReadBytesList(
     HWND hwnd,
     int numBytes,
     WORD WINAPI pGetWord(HWND, int),
     LONG WINAPI pGetLong(HWND, int),
-    LONG_PTR WINAPI pGetLongPtr(HWND, int)
+    LONG_PTR WINAPI pGetLongPtr(HWND, int),
+    BytesChunk *rgChunks
 )
 {
-    WCHAR ach[256];
     int i = 0;
+    int cChunks = 0;
     LONG_PTR lp;
 
-    SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_RESETCONTENT, 0, 0);
-    EnableDlgItem(hwndDlg, IDC_BYTESLIST, numBytes != 0);
-
-    // Retrieve all the bytes + add to combo box
+    // Retrieve all the bytes
     // We will be getting all the bytes except for the possible last incomplete portion by Get*LongPtr.
     // Because Get*Long* checks the bounds, the last piece has to be retrieved with one operation whose span ends at the very last byte.
     while (numBytes > 0)
@@ -320,130 +408,175 @@ void FillBytesList(
         if (chunkBytes < sizeof(lp))
             lp &= (1ll << bitsInByte * chunkBytes) - 1;
 
-        if (dwLastError == ERROR_SUCCESS)
-        {
-            swprintf_s(ach, ARRAYSIZE(ach), L"+%-8d %0*IX", i, 2 * chunkBytes, lp);
-        }
-        else
-            swprintf_s(ach, ARRAYSIZE(ach), L"+%-8d Unavailable (0x%08X)", i, dwLastError);
+        rgChunks[cChunks].offset  = i;
+        rgChunks[cChunks].cb      = chunkBytes;
+        rgChunks[cChunks].value   = (dwLastError == ERROR_SUCCESS) ? lp : 0;
+        rgChunks[cChunks].dwError = dwLastError;
+        cChunks++;
 
         i += chunkBytes;
         numBytes -= chunkBytes;
-
-        LRESULT index = SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_ADDSTRING, 0, (LPARAM)ach);
-        SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_SETITEMDATA, index, dwLastError == ERROR_SUCCESS ? lp : dwLastError);
     }
 
-    SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_SETCURSEL, 0, 0);
+    return cChunks;
 }
 
+void ShowBytesList(HWND hwndDlg, const BytesChunk *rgChunks, int cChunks, BOOL fEnable)
+{
+    WCHAR ach[256];
+    int i;
 
-//
-// Clears all the controls on the tab because either there is no current window,
-// or the current window is invalid.
-//
+    SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_RESETCONTENT, 0, 0);
+    EnableDlgItem(hwndDlg, IDC_BYTESLIST, fEnable);
 
-void ResetClassTab(HWND hwnd, HWND hwndDlg)
-{
-    // Reset the labels to blank or '(invalid window)'
+    for (i = 0; i < cChunks; i++)
+    {
+        const BytesChunk *pChunk = &rgChunks[i];
 
-    PCWSTR pszMessage = hwnd ? szInvalidWindow : L"";
+        if (pChunk->dwError == ERROR_SUCCESS)
+            swprintf_s(ach, ARRAYSIZE(ach), L"+%-8d %0*IX", pChunk->offset, 2 * pChunk->cb, pChunk->value);
+        else
+            swprintf_s(ach, ARRAYSIZE(ach), L"+%-8d Unavailable (0x%08X)", pChunk->offset, pChunk->dwError);
 
-    SetDlgItemTextEx(hwndDlg, IDC_CLASSNAME,      pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_ATOM,           pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_WINDOWBYTES,    pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_MENUHANDLE,     pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_CURSORHANDLE,   pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_ICONHANDLE,     pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_BKGNDBRUSH,     pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_WNDPROC,        pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_CLASSPROC,      pszMessage);
-    SetDlgItemTextEx(hwndDlg, IDC_INSTANCEHANDLE, pszMessage);
+        LRESULT index = SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_ADDSTRING, 0, (LPARAM)ach);
+        SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_SETITEMDATA, index, pChunk->dwError == ERROR_SUCCESS ? pChunk->value : pChunk->dwError);
+    }
 
-    // Labels too short for "(invalid window)"
+    SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_SETCURSEL, 0, 0);
+}
 
-    SetDlgItemTextEx(hwndDlg, IDC_STYLE,          L"");
-    SetDlgItemTextEx(hwndDlg, IDC_CLASSBYTES,     L"");
+void FillBytesList(
+    HWND hwndDlg,
+    HWND hwnd,
+    int numBytes,
+    WORD WINAPI pGetWord(HWND, int),
+    LONG WINAPI pGetLong(HWND, int),
+    LONG_PTR WINAPI pGetLongPtr(HWND, int)
+)
+{
+    BytesChunk *rgChunks = (BytesChunk *)malloc(max(numBytes, 1) * sizeof(BytesChunk));
+    int cChunks = 0;
 
-    // Reset controls to default states.
+    if (rgChunks)
+        cChunks = ReadBytesList(hwnd, numBytes, pGetWord, pGetLong, pGetLongPtr, rgChunks);
 
-    SendDlgItemMessage(hwndDlg, IDC_STYLELIST, CB_RESETCONTENT, 0, 0);
-    SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_RESETCONTENT, 0, 0);
-    EnableDlgItem(hwndDlg, IDC_STYLELIST, FALSE);
-    EnableDlgItem(hwndDlg, IDC_BYTESLIST, FALSE);
+    ShowBytesList(hwndDlg, rgChunks, cChunks, numBytes != 0);
 
-    ShowDlgItem(hwndDlg, IDC_WNDPROC_LINK, SW_HIDE);
-    ShowDlgItem(hwndDlg, IDC_WNDPROC, SW_SHOW);
+    free(rgChunks);
 }
 
 
 //
-// Set the class information on the Class Tab, for the specified window.
-// This function assumes that g_WndClassEx is completely populated.
+//  Decoded class information, cached per class so that refreshing the tab
+//  for a window whose class has been seen before only has to check whether
+//  the class extra bytes changed.  Classes are told apart by atom and
+//  module; the A/W flavor matters as well because of the class proc.  Two
+//  processes that load the same image at the same base register the same
+//  atom, so the process (pid and creation time, in case the pid is reused)
+//  is part of the key too.
 //
-void UpdateClassTab(HWND hwnd)
+#define MAX_CLASS_TAB_CACHE 16
+
+typedef struct
 {
-    WCHAR ach[256];
-    int i, numstyles;
-    HWND hwndDlg = WinSpyTab[CLASS_TAB].hwnd;
-    UINT_PTR handle;
+    WORD        wAtom;
+    PVOID       hModule;
+    BOOL        fUnicode;
+    DWORD       dwProcessId;
+    FILETIME    ftCreation;
+    BOOL        fValid;
+
+    DWORD       dwStyle;
+    DWORD       cbClsExtra;
+    PVOID       clsproc;
+
+    BytesChunk *rgChunks;       // Class extra bytes
+    int         cChunks;
+
+    WCHAR       szClassName[256];
+    WCHAR       szMenu[32];
+    WCHAR       szCursor[64];
+    WCHAR       szIcon[64];
+    WCHAR       szBrush[80];
+    WCHAR       szWndBytes[16];
+} ClassTabInfo;
+
+static ClassTabInfo g_rgClassTabCache[MAX_CLASS_TAB_CACHE];
+static int          g_iNextClassTabEntry;
+static int          g_iShownClassTabEntry = -1;    // Entry the tab's class fields show
+
+static int FindClassTabEntry(WORD wAtom, PVOID hModule, BOOL fUnicode, DWORD dwProcessId, const FILETIME *pftCreation)
+{
+    int i;
 
-    if (!hwnd || !IsWindow(hwnd))
+    for (i = 0; i < MAX_CLASS_TAB_CACHE; i++)
     {
-        ResetClassTab(hwnd, hwndDlg);
-        return;
+        ClassTabInfo *pInfo = &g_rgClassTabCache[i];
+
+        if (pInfo->fValid && pInfo->wAtom == wAtom && pInfo->hModule == hModule && pInfo->fUnicode == fUnicode &&
+            pInfo->dwProcessId == dwProcessId && CompareFileTime(&pInfo->ftCreation, pftCreation) == 0)
+            return i;
     }
 
-    DWORD dwStyle    = (DWORD)GetClassLong(hwnd, GCL_STYLE);
-    WORD  wAtom      = (WORD)GetClassLong(hwnd, GCW_ATOM);
-    DWORD cbClsExtra = (DWORD)GetClassLong(hwnd, GCL_CBCLSEXTRA);
-    DWORD cbWndExtra = (DWORD)GetClassLong(hwnd, GCL_CBWNDEXTRA);
-    PVOID hModule    = (PVOID)GetClassLongPtr(hwnd, GCLP_HMODULE);
-    PVOID clsproc    = (PVOID)(IsWindowUnicode(hwnd) ? GetClassLongPtrW : GetClassLongPtrA)(hwnd, GCLP_WNDPROC);
+    return -1;
+}
 
-    // Class name
+static BOOL SameBytesList(const BytesChunk *rgChunks1, int cChunks1, const BytesChunk *rgChunks2, int cChunks2)
+{
+    int i;
 
-    GetClassName(hwnd, ach, ARRAYSIZE(ach));
-    VerboseClassName(ach, ARRAYSIZE(ach), wAtom);
+    if (cChunks1 != cChunks2)
+        return FALSE;
 
-    SetDlgItemTextEx(hwndDlg, IDC_CLASSNAME, ach);
+    for (i = 0; i < cChunks1; i++)
+    {
+        if (rgChunks1[i].offset != rgChunks2[i].offset || rgChunks1[i].cb != rgChunks2[i].cb ||
+            rgChunks1[i].value != rgChunks2[i].value || rgChunks1[i].dwError != rgChunks2[i].dwError)
+            return FALSE;
+    }
 
-    // Class style
+    return TRUE;
+}
 
-    FormatDlgItemText(hwndDlg, IDC_STYLE, L"%08X", dwStyle);
+//
+//  Decodes everything about the class of hwnd into an entry.
+//
+static void DecodeClassTabInfo(ClassTabInfo *pInfo, HWND hwnd, BytesChunk *rgChunks, int cChunks)
+{
+    WCHAR ach[256];
+    int i;
+    UINT_PTR handle;
 
-    // Atom
+    pInfo->dwStyle = (DWORD)GetClassLong(hwnd, GCL_STYLE);
+    pInfo->clsproc = (PVOID)(pInfo->fUnicode ? GetClassLongPtrW : GetClassLongPtrA)(hwnd, GCLP_WNDPROC);
 
-    FormatDlgItemText(hwndDlg, IDC_ATOM, L"%04X", wAtom);
+    free(pInfo->rgChunks);
+    pInfo->rgChunks = rgChunks;
+    pInfo->cChunks  = cChunks;
 
-    // Extra class bytes
+    // Class name
 
-    FormatDlgItemText(hwndDlg, IDC_CLASSBYTES, L"%d", cbClsExtra);
+    GetClassName(hwnd, pInfo->szClassName, ARRAYSIZE(pInfo->szClassName));
+    VerboseClassName(pInfo->szClassName, ARRAYSIZE(pInfo->szClassName), pInfo->wAtom);
 
     // Extra window bytes
 
-    FormatDlgItemText(hwndDlg, IDC_WINDOWBYTES, L"%d", cbWndExtra);
+    swprintf_s(pInfo->szWndBytes, ARRAYSIZE(pInfo->szWndBytes), L"%d", (DWORD)GetClassLong(hwnd, GCL_CBWNDEXTRA));
 
     // Menu
 
     handle = GetClassLongPtr(hwnd, GCLP_MENUNAME);
-    FormatHandle(ach, ARRAYSIZE(ach), NULL, 0, handle);
-
-    SetDlgItemTextEx(hwndDlg, IDC_MENUHANDLE, ach);
+    FormatHandle(pInfo->szMenu, ARRAYSIZE(pInfo->szMenu), NULL, handle);
 
     // Cursor handle
 
     handle = GetClassLongPtr(hwnd, GCLP_HCURSOR);
-    FormatHandle(ach, ARRAYSIZE(ach), CursorLookup, NUM_CURSOR_LOOKUP, handle);
-
-    SetDlgItemTextEx(hwndDlg, IDC_CURSORHANDLE, ach);
+    FormatHandle(pInfo->szCursor, ARRAYSIZE(pInfo->szCursor), &CursorMap, handle);
 
     // Icon handle
 
     handle = GetClassLongPtr(hwnd, GCLP_HICON);
-    FormatHandle(ach, ARRAYSIZE(ach), IconLookup, NUM_ICON_LOOKUP, handle);
-
-    SetDlgItemTextEx(hwndDlg, IDC_ICONHANDLE, ach);
+    FormatHandle(pInfo->szIcon, ARRAYSIZE(pInfo->szIcon), &IconMap, handle);
 
     // Background brush handle
 
@@ -454,7 +587,7 @@ void UpdateClassTab(HWND hwnd)
     if (!(handle > 0 && handle <= MAXUINT) || (-1 == FormatConst(ach, ARRAYSIZE(ach), BrushLookup, NUM_BRUSH_STYLES, (UINT)handle - 1)))
     {
         //now search by handle value
-        i = FormatHandle(ach, ARRAYSIZE(ach), BrushLookup2, NUM_BRUSH2_LOOKUP, handle);
+        i = FormatHandle(ach, ARRAYSIZE(ach), &BrushMap, handle);
         if (i != -1)
         {
             int len = PrintHandle(ach, ARRAYSIZE(ach), (UINT_PTR)BrushLookup2[i].handle);
@@ -462,29 +595,43 @@ void UpdateClassTab(HWND hwnd)
         }
     }
 
-    SetDlgItemTextEx(hwndDlg, IDC_BKGNDBRUSH, ach);
+    wcscpy_s(pInfo->szBrush, ARRAYSIZE(pInfo->szBrush), ach);
+}
 
-    // Window procedure
+//
+//  Puts the class fields of an entry on the tab.
+//
+static void ShowClassTabInfo(HWND hwndDlg, const ClassTabInfo *pInfo)
+{
+    WCHAR ach[32];
+    int i, numstyles;
 
-    UpdateWndProcControls(hwnd, hwndDlg, clsproc);
+    SetDlgItemTextEx(hwndDlg, IDC_CLASSNAME, pInfo->szClassName);
+    FormatDlgItemText(hwndDlg, IDC_STYLE, L"%08X", pInfo->dwStyle);
+    FormatDlgItemText(hwndDlg, IDC_ATOM, L"%04X", pInfo->wAtom);
+    FormatDlgItemText(hwndDlg, IDC_CLASSBYTES, L"%d", pInfo->cbClsExtra);
+    SetDlgItemTextEx(hwndDlg, IDC_WINDOWBYTES, pInfo->szWndBytes);
+    SetDlgItemTextEx(hwndDlg, IDC_MENUHANDLE, pInfo->szMenu);
+    SetDlgItemTextEx(hwndDlg, IDC_CURSORHANDLE, pInfo->szCursor);
+    SetDlgItemTextEx(hwndDlg, IDC_ICONHANDLE, pInfo->szIcon);
+    SetDlgItemTextEx(hwndDlg, IDC_BKGNDBRUSH, pInfo->szBrush);
 
     // Class window procedure
 
-    if (clsproc == 0)
+    if (pInfo->clsproc == 0)
     {
         wcscpy_s(ach, ARRAYSIZE(ach), L"N/A");
     }
     else
     {
-        swprintf_s(ach, ARRAYSIZE(ach), L"%p", clsproc);
+        swprintf_s(ach, ARRAYSIZE(ach), L"%p", pInfo->clsproc);
     }
 
     SetDlgItemTextEx(hwndDlg, IDC_CLASSPROC, ach);
 
-
     // Instance handle
 
-    FormatDlgItemText(hwndDlg, IDC_INSTANCEHANDLE, L"%p", hModule);
+    FormatDlgItemText(hwndDlg, IDC_INSTANCEHANDLE, L"%p", pInfo->hModule);
 
     // Fill the combo box with the class styles
 
@@ -493,7 +640,7 @@ void UpdateClassTab(HWND hwnd)
 
     for (i = 0; i < NUM_CLASS_STYLES; i++)
     {
-        if (dwStyle & ClassLookup[i].value)
+        if (pInfo->dwStyle & ClassLookup[i].value)
         {
             SendDlgItemMessage(hwndDlg, IDC_STYLELIST, CB_ADDSTRING, 0,
                 (LPARAM)ClassLookup[i].szName);
@@ -505,8 +652,158 @@ void UpdateClassTab(HWND hwnd)
     SendDlgItemMessage(hwndDlg, IDC_STYLELIST, CB_SETCURSEL, 0, 0);
     EnableDlgItem(hwndDlg, IDC_STYLELIST, numstyles != 0);
 
-
     // Fill combo box with class extra bytes
 
-    FillBytesList(hwndDlg, hwnd, cbClsExtra, GetClassWord, (LONG (WINAPI *)(HWND, int))GetClassLong, (LONG_PTR (WINAPI *)(HWND, int))GetClassLongPtr);
+    ShowBytesList(hwndDlg, pInfo->rgChunks, pInfo->cChunks, pInfo->cbClsExtra != 0);
+}
+
+
+//
+// Clears all the controls on the tab because either there is no current window,
+// or the current window is invalid.
+//
+
+void ResetClassTab(HWND hwnd, HWND hwndDlg)
+{
+    // Reset the labels to blank or '(invalid window)'
+
+    PCWSTR pszMessage = hwnd ? szInvalidWindow : L"";
+
+    g_iShownClassTabEntry = -1;
+
+    SetDlgItemTextEx(hwndDlg, IDC_CLASSNAME,      pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_ATOM,           pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_WINDOWBYTES,    pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_MENUHANDLE,     pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_CURSORHANDLE,   pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_ICONHANDLE,     pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_BKGNDBRUSH,     pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_WNDPROC,        pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_CLASSPROC,      pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_INSTANCEHANDLE, pszMessage);
+
+    // Labels too short for "(invalid window)"
+
+    SetDlgItemTextEx(hwndDlg, IDC_STYLE,          L"");
+    SetDlgItemTextEx(hwndDlg, IDC_CLASSBYTES,     L"");
+
+    // Reset controls to default states.
+
+    SendDlgItemMessage(hwndDlg, IDC_STYLELIST, CB_RESETCONTENT, 0, 0);
+    SendDlgItemMessage(hwndDlg, IDC_BYTESLIST, CB_RESETCONTENT, 0, 0);
+    EnableDlgItem(hwndDlg, IDC_STYLELIST, FALSE);
+    EnableDlgItem(hwndDlg, IDC_BYTESLIST, FALSE);
+
+    ShowDlgItem(hwndDlg, IDC_WNDPROC_LINK, SW_HIDE);
+    ShowDlgItem(hwndDlg, IDC_WNDPROC, SW_SHOW);
+}
+
+
+//
+// Set the class information on the Class Tab, for the specified window.
+//
+// The class fields only get decoded the first time a class is seen, or
+// when its extra bytes have changed, and only get put on the tab when
+// they differ from what is already there.  The window procedure belongs
+// to the window, so that is always updated.
+//
+void UpdateClassTab(HWND hwnd)
+{
+    HWND hwndDlg = WinSpyTab[CLASS_TAB].hwnd;
+
+    if (!hwnd || !IsWindow(hwnd))
+    {
+        ResetClassTab(hwnd, hwndDlg);
+        return;
+    }
+
+    PROCESSINFO process = { 0 };
+    DWORD       dwProcessId = 0;
+
+    // The creation time is zero if the process can't be opened, which
+    // leaves just the pid.
+    GetWindowThreadProcessId(hwnd, &dwProcessId);
+    ProcessInfoCache_Get(dwProcessId, &process);
+
+    WORD  wAtom    = (WORD)GetClassLong(hwnd, GCW_ATOM);
+    PVOID hModule  = (PVOID)GetClassLongPtr(hwnd, GCLP_HMODULE);
+    BOOL  fUnicode = IsWindowUnicode(hwnd);
+    int   iEntry   = FindClassTabEntry(wAtom, hModule, fUnicode, dwProcessId, &process.ftCreation);
+    BOOL  fChanged = FALSE;
+
+    DWORD cbClsExtra = (iEntry != -1) ? g_rgClassTabCache[iEntry].cbClsExtra : (DWORD)GetClassLong(hwnd, GCL_CBCLSEXTRA);
+
+    // Class extra bytes are what gets probed on every refresh.
+
+    BytesChunk *rgChunks = NULL;
+    int         cChunks  = 0;
+
+    if (cbClsExtra != 0)
+    {
+        rgChunks = (BytesChunk *)malloc(cbClsExtra * sizeof(BytesChunk));
+
+        if (rgChunks)
+            cChunks = ReadBytesList(hwnd, cbClsExtra, GetClassWord, (LONG (WINAPI *)(HWND, int))GetClassLong, (LONG_PTR (WINAPI *)(HWND, int))GetClassLongPtr, rgChunks);
+    }
+
+    if (iEntry == -1)
+    {
+        iEntry = g_iNextClassTabEntry;
+        g_iNextClassTabEntry = (g_iNextClassTabEntry + 1) % MAX_CLASS_TAB_CACHE;
+
+        ClassTabInfo *pInfo = &g_rgClassTabCache[iEntry];
+
+        pInfo->wAtom       = wAtom;
+        pInfo->hModule     = hModule;
+        pInfo->fUnicode    = fUnicode;
+        pInfo->dwProcessId = dwProcessId;
+        pInfo->ftCreation  = process.ftCreation;
+        pInfo->fValid      = TRUE;
+        pInfo->cbClsExtra  = cbClsExtra;
+
+        DecodeClassTabInfo(pInfo, hwnd, rgChunks, cChunks);
+        fChanged = TRUE;
+    }
+    else if (!SameBytesList(rgChunks, cChunks, g_rgClassTabCache[iEntry].rgChunks, g_rgClassTabCache[iEntry].cChunks))
+    {
+        DecodeClassTabInfo(&g_rgClassTabCache[iEntry], hwnd, rgChunks, cChunks);
+        fChanged = TRUE;
+    }
+    else
+    {
+        free(rgChunks);
+    }
+
+    ClassTabInfo *pInfo = &g_rgClassTabCache[iEntry];
+
+    if (fChanged || iEntry != g_iShownClassTabEntry)
+    {
+        ShowClassTabInfo(hwndDlg, pInfo);
+        g_iShownClassTabEntry = iEntry;
+    }
+
+    // Window procedure
+
+    UpdateWndProcControls(hwnd, hwndDlg, pInfo->clsproc);
+}
+
+//
+// Probe for the auto-update timer
+//
+
+ULONGLONG ProbeClassTab(HWND hwnd)
+{
+    static const int rgIndex[] =
+    {
+        GCL_STYLE, GCLP_HICON, GCLP_HICONSM, GCLP_HCURSOR, GCLP_HBRBACKGROUND, GCLP_MENUNAME, GCLP_WNDPROC,
+    };
+
+    ULONG_PTR rgValues[ARRAYSIZE(rgIndex)];
+
+    for (UINT i = 0; i < ARRAYSIZE(rgIndex); i++)
+    {
+        rgValues[i] = GetClassLongPtr(hwnd, rgIndex[i]);
+    }
+
+    return HashProbeData(PROBE_HASH_INIT, rgValues, sizeof(rgValues));
 }
@@ -127,33 +127,28 @@ void DescribeDpiAwarenessContext(DPI_AWARENESS_CONTEXT dpiContext, PSTR pszBuffe
     }
 }
 
-void DescribeProcessDpiAwareness(DWORD dwProcessId, PSTR pszAwareness, size_t cchAwareness, PSTR pszDpi, size_t cchDpi)
+//
+// hProcess needs PROCESS_QUERY_LIMITED_INFORMATION access, or is NULL if
+// that was denied.
+//
+void DescribeProcessDpiAwareness(HANDLE hProcess, PSTR pszAwareness, size_t cchAwareness, PSTR pszDpi, size_t cchDpi)
 {
-    HANDLE hProcess = NULL;
-
     InitializeDpiApis();
 
     *pszAwareness = '\0';
     *pszDpi = '\0';
 
-    if (s_pfnGetDpiAwarenessContextForProcess || s_pfnGetProcessDpiAwareness)
+    if (!s_pfnGetDpiAwarenessContextForProcess && !s_pfnGetProcessDpiAwareness)
     {
-        hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, dwProcessId);
-
-        if (!hProcess)
-        {
-            DWORD dwError = GetLastError();
-
-            if (dwError == ERROR_ACCESS_DENIED)
-            {
-                StringCchCopyA(pszAwareness, cchAwareness, "<Access Denied>");
-                StringCchCopyA(pszDpi, cchDpi, "<Access Denied>");
-            }
-        }
+        StringCchCopyA(pszAwareness, cchAwareness, "<Unavailable>");
+        return;
     }
-    else
+
+    if (!hProcess)
     {
-        StringCchCopyA(pszAwareness, cchAwareness, "<Unavailable>");
+        StringCchCopyA(pszAwareness, cchAwareness, "<Access Denied>");
+        StringCchCopyA(pszDpi, cchDpi, "<Access Denied>");
+        return;
     }
 
     if (hProcess)
@@ -212,8 +207,6 @@ void DescribeProcessDpiAwareness(DWORD dwProcessId, PSTR pszAwareness, size_t cc
                 StringCchCopyA(pszDpi, cchDpi, "<Unavailable>");
             }
         }
-
-        CloseHandle(hProcess);
     }
 }
 
@@ -327,3 +320,34 @@ int DPIScale(HWND hwnd, int value)
 
     return MulDiv(value, dpi, 96);
 }
+
+//
+// Probe for the auto-update timer.  The DPI follows the monitor.
+//
+
+ULONGLONG ProbeDpiTab(HWND hwnd)
+{
+    struct
+    {
+        RECT                  rcWindow;
+        HMONITOR              hMonitor;
+        DPI_AWARENESS_CONTEXT dpiContext;
+        UINT                  dpi;
+    }
+    probe;
+
+    InitializeDpiApis();
+
+    ZeroMemory(&probe, sizeof(probe));
+
+    GetWindowRect(hwnd, &probe.rcWindow);
+    probe.hMonitor = MonitorFromWindow(hwnd, MONITOR_DEFAULTTONULL);
+
+    if (s_pfnGetWindowDpiAwarenessContext)
+        probe.dpiContext = s_pfnGetWindowDpiAwarenessContext(hwnd);
+
+    if (s_pfnGetDpiForWindow)
+        probe.dpi = s_pfnGetDpiForWindow(hwnd);
+
+    return HashProbeData(PROBE_HASH_INIT, &probe, sizeof(probe));
+}
@@ -26,15 +26,18 @@ void FillBytesList(
 );
 
 //
-// Three possible states:
+// Four possible states:
 //
 // 1. The wndproc isn't known and we have not yet tried to get it.
 //    The "N/A" link control is shown.
 //
-// 2. We tried to fetch the wndproc via thread injection and failed.
+// 2. A worker is fetching the wndproc via thread injection.
+//    The non-link control is shown with a value of "Pending...".
+//
+// 3. We tried to fetch the wndproc via thread injection and failed.
 //    The non-link control is shown with a value of "N/A".
 //
-// 3. We know the wndproc.
+// 4. We know the wndproc.
 //    Show the non-link control with the value of the wndproc.
 //
 
@@ -45,14 +48,14 @@ void UpdateWndProcControls(HWND hwnd, HWND hwndDlg, PVOID clsproc)
     // If we don't know the wndproc and have not already attempted the
     // remote thread injection, then show the link.
 
-    BOOL fShowLink = (!g_WndProc && !g_fTriedRemote);
+    BOOL fShowLink = (!g_WndProc && !g_fTriedRemote && !g_fRemotePending);
 
     ShowDlgItem(hwndDlg, IDC_WNDPROC_LINK, fShowLink ? SW_SHOW : SW_HIDE);
     ShowDlgItem(hwndDlg, IDC_WNDPROC,      fShowLink ? SW_HIDE : SW_SHOW);
 
     if (g_WndProc == 0)
     {
-        swprintf_s(ach, ARRAYSIZE(ach), L"N/A");
+        swprintf_s(ach, ARRAYSIZE(ach), g_fRemotePending ? L"Pending..." : L"N/A");
     }
     else
     {
@@ -147,7 +150,8 @@ void UpdateGeneralTab(HWND hwnd)
     // because it gets text of children in other processes
     if (g_fPassword)
     {
-        // For password edit controls, we try thread injection.
+        // For password edit controls, we try thread injection.  The text
+        // stays empty until the worker gets back to us.
 
         GetRemoteInfo();
         wcscpy_s(ach, ARRAYSIZE(ach), g_szPassword);
@@ -288,3 +292,42 @@ void UpdateGeneralTab(HWND hwnd)
 
     FillBytesList(hwndDlg, hwnd, numbytes, GetWindowWord, GetWindowLong, GetWindowLongPtr);
 }
+
+//
+// Probe for the auto-update timer.  Text is compared by length; an edit
+// that keeps the length waits for the next full update.
+//
+
+#define PROBE_TEXT_TIMEOUT  10
+
+ULONGLONG ProbeGeneralTab(HWND hwnd)
+{
+    struct
+    {
+        RECT      rcWindow;
+        RECT      rcClient;
+        LONG_PTR  lpInstance;
+        LONG_PTR  lpUserData;
+        LONG_PTR  lpId;
+        DWORD_PTR cchText;
+        DWORD     dwStyle;
+    }
+    probe;
+
+    ZeroMemory(&probe, sizeof(probe));
+
+    GetWindowRect(hwnd, &probe.rcWindow);
+    GetClientRect(hwnd, &probe.rcClient);
+
+    probe.lpInstance = GetWindowLongPtr(hwnd, GWLP_HINSTANCE);
+    probe.lpUserData = GetWindowLongPtr(hwnd, GWLP_USERDATA);
+    probe.lpId       = GetWindowLongPtr(hwnd, GWLP_ID);
+    probe.dwStyle    = GetWindowLong(hwnd, GWL_STYLE);
+
+    if (!SendMessageTimeout(hwnd, WM_GETTEXTLENGTH, 0, 0, SMTO_ABORTIFHUNG, PROBE_TEXT_TIMEOUT, &probe.cchText))
+    {
+        probe.cchText = (DWORD_PTR)-1;
+    }
+
+    return HashProbeData(PROBE_HASH_INIT, &probe, sizeof(probe));
+}
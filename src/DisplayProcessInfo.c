@@ -11,175 +11,53 @@
 
 #include "WinSpy.h"
 
+#include <malloc.h>
 #include "Utils.h"
 #include <shellapi.h>
 #include <psapi.h>
 #include "resource.h"
-#include <tlhelp32.h>
+#include "ProcessInfoCache.h"
 
-void DescribeProcessDpiAwareness(DWORD dwProcessId, PSTR pszAwareness, size_t cchAwareness, PSTR pszDpi, size_t cchDpi);
 BOOL IsGetSystemDpiForProcessPresent();
 
-typedef BOOL(WINAPI * EnumProcessModulesProc)(HANDLE, HMODULE *, DWORD, PDWORD);
-typedef DWORD(WINAPI * GetModuleBaseNameProc)(HANDLE, HMODULE, PWSTR, DWORD);
-typedef DWORD(WINAPI * GetModuleFileNameExProc)(HANDLE, HMODULE, PWSTR, DWORD);
-
-typedef BOOL(WINAPI * QueryFullProcessImageNameProc)(HANDLE hProcess, DWORD dwFlags, PWSTR lpExeName, PDWORD lpdwSize);
-
-BOOL GetProcessNameByPid1(DWORD dwProcessId, WCHAR szName[], DWORD nNameSize, WCHAR szPath[], DWORD nPathSize)
+//
+//  Returns FALSE if the process isn't running.  The name is all that is
+//  known about processes we aren't allowed to open, in which case szPath
+//  comes back empty.
+//
+BOOL GetProcessNameByPid(DWORD dwProcessId, WCHAR szName[], DWORD nNameSize, WCHAR szPath[], DWORD nPathSize)
 {
-    HANDLE h = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    PROCESSENTRY32 pe = { sizeof(pe) };
-    BOOL fFound = FALSE;
-
-    szPath[0] = '\0';
     szName[0] = '\0';
+    szPath[0] = '\0';
 
-    if (Process32First(h, &pe))
-    {
-        do
-        {
-            if (pe.th32ProcessID == dwProcessId)
-            {
-                if (szName)
-                {
-                    lstrcpyn(szName, pe.szExeFile, nNameSize);
-                }
-
-                if (szPath)
-                {
-                    //OpenProcess(
-                    lstrcpyn(szPath, pe.szExeFile, nPathSize);
-                }
-
-                fFound = TRUE;
-                break;
-            }
-        } while (Process32Next(h, &pe));
-    }
-
-    CloseHandle(h);
+    // Neither of these needs the rest of what the Process tab shows
+    if (!ProcessInfoCache_GetName(dwProcessId, szName, nNameSize) || !szName[0])
+        return FALSE;
 
-    return fFound;
+    return ProcessInfoCache_GetPath(dwProcessId, szPath, nPathSize);
 }
 
-
-//
-// This uses PSAPI.DLL, which is only available under NT/2000/XP I think,
-// so we dynamically load this library, so that we can still run under 9x.
 //
-//  dwProcessId  [in]
-//  szName       [out]
-//  nNameSize    [in]
-//  szPath       [out]
-//  nPathSize    [in]
+//  Integrity levels are a mandatory label RID, see TokenIntegrityLevel
 //
-BOOL GetProcessNameByPid_BelowVista(DWORD dwProcessId, WCHAR szName[], DWORD nNameSize, WCHAR szPath[], DWORD nPathSize)
+static PCWSTR DescribeIntegrity(DWORD dwIntegrity)
 {
-    HMODULE hPSAPI;
-    HANDLE hProcess;
-
-    HMODULE hModule;
-    DWORD   dwNumModules;
-
-    EnumProcessModulesProc  fnEnumProcessModules;
-    GetModuleBaseNameProc   fnGetModuleBaseName;
-    GetModuleFileNameExProc fnGetModuleFileNameEx;
-
-    // Attempt to load Process Helper library
-    hPSAPI = LoadLibrary(L"psapi.dll");
-
-    if (!hPSAPI)
-    {
-        szName[0] = '\0';
-        return FALSE;
-    }
-
-    // OK, we have access to the PSAPI functions, so open the process
-    hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, dwProcessId);
-    if (!hProcess)
-    {
-        FreeLibrary(hPSAPI);
-        return FALSE;
-    }
-
-
-    fnEnumProcessModules = (EnumProcessModulesProc)GetProcAddress(hPSAPI, "EnumProcessModules");
-    fnGetModuleBaseName = (GetModuleBaseNameProc)GetProcAddress(hPSAPI, "GetModuleBaseNameW");
-    fnGetModuleFileNameEx = (GetModuleFileNameExProc)GetProcAddress(hPSAPI, "GetModuleFileNameExW");
-
-    if (!fnEnumProcessModules || !fnGetModuleBaseName)
-    {
-        CloseHandle(hProcess);
-        FreeLibrary(hPSAPI);
-        return FALSE;
-    }
-
-    // Find the first module
-    if (fnEnumProcessModules(hProcess, &hModule, sizeof(hModule), &dwNumModules))
-    {
-        // Now get the module name
-        if (szName)
-            fnGetModuleBaseName(hProcess, hModule, szName, nNameSize);
-
-        // get module filename
-        if (szPath)
-            fnGetModuleFileNameEx(hProcess, hModule, szPath, nPathSize);
-    }
+    if (dwIntegrity == PROCESSINFO_NO_INTEGRITY)
+        return L"N/A";
+    else if (dwIntegrity >= SECURITY_MANDATORY_PROTECTED_PROCESS_RID)
+        return L"Protected";
+    else if (dwIntegrity >= SECURITY_MANDATORY_SYSTEM_RID)
+        return L"System";
+    else if (dwIntegrity >= SECURITY_MANDATORY_HIGH_RID)
+        return L"High";
+    else if (dwIntegrity >= SECURITY_MANDATORY_MEDIUM_PLUS_RID)
+        return L"Medium Plus";
+    else if (dwIntegrity >= SECURITY_MANDATORY_MEDIUM_RID)
+        return L"Medium";
+    else if (dwIntegrity >= SECURITY_MANDATORY_LOW_RID)
+        return L"Low";
     else
-    {
-        CloseHandle(hProcess);
-        FreeLibrary(hPSAPI);
-        return FALSE;
-    }
-
-    CloseHandle(hProcess);
-    FreeLibrary(hPSAPI);
-
-    return TRUE;
-}
-
-BOOL GetProcessNameByPid(DWORD dwProcessId, WCHAR szName[], DWORD nNameSize, WCHAR szPath[], DWORD nPathSize)
-{
-    static QueryFullProcessImageNameProc fnQueryFullProcessImageName = NULL;
-    HANDLE hProcess;
-    DWORD dwSize;
-    WCHAR *pName;
-    BOOL bSucceeded;
-
-    if (!fnQueryFullProcessImageName)
-    {
-#ifdef UNICODE
-        fnQueryFullProcessImageName = (QueryFullProcessImageNameProc)GetProcAddress(GetModuleHandle(TEXT("kernel32")), "QueryFullProcessImageNameW");
-#else
-        fnQueryFullProcessImageName = (QueryFullProcessImageNameProc)GetProcAddress(GetModuleHandle(TEXT("kernel32")), "QueryFullProcessImageNameA");
-#endif
-
-        if (!fnQueryFullProcessImageName)
-            return GetProcessNameByPid_BelowVista(dwProcessId, szName, nNameSize, szPath, nPathSize);
-    }
-
-    bSucceeded = FALSE;
-
-    hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, dwProcessId);
-    if (hProcess)
-    {
-        dwSize = nPathSize;
-
-        if (fnQueryFullProcessImageName(hProcess, 0, szPath, &dwSize))
-        {
-            pName = wcsrchr(szPath, '\\');
-            if (pName)
-            {
-                wcsncpy_s(szName, nNameSize, pName + 1, _TRUNCATE);
-                bSucceeded = TRUE;
-            }
-        }
-
-        CloseHandle(hProcess);
-    }
-
-    return bSucceeded;
+        return L"Untrusted";
 }
 
 
@@ -190,8 +68,7 @@ void UpdateProcessTab(HWND hwnd, DWORD dwOverridePID)
 {
     DWORD dwProcessId = 0;
     DWORD dwThreadId = 0;
-    WCHAR ach[32];
-    WCHAR szPath[MAX_PATH];
+    PROCESSINFO info;
     BOOL  fValid;
     HWND  hwndDlg = WinSpyTab[PROCESS_TAB].hwnd;
     PCWSTR pszDefault = L"";
@@ -239,28 +116,18 @@ void UpdateProcessTab(HWND hwnd, DWORD dwOverridePID)
     }
 
 
-    // Try to get process name and path
-    if (dwProcessId && GetProcessNameByPid(dwProcessId, ach, ARRAYSIZE(ach),
-        szPath, ARRAYSIZE(szPath)))
-    {
-        SetDlgItemTextEx(hwndDlg, IDC_PROCESSNAME, ach);
-        SetDlgItemTextEx(hwndDlg, IDC_PROCESSPATH, szPath);
-    }
-    else
-    {
-        SetDlgItemTextEx(hwndDlg, IDC_PROCESSNAME, fValid ? L"N/A" : pszDefault);
-        SetDlgItemTextEx(hwndDlg, IDC_PROCESSPATH, fValid ? L"N/A" : pszDefault);
-    }
+    // Process name, path, integrity level and DPI, all from the cache
 
-    if (dwProcessId)
+    if (dwProcessId && ProcessInfoCache_Get(dwProcessId, &info))
     {
-        CHAR szMode[100];
-        CHAR szDpi[100];
+        SetDlgItemTextEx(hwndDlg, IDC_PROCESSNAME, info.szName[0] ? info.szName : L"N/A");
+        SetDlgItemTextEx(hwndDlg, IDC_PROCESSPATH, info.szPath[0] ? info.szPath : L"N/A");
 
-        DescribeProcessDpiAwareness(dwProcessId, szMode, ARRAYSIZE(szMode), szDpi, ARRAYSIZE(szDpi));
+        SetDlgItemTextEx(hwndDlg, IDC_PROCESS_INTEGRITY,
+            info.fAccessDenied ? L"<Access Denied>" : DescribeIntegrity(info.dwIntegrity));
 
-        SetDlgItemTextExA(hwndDlg, IDC_PROCESS_DPI_AWARENESS, szMode);
-        SetDlgItemTextExA(hwndDlg, IDC_PROCESS_SYSTEM_DPI, szDpi);
+        SetDlgItemTextExA(hwndDlg, IDC_PROCESS_DPI_AWARENESS, info.szDpiAwareness);
+        SetDlgItemTextExA(hwndDlg, IDC_PROCESS_SYSTEM_DPI, info.szSystemDpi);
 
         if (!IsGetSystemDpiForProcessPresent())
         {
@@ -270,11 +137,26 @@ void UpdateProcessTab(HWND hwnd, DWORD dwOverridePID)
     }
     else
     {
+        SetDlgItemTextEx(hwndDlg, IDC_PROCESSNAME, fValid ? L"N/A" : pszDefault);
+        SetDlgItemTextEx(hwndDlg, IDC_PROCESSPATH, fValid ? L"N/A" : pszDefault);
+        SetDlgItemTextEx(hwndDlg, IDC_PROCESS_INTEGRITY, fValid ? L"N/A" : pszDefault);
         SetDlgItemTextEx(hwndDlg, IDC_PROCESS_DPI_AWARENESS, pszDefault);
         SetDlgItemTextEx(hwndDlg, IDC_PROCESS_SYSTEM_DPI, pszDefault);
     }
 }
 
+//
+//  Probe for the auto-update timer.  What the tab shows is fixed for the
+//  life of the process, apart from what's cached in ProcessInfoCache.
+//
+ULONGLONG ProbeProcessTab(HWND hwnd)
+{
+    DWORD rgIds[2];
+
+    rgIds[0] = GetWindowThreadProcessId(hwnd, &rgIds[1]);
+
+    return HashProbeData(PROBE_HASH_INIT, rgIds, sizeof(rgIds));
+}
 
 WCHAR szWarning1[] = L"Are you sure you want to close this process?";
 WCHAR szWarning2[] = L"WARNING: Terminating a process can cause undesired\r\n"\
@@ -283,6 +165,132 @@ L"process will not be given the chance to save its state or\r\n"\
 L"data before it is terminated. Are you sure you want to\r\n"\
 L"terminate the process?";
 
+typedef struct
+{
+    DWORD              dwProcessId;
+    REMOTEWINDOWINFO  *rgInfo;
+    UINT               cInfo;
+    UINT               cAlloc;
+}
+PROCESSWINDOWLIST;
+
+static BOOL CALLBACK CollectProcessWindowProc(HWND hwnd, LPARAM lParam)
+{
+    PROCESSWINDOWLIST *pList = (PROCESSWINDOWLIST *)lParam;
+    DWORD              dwProcessId = 0;
+    WCHAR              szClass[32];
+
+    GetWindowThreadProcessId(hwnd, &dwProcessId);
+
+    if (dwProcessId != pList->dwProcessId)
+        return TRUE;
+
+    // Console windows claim to belong to the console process, which may
+    // not even have user32 loaded, so leave them out (see GetRemoteInfo).
+
+    GetClassName(hwnd, szClass, ARRAYSIZE(szClass));
+
+    if (wcscmp(szClass, L"ConsoleWindowClass") == 0)
+        return TRUE;
+
+    if (pList->cInfo == pList->cAlloc)
+    {
+        UINT              cAlloc = pList->cAlloc ? pList->cAlloc * 2 : 256;
+        REMOTEWINDOWINFO *rgInfo = (REMOTEWINDOWINFO *)realloc(pList->rgInfo, cAlloc * sizeof(REMOTEWINDOWINFO));
+
+        if (!rgInfo)
+            return FALSE;
+
+        pList->rgInfo = rgInfo;
+        pList->cAlloc = cAlloc;
+    }
+
+    ZeroMemory(&pList->rgInfo[pList->cInfo], sizeof(REMOTEWINDOWINFO));
+    pList->rgInfo[pList->cInfo++].hwnd = hwnd;
+    return TRUE;
+}
+
+//
+//  Copies the real window procedure of every window in the process to the
+//  clipboard, as tab separated text, along with whether it's subclassed.
+//  All of it comes from a single injected thread.
+//
+static void CopyProcessWindowProcs(HWND hwndParent, DWORD dwProcessId)
+{
+    PROCESSWINDOWLIST list = { dwProcessId };
+    UINT              cTopLevel;
+    WCHAR            *pszText;
+    size_t            cchText;
+    size_t            cchUsed;
+    WCHAR             szClass[256];
+
+    EnumWindows(CollectProcessWindowProc, (LPARAM)&list);
+
+    // Children of a window can belong to other processes, so only the
+    // windows of this process are kept.
+
+    cTopLevel = list.cInfo;
+
+    for (UINT i = 0; i < cTopLevel; i++)
+    {
+        EnumChildWindows(list.rgInfo[i].hwnd, CollectProcessWindowProc, (LPARAM)&list);
+    }
+
+    if (list.cInfo == 0)
+    {
+        MessageBox(hwndParent, L"The process has no windows", szAppName, MB_OK | MB_ICONINFORMATION);
+    }
+    else if (!ProcessArchMatches(list.rgInfo[0].hwnd))
+    {
+        MessageBox(hwndParent, L"Window procedures can only be read from processes of the same bitness as WinSpy++", szAppName, MB_OK | MB_ICONWARNING);
+    }
+    else
+    {
+        HCURSOR hOldCursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+
+        if (!GetRemoteWindowInfoBatch(list.rgInfo, list.cInfo))
+        {
+            MessageBox(hwndParent, L"Unable to read window procedures from the process", szAppName, MB_OK | MB_ICONWARNING);
+        }
+        else
+        {
+            cchText = (list.cInfo + 1) * (ARRAYSIZE(szClass) + ARRAYSIZE(list.rgInfo->szText) + 64);
+            pszText = (WCHAR *)malloc(cchText * sizeof(WCHAR));
+
+            if (pszText)
+            {
+                cchUsed = swprintf_s(pszText, cchText, L"Handle\tClass\tWindow Proc\tClass Proc\tSubclassed\tText\r\n");
+
+                for (UINT i = 0; i < list.cInfo; i++)
+                {
+                    const REMOTEWINDOWINFO *pInfo = &list.rgInfo[i];
+                    PCWSTR                  pszSubclassed;
+
+                    if (!pInfo->clsproc)
+                        pszSubclassed = L"?";
+                    else if (pInfo->wndproc != pInfo->clsproc)
+                        pszSubclassed = L"Yes";
+                    else
+                        pszSubclassed = L"No";
+
+                    szClass[0] = L'\0';
+                    GetClassName(pInfo->hwnd, szClass, ARRAYSIZE(szClass));
+
+                    cchUsed += swprintf_s(pszText + cchUsed, cchText - cchUsed, L"%08X\t%s\t%p\t%p\t%s\t%s\r\n",
+                        (UINT)(UINT_PTR)pInfo->hwnd, szClass, pInfo->wndproc, pInfo->clsproc, pszSubclassed, pInfo->szText);
+                }
+
+                CopyTextToClipboard(hwndParent, pszText);
+                free(pszText);
+            }
+        }
+
+        SetCursor(hOldCursor);
+    }
+
+    free(list.rgInfo);
+}
+
 void ShowProcessContextMenu(HWND hwndParent, INT x, INT y, BOOL fForButton, HWND hwnd, DWORD dwProcessId)
 {
     DWORD dwThreadId = 0;
@@ -329,7 +337,7 @@ void ShowProcessContextMenu(HWND hwndParent, INT x, INT y, BOOL fForButton, HWND
             WCHAR szName[32];
             WCHAR szPath[MAX_PATH];
 
-            if (GetProcessNameByPid(dwProcessId, szName, ARRAYSIZE(szName), szPath, ARRAYSIZE(szPath)))
+            if (GetProcessNameByPid(dwProcessId, szName, ARRAYSIZE(szName), szPath, ARRAYSIZE(szPath)) && szPath[0])
             {
                 swprintf_s(szExplorer, ARRAYSIZE(szExplorer), L"/select,\"%s\"", szPath);
                 ShellExecute(0, L"open", L"explorer", szExplorer, 0, SW_SHOW);
@@ -341,6 +349,10 @@ void ShowProcessContextMenu(HWND hwndParent, INT x, INT y, BOOL fForButton, HWND
         }
         break;
 
+        case IDM_WINSPY_COPYWNDPROCS:
+            CopyProcessWindowProcs(hwndParent, dwProcessId);
+            break;
+
         // Forcibly terminate!
         case IDM_WINSPY_TERMINATE:
         {
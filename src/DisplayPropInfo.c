@@ -12,6 +12,8 @@
 #include "WinSpy.h"
 
 #include "resource.h"
+#include "KnownClass.h"
+#include "Utils.h"
 
 //
 //  Called once for each window property
@@ -66,3 +68,51 @@ void UpdatePropertyTab(HWND hwnd)
 
     UpdateScrollbarInfo(hwnd);
 }
+
+//
+//  Probe for the auto-update timer: the properties and the scrollbars
+//
+static BOOL CALLBACK ProbePropEnumProcEx(HWND hwnd, PWSTR lpszString, HANDLE hData, ULONG_PTR dwUser)
+{
+    UNREFERENCED_PARAMETER(hwnd);
+    ULONGLONG *pHash = (ULONGLONG *)dwUser;
+
+    if (((ULONG_PTR)lpszString & ~(ULONG_PTR)0xFFFF) == 0)
+        *pHash = HashProbeData(*pHash, &lpszString, sizeof(lpszString));
+    else
+        *pHash = HashProbeData(*pHash, lpszString, wcslen(lpszString) * sizeof(WCHAR));
+
+    *pHash = HashProbeData(*pHash, &hData, sizeof(hData));
+
+    return TRUE;
+}
+
+ULONGLONG ProbePropertyTab(HWND hwnd)
+{
+    ULONGLONG  hash       = PROBE_HASH_INIT;
+    DWORD      dwStyle    = GetWindowLong(hwnd, GWL_STYLE);
+    BOOL       fScrollBar = (GetKnownClass(hwnd) == KNOWNCLASS_SCROLLBAR);
+    SCROLLINFO si;
+
+    EnumPropsEx(hwnd, ProbePropEnumProcEx, (ULONG_PTR)&hash);
+
+    hash = HashProbeData(hash, &dwStyle, sizeof(dwStyle));
+
+    // SB_CTL sends a message, so it's only for actual scrollbar controls.
+
+    for (int nBar = SB_HORZ; nBar <= SB_CTL; nBar++)
+    {
+        if ((nBar == SB_CTL) != fScrollBar)
+            continue;
+
+        ZeroMemory(&si, sizeof(si));
+        si.cbSize = sizeof(si);
+        si.fMask  = SIF_ALL;
+
+        GetScrollInfo(hwnd, nBar, &si);
+
+        hash = HashProbeData(hash, &si, sizeof(si));
+    }
+
+    return hash;
+}
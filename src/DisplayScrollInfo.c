@@ -12,9 +12,10 @@
 #include "WinSpy.h"
 
 #include "resource.h"
+#include "KnownClass.h"
 #include "Utils.h"
 
-void SetInfo(HWND hwndDlg, HWND hwnd, BOOL fValid, BOOL fVert, PCWSTR ach, DWORD dwStyle)
+void SetInfo(HWND hwndDlg, HWND hwnd, BOOL fValid, BOOL fVert, PCWSTR ach, UINT uClass, DWORD dwStyle)
 {
     SCROLLINFO si;
     DWORD bartype = fVert ? SB_VERT : SB_HORZ;
@@ -25,7 +26,7 @@ void SetInfo(HWND hwndDlg, HWND hwnd, BOOL fValid, BOOL fVert, PCWSTR ach, DWORD
         si.cbSize = sizeof(SCROLLINFO);
         si.fMask = SIF_ALL;
 
-        if (lstrcmpi(ach, L"ScrollBar") == 0)
+        if (uClass == KNOWNCLASS_SCROLLBAR)
         {
             static_assert(SBS_HORZ == SB_HORZ && SBS_VERT == SB_VERT, "");
             if ((dwStyle & SBS_DIR_MASK) == bartype)
@@ -41,10 +42,10 @@ void SetInfo(HWND hwndDlg, HWND hwnd, BOOL fValid, BOOL fVert, PCWSTR ach, DWORD
 
     if (fValid && GetScrollInfo(hwnd, bartype, &si))
     {
-        SetDlgItemInt(hwndDlg, fVert ? IDC_VMIN : IDC_HMIN, si.nMin, TRUE);
-        SetDlgItemInt(hwndDlg, fVert ? IDC_VMAX : IDC_HMAX, si.nMax, TRUE);
-        SetDlgItemInt(hwndDlg, fVert ? IDC_VPOS : IDC_HPOS, si.nPos, TRUE);
-        SetDlgItemInt(hwndDlg, fVert ? IDC_VPAGE : IDC_HPAGE, si.nPage, TRUE);
+        FormatDlgItemText(hwndDlg, fVert ? IDC_VMIN : IDC_HMIN, L"%d", si.nMin);
+        FormatDlgItemText(hwndDlg, fVert ? IDC_VMAX : IDC_HMAX, L"%d", si.nMax);
+        FormatDlgItemText(hwndDlg, fVert ? IDC_VPOS : IDC_HPOS, L"%d", si.nPos);
+        FormatDlgItemText(hwndDlg, fVert ? IDC_VPAGE : IDC_HPAGE, L"%d", si.nPage);
 
         if (bartype != SB_CTL)
         {
@@ -64,6 +65,7 @@ void SetInfo(HWND hwndDlg, HWND hwnd, BOOL fValid, BOOL fVert, PCWSTR ach, DWORD
 void UpdateScrollbarInfo(HWND hwnd)
 {
     DWORD dwStyle = 0;
+    UINT   uClass = KNOWNCLASS_UNKNOWN;
     WCHAR  ach[256];
     HWND   hwndDlg = WinSpyTab[PROPERTY_TAB].hwnd;
 
@@ -78,11 +80,11 @@ void UpdateScrollbarInfo(HWND hwnd)
 
     if (fValid)
     {
-        GetClassName(hwnd, ach, ARRAYSIZE(ach));
+        uClass = GetKnownClass(hwnd);
 
         dwStyle = GetWindowLong(hwnd, GWL_STYLE);
     }
 
-    SetInfo(hwndDlg, hwnd, fValid, FALSE, ach, dwStyle);
-    SetInfo(hwndDlg, hwnd, fValid, TRUE, ach, dwStyle);
+    SetInfo(hwndDlg, hwnd, fValid, FALSE, ach, uClass, dwStyle);
+    SetInfo(hwndDlg, hwnd, fValid, TRUE, ach, uClass, dwStyle);
 }
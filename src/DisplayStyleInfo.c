@@ -6,6 +6,8 @@
 
 #include "WinSpy.h"
 
+#include <assert.h>
+
 #include "Utils.h"
 
 #pragma warning(push)
@@ -14,13 +16,9 @@
 #pragma warning(pop)
 
 #include "resource.h"
-
-inline BOOL StyleApplicableAndPresent(DWORD value, StyleLookupEx *pStyle)
-{
-    if (((pStyle->dependencyValue | pStyle->dependencyExtraMask) & value) != pStyle->dependencyValue)
-        return FALSE;
-    return ((pStyle->value | pStyle->extraMask) & value) == pStyle->value;
-}
+#include "KnownClass.h"
+#include "StyleDecoder.h"
+#include "StyleQuery.h"
 
 //
 //  Use these helper macros to fill in the style structures.
@@ -805,22 +803,199 @@ ClassStyleInfo ClassStyleInfos[] =
 
 ClassStyleInfo* FindClassStyleInfo(HWND hwnd)
 {
-    WCHAR szClassName[256];
+    return GetKnownClassStyleInfo(GetKnownClass(hwnd));
+}
+
+
+//
+// ClassStyleInfos index + 1 of each KNOWNCLASS, or 0 if it has no entry.
+//
+
+static BYTE g_rgClassStyleInfo[KNOWNCLASS_COUNT];
+static BOOL g_fClassStyleInfoBuilt;
+
+static_assert(KNOWNCLASS_COUNT <= 64, "Too many classes for STYLEQUERYTERM.fClasses");
+
+ClassStyleInfo* GetKnownClassStyleInfo(UINT uClass)
+{
+    if (!g_fClassStyleInfoBuilt)
+    {
+        for (UINT i = 0; i < ARRAYSIZE(ClassStyleInfos); i++)
+        {
+            UINT uKnown = GetKnownClassFromName(ClassStyleInfos[i].ClassName);
+
+            // Every table has to be for a class in KnownClass.c, or the
+            // unknown classes would get it.
+            assert(uKnown != KNOWNCLASS_UNKNOWN);
+
+            if (uKnown != KNOWNCLASS_UNKNOWN)
+                g_rgClassStyleInfo[uKnown] = (BYTE)(i + 1);
+        }
+
+        g_fClassStyleInfoBuilt = TRUE;
+    }
+
+    if (uClass == KNOWNCLASS_UNKNOWN || uClass >= KNOWNCLASS_COUNT || g_rgClassStyleInfo[uClass] == 0)
+        return NULL;
+
+    return &ClassStyleInfos[g_rgClassStyleInfo[uClass] - 1];
+}
+
+
+//
+// Looks for a style name in one table.  A definition that is the same
+// style as one already found only adds its classes to that term (the Edit
+// and RichEdit tables share the ES_ styles, for instance); a different
+// value or style word becomes an alternative term of its own.  Returns
+// FALSE if that doesn't fit in the query.
+//
+
+static BOOL AddStyleQueryMatch(StyleLookupEx *pTable, PCWSTR pszName, UINT iWord, ULONGLONG fClasses, STYLEQUERY *pQuery, UINT iFirst)
+{
+    for (StyleLookupEx *pStyle = pTable; pStyle->name; pStyle++)
+    {
+        if (_wcsicmp(pStyle->name, pszName) != 0)
+            continue;
+
+        DWORD dwMask    = pStyle->value | pStyle->extraMask;
+        DWORD dwDepMask = pStyle->dependencyValue | pStyle->dependencyExtraMask;
+
+        for (UINT t = iFirst; t < pQuery->cTerms; t++)
+        {
+            STYLEQUERYTERM *pTerm = &pQuery->rgTerms[t];
+
+            if (pTerm->iWord == iWord && pTerm->dwMask == dwMask && pTerm->dwValue == pStyle->value &&
+                pTerm->dwDepMask == dwDepMask && pTerm->dwDepValue == pStyle->dependencyValue)
+            {
+                pTerm->fClasses |= fClasses;
+                return TRUE;
+            }
+        }
+
+        if (pQuery->cTerms == MAX_STYLEQUERY_TERMS)
+            return FALSE;
+
+        STYLEQUERYTERM *pTerm = &pQuery->rgTerms[pQuery->cTerms];
+
+        ZeroMemory(pTerm, sizeof(*pTerm));
+        pTerm->dwMask       = dwMask;
+        pTerm->dwValue      = pStyle->value;
+        pTerm->dwDepMask    = dwDepMask;
+        pTerm->dwDepValue   = pStyle->dependencyValue;
+        pTerm->iWord        = iWord;
+        pTerm->fAlternative = pQuery->cTerms > iFirst;
+        pTerm->fClasses     = fClasses;
+
+        pQuery->cTerms++;
+        return TRUE;
+    }
+
+    return TRUE;
+}
+
+//
+// Adds the terms for one style name to the query.  Returns FALSE, with
+// the reason in pszError, if the name is unknown or there's no room.
+//
+
+static BOOL ResolveStyleQueryName(PCWSTR pszName, BOOL fNegate, STYLEQUERY *pQuery, PWSTR pszError, size_t cchError)
+{
+    UINT iFirst = pQuery->cTerms;
+    BOOL fRoom  = TRUE;
 
-    GetClassName(hwnd, szClassName, ARRAYSIZE(szClassName));
+    fRoom &= AddStyleQueryMatch(WindowStyles, pszName, STYLEQUERY_STYLE, STYLEQUERY_ALLCLASSES, pQuery, iFirst);
+    fRoom &= AddStyleQueryMatch(StyleExList, pszName, STYLEQUERY_EXSTYLE, STYLEQUERY_ALLCLASSES, pQuery, iFirst);
 
-    // Adjust the name for winforms.
-    ExtractWindowsFormsInnerClassName(szClassName);
+    for (UINT i = 0; i < ARRAYSIZE(ClassStyleInfos); i++)
+    {
+        ClassStyleInfo *pClassInfo = &ClassStyleInfos[i];
+        UINT            uKnown     = GetKnownClassFromName(pClassInfo->ClassName);
+        ULONGLONG       fClass     = 1ull << uKnown;
+
+        if (uKnown == KNOWNCLASS_UNKNOWN)
+            continue;
+
+        if (pClassInfo->Styles)
+            fRoom &= AddStyleQueryMatch(pClassInfo->Styles, pszName, STYLEQUERY_STYLE, fClass, pQuery, iFirst);
+
+        if (pClassInfo->UsesComctlStyles)
+            fRoom &= AddStyleQueryMatch(CommCtrlList, pszName, STYLEQUERY_STYLE, fClass, pQuery, iFirst);
+
+        if (pClassInfo->StylesExtra)
+            fRoom &= AddStyleQueryMatch(pClassInfo->StylesExtra, pszName, STYLEQUERY_EXTRA, fClass, pQuery, iFirst);
+    }
+
+    if (!fRoom)
+    {
+        wcscpy_s(pszError, cchError, L"Too many styles");
+        return FALSE;
+    }
+
+    if (pQuery->cTerms == iFirst)
+    {
+        swprintf_s(pszError, cchError, L"Unknown style: %s", pszName);
+        return FALSE;
+    }
+
+    for (UINT t = iFirst; t < pQuery->cTerms; t++)
+    {
+        pQuery->rgTerms[t].fNegate = fNegate;
+    }
+
+    return TRUE;
+}
+
+
+//
+// Parses a style query: style names separated by spaces, each of which
+// must be present, or absent if prefixed with '!' or '-'.  On failure the
+// offending name (or the reason) ends up in pszError.
+//
+
+BOOL ParseStyleQuery(PCWSTR pszQuery, STYLEQUERY *pQuery, PWSTR pszError, size_t cchError)
+{
+    PCWSTR psz = pszQuery;
 
-    for (INT i = 0; i < ARRAYSIZE(ClassStyleInfos); i++)
+    ZeroMemory(pQuery, sizeof(*pQuery));
+
+    for (;;)
     {
-        if (_wcsicmp(szClassName, ClassStyleInfos[i].ClassName) == 0)
+        WCHAR szName[MAX_STYLE_NAME_CCH];
+        BOOL   fNegate = FALSE;
+        size_t cch = 0;
+
+        while (iswspace(*psz))
+            psz++;
+
+        if (*psz == L'\0')
+            break;
+
+        if (*psz == L'!' || *psz == L'-')
+        {
+            fNegate = TRUE;
+            psz++;
+        }
+
+        while (*psz && !iswspace(*psz))
         {
-            return &ClassStyleInfos[i];
+            if (cch < ARRAYSIZE(szName) - 1)
+                szName[cch++] = *psz;
+            psz++;
         }
+
+        szName[cch] = L'\0';
+
+        if (!ResolveStyleQueryName(szName, fNegate, pQuery, pszError, cchError))
+            return FALSE;
+    }
+
+    if (pQuery->cTerms == 0)
+    {
+        wcscpy_s(pszError, cchError, L"No styles given");
+        return FALSE;
     }
 
-    return NULL;
+    return TRUE;
 }
 
 
@@ -842,6 +1017,16 @@ DWORD AddStylesToList(StyleLookupEx *StyleList, HWND hwndList, DWORD dwStyles, B
     BOOL           fPresent;
     StyleLookupEx *pStyle;
 
+    const STYLEDECODER *pDecoder = StyleDecoder_Get(StyleList);
+    ULONGLONG           fMatches = 0;
+
+    // The decoder works out which styles are present in one go, and what
+    // is left over.
+    if (pDecoder)
+    {
+        fMatches = StyleDecoder_Decode(pDecoder, dwOrig, &dwStyles);
+    }
+
     //
     //  Loop through all of the styles that we know about
     //  Check each style against our window's one, to see
@@ -851,7 +1036,10 @@ DWORD AddStylesToList(StyleLookupEx *StyleList, HWND hwndList, DWORD dwStyles, B
     {
         pStyle = &StyleList[i];
 
-        fPresent = StyleApplicableAndPresent(dwOrig, pStyle);
+        if (pDecoder)
+            fPresent = (BOOL)((fMatches >> i) & 1);
+        else
+            fPresent = StyleApplicableAndPresent(dwOrig, pStyle);
 
         // Now add the style.
         if (fPresent || fAllStyles)
@@ -1068,9 +1256,9 @@ void ResetStyleTab(HWND hwnd, HWND hwndDlg)
 
     PCWSTR pszMessage = hwnd ? szInvalidWindow : L"";
 
-    SetDlgItemText(hwndDlg, IDC_STYLE,    pszMessage);
-    SetDlgItemText(hwndDlg, IDC_STYLEEX,  pszMessage);
-    SetDlgItemText(hwndDlg, IDC_STYLEEXT, pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_STYLE,    pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_STYLEEX,  pszMessage);
+    SetDlgItemTextEx(hwndDlg, IDC_STYLEEXT, pszMessage);
 
     // Clear the listboxes.
 
@@ -1205,3 +1393,18 @@ void UpdateStyleTab(HWND hwnd)
 
     s_hwndCurrent = hwnd;
 }
+
+//
+// Probe for the auto-update timer.  Control-specific extended styles need a
+// message to read, so they are left to the next full update.
+//
+
+ULONGLONG ProbeStyleTab(HWND hwnd)
+{
+    DWORD rgStyles[2];
+
+    rgStyles[0] = GetWindowLong(hwnd, GWL_STYLE);
+    rgStyles[1] = GetWindowLong(hwnd, GWL_EXSTYLE);
+
+    return HashProbeData(PROBE_HASH_INIT, rgStyles, sizeof(rgStyles));
+}
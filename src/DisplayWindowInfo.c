@@ -10,67 +10,146 @@
 
 #include "WinSpy.h"
 
+#include <malloc.h>
 #include "resource.h"
 #include "Utils.h"
 
-static BOOL CALLBACK ChildWindowProc(HWND hwnd, LPARAM lParam)
+//
+//  Both lists are virtual (LVS_OWNERDATA).  They only hold the handles,
+//  the text for the rows on screen is fetched when the listview asks.
+//
+typedef struct
+{
+    HWND *rgHwnd;
+    UINT  cHwnd;
+    UINT  cAlloc;
+}
+WINDOWLIST;
+
+#define MAX_USER_HANDLES    0x10000
+
+static WINDOWLIST g_ChildList;      // IDC_LIST1
+static WINDOWLIST g_SiblingList;    // IDC_LIST2
+static WINDOWLIST g_NewList;        // Compared with what's shown
+
+static WINDOWLIST *GetWindowList(UINT_PTR uListId)
+{
+    return (uListId == IDC_LIST1) ? &g_ChildList : &g_SiblingList;
+}
+
+static BOOL AddToWindowList(WINDOWLIST *pList, HWND hwnd)
 {
-    WCHAR  ach[256];
-    WCHAR  cname[256];
-    WCHAR  wname[256];
-    LVITEM lvitem;
-
-    //only display 1st generation (1-deep) children -
-    //(don't display child windows of child windows)
-    if (GetRealParent(hwnd) == g_hCurWnd)
+    if (pList->cHwnd == pList->cAlloc)
     {
-        GetClassName(hwnd, cname, ARRAYSIZE(cname));
-        GetWindowText(hwnd, wname, ARRAYSIZE(wname));
-        swprintf_s(ach, ARRAYSIZE(ach), L"%08X", (UINT)(UINT_PTR)hwnd);
-
-        lvitem.mask = LVIF_TEXT | LVIF_IMAGE | LVIF_PARAM | LVIF_STATE;
-        lvitem.iSubItem = 0;
-        lvitem.pszText = ach;
-        lvitem.iItem = 0;
-        lvitem.state = 0;
-        lvitem.stateMask = 0;
-        lvitem.iImage = 0;
-
-        ListView_InsertItem((HWND)lParam, &lvitem);
-        ListView_SetItemText((HWND)lParam, 0, 1, cname);
-        ListView_SetItemText((HWND)lParam, 0, 2, wname);
+        UINT  cAlloc = pList->cAlloc ? pList->cAlloc * 2 : 64;
+        HWND *rgNew  = (HWND *)realloc(pList->rgHwnd, cAlloc * sizeof(HWND));
+
+        if (!rgNew)
+            return FALSE;
+
+        pList->rgHwnd = rgNew;
+        pList->cAlloc = cAlloc;
     }
+
+    pList->rgHwnd[pList->cHwnd++] = hwnd;
     return TRUE;
 }
 
-static BOOL CALLBACK SiblingWindowProc(HWND hwnd, LPARAM lParam)
+//
+//  Collect hwndAny and the other windows at its level, except hwndExclude.
+//  Unlike EnumChildWindows this doesn't descend into their children.  The
+//  lists have always shown the bottom-most window first, so walk up from
+//  the bottom.
+//
+static void FillWindowList(WINDOWLIST *pList, HWND hwndAny, HWND hwndExclude)
 {
-    WCHAR  ach[256];
-    WCHAR  cname[256];
-    WCHAR  wname[256];
-    LVITEM lvitem;
+    HWND hwnd = hwndAny ? GetWindow(hwndAny, GW_HWNDLAST) : NULL;
+
+    pList->cHwnd = 0;
 
-    //sibling windows must share the same parent
-    if (g_hCurWnd != hwnd && GetRealParent(hwnd) == GetRealParent(g_hCurWnd))
+    // A window moving in z-order meanwhile could send us round in circles,
+    // but there can't be more windows than USER handles.
+    for ( ; hwnd && pList->cHwnd < MAX_USER_HANDLES; hwnd = GetWindow(hwnd, GW_HWNDPREV))
     {
-        GetClassName(hwnd, cname, ARRAYSIZE(cname));
-        GetWindowText(hwnd, wname, ARRAYSIZE(wname));
-        swprintf_s(ach, ARRAYSIZE(ach), L"%08X", (UINT)(UINT_PTR)hwnd);
-
-        lvitem.mask = LVIF_TEXT | LVIF_IMAGE | LVIF_PARAM | LVIF_STATE;
-        lvitem.iSubItem = 0;
-        lvitem.pszText = ach;
-        lvitem.iItem = 0;
-        lvitem.state = 0;
-        lvitem.stateMask = 0;
-        lvitem.iImage = 0;
-
-        ListView_InsertItem((HWND)lParam, &lvitem);
-        ListView_SetItemText((HWND)lParam, 0, 1, cname);
-        ListView_SetItemText((HWND)lParam, 0, 2, wname);
+        if (hwnd != hwndExclude && !AddToWindowList(pList, hwnd))
+            break;
     }
+}
 
-    return TRUE;
+//
+//  Refill one of the lists.  If the same windows are there as before, the
+//  selection and scroll position are kept and only the text is refreshed.
+//
+static void UpdateWindowList(HWND hwndList, WINDOWLIST *pList, HWND hwndAny, HWND hwndExclude)
+{
+    WINDOWLIST list;
+
+    FillWindowList(&g_NewList, hwndAny, hwndExclude);
+
+    if (g_NewList.cHwnd == pList->cHwnd &&
+        (pList->cHwnd == 0 || memcmp(g_NewList.rgHwnd, pList->rgHwnd, pList->cHwnd * sizeof(HWND)) == 0))
+    {
+        int iTop = ListView_GetTopIndex(hwndList);
+
+        ListView_RedrawItems(hwndList, iTop, iTop + ListView_GetCountPerPage(hwndList));
+        return;
+    }
+
+    list      = *pList;
+    *pList    = g_NewList;
+    g_NewList = list;
+
+    // Deleting first drops the old selection and scroll position
+    ListView_DeleteAllItems(hwndList);
+    ListView_SetItemCountEx(hwndList, pList->cHwnd, 0);
+}
+
+//
+//  LVN_GETDISPINFO for either list on the Windows tab
+//
+void GetWindowTabDispInfo(NMLVDISPINFO *pdi)
+{
+    WINDOWLIST *pList = GetWindowList(pdi->hdr.idFrom);
+    LVITEM     *pItem = &pdi->item;
+    HWND        hwnd;
+
+    if (!(pItem->mask & LVIF_TEXT) || pItem->cchTextMax <= 0)
+        return;
+
+    pItem->pszText[0] = L'\0';
+
+    if (pItem->iItem < 0 || (UINT)pItem->iItem >= pList->cHwnd)
+        return;
+
+    hwnd = pList->rgHwnd[pItem->iItem];
+
+    switch (pItem->iSubItem)
+    {
+    case 0:
+        swprintf_s(pItem->pszText, pItem->cchTextMax, L"%08X", (UINT)(UINT_PTR)hwnd);
+        break;
+
+    case 1:
+        GetClassName(hwnd, pItem->pszText, pItem->cchTextMax);
+        break;
+
+    case 2:
+        GetWindowText(hwnd, pItem->pszText, pItem->cchTextMax);
+        break;
+    }
+}
+
+//
+//  The window shown in a row of either list, or NULL
+//
+HWND GetWindowTabItem(UINT_PTR uListId, int iItem)
+{
+    WINDOWLIST *pList = GetWindowList(uListId);
+
+    if (iItem < 0 || (UINT)iItem >= pList->cHwnd)
+        return NULL;
+
+    return pList->rgHwnd[iItem];
 }
 
 //
@@ -82,27 +161,24 @@ void UpdateWindowTab(HWND hwnd)
     HWND hParentWnd = NULL;
     WCHAR ach[10];
 
-    HWND hwndList1 = GetDlgItem(WinSpyTab[WINDOW_TAB].hwnd, IDC_LIST1);
-    HWND hwndList2 = GetDlgItem(WinSpyTab[WINDOW_TAB].hwnd, IDC_LIST2);
+    HWND hwndDlg = WinSpyTab[WINDOW_TAB].hwnd;
+    HWND hwndList1 = GetDlgItem(hwndDlg, IDC_LIST1);
+    HWND hwndList2 = GetDlgItem(hwndDlg, IDC_LIST2);
     HWND hwndLink;
 
-    ListView_DeleteAllItems(hwndList1);
-    ListView_DeleteAllItems(hwndList2);
-
-
-    // Get all children of the window
     if (hwnd)
     {
-        EnumChildWindows(hwnd, ChildWindowProc, (LPARAM)hwndList1);
-
-        // Get children of its PARENT (i.e, its siblings!)
         hParentWnd = GetRealParent(hwnd);
-        if (hParentWnd)
-            EnumChildWindows(hParentWnd, SiblingWindowProc, (LPARAM)hwndList2);
     }
 
+    // Direct children of the window
+    UpdateWindowList(hwndList1, &g_ChildList, hwnd ? GetWindow(hwnd, GW_CHILD) : NULL, NULL);
+
+    // Children of its PARENT (i.e, its siblings!)
+    UpdateWindowList(hwndList2, &g_SiblingList, hParentWnd ? hwnd : NULL, hwnd);
+
     // Set the Parent hyperlink
-    hwndLink = GetDlgItem(WinSpyTab[WINDOW_TAB].hwnd, IDC_PARENT);
+    hwndLink = GetDlgItem(hwndDlg, IDC_PARENT);
 
     if (hParentWnd)
     {
@@ -113,13 +189,13 @@ void UpdateWindowTab(HWND hwnd)
         *ach = 0;
     }
 
-    SetWindowText(hwndLink, ach);
+    SetDlgItemTextEx(hwndDlg, IDC_PARENT, ach);
     EnableWindow(hwndLink, (*ach != 0));
 
     // Set the Owner hyperlink
     HWND hwndOwner = hwnd ? GetWindow(hwnd, GW_OWNER) : NULL;
 
-    hwndLink = GetDlgItem(WinSpyTab[WINDOW_TAB].hwnd, IDC_OWNER);
+    hwndLink = GetDlgItem(hwndDlg, IDC_OWNER);
 
     if (hwndOwner)
     {
@@ -130,6 +206,39 @@ void UpdateWindowTab(HWND hwnd)
         *ach = 0;
     }
 
-    SetWindowText(hwndLink, ach);
+    SetDlgItemTextEx(hwndDlg, IDC_OWNER, ach);
     EnableWindow(hwndLink, (*ach != 0));
 }
+
+static ULONGLONG HashWindowLevel(ULONGLONG hash, HWND hwndAny)
+{
+    HWND hwnd = hwndAny ? GetWindow(hwndAny, GW_HWNDFIRST) : NULL;
+
+    for (UINT i = 0; hwnd && i < MAX_USER_HANDLES; i++, hwnd = GetWindow(hwnd, GW_HWNDNEXT))
+    {
+        hash = HashProbeData(hash, &hwnd, sizeof(hwnd));
+    }
+
+    return hash;
+}
+
+//
+//  Probe for the auto-update timer.  Window text in the lists is only
+//  refreshed by full updates.
+//
+ULONGLONG ProbeWindowTab(HWND hwnd)
+{
+    ULONGLONG hash = PROBE_HASH_INIT;
+    HWND      rgRelatives[2];
+
+    rgRelatives[0] = GetRealParent(hwnd);
+    rgRelatives[1] = GetWindow(hwnd, GW_OWNER);
+
+    hash = HashProbeData(hash, rgRelatives, sizeof(rgRelatives));
+    hash = HashWindowLevel(hash, GetWindow(hwnd, GW_CHILD));
+
+    if (rgRelatives[0])
+        hash = HashWindowLevel(hash, hwnd);
+
+    return hash;
+}
@@ -51,8 +51,6 @@
 #include "resource.h"
 #include "CaptureWindow.h"
 
-HWND CreateOverlayWindow(HWND hwndToCover);
-
 static LONG    g_lRefCount = 0;
 
 //
@@ -71,12 +69,24 @@ static WNDPROC oldstaticproc;
 
 static BOOL    g_fDragging;
 static HWND    g_hwndFinder;    // The active finder tool window
-static HWND    g_hwndOverlay;   // The overlay/highlight window
 static HWND    g_hwndCurrent;   // The currently selected window
 static HWND    g_hwndOldFocus;  // Who had focus before we took it
 static POINT   g_ptLast;        // Position of last mouse move
 static HCURSOR g_hOldCursor;
 static BOOL    g_fAltDown;      // Is the alt key pressed?
+static RECT    g_rcStable;      // Moving within here can't change the selection
+static BOOL    g_fMoveTimer;    // Mouse moves are being coalesced
+static BOOL    g_fMovePending;  // A mouse move is waiting for the timer
+
+static FINDTOOLSTATS g_Stats;   // Counters for the current/last drag
+
+//
+// Mouse moves are applied at most once per display frame.  The first move
+// is applied straight away and starts the timer; any further moves before
+// it fires are merged into one.
+//
+#define MOVE_TIMER_ID       1
+#define MOVE_TIMER_INTERVAL 16
 
 
 void LoadFinderResources()
@@ -93,17 +103,18 @@ void FreeFinderResources()
     DeleteObject(hBitmapDrag2);
 
     DestroyCursor(hCursor);
+
+    DestroyOverlayResources();
 }
 
 void FindTool_ShowOverlay()
 {
-    g_hwndOverlay = CreateOverlayWindow(g_hwndCurrent);
+    ShowOverlayWindow(g_hwndCurrent);
 }
 
 void FindTool_RemoveOverlay()
 {
-    DestroyWindow(g_hwndOverlay);
-    g_hwndOverlay = NULL;
+    HideOverlayWindow();
 }
 
 UINT FindTool_FireNotify(UINT uCode, HWND hwnd)
@@ -147,14 +158,31 @@ void FindTool_UpdateSelectionFromPoint(POINT pt)
 
     ClientToScreen(g_hwndFinder, (POINT *)&pt);
 
+    // Still over the same window, and nothing smaller could be under the
+    // mouse instead, nor another window in front of it.
+    if (PtInRect(&g_rcStable, pt) && WindowFromPointEx_CheckStable(pt))
+    {
+        return;
+    }
+
+    g_Stats.cHitTests++;
+
     hwndPoint = WindowFromPointEx(pt, g_fAltDown, g_opts.fShowHidden);
 
+    WindowFromPointEx_GetStableRect(&g_rcStable);
+
     if (hwndPoint && (hwndPoint != g_hwndCurrent))
     {
+        g_Stats.cSelChanges++;
         FindTool_FireNotify(WFN_SELCHANGED, hwndPoint);
     }
 }
 
+void FindTool_GetStats(FINDTOOLSTATS *pStats)
+{
+    *pStats = g_Stats;
+}
+
 void FindTool_BeginDrag(HWND hwnd, LPARAM lParam)
 {
     g_ptLast.x = (short)LOWORD(lParam);
@@ -168,6 +196,10 @@ void FindTool_BeginDrag(HWND hwnd, LPARAM lParam)
         g_fDragging = TRUE;
         g_fAltDown = ((GetKeyState(VK_MENU) & 0x8000) != 0);
 
+        ZeroMemory(&g_Stats, sizeof(g_Stats));
+        SetRectEmpty(&g_rcStable);
+        WindowFromPointEx_BeginCache();
+
         SendMessage(hwnd, STM_SETIMAGE, IMAGE_BITMAP, (LPARAM)hBitmapDrag2);
 
         SetCapture(hwnd);
@@ -188,8 +220,20 @@ void FindTool_EndDrag(UINT uCode)
 {
     if (g_fDragging)
     {
+        // Catch up with the final mouse position.
+        if (uCode == WFN_END && g_fMovePending)
+        {
+            FindTool_UpdateSelectionFromPoint(g_ptLast);
+        }
+
+        KillTimer(g_hwndFinder, MOVE_TIMER_ID);
+        g_fMoveTimer = FALSE;
+        g_fMovePending = FALSE;
+
         g_fDragging = FALSE;
 
+        WindowFromPointEx_EndCache();
+
         FindTool_RemoveOverlay();
         ReleaseCapture();
         SetFocus(g_hwndOldFocus);
@@ -225,14 +269,48 @@ LRESULT CALLBACK StaticProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
             pt.x = (short)LOWORD(lParam);
             pt.y = (short)HIWORD(lParam);
 
+            g_Stats.cMoves++;
+
             if (!(g_ptLast.x == pt.x && g_ptLast.y == pt.y))
             {
                 g_ptLast = pt;
-                FindTool_UpdateSelectionFromPoint(pt);
+
+                if (g_fMoveTimer)
+                {
+                    g_fMovePending = TRUE;
+                }
+                else
+                {
+                    FindTool_UpdateSelectionFromPoint(pt);
+
+                    SetTimer(hwnd, MOVE_TIMER_ID, MOVE_TIMER_INTERVAL, NULL);
+                    g_fMoveTimer = TRUE;
+                }
             }
         }
         return 0;
 
+    case WM_TIMER:
+
+        if (wParam == MOVE_TIMER_ID)
+        {
+            if (g_fDragging && g_fMovePending)
+            {
+                g_fMovePending = FALSE;
+                FindTool_UpdateSelectionFromPoint(g_ptLast);
+            }
+            else
+            {
+                // The mouse has stopped, so the next move can go straight
+                // through.
+                KillTimer(hwnd, MOVE_TIMER_ID);
+                g_fMoveTimer = FALSE;
+            }
+
+            return 0;
+        }
+        break;
+
     case WM_LBUTTONUP:
 
         // Mouse has been released, so end the find-tool
@@ -286,6 +364,7 @@ LRESULT CALLBACK StaticProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         else if (wParam == VK_MENU) // Alt Key
         {
             g_fAltDown = !newStateReleased;
+            SetRectEmpty(&g_rcStable);
             FindTool_UpdateSelectionFromPoint(g_ptLast);
         }
 
@@ -24,8 +24,31 @@ typedef UINT(CALLBACK * WNDFINDPROC) (HWND hwndTool, UINT uCode, HWND hwnd);
 
 BOOL MakeFinderTool(HWND hwnd, WNDFINDPROC wfp);
 
+//
+//  Counters for the current or most recent drag, to show how much work
+//  the mouse move coalescing and hit-test early-out save.  The About box
+//  shows them.
+//
+typedef struct
+{
+    UINT cMoves;        // WM_MOUSEMOVE messages received
+    UINT cHitTests;     // WindowFromPointEx calls
+    UINT cSelChanges;   // WFN_SELCHANGED notifications (tab updates)
+} FINDTOOLSTATS;
+
+void FindTool_GetStats(FINDTOOLSTATS *pStats);
+
 void FlashWindowBorder(HWND hwnd);
 
+//
+//  Selection overlay windows (FindToolTrans.c)
+//
+HWND CreateOverlayWindow(PCWSTR pszClassName);
+BOOL CoverWindowWithOverlay(HWND hwndOverlay, HWND hwndToCover);
+void ShowOverlayWindow(HWND hwndToCover);
+void HideOverlayWindow();
+void DestroyOverlayResources();
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,23 +10,113 @@
 #include "WinSpy.h"
 
 #include "Utils.h"
+#include "FindTool.h"
 #include "resource.h"
 
 
 #define WC_TRANSWINDOW  TEXT("TransparentWindow")
 
-HBITMAP MakeDockPanelBitmap(SIZE outputSize)
+//
+// Selection frame bitmaps, expanded from the nine-grid image for each
+// size of window covered.  The finder tends to go back and forth between
+// the same few windows, so the last few sizes are kept.  The total size is
+// capped as well, since a frame for a maximized window is a screen-sized
+// bitmap.
+//
+#define MAX_FRAME_BITMAPS   8
+#define MAX_FRAME_PIXELS    (8 * 1024 * 1024)
+
+typedef struct
+{
+    SIZE    size;
+    HBITMAP hbmp;
+    UINT    uLastUse;
+} FrameBitmap;
+
+static FrameBitmap g_rgFrames[MAX_FRAME_BITMAPS];
+static UINT        g_uFrameUse;
+static HBITMAP     g_hbmBox;
+
+static HDC         g_hdcOverlay;        // Memory DC for UpdateLayeredWindow
+static HWND        g_hwndOverlay;       // The finder's overlay window
+
+static LONGLONG FramePixels(const FrameBitmap *pFrame)
+{
+    return (LONGLONG)pFrame->size.cx * pFrame->size.cy;
+}
+
+static void FreeFrame(FrameBitmap *pFrame)
+{
+    DeleteObject(pFrame->hbmp);
+    ZeroMemory(pFrame, sizeof(*pFrame));
+}
+
+//
+// Returns the selection frame bitmap for the specified size.  The bitmap
+// belongs to the cache, and stays valid until the next call.
+//
+static HBITMAP GetFrameBitmap(SIZE size)
 {
-    static HBITMAP hbmBox;
+    FrameBitmap *pFrame = NULL;
+    LONGLONG     cPixels = (LONGLONG)size.cx * size.cy;
+    int          i;
+
+    g_uFrameUse++;
 
-    if (hbmBox == 0)
+    for (i = 0; i < MAX_FRAME_BITMAPS; i++)
     {
-        hbmBox = LoadPNGImage(IDB_SELBOX, NULL);
+        if (g_rgFrames[i].hbmp && g_rgFrames[i].size.cx == size.cx && g_rgFrames[i].size.cy == size.cy)
+        {
+            g_rgFrames[i].uLastUse = g_uFrameUse;
+            return g_rgFrames[i].hbmp;
+        }
+    }
+
+    // Make room, dropping the least recently used frames.
+
+    for (;;)
+    {
+        FrameBitmap *pOldest = NULL;
+        LONGLONG     cTotal  = cPixels;
+
+        pFrame = NULL;
+
+        for (i = 0; i < MAX_FRAME_BITMAPS; i++)
+        {
+            if (!g_rgFrames[i].hbmp)
+            {
+                pFrame = &g_rgFrames[i];
+                continue;
+            }
+
+            cTotal += FramePixels(&g_rgFrames[i]);
+
+            if (!pOldest || g_uFrameUse - g_rgFrames[i].uLastUse > g_uFrameUse - pOldest->uLastUse)
+            {
+                pOldest = &g_rgFrames[i];
+            }
+        }
+
+        if (pFrame && (cTotal <= MAX_FRAME_PIXELS || !pOldest))
+        {
+            break;
+        }
+
+        FreeFrame(pOldest);
+    }
+
+    if (g_hbmBox == 0)
+    {
+        g_hbmBox = LoadPNGImage(IDB_SELBOX, NULL);
     }
 
     RECT edges = { 2, 2, 2, 2 };
 
-    return ExpandNineGridImage(outputSize, hbmBox, edges);
+    pFrame->size     = size;
+    pFrame->hbmp     = ExpandNineGridImage(size, g_hbmBox, edges);
+    pFrame->uLastUse = g_uFrameUse;
+
+    return pFrame->hbmp;
 }
 
 
@@ -45,16 +135,82 @@ LRESULT CALLBACK TransparentWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
 }
 
 //
-// Creates a transparent overlay window of the same size and position of
-// an existing window.
+// Creates a hidden layered window for covering other windows with the
+// selection frame.
 //
-HWND CreateOverlayWindow(HWND hwndToCover)
+HWND CreateOverlayWindow(PCWSTR pszClassName)
 {
-    HWND hwnd;
-    HBITMAP hbmp;
-    RECT rc;
-    SIZE size;
+    return CreateWindowEx(
+        WS_EX_TOOLWINDOW | WS_EX_LAYERED,
+        pszClassName,
+        0,
+        WS_POPUP,
+        0, 0, 0, 0,
+        0, 0, 0,
+        NULL);
+}
+
+//
+// Moves and resizes a layered overlay window to cover an existing window,
+// and shows it.  The window is reused as is, and the frame bitmap comes
+// from the cache, so normally nothing is allocated.
+//
+BOOL CoverWindowWithOverlay(HWND hwndOverlay, HWND hwndToCover)
+{
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 220, AC_SRC_ALPHA };
+    POINT         ptZero = { 0, 0 };
+    POINT         pt;
+    SIZE          size;
+    RECT          rc;
+    HBITMAP       hbmp;
+
+    GetWindowRect(hwndToCover, &rc);
+
+    pt.x    = rc.left;
+    pt.y    = rc.top;
+    size.cx = GetRectWidth(&rc);
+    size.cy = GetRectHeight(&rc);
+
+    if (size.cx <= 0 || size.cy <= 0)
+    {
+        ShowWindow(hwndOverlay, SW_HIDE);
+        return FALSE;
+    }
 
+    if (!g_hdcOverlay)
+    {
+        g_hdcOverlay = CreateCompatibleDC(NULL);
+    }
+
+    hbmp = GetFrameBitmap(size);
+
+    if (!g_hdcOverlay || !hbmp)
+    {
+        return FALSE;
+    }
+
+    HANDLE hbmpOld = SelectObject(g_hdcOverlay, hbmp);
+
+    UpdateLayeredWindow(hwndOverlay, NULL, &pt, &size, g_hdcOverlay, &ptZero, RGB(0, 0, 0), &blend, ULW_ALPHA);
+
+    SelectObject(g_hdcOverlay, hbmpOld);
+
+    SetWindowPos(
+        hwndOverlay,
+        HWND_TOPMOST,
+        0, 0, 0, 0,
+        SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE | SWP_SHOWWINDOW);
+
+    return TRUE;
+}
+
+//
+// Shows the finder's overlay window over the specified window.  There is
+// only the one overlay window, which is hidden rather than destroyed
+// between uses.
+//
+void ShowOverlayWindow(HWND hwndToCover)
+{
     // Initialize window class on first use.
     static BOOL fInitializedWindowClass = FALSE;
 
@@ -71,32 +227,46 @@ HWND CreateOverlayWindow(HWND hwndToCover)
         fInitializedWindowClass = TRUE;
     }
 
-    GetWindowRect(hwndToCover, &rc);
+    if (!g_hwndOverlay)
+    {
+        g_hwndOverlay = CreateOverlayWindow(WC_TRANSWINDOW);
+    }
 
-    hwnd = CreateWindowEx(
-        WS_EX_TOOLWINDOW | WS_EX_LAYERED,
-        WC_TRANSWINDOW,
-        0,
-        WS_POPUP,
-        rc.left, rc.top,
-        GetRectWidth(&rc),
-        GetRectHeight(&rc),
-        0, 0, 0,
-        NULL);
+    if (g_hwndOverlay)
+    {
+        CoverWindowWithOverlay(g_hwndOverlay, hwndToCover);
+    }
+}
 
-    size.cx = GetRectWidth(&rc);
-    size.cy = GetRectHeight(&rc);
-    hbmp = MakeDockPanelBitmap(size);
+void HideOverlayWindow()
+{
+    if (g_hwndOverlay)
+    {
+        ShowWindow(g_hwndOverlay, SW_HIDE);
+    }
+}
 
-    UpdateLayeredWindowContent(hwnd, rc, hbmp, 220);
+//
+// Frees the overlay window and the cached frames.
+//
+void DestroyOverlayResources()
+{
+    int i;
 
-    DeleteObject(hbmp);
+    if (g_hwndOverlay)
+    {
+        DestroyWindow(g_hwndOverlay);
+        g_hwndOverlay = NULL;
+    }
 
-    SetWindowPos(
-        hwnd,
-        HWND_TOPMOST,
-        0, 0, 0, 0,
-        SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE | SWP_SHOWWINDOW);
+    for (i = 0; i < MAX_FRAME_BITMAPS; i++)
+    {
+        FreeFrame(&g_rgFrames[i]);
+    }
 
-    return hwnd;
+    if (g_hdcOverlay)
+    {
+        DeleteDC(g_hdcOverlay);
+        g_hdcOverlay = NULL;
+    }
 }
@@ -13,6 +13,12 @@
 #define FLASH_TIMER_FREQUENCY   200
 #define FLASH_TIMER_ITERATIONS  5
 
+//
+// There is only one flash window.  It is hidden rather than destroyed once
+// it has finished flashing, and flashing another window starts it over.
+//
+static HWND g_hwndFlash;
+
 LRESULT CALLBACK FlashWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     if (msg == WM_TIMER)
@@ -21,7 +27,8 @@ LRESULT CALLBACK FlashWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
         if (iteration == FLASH_TIMER_ITERATIONS)
         {
-            DestroyWindow(hwnd);
+            KillTimer(hwnd, FLASH_TIMER_ID);
+            ShowWindow(hwnd, SW_HIDE);
         }
         else
         {
@@ -30,39 +37,20 @@ LRESULT CALLBACK FlashWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
             ShowWindow(hwnd, fHide ? SW_HIDE : SW_SHOWNOACTIVATE);
 
             SetWindowLongPtr(hwnd, GWLP_USERDATA, iteration + 1);
-
-            SetTimer(hwnd, FLASH_TIMER_ID, FLASH_TIMER_FREQUENCY, NULL);
         }
     }
-
-    return DefWindowProc(hwnd, msg, wParam, lParam);
-}
-
-HBITMAP MakeFlashWindowBitmap(RECT rc)
-{
-    static HBITMAP hbmBox;
-
-    if (hbmBox == 0)
+    else if (msg == WM_NCDESTROY)
     {
-        hbmBox = LoadPNGImage(IDB_SELBOX, NULL);
+        g_hwndFlash = NULL;
     }
 
-    RECT edges = { 2, 2, 2, 2 };
-    SIZE size;
-
-    size.cx = GetRectWidth(&rc);
-    size.cy = GetRectHeight(&rc);
-
-    return ExpandNineGridImage(size, hbmBox, edges);
+    return DefWindowProc(hwnd, msg, wParam, lParam);
 }
 
 HWND CreateFlashWindow(HWND hwndToCover)
 {
     static BOOL fInitializedWindowClass = FALSE;
 
-    RECT rc;
-    HWND hwnd;
-
     if (!fInitializedWindowClass)
     {
         WNDCLASSEX wc = { sizeof(wc) };
@@ -76,37 +64,21 @@ HWND CreateFlashWindow(HWND hwndToCover)
         fInitializedWindowClass = TRUE;
     }
 
-    GetWindowRect(hwndToCover, &rc);
-
-    hwnd = CreateWindowEx(
-              WS_EX_TOOLWINDOW | WS_EX_LAYERED,
-              WC_FLASHWINDOW,
-              0,
-              WS_POPUP,
-              rc.left, rc.top,
-              rc.right - rc.left,
-              rc.bottom - rc.top,
-              0, 0, 0,
-              NULL);
-
-    if (hwnd)
+    if (!g_hwndFlash)
     {
-        HBITMAP hbmp = MakeFlashWindowBitmap(rc);
-        UpdateLayeredWindowContent(hwnd, rc, hbmp, 220);
-        DeleteObject(hbmp);
+        g_hwndFlash = CreateOverlayWindow(WC_FLASHWINDOW);
+    }
 
-        SetWindowPos(
-            hwnd,
-            HWND_TOPMOST,
-            0, 0, 0, 0,
-            SWP_NOMOVE|SWP_NOSIZE|SWP_NOACTIVATE|SWP_SHOWWINDOW);
+    if (g_hwndFlash && CoverWindowWithOverlay(g_hwndFlash, hwndToCover))
+    {
+        SetWindowLongPtr(g_hwndFlash, GWLP_USERDATA, 0);
 
-        SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+        SetTimer(g_hwndFlash, FLASH_TIMER_ID, FLASH_TIMER_FREQUENCY, NULL);
 
-        SetTimer(hwnd, FLASH_TIMER_ID, FLASH_TIMER_FREQUENCY, NULL);
+        return g_hwndFlash;
     }
 
-    return hwnd;
+    return NULL;
 }
 
 void FlashWindowBorder(HWND hwnd)
@@ -18,11 +18,20 @@
 #include "WinSpy.h"
 
 #include <psapi.h>
+#include <malloc.h>
+#include "InjectBatch.h"
 #include "InjectThread.h"
+#include "RemoteAgent.h"
+#include "TextBuffer.h"
+
+#define LONGTEXT_CHUNK  0x10000         // Characters per ReadProcessMemory
+#define GETTEXT_TIMEOUT 100             // Per WM_GETTEXT
+#define BATCH_TEXT_TIMEOUT  5000        // All of a batch's WM_GETTEXTs, well inside INJECT_TIMEOUT
 
 typedef BOOL(WINAPI *PROCGETCLASSINFOEXW)(HINSTANCE, PCWSTR, WNDCLASSEXW*);
 typedef LONG_PTR(WINAPI *PROCGETWINDOWLONGPTR)(HWND, int);
 typedef LRESULT(WINAPI *PROCSENDMESSAGETO)(HWND, UINT, WPARAM, LPARAM, UINT, UINT, PDWORD_PTR);
+typedef DWORD(WINAPI *PROCGETTICKCOUNT)(void);
 
 //
 //  Define a structure for the remote thread to use
@@ -46,6 +55,40 @@ typedef struct
     WCHAR       szText[200]; // Window text to retrieve
 } INJDATA;
 
+//
+//  Header of the data block for a batch of windows, see InjectBatch.h
+//
+typedef struct
+{
+    PROCGETCLASSINFOEXW   fnGetClassInfoExW;
+    PROCGETCLASSINFOEXW   fnGetClassInfoExA;
+    PROCGETWINDOWLONGPTR  fnGetWindowLongPtrW;
+    PROCGETWINDOWLONGPTR  fnGetWindowLongPtrA;
+    PROCSENDMESSAGETO     fnSendMessageTimeout;
+    PROCGETTICKCOUNT      fnGetTickCount;
+
+    DWORD                 dwTextTimeout;    // For all the WM_GETTEXTs together
+    INJBATCHLAYOUT        layout;
+    WNDCLASSEXW           wcScratch;   // Somewhere for GetClassInfoEx to write to
+} INJBATCHHEADER;
+
+//
+//  For reading text of any length.  The buffer is allocated in the target
+//  by us, the injected thread only fills it in.
+//
+typedef struct
+{
+    // Input starts
+    PROCSENDMESSAGETO     fnSendMessageTimeout;
+
+    HWND        hwnd;
+    WCHAR      *pszBuffer;      // In the target process
+    DWORD       cchBuffer;
+
+    // Output starts
+    DWORD_PTR   cchCopied;
+} INJTEXTDATA;
+
 #pragma runtime_checks("", off)
 // calls to the stack checking routine must be disabled
 #pragma check_stack(off)
@@ -103,6 +146,82 @@ static DWORD WINAPI GetDataProc(PVOID pParam)
 __declspec(code_seg(".inject$z"))
 static void AfterGetDataProc(void) { }
 
+//
+//  The same for a whole batch of windows.  Its code has to be kept apart
+//  from GetDataProc's so that each can be copied on its own.  A few slow
+//  windows mustn't make the whole batch time out, so the WM_GETTEXTs share
+//  one deadline, and the windows after it get no text.
+//
+__declspec(code_seg(".injbat$a"))
+static DWORD WINAPI GetBatchDataProc(PVOID pParam)
+{
+    INJBATCHHEADER       *pHeader = (INJBATCHHEADER *)pParam;
+    const INJBATCHLAYOUT *pLayout = &pHeader->layout;
+    DWORD_PTR             dwpResult;
+    DWORD                 dwStart = pHeader->fnGetTickCount();
+
+    for (UINT i = 0; i < pLayout->cWindows; i++)
+    {
+        INJWINDOWREQUEST *pRequest = INJBATCH_REQUEST(pHeader, pLayout, i);
+        INJWINDOWRESULT  *pResult  = INJBATCH_RESULT(pHeader, pLayout, i);
+
+        PROCGETWINDOWLONGPTR fnGetWindowLongPtr = pRequest->fUnicode ? pHeader->fnGetWindowLongPtrW : pHeader->fnGetWindowLongPtrA;
+        PROCGETCLASSINFOEXW  fnGetClassInfoEx   = pRequest->fUnicode ? pHeader->fnGetClassInfoExW : pHeader->fnGetClassInfoExA;
+
+        pResult->wndproc = (WNDPROC)fnGetWindowLongPtr(pRequest->hwnd, GWLP_WNDPROC);
+        pResult->clsproc = NULL;
+
+        pHeader->wcScratch.cbSize = sizeof(pHeader->wcScratch);
+
+        if (fnGetClassInfoEx(pRequest->hInst, (PCWSTR)(intptr_t)pRequest->atom, &pHeader->wcScratch))
+            pResult->clsproc = pHeader->wcScratch.lpfnWndProc;
+
+        if (pLayout->cchText)
+        {
+            WCHAR *pszText   = INJBATCH_TEXT(pHeader, pLayout, i);
+            DWORD  dwElapsed = pHeader->fnGetTickCount() - dwStart;
+
+            // Null-terminate in case the gettext fails
+            pszText[0] = L'\0';
+
+            if (dwElapsed < pHeader->dwTextTimeout)
+            {
+                pHeader->fnSendMessageTimeout(pRequest->hwnd, WM_GETTEXT,
+                    pLayout->cchText, (LPARAM)pszText,
+                    SMTO_ABORTIFHUNG, min((DWORD)GETTEXT_TIMEOUT, pHeader->dwTextTimeout - dwElapsed), &dwpResult);
+            }
+
+            pszText[pLayout->cchText - 1] = L'\0';
+        }
+    }
+
+    return TRUE;
+}
+
+__declspec(code_seg(".injbat$z"))
+static void AfterGetBatchDataProc(void) { }
+
+__declspec(code_seg(".injtxt$a"))
+static DWORD WINAPI GetLongTextProc(PVOID pParam)
+{
+    INJTEXTDATA *pInjData = (INJTEXTDATA *)pParam;
+
+    // Null-terminate in case the gettext fails
+    pInjData->pszBuffer[0] = L'\0';
+
+    if (!pInjData->fnSendMessageTimeout(pInjData->hwnd, WM_GETTEXT,
+        pInjData->cchBuffer, (LPARAM)pInjData->pszBuffer,
+        SMTO_ABORTIFHUNG, 5000, &pInjData->cchCopied))
+    {
+        pInjData->cchCopied = 0;
+    }
+
+    return TRUE;
+}
+
+__declspec(code_seg(".injtxt$z"))
+static void AfterGetLongTextProc(void) { }
+
 #pragma check_stack
 #pragma runtime_checks("", restore)
 
@@ -111,6 +230,49 @@ BOOL IsInsideModule(MODULEINFO *pModuleInfo, PVOID fn)
     return !fn || (pModuleInfo->lpBaseOfDll <= fn && (PVOID)((BYTE*)pModuleInfo->lpBaseOfDll + pModuleInfo->SizeOfImage) > fn);
 }
 
+BOOL IsBatchDataValid(INJBATCHHEADER *pHeader)
+{
+    // Same rules as IsInjectionDataValid
+    HMODULE hModUser32 = GetModuleHandle(L"user32.dll");
+    if (!hModUser32)
+        return FALSE;
+
+    MODULEINFO moduleInfo;
+    if (!GetModuleInformation(GetCurrentProcess(), hModUser32, &moduleInfo, sizeof(moduleInfo)))
+        return FALSE;
+
+    // GetTickCount is the one kernel32 function, which is also at the same
+    // address in every process.
+    HMODULE hModKernel32 = GetModuleHandle(L"kernel32.dll");
+    if (!hModKernel32)
+        return FALSE;
+
+    MODULEINFO kernelInfo;
+    if (!GetModuleInformation(GetCurrentProcess(), hModKernel32, &kernelInfo, sizeof(kernelInfo)))
+        return FALSE;
+
+    return (IsInsideModule(&moduleInfo, (PVOID)(intptr_t)pHeader->fnSendMessageTimeout) &&
+        IsInsideModule(&moduleInfo, (PVOID)(intptr_t)pHeader->fnGetWindowLongPtrW) &&
+        IsInsideModule(&moduleInfo, (PVOID)(intptr_t)pHeader->fnGetWindowLongPtrA) &&
+        IsInsideModule(&moduleInfo, (PVOID)(intptr_t)pHeader->fnGetClassInfoExW) &&
+        IsInsideModule(&moduleInfo, (PVOID)(intptr_t)pHeader->fnGetClassInfoExA) &&
+        IsInsideModule(&kernelInfo, (PVOID)(intptr_t)pHeader->fnGetTickCount));
+}
+
+BOOL IsLongTextDataValid(INJTEXTDATA *pInjData)
+{
+    // Same rules as IsInjectionDataValid
+    HMODULE hModUser32 = GetModuleHandle(L"user32.dll");
+    if (!hModUser32)
+        return FALSE;
+
+    MODULEINFO moduleInfo;
+    if (!GetModuleInformation(GetCurrentProcess(), hModUser32, &moduleInfo, sizeof(moduleInfo)))
+        return FALSE;
+
+    return pInjData->fnSendMessageTimeout && IsInsideModule(&moduleInfo, (PVOID)(intptr_t)pInjData->fnSendMessageTimeout);
+}
+
 BOOL IsInjectionDataValid(INJDATA *pInjData)
 {
     // It is only safe to inject this code if we are passing the addresses of functions in user32.dll (which is shared across all processes).
@@ -129,6 +291,45 @@ BOOL IsInjectionDataValid(INJDATA *pInjData)
         IsInsideModule(&moduleInfo, (PVOID)(intptr_t)pInjData->fnGetClassInfoEx));
 }
 
+//
+//  Ask the process's agent instead of injecting a thread, if agents are
+//  turned on.  Returns FALSE if there's no agent to ask, otherwise fills in
+//  the output part of InjData as GetDataProc would.
+//
+static BOOL QueryRemoteAgent(HWND hwnd, INJDATA *pInjData, BOOL *pfReturn)
+{
+    AGENTSLOT query;
+    DWORD     dwProcessId;
+
+    static_assert(AGENT_MAX_TEXT == ARRAYSIZE(pInjData->szText), "Agent text buffer expected to be the same size");
+
+    if (!g_opts.fRemoteAgent)
+        return FALSE;
+
+    ZeroMemory(&query, sizeof(query));
+
+    query.hwnd = hwnd;
+
+    if (pInjData->fnGetWindowLongPtr)
+        query.fQuery |= AGENT_QUERY_WNDPROC;
+    if (pInjData->fnGetClassInfoEx)
+        query.fQuery |= AGENT_QUERY_CLASS;
+    if (pInjData->fnSendMessageTimeout)
+        query.fQuery |= AGENT_QUERY_TEXT;
+
+    GetWindowThreadProcessId(hwnd, &dwProcessId);
+
+    if (!RemoteAgent_QueryWindows(dwProcessId, &query, 1))
+        return FALSE;
+
+    pInjData->wcOutput = query.wc;
+    pInjData->wndproc = query.wndproc;
+    memcpy(pInjData->szText, query.szText, sizeof(pInjData->szText));
+
+    *pfReturn = !(query.fQuery & AGENT_QUERY_CLASS) || (query.fAnswered & AGENT_QUERY_CLASS);
+    return TRUE;
+}
+
 BOOL GetRemoteWindowInfo(HWND hwnd, WNDCLASSEX *pClass, WNDPROC *pProc, WCHAR *pszText, int nTextLen)
 {
     INJDATA InjData;
@@ -161,7 +362,8 @@ BOOL GetRemoteWindowInfo(HWND hwnd, WNDCLASSEX *pClass, WNDPROC *pProc, WCHAR *p
     // Inject the GetClassInfoExProc function, and our InjData structure!
     //
 #define offsetof(s,m) ((size_t)&(((s*)0)->m))
-    fReturn = IsInjectionDataValid(&InjData) && InjectRemoteThread(hwnd, GetDataProc, cbCodeSize, &InjData, sizeof(InjData), offsetof(INJDATA, wcOutput));
+    if (!QueryRemoteAgent(hwnd, &InjData, &fReturn))
+        fReturn = IsInjectionDataValid(&InjData) && InjectRemoteThread(hwnd, GetDataProc, cbCodeSize, &InjData, sizeof(InjData), offsetof(INJDATA, wcOutput));
 
     if (fReturn == FALSE)
     {
@@ -191,3 +393,206 @@ BOOL GetRemoteWindowInfo(HWND hwnd, WNDCLASSEX *pClass, WNDPROC *pProc, WCHAR *p
         return TRUE;
     }
 }
+
+//
+//  Ask the agent about a batch of windows.  Returns FALSE if there's no
+//  agent to ask.
+//
+static BOOL QueryRemoteAgentBatch(REMOTEWINDOWINFO *rgInfo, UINT cWindows)
+{
+    AGENTSLOT *rgQueries;
+    DWORD      dwProcessId;
+    BOOL       fReturn;
+
+    if (!g_opts.fRemoteAgent)
+        return FALSE;
+
+    rgQueries = (AGENTSLOT *)calloc(cWindows, sizeof(AGENTSLOT));
+    if (!rgQueries)
+        return FALSE;
+
+    for (UINT i = 0; i < cWindows; i++)
+    {
+        rgQueries[i].hwnd   = rgInfo[i].hwnd;
+        rgQueries[i].fQuery = AGENT_QUERY_WNDPROC | AGENT_QUERY_CLASS | AGENT_QUERY_TEXT;
+    }
+
+    GetWindowThreadProcessId(rgInfo[0].hwnd, &dwProcessId);
+
+    fReturn = RemoteAgent_QueryWindows(dwProcessId, rgQueries, cWindows);
+
+    if (fReturn)
+    {
+        for (UINT i = 0; i < cWindows; i++)
+        {
+            rgInfo[i].wndproc = rgQueries[i].wndproc;
+            rgInfo[i].clsproc = (rgQueries[i].fAnswered & AGENT_QUERY_CLASS) ? rgQueries[i].wc.lpfnWndProc : NULL;
+            StringCchCopy(rgInfo[i].szText, ARRAYSIZE(rgInfo[i].szText), rgQueries[i].szText);
+        }
+    }
+
+    free(rgQueries);
+    return fReturn;
+}
+
+//
+//  Window procedure, class procedure and text for a batch of windows that
+//  all belong to the same process, with one injected thread for up to
+//  INJBATCH_MAX_WINDOWS windows.  Only the hwnd of each entry needs to be
+//  filled in.
+//
+BOOL GetRemoteWindowInfoBatch(REMOTEWINDOWINFO *rgInfo, UINT cWindows)
+{
+    INJBATCHHEADER *pHeader;
+    INJBATCHLAYOUT  layout  = { 0 };
+    BOOL            fReturn = TRUE;
+
+    // Calculate how many bytes the injected code takes
+    DWORD_PTR cbCodeSize = ((BYTE *)(intptr_t)AfterGetBatchDataProc - (BYTE *)(intptr_t)GetBatchDataProc);
+
+    if (cWindows == 0 || QueryRemoteAgentBatch(rgInfo, cWindows))
+        return TRUE;
+
+    for (UINT iFirst = 0; fReturn && iFirst < cWindows; iFirst += layout.cWindows)
+    {
+        InjBatch_Layout(&layout, sizeof(INJBATCHHEADER), min(cWindows - iFirst, (UINT)INJBATCH_MAX_WINDOWS), (UINT)ARRAYSIZE(rgInfo->szText));
+
+        pHeader = (INJBATCHHEADER *)calloc(1, layout.cbTotal);
+        if (!pHeader)
+            return FALSE;
+
+        pHeader->fnGetClassInfoExW    = GetClassInfoExW;
+        pHeader->fnGetClassInfoExA    = (PROCGETCLASSINFOEXW)GetClassInfoExA;
+        pHeader->fnGetWindowLongPtrW  = GetWindowLongPtrW;
+        pHeader->fnGetWindowLongPtrA  = GetWindowLongPtrA;
+        pHeader->fnSendMessageTimeout = SendMessageTimeout;
+        pHeader->fnGetTickCount       = GetTickCount;
+        pHeader->dwTextTimeout        = BATCH_TEXT_TIMEOUT;
+        pHeader->layout               = layout;
+
+        for (UINT i = 0; i < layout.cWindows; i++)
+        {
+            INJWINDOWREQUEST *pRequest = INJBATCH_REQUEST(pHeader, &layout, i);
+            HWND              hwnd     = rgInfo[iFirst + i].hwnd;
+
+            pRequest->hwnd     = hwnd;
+            pRequest->hInst    = (HINSTANCE)GetClassLongPtr(hwnd, GCLP_HMODULE);
+            pRequest->atom     = (ATOM)GetClassLong(hwnd, GCW_ATOM);
+            pRequest->fUnicode = IsWindowUnicode(hwnd);
+        }
+
+        fReturn = IsBatchDataValid(pHeader) && InjectRemoteThread(rgInfo[iFirst].hwnd, GetBatchDataProc, cbCodeSize, pHeader, layout.cbTotal, layout.cbResults);
+
+        for (UINT i = 0; i < layout.cWindows; i++)
+        {
+            REMOTEWINDOWINFO *pInfo = &rgInfo[iFirst + i];
+
+            if (fReturn)
+            {
+                pInfo->wndproc = INJBATCH_RESULT(pHeader, &layout, i)->wndproc;
+                pInfo->clsproc = INJBATCH_RESULT(pHeader, &layout, i)->clsproc;
+                StringCchCopy(pInfo->szText, ARRAYSIZE(pInfo->szText), INJBATCH_TEXT(pHeader, &layout, i));
+            }
+            else
+            {
+                pInfo->wndproc = NULL;
+                pInfo->clsproc = NULL;
+                pInfo->szText[0] = L'\0';
+            }
+        }
+
+        free(pHeader);
+    }
+
+    return fReturn;
+}
+
+//
+//  Copy cchText characters out of the target a chunk at a time, so the
+//  caller can show progress (and give up) on very long text.
+//
+static BOOL ReadRemoteText(HANDLE hProcess, const WCHAR *pszRemote, size_t cchText, TEXTBUFFER *pText, TEXTPROGRESSPROC pfnProgress, PVOID pContext)
+{
+    size_t cchDone = 0;
+    SIZE_T cbRead;
+
+    if (!TextBuffer_Reserve(pText, cchText))
+        return FALSE;
+
+    while (cchDone < cchText)
+    {
+        size_t cchChunk = min(cchText - cchDone, (size_t)LONGTEXT_CHUNK);
+
+        if (!ReadProcessMemory(hProcess, pszRemote + cchDone, pText->pszText + pText->cchText, cchChunk * sizeof(WCHAR), &cbRead) ||
+            cbRead != cchChunk * sizeof(WCHAR))
+        {
+            return FALSE;
+        }
+
+        cchDone        += cchChunk;
+        pText->cchText += cchChunk;
+        pText->pszText[pText->cchText] = L'\0';
+
+        if (pfnProgress && !pfnProgress(cchDone, cchText, pContext))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL GetRemoteWindowTextLong(HWND hwnd, TEXTBUFFER *pText, TEXTPROGRESSPROC pfnProgress, PVOID pContext)
+{
+    INJTEXTDATA InjData;
+    DWORD_PTR   cchLength;
+    DWORD       dwProcessId;
+    HANDLE      hProcess;
+    WCHAR      *pszRemote;
+    BOOL        fReturn = FALSE;
+    BOOL        fTimedOut = FALSE;
+
+    // Calculate how many bytes the injected code takes
+    DWORD_PTR cbCodeSize = ((BYTE *)(intptr_t)AfterGetLongTextProc - (BYTE *)(intptr_t)GetLongTextProc);
+
+    // Password edits do answer WM_GETTEXTLENGTH from other processes, it's
+    // only WM_GETTEXT they refuse.
+    if (!SendMessageTimeout(hwnd, WM_GETTEXTLENGTH, 0, 0, SMTO_ABORTIFHUNG, 1000, &cchLength) ||
+        cchLength >= TEXTBUFFER_MAX_TEXT)
+    {
+        return FALSE;
+    }
+
+    GetWindowThreadProcessId(hwnd, &dwProcessId);
+
+    hProcess = OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_READ, FALSE, dwProcessId);
+    if (!hProcess)
+        return FALSE;
+
+    pszRemote = (WCHAR *)VirtualAllocEx(hProcess, NULL, (cchLength + 1) * sizeof(WCHAR), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+    if (pszRemote)
+    {
+        ZeroMemory(&InjData, sizeof(InjData));
+
+        InjData.fnSendMessageTimeout = SendMessageTimeout;
+        InjData.hwnd      = hwnd;
+        InjData.pszBuffer = pszRemote;
+        InjData.cchBuffer = (DWORD)cchLength + 1;
+
+        if (IsLongTextDataValid(&InjData))
+        {
+            if (InjectRemoteThread(hwnd, GetLongTextProc, cbCodeSize, &InjData, sizeof(InjData), offsetof(INJTEXTDATA, cchCopied)))
+                fReturn = ReadRemoteText(hProcess, pszRemote, min(InjData.cchCopied, cchLength), pText, pfnProgress, pContext);
+            else
+                fTimedOut = (GetLastError() == WAIT_TIMEOUT);
+        }
+
+        // A thread that timed out could still write to the buffer later, so
+        // like the injected code it has to stay.  Otherwise nothing will.
+        if (!fTimedOut)
+            VirtualFreeEx(hProcess, pszRemote, 0, MEM_RELEASE);
+    }
+
+    CloseHandle(hProcess);
+
+    return fReturn;
+}
@@ -0,0 +1,179 @@
+//
+//  HwndIndex.c
+//
+//  Looks up tree nodes by window handle.  See HwndIndex.h.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+
+#include "HwndIndex.h"
+
+#define HWNDINDEX_MIN_SLOTS 1024
+
+static size_t HashHwnd(HWND hwnd)
+{
+    ULONGLONG key = (ULONG_PTR)hwnd;
+
+    key *= 0x9E3779B97F4A7C15ull;
+
+    return (size_t)(key >> 17);
+}
+
+static void InsertSlot(HWNDINDEXSLOT *rgSlots, size_t cSlots, HWND hwnd, ptrdiff_t nodeIndex)
+{
+    size_t slot = HashHwnd(hwnd) & (cSlots - 1);
+
+    while (rgSlots[slot].nodeIndex != -1)
+    {
+        slot = (slot + 1) & (cSlots - 1);
+    }
+
+    rgSlots[slot].hwnd      = hwnd;
+    rgSlots[slot].nodeIndex = nodeIndex;
+}
+
+//
+// Moves every entry into a table twice the size.
+//
+static BOOL Grow(HWNDINDEX *pIndex)
+{
+    size_t         cSlots = pIndex->cSlots ? pIndex->cSlots * 2 : HWNDINDEX_MIN_SLOTS;
+    HWNDINDEXSLOT *rgSlots = (HWNDINDEXSLOT *)malloc(cSlots * sizeof(HWNDINDEXSLOT));
+
+    if (!rgSlots)
+    {
+        return FALSE;
+    }
+
+    for (size_t i = 0; i < cSlots; i++)
+    {
+        rgSlots[i].hwnd      = NULL;
+        rgSlots[i].nodeIndex = -1;
+    }
+
+    for (size_t i = 0; i < pIndex->cSlots; i++)
+    {
+        if (pIndex->rgSlots[i].nodeIndex != -1)
+        {
+            InsertSlot(rgSlots, cSlots, pIndex->rgSlots[i].hwnd, pIndex->rgSlots[i].nodeIndex);
+        }
+    }
+
+    free(pIndex->rgSlots);
+
+    pIndex->rgSlots = rgSlots;
+    pIndex->cSlots  = cSlots;
+
+    return TRUE;
+}
+
+BOOL HwndIndex_Add(HWNDINDEX *pIndex, HWND hwnd, ptrdiff_t nodeIndex)
+{
+    if ((pIndex->cUsed + 1) * 2 > pIndex->cSlots && !Grow(pIndex))
+    {
+        // Fuller than we'd like is still better than missing entries, as
+        // long as there's a free slot left to end the probes.
+
+        if (pIndex->cUsed + 1 >= pIndex->cSlots)
+        {
+            return FALSE;
+        }
+    }
+
+    InsertSlot(pIndex->rgSlots, pIndex->cSlots, hwnd, nodeIndex);
+    pIndex->cUsed++;
+
+    return TRUE;
+}
+
+void HwndIndex_Remove(HWNDINDEX *pIndex, HWND hwnd, ptrdiff_t nodeIndex)
+{
+    size_t mask = pIndex->cSlots - 1;
+    size_t slot;
+
+    if (!pIndex->cSlots)
+    {
+        return;
+    }
+
+    slot = HashHwnd(hwnd) & mask;
+
+    while (pIndex->rgSlots[slot].nodeIndex != nodeIndex)
+    {
+        if (pIndex->rgSlots[slot].nodeIndex == -1)
+        {
+            return;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    // Backward shift deletion: pull up any following entries whose probe
+    // sequence passes through the slot being vacated.
+
+    size_t next = slot;
+
+    for (;;)
+    {
+        next = (next + 1) & mask;
+
+        if (pIndex->rgSlots[next].nodeIndex == -1)
+        {
+            break;
+        }
+
+        size_t home = HashHwnd(pIndex->rgSlots[next].hwnd) & mask;
+
+        if (((next - home) & mask) >= ((next - slot) & mask))
+        {
+            pIndex->rgSlots[slot] = pIndex->rgSlots[next];
+            slot = next;
+        }
+    }
+
+    pIndex->rgSlots[slot].hwnd      = NULL;
+    pIndex->rgSlots[slot].nodeIndex = -1;
+    pIndex->cUsed--;
+}
+
+void HwndIndex_Clear(HWNDINDEX *pIndex)
+{
+    for (size_t i = 0; i < pIndex->cSlots; i++)
+    {
+        pIndex->rgSlots[i].hwnd      = NULL;
+        pIndex->rgSlots[i].nodeIndex = -1;
+    }
+
+    pIndex->cUsed = 0;
+}
+
+void HwndIndex_Free(HWNDINDEX *pIndex)
+{
+    free(pIndex->rgSlots);
+
+    ZeroMemory(pIndex, sizeof(*pIndex));
+}
+
+ptrdiff_t HwndIndex_Find(const HWNDINDEX *pIndex, HWND hwnd)
+{
+    if (!pIndex->cSlots)
+    {
+        return -1;
+    }
+
+    size_t slot = HashHwnd(hwnd) & (pIndex->cSlots - 1);
+
+    while (pIndex->rgSlots[slot].nodeIndex != -1)
+    {
+        if (pIndex->rgSlots[slot].hwnd == hwnd)
+        {
+            return pIndex->rgSlots[slot].nodeIndex;
+        }
+
+        slot = (slot + 1) & (pIndex->cSlots - 1);
+    }
+
+    return -1;
+}
@@ -0,0 +1,49 @@
+#ifndef HWNDINDEX_INCLUDED
+#define HWNDINDEX_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// HWNDINDEX
+//
+// Open addressed hash table mapping window handles to the index of their
+// node in the tree's node pool, so that the tree can find a window's item
+// without scanning the whole pool.  Each slot keeps the handle next to the
+// index, so lookups don't touch the pool at all.  The table stays at most
+// half full, and removal shifts entries back instead of leaving
+// tombstones, so it doesn't degrade as windows come and go.
+//
+// Zero it before first use.
+//
+
+typedef struct
+{
+    HWND      hwnd;
+    ptrdiff_t nodeIndex;            // -1 for an empty slot
+}
+HWNDINDEXSLOT;
+
+typedef struct
+{
+    HWNDINDEXSLOT *rgSlots;
+    size_t         cSlots;          // Power of two, or 0 before the first Add
+    size_t         cUsed;
+}
+HWNDINDEX;
+
+// Returns FALSE if the table was full and couldn't be grown.
+BOOL      HwndIndex_Add(HWNDINDEX *pIndex, HWND hwnd, ptrdiff_t nodeIndex);
+void      HwndIndex_Remove(HWNDINDEX *pIndex, HWND hwnd, ptrdiff_t nodeIndex);
+void      HwndIndex_Clear(HWNDINDEX *pIndex);
+void      HwndIndex_Free(HWNDINDEX *pIndex);
+
+// Returns the node index for hwnd, or -1.
+ptrdiff_t HwndIndex_Find(const HWNDINDEX *pIndex, HWND hwnd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
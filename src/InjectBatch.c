@@ -0,0 +1,32 @@
+//
+//  InjectBatch.c
+//
+//  Lays out the data block for a multi-window injected query.
+//
+
+#include "WinSpy.h"
+
+#include "InjectBatch.h"
+
+static DWORD AlignBlockOffset(DWORD cb)
+{
+    return (cb + (sizeof(LONG_PTR) - 1)) & ~(DWORD)(sizeof(LONG_PTR) - 1);
+}
+
+BOOL InjBatch_Layout(INJBATCHLAYOUT *pLayout, DWORD cbHeader, UINT cWindows, UINT cchText)
+{
+    ZeroMemory(pLayout, sizeof(INJBATCHLAYOUT));
+
+    // The limits keep every offset well inside a DWORD.
+    if (cWindows > INJBATCH_MAX_WINDOWS || cchText > INJBATCH_MAX_TEXT || cbHeader > 0x10000)
+        return FALSE;
+
+    pLayout->cWindows   = cWindows;
+    pLayout->cchText    = cchText;
+    pLayout->cbRequests = AlignBlockOffset(cbHeader);
+    pLayout->cbResults  = AlignBlockOffset(pLayout->cbRequests + cWindows * (DWORD)sizeof(INJWINDOWREQUEST));
+    pLayout->cbText     = AlignBlockOffset(pLayout->cbResults + cWindows * (DWORD)sizeof(INJWINDOWRESULT));
+    pLayout->cbTotal    = AlignBlockOffset(pLayout->cbText + cWindows * cchText * (DWORD)sizeof(WCHAR));
+
+    return TRUE;
+}
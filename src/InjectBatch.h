@@ -0,0 +1,73 @@
+#ifndef INJECTBATCH_INCLUDED
+#define INJECTBATCH_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// INJBATCHLAYOUT
+//
+// Layout of the data block for asking an injected thread about many windows
+// at once.  The block is
+//
+//   [header][requests][results][text]
+//
+// where the header is whatever the injected code needs (function pointers
+// and a copy of the layout), requests and results have one entry per window
+// and the text area has cchText characters per window.  Everything before
+// cbResults is input and everything from it on is output, which matches the
+// cbInput split InjectRemoteThread does.
+//
+// The injected code only does pointer arithmetic with the offsets, through
+// the INJBATCH_xxx macros, so it never has to call anything to find its way
+// around the block.
+//
+
+#define INJBATCH_MAX_WINDOWS    4096
+#define INJBATCH_MAX_TEXT       1024
+
+typedef struct
+{
+    HWND        hwnd;
+    HINSTANCE   hInst;                      // Module that registered the class
+    ATOM        atom;
+    BOOL        fUnicode;
+}
+INJWINDOWREQUEST;
+
+typedef struct
+{
+    WNDPROC     wndproc;
+    WNDPROC     clsproc;                    // NULL if the class couldn't be looked up
+}
+INJWINDOWRESULT;
+
+typedef struct
+{
+    UINT        cWindows;
+    UINT        cchText;                    // Per window, 0 to skip the text
+    DWORD       cbRequests;                 // Offsets from the start of the block
+    DWORD       cbResults;
+    DWORD       cbText;
+    DWORD       cbTotal;
+}
+INJBATCHLAYOUT;
+
+// Returns FALSE if there are too many windows or too much text.
+BOOL InjBatch_Layout(INJBATCHLAYOUT *pLayout, DWORD cbHeader, UINT cWindows, UINT cchText);
+
+#define INJBATCH_REQUEST(pBlock, pLayout, i) \
+    ((INJWINDOWREQUEST *)((BYTE *)(pBlock) + (pLayout)->cbRequests) + (i))
+
+#define INJBATCH_RESULT(pBlock, pLayout, i) \
+    ((INJWINDOWRESULT *)((BYTE *)(pBlock) + (pLayout)->cbResults) + (i))
+
+#define INJBATCH_TEXT(pBlock, pLayout, i) \
+    ((WCHAR *)((BYTE *)(pBlock) + (pLayout)->cbText) + (size_t)(i) * (pLayout)->cchText)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
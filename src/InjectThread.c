@@ -14,11 +14,247 @@
 
 #include "InjectThread.h"
 
-#define INJECT_ACCESS (PROCESS_CREATE_THREAD|PROCESS_QUERY_INFORMATION|PROCESS_VM_OPERATION|PROCESS_VM_READ|PROCESS_VM_WRITE)
+#define INJECT_ACCESS (PROCESS_CREATE_THREAD|PROCESS_QUERY_INFORMATION|PROCESS_VM_OPERATION|PROCESS_VM_READ|PROCESS_VM_WRITE|SYNCHRONIZE)
 
 typedef PVOID(WINAPI * VA_EX_PROC)(HANDLE, PVOID, SIZE_T, DWORD, DWORD);
 typedef PVOID(WINAPI * VF_EX_PROC)(HANDLE, PVOID, SIZE_T, DWORD);
 
+//
+//  Copy a function and its data into a new block of executable memory in
+//  another process.  The data follows the code, aligned, and only the first
+//  cbInput bytes of it are written.
+//
+//  Returns the remote address of the code (free it with VirtualFreeEx), or
+//  NULL.  *ppRemoteData receives the remote address of the data.
+//
+PVOID WriteRemoteCode(HANDLE hProcess, LPTHREAD_START_ROUTINE lpCode, DWORD_PTR cbCodeSize, PVOID lpData, DWORD cbDataSize, DWORD cbInput, PVOID *ppRemoteData)
+{
+    SIZE_T dwWritten;           // Number of bytes written to the remote process
+    void  *pRemoteCode;
+    void  *pRemoteData;
+
+    const DWORD_PTR cbCodeSizeAligned = (cbCodeSize + (sizeof(LONG_PTR) - 1)) & ~(sizeof(LONG_PTR) - 1);
+
+    pRemoteCode = VirtualAllocEx(hProcess, 0, cbCodeSizeAligned + cbDataSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!pRemoteCode)
+        return NULL;
+
+    // The data MUST start on a 32bit/64bit boundary
+    pRemoteData = (void *)((BYTE *)pRemoteCode + cbCodeSizeAligned);
+
+    // Write a copy of our injection code into the remote process, and then
+    // put the data in after it
+    if (WriteProcessMemory(hProcess, pRemoteCode, (void *)(intptr_t)lpCode, cbCodeSize, &dwWritten) && dwWritten == cbCodeSize &&
+        WriteProcessMemory(hProcess, pRemoteData, lpData, cbInput, &dwWritten) && dwWritten == cbInput)
+    {
+        *ppRemoteData = pRemoteData;
+        return pRemoteCode;
+    }
+
+    VirtualFreeEx(hProcess, pRemoteCode, 0, MEM_RELEASE);
+    return NULL;
+}
+
+
+//
+//  Opening the target, allocating memory in it and copying the code over
+//  take more calls than running the thread does, and they're the same every
+//  time.  So the process handle and a block holding the code are kept for a
+//  few recently used (process, code) pairs, and a query only writes its data
+//  after the code.  Queries with a lot of data get a block of their own,
+//  freed afterwards as before.
+//
+//  An entry goes when its process has exited, or when calls against it
+//  start failing, in which case the query is retried from scratch.  The
+//  pid can't be reused while the entry holds the process handle.  A query
+//  that times out abandons its entry without freeing the block, since the
+//  code may still run later.
+//
+#define INJECT_CACHE_SIZE       8
+#define INJECT_CACHE_MAX_DATA   0x10000
+#define INJECT_PAGE_SIZE        0x1000
+#define INJECT_TIMEOUT          7000
+
+typedef struct
+{
+    DWORD       dwProcessId;
+    HANDLE      hProcess;                   // NULL if the entry is unused
+    LPTHREAD_START_ROUTINE lpCode;          // Our copy of the code in the block
+    PVOID       pRemoteCode;
+    DWORD_PTR   cbCodeAligned;              // The data starts here
+    DWORD       cbDataAlloc;                // Room for data after the code
+    DWORD       dwLastUsed;
+    BOOL        fBusy;                      // A query is using the block
+}
+INJECTTARGET;
+
+static INJECTTARGET g_rgTargets[INJECT_CACHE_SIZE];
+static SRWLOCK      g_TargetLock = SRWLOCK_INIT;
+static INJECTSTATS  g_InjectStats;
+
+static void DiscardTarget(INJECTTARGET *pTarget, BOOL fFreeMemory, UINT *pcCalls)
+{
+    if (pTarget->pRemoteCode && fFreeMemory)
+    {
+        VirtualFreeEx(pTarget->hProcess, pTarget->pRemoteCode, 0, MEM_RELEASE);
+        (*pcCalls)++;
+    }
+
+    if (pTarget->hProcess)
+    {
+        CloseHandle(pTarget->hProcess);
+        (*pcCalls)++;
+    }
+
+    ZeroMemory(pTarget, sizeof(INJECTTARGET));
+}
+
+//
+//  Find an idle entry whose block holds lpCode and has room for the data,
+//  or else clear out an entry for the caller to set up.  Either way the
+//  entry comes back busy.  Call with g_TargetLock held.
+//
+static INJECTTARGET *AcquireTarget(DWORD dwProcessId, LPTHREAD_START_ROUTINE lpCode, DWORD cbDataSize, UINT *pcCalls)
+{
+    INJECTTARGET *pTarget;
+    INJECTTARGET *pReuse = NULL;
+    UINT i;
+
+    for (i = 0; i < ARRAYSIZE(g_rgTargets); i++)
+    {
+        pTarget = &g_rgTargets[i];
+
+        if (!pTarget->fBusy && pTarget->hProcess && pTarget->dwProcessId == dwProcessId &&
+            pTarget->lpCode == lpCode && pTarget->cbDataAlloc >= cbDataSize)
+        {
+            // The block went with the process, so there's nothing to free.
+            (*pcCalls)++;
+            if (WaitForSingleObject(pTarget->hProcess, 0) == WAIT_OBJECT_0)
+            {
+                DiscardTarget(pTarget, FALSE, pcCalls);
+                continue;
+            }
+
+            pTarget->fBusy      = TRUE;
+            pTarget->dwLastUsed = GetTickCount();
+            return pTarget;
+        }
+    }
+
+    // Take an unused entry, or the least recently used idle one
+    for (i = 0; i < ARRAYSIZE(g_rgTargets); i++)
+    {
+        pTarget = &g_rgTargets[i];
+
+        if (pTarget->fBusy)
+            continue;
+
+        if (!pTarget->hProcess)
+        {
+            pReuse = pTarget;
+            break;
+        }
+
+        if (!pReuse || (LONG)(pTarget->dwLastUsed - pReuse->dwLastUsed) < 0)
+            pReuse = pTarget;
+    }
+
+    if (pReuse)
+    {
+        DiscardTarget(pReuse, TRUE, pcCalls);
+
+        pReuse->fBusy      = TRUE;
+        pReuse->dwLastUsed = GetTickCount();
+    }
+
+    return pReuse;
+}
+
+//
+//  Open the process and copy the code into a new block with room for at
+//  least cbDataSize bytes after it.  On failure the entry is left for
+//  DiscardTarget to clean up.
+//
+static BOOL SetupTarget(INJECTTARGET *pTarget, DWORD dwProcessId, LPTHREAD_START_ROUTINE lpCode, DWORD_PTR cbCodeSize, DWORD cbDataSize, UINT *pcCalls)
+{
+    SIZE_T    dwWritten;
+    DWORD_PTR cbAlloc;
+
+    pTarget->dwProcessId   = dwProcessId;
+    pTarget->lpCode        = lpCode;
+
+    // The data MUST start on a 32bit/64bit boundary
+    pTarget->cbCodeAligned = (cbCodeSize + (sizeof(LONG_PTR) - 1)) & ~(sizeof(LONG_PTR) - 1);
+
+    // VirtualAllocEx hands out whole pages anyway, and the slack lets later
+    // queries with a little more data use the same block
+    cbAlloc = (pTarget->cbCodeAligned + cbDataSize + (INJECT_PAGE_SIZE - 1)) & ~(DWORD_PTR)(INJECT_PAGE_SIZE - 1);
+    pTarget->cbDataAlloc = (DWORD)(cbAlloc - pTarget->cbCodeAligned);
+
+    (*pcCalls)++;
+    pTarget->hProcess = OpenProcess(INJECT_ACCESS, FALSE, dwProcessId);
+    if (!pTarget->hProcess)
+        return FALSE;
+
+    (*pcCalls)++;
+    pTarget->pRemoteCode = VirtualAllocEx(pTarget->hProcess, 0, cbAlloc, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!pTarget->pRemoteCode)
+        return FALSE;
+
+    (*pcCalls)++;
+    return WriteProcessMemory(pTarget->hProcess, pTarget->pRemoteCode, (void *)(intptr_t)lpCode, cbCodeSize, &dwWritten) && dwWritten == cbCodeSize;
+}
+
+//
+//  Write the first cbWrite bytes of the data after the code, run the code
+//  on a new thread and read the output part of the data back.
+//
+static BOOL RunRemoteThread(INJECTTARGET *pTarget, PVOID lpData, DWORD cbDataSize, DWORD cbInput, DWORD cbWrite, DWORD *pdwExitCode, BOOL *pfTimedOut, UINT *pcCalls)
+{
+    HANDLE hRemoteThread;       //handle to the injected thread
+    SIZE_T cbDone;
+    BOOL   fSuccess = FALSE;
+
+    BYTE *pRemoteData = (BYTE *)pTarget->pRemoteCode + pTarget->cbCodeAligned;
+
+    *pfTimedOut = FALSE;
+
+    (*pcCalls)++;
+    if (!(WriteProcessMemory(pTarget->hProcess, pRemoteData, lpData, cbWrite, &cbDone) && cbDone == cbWrite))
+        return FALSE;
+
+    // Create the remote thread!!!
+    (*pcCalls)++;
+    hRemoteThread = CreateRemoteThread(pTarget->hProcess, NULL, 0,
+        (LPTHREAD_START_ROUTINE)(intptr_t)pTarget->pRemoteCode, pRemoteData, 0, NULL);
+
+    if (!hRemoteThread)
+        return FALSE;
+
+    // Wait for the thread to terminate
+    (*pcCalls)++;
+    if (WaitForSingleObject(hRemoteThread, INJECT_TIMEOUT) != WAIT_OBJECT_0)
+    {
+        // Timeout or failure
+        *pfTimedOut = TRUE;
+    }
+    else
+    {
+        // Read the user-structure back again
+        (*pcCalls)++;
+        if (ReadProcessMemory(pTarget->hProcess, pRemoteData + cbInput, (BYTE *)lpData + cbInput, cbDataSize - cbInput, &cbDone) && cbDone == cbDataSize - cbInput)
+        {
+            (*pcCalls)++;
+            fSuccess = GetExitCodeThread(hRemoteThread, pdwExitCode);
+        }
+    }
+
+    (*pcCalls)++;
+    CloseHandle(hRemoteThread);
+
+    return fSuccess;
+}
+
 //
 //  Inject a thread into the process which owns the specified window.
 //
@@ -32,83 +268,109 @@ typedef PVOID(WINAPI * VF_EX_PROC)(HANDLE, PVOID, SIZE_T, DWORD);
 //  The user-defined structure is also injected into the target process' address space.
 //  When the thread terminates, the structure is read back from the process.
 //
+//  On failure GetLastError() is WAIT_TIMEOUT if the thread was started but
+//  didn't finish in time, so it may still touch the process' memory later.
+//  Any other failure means nothing of the query is left running.
+//
 DWORD InjectRemoteThread(HWND hwnd, LPTHREAD_START_ROUTINE lpCode, DWORD_PTR cbCodeSize, PVOID lpData, DWORD cbDataSize, DWORD cbInput)
 {
     DWORD  dwProcessId;         //id of remote process
-    DWORD  dwThreadId;          //id of the thread in remote process
-    HANDLE hProcess;            //handle to the remote process
+    DWORD  dwExitCode = FALSE;
 
-    HANDLE hRemoteThread;       //handle to the injected thread
+    INJECTTARGET  tempTarget;
+    INJECTTARGET *pTarget;
 
-    SIZE_T dwWritten;           // Number of bytes written to the remote process
-    SIZE_T dwRead;
-    DWORD  dwExitCode;
+    UINT   cCalls    = 0;       // Calls made against the target for this query
+    BOOL   fCached   = FALSE;
+    BOOL   fSuccess  = FALSE;
+    BOOL   fTimedOut = FALSE;
+    int    iTry;
 
-    LPTHREAD_START_ROUTINE pRemoteCode;
-    void *pRemoteData;
+    // Find the process ID of the process which created the specified window
+    GetWindowThreadProcessId(hwnd, &dwProcessId);
 
-    const DWORD_PTR cbCodeSizeAligned = (cbCodeSize + (sizeof(LONG_PTR) - 1)) & ~(sizeof(LONG_PTR) - 1);
+    for (iTry = 0; iTry < 2; iTry++)
+    {
+        pTarget = NULL;
 
-    // Return FALSE in case of failure
-    dwExitCode = FALSE;
+        if (cbDataSize <= INJECT_CACHE_MAX_DATA)
+        {
+            AcquireSRWLockExclusive(&g_TargetLock);
+            pTarget = AcquireTarget(dwProcessId, lpCode, cbDataSize, &cCalls);
+            ReleaseSRWLockExclusive(&g_TargetLock);
+        }
 
-    // Find the process ID of the process which created the specified window
-    dwThreadId = GetWindowThreadProcessId(hwnd, &dwProcessId);
+        if (!pTarget)
+        {
+            ZeroMemory(&tempTarget, sizeof(tempTarget));
+            pTarget = &tempTarget;
+        }
 
-    // Open the remote process so we can allocate some memory in it
-    hProcess = OpenProcess(INJECT_ACCESS, FALSE, dwProcessId);
-    if (hProcess)
-    {
-        pRemoteCode = (LPTHREAD_START_ROUTINE)(intptr_t)VirtualAllocEx(hProcess, 0, cbCodeSizeAligned + cbDataSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-        if (pRemoteCode)
+        fCached = pTarget->hProcess != NULL;
+
+        if (fCached)
         {
-            do
-            {
-                // Write a copy of our injection code into the remote process
-                if (!(WriteProcessMemory(hProcess, (void *)(intptr_t)pRemoteCode, (void *)(intptr_t)lpCode, cbCodeSize, &dwWritten) && dwWritten == cbCodeSize))
-                    break;
-
-                // Write a copy of the data to the remote process. This structure
-                // MUST start on a 32bit/64bit boundary
-                pRemoteData = (void *)((BYTE *)(intptr_t)pRemoteCode + cbCodeSizeAligned);
-
-                // Put data in the remote thread's memory block
-                if (!(WriteProcessMemory(hProcess, pRemoteData, lpData, cbInput, &dwWritten) && dwWritten == cbInput))
-                    break;
-
-                // Create the remote thread!!!
-                hRemoteThread = CreateRemoteThread(hProcess, NULL, 0,
-                    pRemoteCode, pRemoteData, 0, NULL);
-
-                if (hRemoteThread)
-                {
-                    // Wait for the thread to terminate
-                    if (WaitForSingleObject(hRemoteThread, 7000) != WAIT_OBJECT_0)
-                    {
-                        // Timeout or failure
-                        // Do not call VirtualFreeEx as the code may still run in the future
-                        CloseHandle(hRemoteThread);
-                        CloseHandle(hProcess);
-
-                        return FALSE;
-                    }
-
-                    // Read the user-structure back again
-                    if (!(ReadProcessMemory(hProcess, (BYTE *)(intptr_t)pRemoteData + cbInput, (BYTE *)(intptr_t)lpData + cbInput, cbDataSize - cbInput, &dwRead) && dwRead == cbDataSize - cbInput))
-                        break;
-
-                    GetExitCodeThread(hRemoteThread, &dwExitCode);
-
-                    CloseHandle(hRemoteThread);
-                }
-            } while (0);
-
-            // Free the memory in the remote process
-            VirtualFreeEx(hProcess, (void *)(intptr_t)pRemoteCode, 0, MEM_RELEASE);
+            // The whole block is written, so the output part starts out the
+            // same as it would in fresh memory
+            fSuccess = RunRemoteThread(pTarget, lpData, cbDataSize, cbInput, cbDataSize, &dwExitCode, &fTimedOut, &cCalls);
+        }
+        else if (SetupTarget(pTarget, dwProcessId, lpCode, cbCodeSize, cbDataSize, &cCalls))
+        {
+            fSuccess = RunRemoteThread(pTarget, lpData, cbDataSize, cbInput, cbInput, &dwExitCode, &fTimedOut, &cCalls);
+        }
+
+        AcquireSRWLockExclusive(&g_TargetLock);
+
+        if (fSuccess && pTarget != &tempTarget)
+        {
+            pTarget->fBusy = FALSE;
+        }
+        else
+        {
+            // Do not call VirtualFreeEx after a timeout as the code may still run in the future
+            DiscardTarget(pTarget, !fTimedOut, &cCalls);
         }
 
-        CloseHandle(hProcess);
+        ReleaseSRWLockExclusive(&g_TargetLock);
+
+        if (fSuccess || fTimedOut || !fCached)
+            break;
+    }
+
+    InterlockedIncrement(&g_InjectStats.cQueries);
+    InterlockedExchangeAdd(&g_InjectStats.cSysCalls, (LONG)cCalls);
+
+    if (fSuccess && fCached)
+        InterlockedIncrement(&g_InjectStats.cCacheHits);
+
+    if (fTimedOut)
+        SetLastError(WAIT_TIMEOUT);
+    else if (!fSuccess && GetLastError() == WAIT_TIMEOUT)
+        SetLastError(ERROR_GEN_FAILURE);
+
+    return fSuccess ? dwExitCode : FALSE;
+}
+
+void GetInjectStats(INJECTSTATS *pStats)
+{
+    pStats->cQueries   = g_InjectStats.cQueries;
+    pStats->cCacheHits = g_InjectStats.cCacheHits;
+    pStats->cSysCalls  = g_InjectStats.cSysCalls;
+}
+
+void FlushInjectCache(void)
+{
+    UINT cCalls = 0;
+    UINT i;
+
+    AcquireSRWLockExclusive(&g_TargetLock);
+
+    // A busy entry belongs to a query that's still running
+    for (i = 0; i < ARRAYSIZE(g_rgTargets); i++)
+    {
+        if (!g_rgTargets[i].fBusy)
+            DiscardTarget(&g_rgTargets[i], TRUE, &cCalls);
     }
 
-    return dwExitCode;
+    ReleaseSRWLockExclusive(&g_TargetLock);
 }
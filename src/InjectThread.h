@@ -5,8 +5,32 @@
 extern "C" {
 #endif
 
+//
+// INJECTSTATS
+//
+// Running totals for InjectRemoteThread.  cSysCalls counts every call made
+// against a target process (opening it, allocating, writing, reading,
+// creating and waiting for the thread, freeing and closing, and checking
+// that a cached process is still alive), so cSysCalls / cQueries is the
+// cost of a query: 11 without the cache, 7 for a cache hit.  The About
+// box shows them.
+//
+typedef struct
+{
+    LONG    cQueries;
+    LONG    cCacheHits;             // Queries that reused a process handle and code block
+    LONG    cSysCalls;
+}
+INJECTSTATS;
+
+PVOID WriteRemoteCode(HANDLE hProcess, LPTHREAD_START_ROUTINE lpCode, DWORD_PTR cbCodeSize, PVOID lpData, DWORD cbDataSize, DWORD cbInput, PVOID *ppRemoteData);
 DWORD InjectRemoteThread(HWND hwnd, LPTHREAD_START_ROUTINE lpCode, DWORD_PTR cbCodeSize, LPVOID lpData, DWORD cbDataSize, DWORD cbInput);
 
+void GetInjectStats(INJECTSTATS *pStats);
+
+// Frees the code blocks InjectRemoteThread keeps in other processes.
+void FlushInjectCache(void);
+
 #ifdef __cplusplus
 }
 #endif
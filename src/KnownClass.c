@@ -0,0 +1,237 @@
+//
+//  KnownClass.c
+//
+//  Maps window class names to KNOWNCLASS ids, once per class.
+//
+
+#include "WinSpy.h"
+
+#include "KnownClass.h"
+#include "Utils.h"
+
+typedef struct
+{
+    PCWSTR  szName;
+    UINT    uClass;
+}
+KNOWNCLASSNAME;
+
+static const KNOWNCLASSNAME g_rgKnownClassNames[] =
+{
+    { L"#32769",               KNOWNCLASS_DESKTOP      },
+    { L"#32770",               KNOWNCLASS_DIALOG       },
+    { L"Button",               KNOWNCLASS_BUTTON       },
+    { L"ComboBox",             KNOWNCLASS_COMBOBOX     },
+    { L"Edit",                 KNOWNCLASS_EDIT         },
+    { L"ListBox",              KNOWNCLASS_LISTBOX      },
+    { L"ComboLBox",            KNOWNCLASS_COMBOLBOX    },
+    { L"RICHEDIT",             KNOWNCLASS_RICHEDIT     },
+    { L"RichEdit20A",          KNOWNCLASS_RICHEDIT20A  },
+    { L"RichEdit20W",          KNOWNCLASS_RICHEDIT20W  },
+    { L"RICHEDIT50W",          KNOWNCLASS_RICHEDIT50W  },
+    { L"RICHEDIT60W",          KNOWNCLASS_RICHEDIT60W  },
+    { L"Scrollbar",            KNOWNCLASS_SCROLLBAR    },
+    { L"Static",               KNOWNCLASS_STATIC       },
+    { L"SysAnimate32",         KNOWNCLASS_ANIMATE      },
+    { L"ComboBoxEx",           KNOWNCLASS_COMBOBOXEX   },
+    { L"SysDateTimePick32",    KNOWNCLASS_DATETIMEPICK },
+    { L"DragList",             KNOWNCLASS_DRAGLIST     },
+    { L"SysHeader32",          KNOWNCLASS_HEADER       },
+    { L"IPAddress",            KNOWNCLASS_IPADDRESS    },
+    { L"SysListView32",        KNOWNCLASS_LISTVIEW     },
+    { L"SysMonthCal32",        KNOWNCLASS_MONTHCAL     },
+    { L"SysPager",             KNOWNCLASS_PAGER        },
+    { L"msctls_progress32",    KNOWNCLASS_PROGRESS     },
+    { L"ReBarWindow32",        KNOWNCLASS_REBAR        },
+    { L"msctls_statusbar32",   KNOWNCLASS_STATUSBAR    },
+    { L"SysLink",              KNOWNCLASS_SYSLINK      },
+    { L"SysTabControl32",      KNOWNCLASS_TABCONTROL   },
+    { L"ToolbarWindow32",      KNOWNCLASS_TOOLBAR      },
+    { L"tooltips_class32",     KNOWNCLASS_TOOLTIPS     },
+    { L"msctls_trackbar32",    KNOWNCLASS_TRACKBAR     },
+    { L"SysTreeView32",        KNOWNCLASS_TREEVIEW     },
+    { L"msctls_updown32",      KNOWNCLASS_UPDOWN       },
+};
+
+static_assert(ARRAYSIZE(g_rgKnownClassNames) == KNOWNCLASS_COUNT - 1, "Every known class needs a name");
+
+//
+//  Names are hashed case-folded, so a lookup is one hash plus (usually)
+//  one compare.  Slots hold an index into g_rgKnownClassNames + 1.
+//
+
+#define NAME_SLOTS  128
+
+static BYTE g_rgNameSlots[NAME_SLOTS];
+static BOOL g_fNameSlotsBuilt;
+
+static UINT HashClassName(PCWSTR pszName)
+{
+    UINT hash = 2166136261u;
+
+    for (; *pszName; pszName++)
+    {
+        WCHAR ch = *pszName;
+
+        if (ch >= L'A' && ch <= L'Z')
+            ch = (WCHAR)(ch + L'a' - L'A');
+
+        hash = (hash ^ ch) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void BuildNameSlots(void)
+{
+    for (UINT i = 0; i < ARRAYSIZE(g_rgKnownClassNames); i++)
+    {
+        UINT slot = HashClassName(g_rgKnownClassNames[i].szName) & (NAME_SLOTS - 1);
+
+        while (g_rgNameSlots[slot] != 0)
+        {
+            slot = (slot + 1) & (NAME_SLOTS - 1);
+        }
+
+        g_rgNameSlots[slot] = (BYTE)(i + 1);
+    }
+
+    g_fNameSlotsBuilt = TRUE;
+}
+
+static UINT LookupClassName(PCWSTR pszName)
+{
+    if (!g_fNameSlotsBuilt)
+        BuildNameSlots();
+
+    UINT slot = HashClassName(pszName) & (NAME_SLOTS - 1);
+
+    while (g_rgNameSlots[slot] != 0)
+    {
+        const KNOWNCLASSNAME *pEntry = &g_rgKnownClassNames[g_rgNameSlots[slot] - 1];
+
+        if (_wcsicmp(pEntry->szName, pszName) == 0)
+            return pEntry->uClass;
+
+        slot = (slot + 1) & (NAME_SLOTS - 1);
+    }
+
+    return KNOWNCLASS_UNKNOWN;
+}
+
+UINT GetKnownClassFromName(PCWSTR pszClassName)
+{
+    WCHAR szCopy[256];
+
+    if (IsWindowsFormsClassName(pszClassName))
+    {
+        wcscpy_s(szCopy, ARRAYSIZE(szCopy), pszClassName);
+        ExtractWindowsFormsInnerClassName(szCopy);
+        pszClassName = szCopy;
+    }
+
+    return LookupClassName(pszClassName);
+}
+
+//
+//  Atom cache.  Class atoms are shared by every module that registers a
+//  class of that name, but the classes themselves aren't, so the module is
+//  part of the key.  When the cache fills up it just starts again.
+//
+
+#define ATOM_SLOTS  1024
+
+typedef struct
+{
+    HINSTANCE   hModule;
+    ATOM        atom;               // 0 for an empty slot
+    BYTE        uClass;
+}
+KNOWNCLASSSLOT;
+
+static KNOWNCLASSSLOT g_rgAtomSlots[ATOM_SLOTS];
+static UINT           g_cAtomSlotsUsed;
+
+static size_t HashClassAtom(ATOM atom, HINSTANCE hModule)
+{
+    ULONGLONG key = ((ULONGLONG)(ULONG_PTR)hModule << 16) | atom;
+
+    key *= 0x9E3779B97F4A7C15ull;
+
+    return (size_t)(key >> 17);
+}
+
+// Returns the slot holding the class, or the empty slot it would go in.
+static size_t FindAtomSlot(ATOM atom, HINSTANCE hModule)
+{
+    size_t slot = HashClassAtom(atom, hModule) & (ATOM_SLOTS - 1);
+
+    while (g_rgAtomSlots[slot].atom != 0)
+    {
+        if (g_rgAtomSlots[slot].atom == atom && g_rgAtomSlots[slot].hModule == hModule)
+            break;
+
+        slot = (slot + 1) & (ATOM_SLOTS - 1);
+    }
+
+    return slot;
+}
+
+static UINT AddAtomSlot(size_t slot, ATOM atom, HINSTANCE hModule, PCWSTR pszClassName)
+{
+    UINT uClass = GetKnownClassFromName(pszClassName);
+
+    if (g_cAtomSlotsUsed >= ATOM_SLOTS * 3 / 4)
+    {
+        ZeroMemory(g_rgAtomSlots, sizeof(g_rgAtomSlots));
+        g_cAtomSlotsUsed = 0;
+
+        slot = FindAtomSlot(atom, hModule);
+    }
+
+    g_rgAtomSlots[slot].hModule = hModule;
+    g_rgAtomSlots[slot].atom    = atom;
+    g_rgAtomSlots[slot].uClass  = (BYTE)uClass;
+    g_cAtomSlotsUsed++;
+
+    return uClass;
+}
+
+UINT GetKnownClassFromAtom(ATOM atom, HINSTANCE hModule, PCWSTR pszClassName)
+{
+    if (atom == 0)
+        return GetKnownClassFromName(pszClassName);
+
+    size_t slot = FindAtomSlot(atom, hModule);
+
+    if (g_rgAtomSlots[slot].atom != 0)
+        return g_rgAtomSlots[slot].uClass;
+
+    return AddAtomSlot(slot, atom, hModule, pszClassName);
+}
+
+UINT GetKnownClass(HWND hwnd)
+{
+    ATOM      atom    = (ATOM)GetClassLong(hwnd, GCW_ATOM);
+    HINSTANCE hModule = (HINSTANCE)GetClassLongPtr(hwnd, GCLP_HMODULE);
+    size_t    slot    = 0;
+    WCHAR     szClassName[256];
+
+    if (atom != 0)
+    {
+        slot = FindAtomSlot(atom, hModule);
+
+        if (g_rgAtomSlots[slot].atom != 0)
+            return g_rgAtomSlots[slot].uClass;
+    }
+
+    // Only fetch the name if the class hasn't been seen before.
+
+    szClassName[0] = L'\0';
+    GetClassName(hwnd, szClassName, ARRAYSIZE(szClassName));
+
+    if (atom == 0)
+        return GetKnownClassFromName(szClassName);
+
+    return AddAtomSlot(slot, atom, hModule, szClassName);
+}
@@ -0,0 +1,74 @@
+#ifndef KNOWNCLASS_INCLUDED
+#define KNOWNCLASS_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// KNOWNCLASS
+//
+// The window classes WinSpy has special handling for (icons, style tables
+// and so on), as small integers that can be switched on or used as table
+// indices.  Class names are matched case-insensitively, and WinForms
+// wrappers (WindowsForms10.Button.app...) count as the class they wrap.
+//
+// Looking up a window goes through a cache keyed by its class atom and the
+// module that registered the class, so after the first window of a class
+// there are no string compares.  Only use the cache from the UI thread.
+//
+
+typedef enum
+{
+    KNOWNCLASS_UNKNOWN = 0,
+    KNOWNCLASS_DESKTOP,             // #32769
+    KNOWNCLASS_DIALOG,              // #32770
+    KNOWNCLASS_BUTTON,
+    KNOWNCLASS_COMBOBOX,
+    KNOWNCLASS_EDIT,
+    KNOWNCLASS_LISTBOX,
+    KNOWNCLASS_COMBOLBOX,
+    KNOWNCLASS_RICHEDIT,
+    KNOWNCLASS_RICHEDIT20A,
+    KNOWNCLASS_RICHEDIT20W,
+    KNOWNCLASS_RICHEDIT50W,
+    KNOWNCLASS_RICHEDIT60W,
+    KNOWNCLASS_SCROLLBAR,
+    KNOWNCLASS_STATIC,
+    KNOWNCLASS_ANIMATE,
+    KNOWNCLASS_COMBOBOXEX,
+    KNOWNCLASS_DATETIMEPICK,
+    KNOWNCLASS_DRAGLIST,
+    KNOWNCLASS_HEADER,
+    KNOWNCLASS_IPADDRESS,
+    KNOWNCLASS_LISTVIEW,
+    KNOWNCLASS_MONTHCAL,
+    KNOWNCLASS_PAGER,
+    KNOWNCLASS_PROGRESS,
+    KNOWNCLASS_REBAR,
+    KNOWNCLASS_STATUSBAR,
+    KNOWNCLASS_SYSLINK,
+    KNOWNCLASS_TABCONTROL,
+    KNOWNCLASS_TOOLBAR,
+    KNOWNCLASS_TOOLTIPS,
+    KNOWNCLASS_TRACKBAR,
+    KNOWNCLASS_TREEVIEW,
+    KNOWNCLASS_UPDOWN,
+    KNOWNCLASS_COUNT
+}
+KNOWNCLASS;
+
+// Canonicalizes a class name.  Doesn't use the cache.
+UINT GetKnownClassFromName(PCWSTR pszClassName);
+
+// Cached lookup, pszClassName is only used the first time a class is seen.
+UINT GetKnownClassFromAtom(ATOM atom, HINSTANCE hModule, PCWSTR pszClassName);
+
+// Cached lookup for a window.
+UINT GetKnownClass(HWND hwnd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
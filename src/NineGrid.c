@@ -0,0 +1,248 @@
+//
+//  NineGrid.c
+//
+//  Nine-grid image expansion, used to draw the frames of the window
+//  finder.  See NineGrid.h.
+//
+
+#include "WinSpy.h"
+
+#include "NineGrid.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+//
+// Sets cPixels 32bpp pixels to the same value.  Most of a nine-grid image
+// is filled this way, since the interior of the source is usually a single
+// pixel wide.
+//
+static void FillPixels(DWORD *pDst, DWORD dwPixel, size_t cPixels)
+{
+#ifdef USE_SSE2
+    // Get to a 16 byte boundary, then write four pixels at a time.
+
+    while (cPixels > 0 && ((ULONG_PTR)pDst & 15) != 0)
+    {
+        *pDst++ = dwPixel;
+        cPixels--;
+    }
+
+    __m128i xmm = _mm_set1_epi32((int)dwPixel);
+
+    for (; cPixels >= 16; cPixels -= 16, pDst += 16)
+    {
+        _mm_store_si128((__m128i *)pDst, xmm);
+        _mm_store_si128((__m128i *)(pDst + 4), xmm);
+        _mm_store_si128((__m128i *)(pDst + 8), xmm);
+        _mm_store_si128((__m128i *)(pDst + 12), xmm);
+    }
+
+    for (; cPixels >= 4; cPixels -= 4, pDst += 4)
+    {
+        _mm_store_si128((__m128i *)pDst, xmm);
+    }
+#endif
+
+    while (cPixels > 0)
+    {
+        *pDst++ = dwPixel;
+        cPixels--;
+    }
+}
+
+//
+// Stretches cxSrc pixels to cxDst pixels (nearest neighbour).
+//
+static void StretchPixels(DWORD *pDst, int cxDst, const DWORD *pSrc, int cxSrc)
+{
+    if (cxSrc == 1)
+    {
+        FillPixels(pDst, pSrc[0], cxDst);
+        return;
+    }
+
+    for (int x = 0; x < cxDst; x++)
+    {
+        pDst[x] = pSrc[(LONGLONG)x * cxSrc / cxDst];
+    }
+}
+
+//
+// Builds one output row of a nine-grid image from a source row: the edges
+// are copied and the interior is stretched between them.
+//
+static void ExpandNineGridRow(DWORD *pDst, int cxDst, const DWORD *pSrc, int cxSrc, int cxEdgeL, int cxEdgeR)
+{
+    memcpy(pDst, pSrc, cxEdgeL * sizeof(DWORD));
+
+    StretchPixels(pDst + cxEdgeL, cxDst - cxEdgeL - cxEdgeR, pSrc + cxEdgeL, cxSrc - cxEdgeL - cxEdgeR);
+
+    memcpy(pDst + cxDst - cxEdgeR, pSrc + cxSrc - cxEdgeR, cxEdgeR * sizeof(DWORD));
+}
+
+//
+// Every source row is expanded once; rows that repeat it are copied from
+// the first.
+//
+void NineGrid_ExpandBits(DWORD *pDst, SIZE sizeDst, const DWORD *pSrc, SIZE sizeSrc, RECT edges)
+{
+    int cyDstInner = sizeDst.cy - (edges.top + edges.bottom);
+    int cySrcInner = sizeSrc.cy - (edges.top + edges.bottom);
+    int ySrcPrev   = -1;
+
+    for (int y = 0; y < sizeDst.cy; y++)
+    {
+        DWORD *pRow = pDst + (size_t)y * sizeDst.cx;
+        int    ySrc;
+
+        if (y < edges.top)
+        {
+            ySrc = y;
+        }
+        else if (y >= sizeDst.cy - edges.bottom)
+        {
+            ySrc = sizeSrc.cy - (sizeDst.cy - y);
+        }
+        else
+        {
+            ySrc = edges.top + (int)((LONGLONG)(y - edges.top) * cySrcInner / cyDstInner);
+        }
+
+        if (ySrc == ySrcPrev)
+        {
+            memcpy(pRow, pRow - sizeDst.cx, sizeDst.cx * sizeof(DWORD));
+        }
+        else
+        {
+            ExpandNineGridRow(pRow, sizeDst.cx, pSrc + (size_t)ySrc * sizeSrc.cx, sizeSrc.cx, edges.left, edges.right);
+        }
+
+        ySrcPrev = ySrc;
+    }
+}
+
+#ifdef _WIN32
+
+HBITMAP NineGrid_ExpandGdi(SIZE outputSize, HBITMAP hbmSrc, RECT edges)
+{
+    HDC     hdcScreen, hdcDst, hdcSrc;
+    HBITMAP hbmDst;
+    void*   pBits;
+    HANDLE  hOldSrc, hOldDst;
+    BITMAP  bmSrc;
+
+    // Create a 32bpp DIB of the desired size, this is the output bitmap.
+    BITMAPINFOHEADER bih = { sizeof(bih) };
+
+    bih.biWidth       = outputSize.cx;
+    bih.biHeight      = outputSize.cy;
+    bih.biPlanes      = 1;
+    bih.biBitCount    = 32;
+    bih.biCompression = BI_RGB;
+    bih.biSizeImage   = 0;
+
+    hdcScreen = GetDC(0);
+    hbmDst = CreateDIBSection(hdcScreen, (BITMAPINFO *)&bih, DIB_RGB_COLORS, &pBits, 0, 0);
+
+    // Determine size of the source image.
+    GetObject(hbmSrc, sizeof(bmSrc), &bmSrc);
+
+    // Prep DCs
+    hdcSrc = CreateCompatibleDC(hdcScreen);
+    hOldSrc = SelectObject(hdcSrc, hbmSrc);
+
+    hdcDst = CreateCompatibleDC(hdcScreen);
+    hOldDst = SelectObject(hdcDst, hbmDst);
+
+    // Sizes of the nine-grid edges
+    int cxEdgeL = edges.left;
+    int cxEdgeR = edges.right;
+    int cyEdgeT = edges.top;
+    int cyEdgeB = edges.bottom;
+
+    // Precompute sizes and coordinates of the interior boxes
+    // (that is, the source and dest rects with the edges subtracted out).
+    int cxDstInner = outputSize.cx - (cxEdgeL + cxEdgeR);
+    int cyDstInner = outputSize.cy - (cyEdgeT + cyEdgeB);
+    int cxSrcInner = bmSrc.bmWidth - (cxEdgeL + cxEdgeR);
+    int cySrcInner = bmSrc.bmHeight - (cyEdgeT + cyEdgeB);
+
+    int xDst1 = cxEdgeL;
+    int xDst2 = outputSize.cx - cxEdgeR;
+    int yDst1 = cyEdgeT;
+    int yDst2 = outputSize.cy - cyEdgeB;
+
+    int xSrc1 = cxEdgeL;
+    int xSrc2 = bmSrc.bmWidth - cxEdgeR;
+    int ySrc1 = cyEdgeT;
+    int ySrc2 = bmSrc.bmHeight - cyEdgeB;
+
+    // Upper-left corner
+    BitBlt(
+        hdcDst, 0, 0, cxEdgeL, cyEdgeT,
+        hdcSrc, 0, 0,
+        SRCCOPY);
+
+    // Upper-right corner
+    BitBlt(
+        hdcDst, xDst2, 0, cxEdgeR, cyEdgeT,
+        hdcSrc, xSrc2, 0,
+        SRCCOPY);
+
+    // Lower-left corner
+    BitBlt(
+        hdcDst, 0, yDst2, cxEdgeL, cyEdgeB,
+        hdcSrc, 0, ySrc2,
+        SRCCOPY);
+
+    // Lower-right corner
+    BitBlt(
+        hdcDst, xDst2, yDst2, cxEdgeR, cyEdgeB,
+        hdcSrc, xSrc2, ySrc2,
+        SRCCOPY);
+
+    // Left side
+    StretchBlt(
+        hdcDst, 0, yDst1, cxEdgeL, cyDstInner,
+        hdcSrc, 0, ySrc1, cxEdgeL, cySrcInner,
+        SRCCOPY);
+
+    // Right side
+    StretchBlt(
+        hdcDst, xDst2, yDst1, cxEdgeR, cyDstInner,
+        hdcSrc, xSrc2, ySrc1, cxEdgeR, cySrcInner,
+        SRCCOPY);
+
+    // Top side
+    StretchBlt(
+        hdcDst, xDst1, 0, cxDstInner, cyEdgeT,
+        hdcSrc, xSrc1, 0, cxSrcInner, cyEdgeT,
+        SRCCOPY);
+
+    // Bottom side
+    StretchBlt(
+        hdcDst, xDst1, yDst2, cxDstInner, cyEdgeB,
+        hdcSrc, xSrc1, ySrc2, cxSrcInner, cyEdgeB,
+        SRCCOPY);
+
+    // Middle
+    StretchBlt(
+        hdcDst, xDst1, yDst1, cxDstInner, cyDstInner,
+        hdcSrc, xSrc1, ySrc1, cxSrcInner, cySrcInner,
+        SRCCOPY);
+
+    SelectObject(hdcSrc, hOldSrc);
+    SelectObject(hdcDst, hOldDst);
+
+    DeleteDC(hdcSrc);
+    DeleteDC(hdcDst);
+
+    ReleaseDC(0, hdcScreen);
+
+    return hbmDst;
+}
+
+#endif
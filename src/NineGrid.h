@@ -0,0 +1,36 @@
+#ifndef NINEGRID_INCLUDED
+#define NINEGRID_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Nine-grid expansion: the corners of the source image are copied as they
+// are, the edges are stretched along their length and the interior is
+// stretched both ways (nearest neighbour) to fill the output size.  The
+// edges rectangle holds the widths of the left, top, right and bottom
+// edges.
+//
+// NineGrid_ExpandBits works on top-down 32bpp pixels, which it copies as
+// is, so premultiplied alpha stays premultiplied.  Both sizes must be
+// larger than the edges in each direction.
+//
+void NineGrid_ExpandBits(DWORD *pDst, SIZE sizeDst, const DWORD *pSrc, SIZE sizeSrc, RECT edges);
+
+#ifdef _WIN32
+
+//
+// The same expansion using GDI, for source bitmaps whose pixels can't be
+// read directly, or output too small for the edges.  Returns a bottom-up
+// 32bpp DIB section.
+//
+HBITMAP NineGrid_ExpandGdi(SIZE outputSize, HBITMAP hbmSrc, RECT edges);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
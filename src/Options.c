@@ -9,6 +9,7 @@
 
 #include "WinSpy.h"
 #include "RegHelper.h"
+#include "RemoteAgent.h"
 #include "resource.h"
 #include "utils.h"
 
@@ -18,6 +19,11 @@ Options g_opts;
 
 static WCHAR szRegLoc[] = REG_BASESTR;
 
+static UINT ClampAutoUpdateInterval(LONG nInterval)
+{
+    return (UINT)max(AUTOUPDATE_MIN_INTERVAL, min(nInterval, AUTOUPDATE_MAX_INTERVAL));
+}
+
 void LoadSettings(void)
 {
     HKEY hkey;
@@ -37,7 +43,12 @@ void LoadSettings(void)
     g_opts.fShowDesktopRoot = GetSettingBool(hkey, L"ShowDesktopRoot", FALSE);
     g_opts.uTreeInclude = GetSettingInt(hkey, L"TreeItems", WINLIST_INCLUDE_ALL);
     g_opts.fShowHiddenInList = GetSettingBool(hkey, L"List_ShowHidden", TRUE);
+    g_opts.fIncrementalRefresh = GetSettingBool(hkey, L"List_Incremental", TRUE);
+    g_opts.fLazyTree = GetSettingBool(hkey, L"List_Lazy", FALSE);
+    g_opts.fLiveTree = GetSettingBool(hkey, L"List_Live", FALSE);
+    g_opts.fRemoteAgent = GetSettingBool(hkey, L"RemoteAgent", FALSE);
     g_opts.fEnableHotkey = GetSettingBool(hkey, L"EnableHotkey", FALSE);
+    g_opts.uAutoUpdateInterval = ClampAutoUpdateInterval(GetSettingInt(hkey, L"AutoUpdateInterval", AUTOUPDATE_DEF_INTERVAL));
 
     g_opts.uPinnedCorner = GetSettingInt(hkey, L"PinCorner", 0);
 
@@ -89,7 +100,12 @@ void SaveSettings(void)
     WriteSettingBool(hkey, L"EnableToolTips", g_opts.fEnableToolTips);
     WriteSettingBool(hkey, L"ShowDesktopRoot", g_opts.fShowDesktopRoot);
     WriteSettingBool(hkey, L"List_ShowHidden", g_opts.fShowHiddenInList);
+    WriteSettingBool(hkey, L"List_Incremental", g_opts.fIncrementalRefresh);
+    WriteSettingBool(hkey, L"List_Lazy", g_opts.fLazyTree);
+    WriteSettingBool(hkey, L"List_Live", g_opts.fLiveTree);
+    WriteSettingBool(hkey, L"RemoteAgent", g_opts.fRemoteAgent);
     WriteSettingInt(hkey, L"TreeItems", g_opts.uTreeInclude);
+    WriteSettingInt(hkey, L"AutoUpdateInterval", g_opts.uAutoUpdateInterval);
     WriteSettingInt(hkey, L"PinCorner", g_opts.uPinnedCorner);
 
     WriteSettingInt(hkey, L"xpos", g_opts.ptPinPos.x);
@@ -126,6 +142,8 @@ INT_PTR CALLBACK OptionsDlgProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lPar
 {
     UNREFERENCED_PARAMETER(lParam);
     static HWND hwndTarget;
+    BOOL fTranslated;
+    UINT uInterval;
 
     switch (iMsg)
     {
@@ -138,6 +156,10 @@ INT_PTR CALLBACK OptionsDlgProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lPar
         CheckDlgButton(hwnd, IDC_OPTIONS_TOOLTIPS, g_opts.fEnableToolTips);
         CheckDlgButton(hwnd, IDC_OPTIONS_DESKTOPROOT, g_opts.fShowDesktopRoot);
         CheckDlgButton(hwnd, IDC_OPTIONS_LIST_SHOWHIDDEN, g_opts.fShowHiddenInList);
+        CheckDlgButton(hwnd, IDC_OPTIONS_INCREMENTAL, g_opts.fIncrementalRefresh);
+        CheckDlgButton(hwnd, IDC_OPTIONS_LAZYTREE, g_opts.fLazyTree);
+        CheckDlgButton(hwnd, IDC_OPTIONS_LIVETREE, g_opts.fLiveTree);
+        CheckDlgButton(hwnd, IDC_OPTIONS_REMOTEAGENT, g_opts.fRemoteAgent);
         CheckDlgButton(hwnd, IDC_OPTIONS_ENABLE_HOTKEY, g_opts.fEnableHotkey);
 
         CheckDlgButton(hwnd, IDC_OPTIONS_INCHANDLE,
@@ -150,6 +172,9 @@ INT_PTR CALLBACK OptionsDlgProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lPar
 
         SendDlgItemMessage(hwnd, IDC_HOTKEY, HKM_SETHOTKEY, g_opts.wHotkey, 0);
 
+        SendDlgItemMessage(hwnd, IDC_OPTIONS_AUTOUPDATE_SPIN, UDM_SETRANGE32, AUTOUPDATE_MIN_INTERVAL, AUTOUPDATE_MAX_INTERVAL);
+        SendDlgItemMessage(hwnd, IDC_OPTIONS_AUTOUPDATE_SPIN, UDM_SETPOS32, 0, g_opts.uAutoUpdateInterval);
+
         return TRUE;
 
     case WM_CLOSE:
@@ -173,9 +198,19 @@ INT_PTR CALLBACK OptionsDlgProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lPar
             g_opts.fEnableToolTips = IsDlgButtonChecked(hwnd, IDC_OPTIONS_TOOLTIPS);
             g_opts.fShowDesktopRoot = IsDlgButtonChecked(hwnd, IDC_OPTIONS_DESKTOPROOT);
             g_opts.fShowHiddenInList = IsDlgButtonChecked(hwnd, IDC_OPTIONS_LIST_SHOWHIDDEN);
+            g_opts.fIncrementalRefresh = IsDlgButtonChecked(hwnd, IDC_OPTIONS_INCREMENTAL);
+            g_opts.fLazyTree = IsDlgButtonChecked(hwnd, IDC_OPTIONS_LAZYTREE);
+            g_opts.fLiveTree = IsDlgButtonChecked(hwnd, IDC_OPTIONS_LIVETREE);
+            g_opts.fRemoteAgent = IsDlgButtonChecked(hwnd, IDC_OPTIONS_REMOTEAGENT);
             g_opts.fEnableHotkey = IsDlgButtonChecked(hwnd, IDC_OPTIONS_ENABLE_HOTKEY);
             g_opts.wHotkey = (WORD)SendDlgItemMessage(hwnd, IDC_HOTKEY, HKM_GETHOTKEY, 0, 0);
 
+            // An empty or garbled interval leaves the old one alone
+            uInterval = GetDlgItemInt(hwnd, IDC_OPTIONS_AUTOUPDATE_INTERVAL, &fTranslated, FALSE);
+
+            if (fTranslated)
+                g_opts.uAutoUpdateInterval = ClampAutoUpdateInterval((LONG)min(uInterval, (UINT)AUTOUPDATE_MAX_INTERVAL));
+
             g_opts.uTreeInclude = 0;
 
             if (IsDlgButtonChecked(hwnd, IDC_OPTIONS_INCHANDLE))
@@ -205,7 +240,16 @@ void ShowOptionsDlg(HWND hwndParent)
 
     UpdateMainWindowText();
 
+    WindowTree_RefreshLabels();
+
+    WindowTree_UpdateLiveHooks();
+
     UpdateGlobalHotkey();
 
+    UpdateAutoUpdateTimer(hwndParent);
+
+    if (!g_opts.fRemoteAgent)
+        RemoteAgent_Shutdown();
+
     SendMessage(g_hwndToolTip, TTM_ACTIVATE, g_opts.fEnableToolTips, 0);
 }
@@ -0,0 +1,365 @@
+//
+//  ProcessIconCache.c
+//
+//  Process nodes in the window tree show the icon of the process image.
+//  SHGetFileInfo is slow, so each image path is only looked up once, on a
+//  thread pool worker, and the icon is kept in the image list for as long
+//  as the path stays in the cache.
+//
+
+#include "WinSpy.h"
+
+#include <shellapi.h>
+#include <malloc.h>
+#include <wctype.h>
+
+#include "ProcessIconCache.h"
+
+//
+//  Once there are this many entries, entries not used by the current
+//  refresh are recycled (least recently used first) instead of adding
+//  more images.  If every entry is in use the cache grows anyway.
+//
+#define MAX_CACHED_ICONS    256
+
+typedef struct
+{
+    WCHAR   szPath[MAX_PATH];
+    int     iImage;
+    UINT    uLastUse;               // Generation in which it was last used
+    UINT    uSerial;                // Changes each time the entry is recycled
+}
+ICONENTRY;
+
+//
+//  Handed to the worker, and then posted back with the icon.
+//
+typedef struct
+{
+    HWND    hwndNotify;
+    UINT    uMsg;
+    int     iEntry;
+    UINT    uSerial;
+    HICON   hIcon;
+    WCHAR   szPath[MAX_PATH];
+}
+ICONREQUEST;
+
+static HIMAGELIST g_himl;
+static HICON      g_hPlaceholder;
+static HWND       g_hwndNotify;
+static UINT       g_uNotifyMsg;
+
+static ICONENTRY *g_rgIcons;
+static int        g_cIcons;
+static int        g_cIconsAlloc;
+static UINT       g_uGeneration;
+static UINT       g_uSerial;
+
+//
+//  Open addressed hash of entry indices, keyed by path (case-insensitive).
+//  Slots hold -1 when empty.  Rebuilt whenever an entry changes path.
+//
+static int       *g_rgIconSlots;
+static size_t     g_cIconSlots;
+
+static size_t HashPath(PCWSTR pszPath)
+{
+    size_t hash = 2166136261u;
+
+    for (; *pszPath; pszPath++)
+    {
+        hash = (hash ^ towlower(*pszPath)) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void IconHash_Insert(int iEntry)
+{
+    size_t mask = g_cIconSlots - 1;
+    size_t slot = HashPath(g_rgIcons[iEntry].szPath) & mask;
+
+    while (g_rgIconSlots[slot] != -1)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    g_rgIconSlots[slot] = iEntry;
+}
+
+static BOOL IconHash_Rebuild()
+{
+    size_t cSlots = 64;
+
+    while (cSlots < (size_t)g_cIconsAlloc * 2)
+    {
+        cSlots *= 2;
+    }
+
+    if (cSlots != g_cIconSlots)
+    {
+        int *rgSlots = (int *)realloc(g_rgIconSlots, cSlots * sizeof(int));
+
+        if (!rgSlots)
+        {
+            return FALSE;
+        }
+
+        g_rgIconSlots = rgSlots;
+        g_cIconSlots  = cSlots;
+    }
+
+    for (size_t i = 0; i < g_cIconSlots; i++)
+    {
+        g_rgIconSlots[i] = -1;
+    }
+
+    for (int i = 0; i < g_cIcons; i++)
+    {
+        IconHash_Insert(i);
+    }
+
+    return TRUE;
+}
+
+static int IconHash_Find(PCWSTR pszPath)
+{
+    if (g_cIconSlots == 0)
+    {
+        return -1;
+    }
+
+    size_t mask = g_cIconSlots - 1;
+    size_t slot = HashPath(pszPath) & mask;
+
+    while (g_rgIconSlots[slot] != -1)
+    {
+        int iEntry = g_rgIconSlots[slot];
+
+        if (_wcsicmp(g_rgIcons[iEntry].szPath, pszPath) == 0)
+        {
+            return iEntry;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return -1;
+}
+
+void ProcessIconCache_Initialize(HIMAGELIST himl, int iPlaceholder, HWND hwndNotify, UINT uMsg)
+{
+    g_himl         = himl;
+    g_hPlaceholder = ImageList_GetIcon(himl, iPlaceholder, ILD_NORMAL);
+    g_hwndNotify   = hwndNotify;
+    g_uNotifyMsg   = uMsg;
+}
+
+//
+//  Note that outstanding requests are not waited for.  Their results are
+//  either dropped by PostMessage failing, or ignored when they arrive.
+//
+void ProcessIconCache_Destroy()
+{
+    if (g_hPlaceholder)
+    {
+        DestroyIcon(g_hPlaceholder);
+    }
+
+    free(g_rgIcons);
+    free(g_rgIconSlots);
+
+    g_himl         = NULL;
+    g_hPlaceholder = NULL;
+    g_rgIcons      = NULL;
+    g_cIcons       = 0;
+    g_cIconsAlloc  = 0;
+    g_rgIconSlots  = NULL;
+    g_cIconSlots   = 0;
+}
+
+void ProcessIconCache_NextGeneration()
+{
+    g_uGeneration++;
+}
+
+static void CALLBACK LoadIconWorker(PTP_CALLBACK_INSTANCE pInstance, PVOID pv)
+{
+    ICONREQUEST *pReq = (ICONREQUEST *)pv;
+    SHFILEINFO   shfi = { 0 };
+
+    UNREFERENCED_PARAMETER(pInstance);
+
+    // SHGetFileInfo needs COM.
+
+    HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+
+    if (SHGetFileInfo(pReq->szPath, 0, &shfi, sizeof(shfi), SHGFI_SMALLICON | SHGFI_ICON))
+    {
+        pReq->hIcon = shfi.hIcon;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        CoUninitialize();
+    }
+
+    if (!PostMessage(pReq->hwndNotify, pReq->uMsg, 0, (LPARAM)pReq))
+    {
+        if (pReq->hIcon)
+        {
+            DestroyIcon(pReq->hIcon);
+        }
+
+        free(pReq);
+    }
+}
+
+//
+//  Finds an entry for a new path: a fresh one while there is room, or
+//  else the least recently used one that the current refresh hasn't used.
+//
+static int AllocateIconEntry()
+{
+    int iEntry = -1;
+
+    if (g_cIcons >= MAX_CACHED_ICONS)
+    {
+        for (int i = 0; i < g_cIcons; i++)
+        {
+            if (g_rgIcons[i].uLastUse != g_uGeneration &&
+                (iEntry == -1 || g_uGeneration - g_rgIcons[i].uLastUse > g_uGeneration - g_rgIcons[iEntry].uLastUse))
+            {
+                iEntry = i;
+            }
+        }
+
+        if (iEntry != -1)
+        {
+            ImageList_ReplaceIcon(g_himl, g_rgIcons[iEntry].iImage, g_hPlaceholder);
+            return iEntry;
+        }
+    }
+
+    if (g_cIcons == g_cIconsAlloc)
+    {
+        int        cAlloc = g_cIconsAlloc ? g_cIconsAlloc * 2 : 32;
+        ICONENTRY *rgNew  = (ICONENTRY *)realloc(g_rgIcons, cAlloc * sizeof(ICONENTRY));
+
+        if (!rgNew)
+        {
+            return -1;
+        }
+
+        g_rgIcons     = rgNew;
+        g_cIconsAlloc = cAlloc;
+    }
+
+    int iImage = ImageList_AddIcon(g_himl, g_hPlaceholder);
+
+    if (iImage == -1)
+    {
+        return -1;
+    }
+
+    iEntry = g_cIcons++;
+    g_rgIcons[iEntry].iImage = iImage;
+
+    return iEntry;
+}
+
+int ProcessIconCache_Lookup(PCWSTR pszPath)
+{
+    if (!g_himl || !pszPath || pszPath[0] == L'\0')
+    {
+        return -1;
+    }
+
+    int iEntry = IconHash_Find(pszPath);
+
+    if (iEntry != -1)
+    {
+        g_rgIcons[iEntry].uLastUse = g_uGeneration;
+        return g_rgIcons[iEntry].iImage;
+    }
+
+    iEntry = AllocateIconEntry();
+
+    if (iEntry == -1)
+    {
+        return -1;
+    }
+
+    ICONENTRY *pEntry = &g_rgIcons[iEntry];
+
+    wcscpy_s(pEntry->szPath, ARRAYSIZE(pEntry->szPath), pszPath);
+    pEntry->uLastUse = g_uGeneration;
+    pEntry->uSerial  = ++g_uSerial;
+
+    if (!IconHash_Rebuild())
+    {
+        // Can't find it again, so don't keep it.
+        pEntry->szPath[0] = L'\0';
+    }
+
+    // Fetch the real icon in the background.
+
+    ICONREQUEST *pReq = (ICONREQUEST *)calloc(1, sizeof(ICONREQUEST));
+
+    if (pReq)
+    {
+        pReq->hwndNotify = g_hwndNotify;
+        pReq->uMsg       = g_uNotifyMsg;
+        pReq->iEntry     = iEntry;
+        pReq->uSerial    = pEntry->uSerial;
+        wcscpy_s(pReq->szPath, ARRAYSIZE(pReq->szPath), pszPath);
+
+        if (!TrySubmitThreadpoolCallback(LoadIconWorker, pReq, NULL))
+        {
+            free(pReq);
+        }
+    }
+
+    return pEntry->iImage;
+}
+
+//
+//  Tree items that survive a refresh don't look up their icon again, so
+//  they mark it as used here.  There are only a few hundred entries at
+//  most, so a scan will do.
+//
+void ProcessIconCache_Touch(int iImage)
+{
+    for (int i = 0; i < g_cIcons; i++)
+    {
+        if (g_rgIcons[i].iImage == iImage)
+        {
+            g_rgIcons[i].uLastUse = g_uGeneration;
+            break;
+        }
+    }
+}
+
+BOOL ProcessIconCache_OnIconReady(LPARAM lParam)
+{
+    ICONREQUEST *pReq     = (ICONREQUEST *)lParam;
+    BOOL         fChanged = FALSE;
+
+    // The entry may have been recycled for another path in the meantime.
+
+    if (pReq->hIcon && g_himl && pReq->iEntry < g_cIcons &&
+        g_rgIcons[pReq->iEntry].uSerial == pReq->uSerial)
+    {
+        fChanged = ImageList_ReplaceIcon(g_himl, g_rgIcons[pReq->iEntry].iImage, pReq->hIcon) != -1;
+    }
+
+    if (pReq->hIcon)
+    {
+        DestroyIcon(pReq->hIcon);
+    }
+
+    free(pReq);
+
+    return fChanged;
+}
@@ -0,0 +1,38 @@
+#ifndef PROCESSICONCACHE_INCLUDED
+#define PROCESSICONCACHE_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Cache of process icons in the window tree's image list, keyed by image
+// path.  Each path gets a stable image index, so refreshing the tree
+// doesn't keep adding icons.  The icons are loaded on the thread pool; the
+// slot holds the placeholder image until the load completes, at which
+// point uMsg is posted to hwndNotify and should be passed on to
+// ProcessIconCache_OnIconReady.
+//
+void ProcessIconCache_Initialize(HIMAGELIST himl, int iPlaceholder, HWND hwndNotify, UINT uMsg);
+void ProcessIconCache_Destroy();
+
+//
+// Starts a new refresh.  Icons that haven't been used since the previous
+// refresh can be evicted once the cache is full.
+//
+void ProcessIconCache_NextGeneration();
+
+// Returns the image index for the path, or -1 if there isn't one.
+int  ProcessIconCache_Lookup(PCWSTR pszPath);
+
+// Marks the icon in use by an existing tree item.
+void ProcessIconCache_Touch(int iImage);
+
+// Returns TRUE if the image list changed.
+BOOL ProcessIconCache_OnIconReady(LPARAM lParam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,434 @@
+//
+//  ProcessInfoCache.c
+//
+//  Name, path, bitness, DPI awareness and integrity level of processes,
+//  looked up once per process.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+#include <tlhelp32.h>
+
+#include "ProcessInfoCache.h"
+#include "Utils.h"
+
+#define PROCESS_INFO_ACCESS     (PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE)
+
+void DescribeProcessDpiAwareness(HANDLE hProcess, PSTR pszAwareness, size_t cchAwareness, PSTR pszDpi, size_t cchDpi);
+
+typedef struct
+{
+    PROCESSINFO info;
+    HANDLE      hProcess;                   // Keeps the pid from being reused
+    BOOL        fOpened;                    // Opened (or denied), with the path and creation time
+    BOOL        fQueried;                   // Everything else is filled in too
+    DWORD       dwParentId;                 // From toolhelp, to spot a reused pid
+    DWORD       dwDeniedTime;
+    UINT        uLastSeen;                  // Refresh that last found it running
+}
+PROCESSENTRY;
+
+//
+//  Pointers to the entries, sorted by pid.
+//
+static PROCESSENTRY **g_rgpEntries;
+static size_t         g_cEntries;
+static size_t         g_cEntriesAlloc;
+static UINT           g_uRefresh;
+
+static size_t FindEntryIndex(DWORD dwProcessId, BOOL *pfFound)
+{
+    size_t iLow  = 0;
+    size_t iHigh = g_cEntries;
+
+    while (iLow < iHigh)
+    {
+        size_t iMid = iLow + (iHigh - iLow) / 2;
+
+        if (g_rgpEntries[iMid]->info.dwProcessId < dwProcessId)
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
+    }
+
+    *pfFound = (iLow < g_cEntries && g_rgpEntries[iLow]->info.dwProcessId == dwProcessId);
+    return iLow;
+}
+
+static PROCESSENTRY *InsertEntry(size_t iEntry, DWORD dwProcessId)
+{
+    PROCESSENTRY *pEntry;
+
+    if (g_cEntries == g_cEntriesAlloc)
+    {
+        size_t         cAlloc  = g_cEntriesAlloc ? g_cEntriesAlloc * 2 : 256;
+        PROCESSENTRY **rgpNew  = (PROCESSENTRY **)realloc(g_rgpEntries, cAlloc * sizeof(PROCESSENTRY *));
+
+        if (!rgpNew)
+            return NULL;
+
+        g_rgpEntries    = rgpNew;
+        g_cEntriesAlloc = cAlloc;
+    }
+
+    pEntry = (PROCESSENTRY *)calloc(1, sizeof(PROCESSENTRY));
+
+    if (!pEntry)
+        return NULL;
+
+    pEntry->info.dwProcessId = dwProcessId;
+    pEntry->info.dwIntegrity = PROCESSINFO_NO_INTEGRITY;
+    pEntry->uLastSeen        = g_uRefresh;
+
+    memmove(&g_rgpEntries[iEntry + 1], &g_rgpEntries[iEntry], (g_cEntries - iEntry) * sizeof(PROCESSENTRY *));
+    g_rgpEntries[iEntry] = pEntry;
+    g_cEntries++;
+
+    return pEntry;
+}
+
+static void FreeEntry(PROCESSENTRY *pEntry)
+{
+    if (pEntry->hProcess)
+        CloseHandle(pEntry->hProcess);
+
+    free(pEntry);
+}
+
+static void RemoveEntry(size_t iEntry)
+{
+    FreeEntry(g_rgpEntries[iEntry]);
+
+    g_cEntries--;
+    memmove(&g_rgpEntries[iEntry], &g_rgpEntries[iEntry + 1], (g_cEntries - iEntry) * sizeof(PROCESSENTRY *));
+}
+
+//
+//  Forget what was looked up, keeping only what toolhelp told us.
+//
+static void ResetEntry(PROCESSENTRY *pEntry)
+{
+    PROCESSENTRY entry = *pEntry;
+
+    if (pEntry->hProcess)
+        CloseHandle(pEntry->hProcess);
+
+    ZeroMemory(pEntry, sizeof(PROCESSENTRY));
+
+    pEntry->info.dwProcessId = entry.info.dwProcessId;
+    pEntry->info.dwIntegrity = PROCESSINFO_NO_INTEGRITY;
+    pEntry->dwParentId       = entry.dwParentId;
+    pEntry->uLastSeen        = entry.uLastSeen;
+
+    wcscpy_s(pEntry->info.szName, ARRAYSIZE(pEntry->info.szName), entry.info.szName);
+}
+
+//
+//  Without refreshes nothing notices processes exiting, so before the
+//  table grows, drop the ones we hold the last handles to.
+//
+static void RemoveExitedEntries(void)
+{
+    for (size_t iEntry = g_cEntries; iEntry-- > 0; )
+    {
+        HANDLE hProcess = g_rgpEntries[iEntry]->hProcess;
+
+        if (hProcess && WaitForSingleObject(hProcess, 0) == WAIT_OBJECT_0)
+            RemoveEntry(iEntry);
+    }
+}
+
+static DWORD GetProcessIntegrity(HANDLE hProcess)
+{
+    HANDLE    hToken;
+    DWORD_PTR rgBuffer[(sizeof(TOKEN_MANDATORY_LABEL) + SECURITY_MAX_SID_SIZE) / sizeof(DWORD_PTR) + 1];
+    DWORD     cbBuffer;
+    DWORD     dwIntegrity = PROCESSINFO_NO_INTEGRITY;
+
+    if (!OpenProcessToken(hProcess, TOKEN_QUERY, &hToken))
+        return dwIntegrity;
+
+    if (GetTokenInformation(hToken, TokenIntegrityLevel, rgBuffer, sizeof(rgBuffer), &cbBuffer))
+    {
+        PSID pSid = ((TOKEN_MANDATORY_LABEL *)rgBuffer)->Label.Sid;
+
+        dwIntegrity = *GetSidSubAuthority(pSid, *GetSidSubAuthorityCount(pSid) - 1);
+    }
+
+    CloseHandle(hToken);
+
+    return dwIntegrity;
+}
+
+//
+//  Open the process and find out its path and creation time, which is all
+//  the icons need.  Returns FALSE if there's no such process.
+//
+static BOOL OpenEntry(PROCESSENTRY *pEntry)
+{
+    PROCESSINFO *pInfo = &pEntry->info;
+    HANDLE       hProcess;
+    FILETIME     ftExit, ftKernel, ftUser;
+    DWORD        cchPath = ARRAYSIZE(pInfo->szPath);
+    WCHAR       *pszName;
+
+    if (pEntry->fOpened)
+        return TRUE;
+
+    hProcess = OpenProcess(PROCESS_INFO_ACCESS, FALSE, pInfo->dwProcessId);
+
+    if (!hProcess)
+    {
+        if (GetLastError() != ERROR_ACCESS_DENIED)
+            return FALSE;
+
+        pEntry->fOpened      = TRUE;
+        pEntry->dwDeniedTime = GetTickCount();
+
+        pInfo->fAccessDenied = TRUE;
+        return TRUE;
+    }
+
+    pEntry->hProcess = hProcess;
+    pEntry->fOpened  = TRUE;
+
+    GetProcessTimes(hProcess, &pInfo->ftCreation, &ftExit, &ftKernel, &ftUser);
+
+    if (QueryFullProcessImageName(hProcess, 0, pInfo->szPath, &cchPath))
+    {
+        pszName = wcsrchr(pInfo->szPath, L'\\');
+        wcscpy_s(pInfo->szName, ARRAYSIZE(pInfo->szName), pszName ? pszName + 1 : pInfo->szPath);
+    }
+    else
+    {
+        pInfo->szPath[0] = L'\0';
+    }
+
+    return TRUE;
+}
+
+//
+//  Open the process and fill in everything.  Returns FALSE if there's no
+//  such process.
+//
+static BOOL QueryEntry(PROCESSENTRY *pEntry)
+{
+    PROCESSINFO *pInfo = &pEntry->info;
+
+    if (!OpenEntry(pEntry))
+        return FALSE;
+
+    pEntry->fQueried = TRUE;
+
+    if (pInfo->fAccessDenied)
+    {
+        DescribeProcessDpiAwareness(NULL, pInfo->szDpiAwareness, ARRAYSIZE(pInfo->szDpiAwareness), pInfo->szSystemDpi, ARRAYSIZE(pInfo->szSystemDpi));
+        return TRUE;
+    }
+
+    pInfo->fArchMatches = ProcessHandleArchMatches(pEntry->hProcess);
+    pInfo->dwIntegrity  = GetProcessIntegrity(pEntry->hProcess);
+
+    DescribeProcessDpiAwareness(pEntry->hProcess, pInfo->szDpiAwareness, ARRAYSIZE(pInfo->szDpiAwareness), pInfo->szSystemDpi, ARRAYSIZE(pInfo->szSystemDpi));
+
+    return TRUE;
+}
+
+//
+//  Without a handle of ours the pid may have been reused.  Toolhelp can at
+//  least tell us if it's a different program, in which case what we know
+//  is thrown away.
+//
+static void MatchToolhelpEntry(PROCESSENTRY *pEntry, const PROCESSENTRY32 *pe)
+{
+    if (!pEntry->hProcess && pEntry->fOpened &&
+        (pEntry->dwParentId != pe->th32ParentProcessID || _wcsicmp(pEntry->info.szName, pe->szExeFile) != 0))
+    {
+        ResetEntry(pEntry);
+    }
+
+    if (!pEntry->fOpened)
+        wcscpy_s(pEntry->info.szName, ARRAYSIZE(pEntry->info.szName), pe->szExeFile);
+
+    pEntry->dwParentId = pe->th32ParentProcessID;
+}
+
+//
+//  A process we couldn't open holds no handle, so its pid may belong to
+//  another process by now.  Checks it against toolhelp before the entry is
+//  used; returns FALSE if the pid isn't running at all.
+//
+static BOOL RecheckDeniedEntry(PROCESSENTRY *pEntry)
+{
+    HANDLE         hSnapshot;
+    PROCESSENTRY32 pe = { sizeof(pe) };
+    BOOL           fFound = FALSE;
+
+    hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+
+    if (hSnapshot == INVALID_HANDLE_VALUE)
+        return TRUE;
+
+    if (Process32First(hSnapshot, &pe))
+    {
+        do
+        {
+            if (pe.th32ProcessID == pEntry->info.dwProcessId)
+            {
+                MatchToolhelpEntry(pEntry, &pe);
+                fFound = TRUE;
+                break;
+            }
+
+        } while (Process32Next(hSnapshot, &pe));
+    }
+
+    CloseHandle(hSnapshot);
+
+    return fFound;
+}
+
+void ProcessInfoCache_Refresh(void)
+{
+    HANDLE         hSnapshot;
+    PROCESSENTRY32 pe = { sizeof(pe) };
+    PROCESSENTRY  *pEntry;
+    size_t         iEntry;
+    BOOL           fFound;
+
+    hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+
+    if (hSnapshot == INVALID_HANDLE_VALUE)
+        return;
+
+    g_uRefresh++;
+
+    if (Process32First(hSnapshot, &pe))
+    {
+        do
+        {
+            iEntry = FindEntryIndex(pe.th32ProcessID, &fFound);
+
+            if (fFound)
+            {
+                pEntry = g_rgpEntries[iEntry];
+            }
+            else
+            {
+                pEntry = InsertEntry(iEntry, pe.th32ProcessID);
+
+                if (!pEntry)
+                    break;
+            }
+
+            MatchToolhelpEntry(pEntry, &pe);
+            pEntry->uLastSeen = g_uRefresh;
+
+        } while (Process32Next(hSnapshot, &pe));
+    }
+
+    CloseHandle(hSnapshot);
+
+    // Drop the processes that weren't in the snapshot
+    for (iEntry = g_cEntries; iEntry-- > 0; )
+    {
+        if (g_rgpEntries[iEntry]->uLastSeen != g_uRefresh)
+            RemoveEntry(iEntry);
+    }
+}
+
+//
+//  The entry for a pid, added (with nothing known about it yet) if there
+//  isn't one.
+//
+static PROCESSENTRY *LookupEntry(DWORD dwProcessId, size_t *piEntry)
+{
+    PROCESSENTRY *pEntry;
+    BOOL          fFound;
+
+    if (g_cEntries == g_cEntriesAlloc)
+        RemoveExitedEntries();
+
+    *piEntry = FindEntryIndex(dwProcessId, &fFound);
+
+    if (!fFound)
+        return InsertEntry(*piEntry, dwProcessId);
+
+    pEntry = g_rgpEntries[*piEntry];
+
+    if (pEntry->info.fAccessDenied && GetTickCount() - pEntry->dwDeniedTime > PROCESSINFO_DENIED_TTL)
+        ResetEntry(pEntry);
+
+    return pEntry;
+}
+
+BOOL ProcessInfoCache_Get(DWORD dwProcessId, PROCESSINFO *pInfo)
+{
+    size_t        iEntry;
+    PROCESSENTRY *pEntry = LookupEntry(dwProcessId, &iEntry);
+
+    if (!pEntry)
+        return FALSE;
+
+    if ((pEntry->info.fAccessDenied && !RecheckDeniedEntry(pEntry)) ||
+        (!pEntry->fQueried && !QueryEntry(pEntry)))
+    {
+        RemoveEntry(iEntry);
+        return FALSE;
+    }
+
+    *pInfo = pEntry->info;
+    return TRUE;
+}
+
+BOOL ProcessInfoCache_GetName(DWORD dwProcessId, PWSTR pszName, size_t cchName)
+{
+    size_t        iEntry;
+    PROCESSENTRY *pEntry = LookupEntry(dwProcessId, &iEntry);
+
+    if (!pEntry)
+        return FALSE;
+
+    // Only a process that started after the last refresh has no name yet
+    if (!pEntry->info.szName[0] && !OpenEntry(pEntry))
+    {
+        RemoveEntry(iEntry);
+        return FALSE;
+    }
+
+    wcsncpy_s(pszName, cchName, pEntry->info.szName, _TRUNCATE);
+    return TRUE;
+}
+
+BOOL ProcessInfoCache_GetPath(DWORD dwProcessId, PWSTR pszPath, size_t cchPath)
+{
+    size_t        iEntry;
+    PROCESSENTRY *pEntry = LookupEntry(dwProcessId, &iEntry);
+
+    if (!pEntry)
+        return FALSE;
+
+    if ((pEntry->info.fAccessDenied && !RecheckDeniedEntry(pEntry)) || !OpenEntry(pEntry))
+    {
+        RemoveEntry(iEntry);
+        return FALSE;
+    }
+
+    wcsncpy_s(pszPath, cchPath, pEntry->info.szPath, _TRUNCATE);
+    return TRUE;
+}
+
+void ProcessInfoCache_Destroy(void)
+{
+    for (size_t i = 0; i < g_cEntries; i++)
+    {
+        FreeEntry(g_rgpEntries[i]);
+    }
+
+    free(g_rgpEntries);
+
+    g_rgpEntries    = NULL;
+    g_cEntries      = 0;
+    g_cEntriesAlloc = 0;
+}
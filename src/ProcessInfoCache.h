@@ -0,0 +1,66 @@
+#ifndef PROCESSINFOCACHE_INCLUDED
+#define PROCESSINFOCACHE_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// PROCESSINFO
+//
+// What WinSpy shows about a process, looked up once per process instead of
+// once per question.  A process is opened the first time it's asked about
+// and the handle is kept; while a handle is open the pid can't be reused,
+// so (pid, creation time) keeps naming the same process until the entry is
+// dropped.  Entries go when a refresh finds the process has exited.
+//
+// ProcessInfoCache_Refresh makes one toolhelp pass over all processes.  It
+// drops the entries for processes that have gone and adds the image name of
+// every new one, so the window tree can label processes without opening
+// them (ProcessInfoCache_GetName).  The icons only need the path, which
+// takes opening the process but none of the other queries
+// (ProcessInfoCache_GetPath); the rest is looked up when something asks
+// for all of it (ProcessInfoCache_Get).
+//
+// A process that can't be opened is remembered as such (fAccessDenied) and
+// not tried again until its pid turns out to be running something else, or
+// PROCESSINFO_DENIED_TTL has passed.  There's no handle to keep such a pid
+// from being reused, so before one of these entries is handed out it's
+// checked against toolhelp.
+//
+// Only the UI thread uses this.
+//
+
+#define PROCESSINFO_DENIED_TTL      10000   // Milliseconds
+#define PROCESSINFO_NO_INTEGRITY    0xFFFFFFFF
+
+typedef struct
+{
+    DWORD       dwProcessId;
+    FILETIME    ftCreation;                 // Zero if the process couldn't be opened
+    BOOL        fAccessDenied;
+    BOOL        fArchMatches;               // Same bitness as WinSpy (see ProcessArchMatches)
+    DWORD       dwIntegrity;                // SECURITY_MANDATORY_xxx_RID or PROCESSINFO_NO_INTEGRITY
+    WCHAR       szName[MAX_PATH];           // From toolhelp if the process can't be opened
+    WCHAR       szPath[MAX_PATH];           // Empty if the process can't be opened
+    CHAR        szDpiAwareness[64];
+    CHAR        szSystemDpi[32];
+}
+PROCESSINFO;
+
+void ProcessInfoCache_Refresh(void);
+
+// These return FALSE if there's no such process.  The path is empty if
+// the process can't be opened.
+BOOL ProcessInfoCache_Get(DWORD dwProcessId, PROCESSINFO *pInfo);
+BOOL ProcessInfoCache_GetName(DWORD dwProcessId, PWSTR pszName, size_t cchName);
+BOOL ProcessInfoCache_GetPath(DWORD dwProcessId, PWSTR pszPath, size_t cchPath);
+
+// Closes the process handles.
+void ProcessInfoCache_Destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,460 @@
+//
+//  RemoteAgent.c
+//
+//  Long-lived agent threads in other processes, which answer window queries
+//  over a shared memory ring instead of needing a thread injected for each
+//  one.
+//
+//  The agent is injected the same way as GetRemoteWindowInfo's thread, so
+//  the same rules apply: it must not call ANY code in this process, only
+//  the system functions it's given the addresses of.
+//
+
+#include "WinSpy.h"
+
+#include "InjectThread.h"
+
+// The agent's half of the ring goes with the agent (see AgentRing.h).
+#define AGENTRING_AGENT_CODE __declspec(code_seg(".agent$m"))
+
+#include "RemoteAgent.h"
+
+#define AGENT_ACCESS (PROCESS_CREATE_THREAD|PROCESS_QUERY_INFORMATION|PROCESS_VM_OPERATION|PROCESS_VM_READ|PROCESS_VM_WRITE|PROCESS_DUP_HANDLE|SYNCHRONIZE)
+
+#define MAX_AGENTS          8
+#define AGENT_IDLE_TIMEOUT  (5 * 60 * 1000)     // Agents exit after this long without a request
+#define AGENT_REPLY_TIMEOUT 7000                // As for a one-off injected thread
+#define AGENT_STOP_TIMEOUT  200
+
+typedef PVOID(WINAPI *PROCMAPVIEWOFFILE)(HANDLE, DWORD, DWORD, DWORD, SIZE_T);
+typedef BOOL(WINAPI *PROCUNMAPVIEWOFFILE)(LPCVOID);
+typedef BOOL(WINAPI *PROCCLOSEHANDLE)(HANDLE);
+typedef DWORD(WINAPI *PROCWAITFORMULTIPLEOBJECTS)(DWORD, const HANDLE *, BOOL, DWORD);
+typedef BOOL(WINAPI *PROCSETEVENT)(HANDLE);
+typedef BOOL(WINAPI *PROCGETCLASSINFOEXW)(HINSTANCE, PCWSTR, WNDCLASSEXW*);
+typedef LONG_PTR(WINAPI *PROCGETWINDOWLONGPTR)(HWND, int);
+typedef LRESULT(WINAPI *PROCSENDMESSAGETO)(HWND, UINT, WPARAM, LPARAM, UINT, UINT, PDWORD_PTR);
+
+//
+//  What the agent is started with.  It stays in the target process next to
+//  the agent's code for as long as the agent runs.
+//
+typedef struct
+{
+    // kernel32
+    PROCMAPVIEWOFFILE           fnMapViewOfFile;
+    PROCUNMAPVIEWOFFILE         fnUnmapViewOfFile;
+    PROCCLOSEHANDLE             fnCloseHandle;
+    PROCWAITFORMULTIPLEOBJECTS  fnWaitForMultipleObjects;
+    PROCSETEVENT                fnSetEvent;
+
+    // user32
+    PROCGETWINDOWLONGPTR        fnGetWindowLongPtrW;
+    PROCGETWINDOWLONGPTR        fnGetWindowLongPtrA;
+    PROCGETCLASSINFOEXW         fnGetClassInfoExW;
+    PROCGETCLASSINFOEXW         fnGetClassInfoExA;
+    PROCSENDMESSAGETO           fnSendMessageTimeoutW;
+
+    // Handles duplicated into the target process
+    HANDLE      hMapping;
+    HANDLE      hResponse;
+    HANDLE      rghWait[2];                     // Request event, WinSpy's process
+
+    DWORD       dwIdleTimeout;
+}
+AGENTSTART;
+
+typedef struct
+{
+    DWORD       dwProcessId;                    // 0 for an unused entry
+    HANDLE      hProcess;
+    HANDLE      hThread;                        // The agent
+    HANDLE      hMapping;
+    HANDLE      hRequest;
+    HANDLE      hResponse;
+    AGENTRING  *pRing;                          // Our view of the ring
+    PVOID       pRemoteCode;                    // AgentProc and its AGENTSTART in the target
+    DWORD       dwLastUsed;
+}
+REMOTEAGENT;
+
+static REMOTEAGENT g_rgAgents[MAX_AGENTS];
+static SRWLOCK     g_AgentLock = SRWLOCK_INIT;     // Queries come from workers too
+
+#pragma runtime_checks("", off)
+#pragma check_stack(off)
+
+//
+//  The agent itself.  Serves everything in the ring each time it's woken,
+//  and exits when it's told to, when WinSpy exits or when it's been idle
+//  for too long.
+//
+__declspec(code_seg(".agent$a"))
+static DWORD WINAPI AgentProc(PVOID pParam)
+{
+    AGENTSTART *pStart = (AGENTSTART *)pParam;
+    AGENTRING  *pRing;
+    AGENTSLOT  *pSlot;
+    DWORD_PTR   dwpResult;
+
+    pRing = (AGENTRING *)pStart->fnMapViewOfFile(pStart->hMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(AGENTRING));
+
+    if (pRing)
+    {
+        while (pStart->fnWaitForMultipleObjects(2, pStart->rghWait, FALSE, pStart->dwIdleTimeout) == WAIT_OBJECT_0 && !pRing->fQuit)
+        {
+            while ((pSlot = AgentRing_NextRequest(pRing)) != NULL)
+            {
+                pSlot->fAnswered = 0;
+
+                if (pSlot->fQuery & AGENT_QUERY_WNDPROC)
+                {
+                    PROCGETWINDOWLONGPTR fnGetWindowLongPtr = pSlot->fUnicode ? pStart->fnGetWindowLongPtrW : pStart->fnGetWindowLongPtrA;
+
+                    pSlot->wndproc = (WNDPROC)fnGetWindowLongPtr(pSlot->hwnd, GWLP_WNDPROC);
+                    pSlot->fAnswered |= AGENT_QUERY_WNDPROC;
+                }
+
+                if (pSlot->fQuery & AGENT_QUERY_CLASS)
+                {
+                    PROCGETCLASSINFOEXW fnGetClassInfoEx = pSlot->fUnicode ? pStart->fnGetClassInfoExW : pStart->fnGetClassInfoExA;
+
+                    pSlot->wc.cbSize = sizeof(pSlot->wc);
+
+                    if (fnGetClassInfoEx(pSlot->hInst, (PCWSTR)(intptr_t)pSlot->atom, &pSlot->wc))
+                        pSlot->fAnswered |= AGENT_QUERY_CLASS;
+                }
+
+                if (pSlot->fQuery & AGENT_QUERY_TEXT)
+                {
+                    // Null-terminate in case the gettext fails
+                    pSlot->szText[0] = L'\0';
+
+                    if (pStart->fnSendMessageTimeoutW(pSlot->hwnd, WM_GETTEXT, AGENT_MAX_TEXT, (LPARAM)pSlot->szText, SMTO_ABORTIFHUNG, 100, &dwpResult))
+                        pSlot->fAnswered |= AGENT_QUERY_TEXT;
+
+                    pSlot->szText[AGENT_MAX_TEXT - 1] = L'\0';
+                }
+
+                AgentRing_CompleteRequest(pRing);
+            }
+
+            pStart->fnSetEvent(pStart->hResponse);
+        }
+
+        pStart->fnUnmapViewOfFile(pRing);
+    }
+
+    pStart->fnCloseHandle(pStart->rghWait[1]);
+    pStart->fnCloseHandle(pStart->rghWait[0]);
+    pStart->fnCloseHandle(pStart->hResponse);
+    pStart->fnCloseHandle(pStart->hMapping);
+
+    return 0;
+}
+
+__declspec(code_seg(".agent$z"))
+static void AfterAgentProc(void) { }
+
+#pragma check_stack
+#pragma runtime_checks("", restore)
+
+//
+//  As with GetRemoteWindowInfo, every function we hand the agent must be in
+//  a system DLL that's at the same address in every process.
+//
+static BOOL IsSystemFunction(PVOID fn)
+{
+    HMODULE hModule;
+
+    if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (PCWSTR)fn, &hModule))
+        return FALSE;
+
+    return hModule == GetModuleHandle(L"user32.dll") ||
+           hModule == GetModuleHandle(L"kernel32.dll") ||
+           hModule == GetModuleHandle(L"kernelbase.dll");
+}
+
+static BOOL IsAgentStartValid(const AGENTSTART *pStart)
+{
+    PVOID rgfn[] =
+    {
+        (PVOID)(intptr_t)pStart->fnMapViewOfFile,
+        (PVOID)(intptr_t)pStart->fnUnmapViewOfFile,
+        (PVOID)(intptr_t)pStart->fnCloseHandle,
+        (PVOID)(intptr_t)pStart->fnWaitForMultipleObjects,
+        (PVOID)(intptr_t)pStart->fnSetEvent,
+        (PVOID)(intptr_t)pStart->fnGetWindowLongPtrW,
+        (PVOID)(intptr_t)pStart->fnGetWindowLongPtrA,
+        (PVOID)(intptr_t)pStart->fnGetClassInfoExW,
+        (PVOID)(intptr_t)pStart->fnGetClassInfoExA,
+        (PVOID)(intptr_t)pStart->fnSendMessageTimeoutW,
+    };
+
+    for (UINT i = 0; i < ARRAYSIZE(rgfn); i++)
+    {
+        if (!IsSystemFunction(rgfn[i]))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void CloseRemoteHandle(HANDLE hProcess, HANDLE hRemote)
+{
+    if (hRemote)
+        DuplicateHandle(hProcess, hRemote, NULL, NULL, 0, FALSE, DUPLICATE_CLOSE_SOURCE);
+}
+
+static void CloseAgentHandles(REMOTEAGENT *pAgent)
+{
+    if (pAgent->pRing)
+        UnmapViewOfFile(pAgent->pRing);
+
+    if (pAgent->hThread)
+        CloseHandle(pAgent->hThread);
+
+    if (pAgent->hResponse)
+        CloseHandle(pAgent->hResponse);
+
+    if (pAgent->hRequest)
+        CloseHandle(pAgent->hRequest);
+
+    if (pAgent->hMapping)
+        CloseHandle(pAgent->hMapping);
+
+    if (pAgent->hProcess)
+        CloseHandle(pAgent->hProcess);
+
+    ZeroMemory(pAgent, sizeof(REMOTEAGENT));
+}
+
+static BOOL StartAgent(REMOTEAGENT *pAgent, DWORD dwProcessId)
+{
+    HANDLE      hSelf = GetCurrentProcess();
+    AGENTSTART  start;
+    PVOID       pRemoteStart = NULL;
+
+    // Calculate how many bytes the agent takes, ring functions included
+    DWORD_PTR cbCodeSize = ((BYTE *)(intptr_t)AfterAgentProc - (BYTE *)(intptr_t)AgentProc);
+
+    ZeroMemory(pAgent, sizeof(REMOTEAGENT));
+    ZeroMemory(&start, sizeof(start));
+
+    start.fnMapViewOfFile          = MapViewOfFile;
+    start.fnUnmapViewOfFile        = UnmapViewOfFile;
+    start.fnCloseHandle            = CloseHandle;
+    start.fnWaitForMultipleObjects = WaitForMultipleObjects;
+    start.fnSetEvent               = SetEvent;
+    start.fnGetWindowLongPtrW      = GetWindowLongPtrW;
+    start.fnGetWindowLongPtrA      = GetWindowLongPtrA;
+    start.fnGetClassInfoExW        = GetClassInfoExW;
+    start.fnGetClassInfoExA        = (PROCGETCLASSINFOEXW)GetClassInfoExA;
+    start.fnSendMessageTimeoutW    = SendMessageTimeoutW;
+    start.dwIdleTimeout            = AGENT_IDLE_TIMEOUT;
+
+    if (!IsAgentStartValid(&start))
+        return FALSE;
+
+    pAgent->hProcess  = OpenProcess(AGENT_ACCESS, FALSE, dwProcessId);
+    pAgent->hMapping  = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(AGENTRING), NULL);
+    pAgent->hRequest  = CreateEvent(NULL, FALSE, FALSE, NULL);
+    pAgent->hResponse = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if (pAgent->hProcess && pAgent->hMapping && pAgent->hRequest && pAgent->hResponse)
+        pAgent->pRing = (AGENTRING *)MapViewOfFile(pAgent->hMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(AGENTRING));
+
+    if (pAgent->pRing)
+    {
+        AgentRing_Init(pAgent->pRing);
+
+        // The agent gets its own handles to everything, including one to
+        // this process so that it notices when we're gone.
+
+        if (DuplicateHandle(hSelf, pAgent->hMapping, pAgent->hProcess, &start.hMapping, 0, FALSE, DUPLICATE_SAME_ACCESS) &&
+            DuplicateHandle(hSelf, pAgent->hResponse, pAgent->hProcess, &start.hResponse, EVENT_MODIFY_STATE, FALSE, 0) &&
+            DuplicateHandle(hSelf, pAgent->hRequest, pAgent->hProcess, &start.rghWait[0], SYNCHRONIZE, FALSE, 0) &&
+            DuplicateHandle(hSelf, hSelf, pAgent->hProcess, &start.rghWait[1], SYNCHRONIZE, FALSE, 0))
+        {
+            pAgent->pRemoteCode = WriteRemoteCode(pAgent->hProcess, AgentProc, cbCodeSize, &start, sizeof(start), sizeof(start), &pRemoteStart);
+        }
+
+        if (pAgent->pRemoteCode)
+        {
+            pAgent->hThread = CreateRemoteThread(pAgent->hProcess, NULL, 0,
+                (LPTHREAD_START_ROUTINE)(intptr_t)pAgent->pRemoteCode, pRemoteStart, 0, NULL);
+        }
+    }
+
+    if (!pAgent->hThread)
+    {
+        // Nothing is running in the target, so everything can go
+        if (pAgent->pRemoteCode)
+            VirtualFreeEx(pAgent->hProcess, pAgent->pRemoteCode, 0, MEM_RELEASE);
+
+        if (pAgent->hProcess)
+        {
+            CloseRemoteHandle(pAgent->hProcess, start.rghWait[1]);
+            CloseRemoteHandle(pAgent->hProcess, start.rghWait[0]);
+            CloseRemoteHandle(pAgent->hProcess, start.hResponse);
+            CloseRemoteHandle(pAgent->hProcess, start.hMapping);
+        }
+
+        CloseAgentHandles(pAgent);
+        return FALSE;
+    }
+
+    pAgent->dwProcessId = dwProcessId;
+    return TRUE;
+}
+
+//
+//  The agent closes its own handles.  Its code can only be freed once it
+//  has exited; if it doesn't in time it's left behind, as InjectRemoteThread
+//  does with a thread that doesn't finish.
+//
+static void StopAgent(REMOTEAGENT *pAgent, DWORD dwTimeout)
+{
+    pAgent->pRing->fQuit = TRUE;
+    SetEvent(pAgent->hRequest);
+
+    if (WaitForSingleObject(pAgent->hThread, dwTimeout) == WAIT_OBJECT_0)
+        VirtualFreeEx(pAgent->hProcess, pAgent->pRemoteCode, 0, MEM_RELEASE);
+
+    CloseAgentHandles(pAgent);
+}
+
+static DWORD AgentAge(const REMOTEAGENT *pAgent, DWORD dwNow)
+{
+    return pAgent->dwProcessId ? dwNow - pAgent->dwLastUsed : MAXDWORD;
+}
+
+//
+//  Finds the agent for a process, or starts one in place of the least
+//  recently used.
+//
+static REMOTEAGENT *GetAgent(DWORD dwProcessId)
+{
+    DWORD        dwNow  = GetTickCount();
+    REMOTEAGENT *pAgent = NULL;
+
+    for (int i = 0; i < MAX_AGENTS; i++)
+    {
+        REMOTEAGENT *pEntry = &g_rgAgents[i];
+
+        // Agents that have exited (idle, or their process went away and the
+        // id may since have been reused) are cleared out.
+
+        if (pEntry->dwProcessId && WaitForSingleObject(pEntry->hThread, 0) != WAIT_TIMEOUT)
+            StopAgent(pEntry, 0);
+
+        if (pEntry->dwProcessId == dwProcessId)
+        {
+            pEntry->dwLastUsed = dwNow;
+            return pEntry;
+        }
+
+        if (!pAgent || AgentAge(pEntry, dwNow) > AgentAge(pAgent, dwNow))
+            pAgent = pEntry;
+    }
+
+    if (pAgent->dwProcessId)
+        StopAgent(pAgent, AGENT_STOP_TIMEOUT);
+
+    if (!StartAgent(pAgent, dwProcessId))
+        return NULL;
+
+    pAgent->dwLastUsed = dwNow;
+    return pAgent;
+}
+
+static BOOL WaitForAgent(REMOTEAGENT *pAgent, LONG iSeq)
+{
+    HANDLE rgh[2] = { pAgent->hResponse, pAgent->hThread };
+
+    // Stale wakeups from an earlier batch are possible, so keep checking.
+    // The agent may also have timed out just as the request went in.
+
+    while (!AgentRing_IsComplete(pAgent->pRing, iSeq))
+    {
+        if (WaitForMultipleObjects(2, rgh, FALSE, AGENT_REPLY_TIMEOUT) != WAIT_OBJECT_0)
+            return AgentRing_IsComplete(pAgent->pRing, iSeq);
+    }
+
+    return TRUE;
+}
+
+BOOL RemoteAgent_QueryWindows(DWORD dwProcessId, AGENTSLOT *rgQueries, UINT cQueries)
+{
+    REMOTEAGENT *pAgent;
+    AGENTSLOT   *pSlot;
+    UINT         iNext = 0;
+
+    if (cQueries == 0)
+        return TRUE;
+
+    AcquireSRWLockExclusive(&g_AgentLock);
+
+    pAgent = GetAgent(dwProcessId);
+
+    while (pAgent && iNext < cQueries)
+    {
+        UINT iFirst    = iNext;
+        LONG iFirstSeq = 0;
+        LONG iSeq      = 0;
+
+        // Post as much as fits and wake the agent once for the lot
+
+        while (iNext < cQueries && (pSlot = AgentRing_BeginRequest(pAgent->pRing)) != NULL)
+        {
+            HWND hwnd = rgQueries[iNext].hwnd;
+
+            pSlot->hwnd     = hwnd;
+            pSlot->fQuery   = rgQueries[iNext].fQuery;
+            pSlot->fUnicode = IsWindowUnicode(hwnd);
+            pSlot->atom     = (ATOM)GetClassLong(hwnd, GCW_ATOM);
+            pSlot->hInst    = (HINSTANCE)GetClassLongPtr(hwnd, GCLP_HMODULE);
+
+            iSeq = AgentRing_PostRequest(pAgent->pRing);
+
+            if (iNext == iFirst)
+                iFirstSeq = iSeq;
+
+            iNext++;
+        }
+
+        SetEvent(pAgent->hRequest);
+
+        if (!WaitForAgent(pAgent, iSeq))
+        {
+            StopAgent(pAgent, 0);
+            pAgent = NULL;
+            break;
+        }
+
+        for (UINT i = iFirst; i < iNext; i++)
+        {
+            rgQueries[i] = *AgentRing_GetSlot(pAgent->pRing, iFirstSeq + (LONG)(i - iFirst));
+
+            // As these pointers come from another process, zero them out to avoid accidental misuse
+            rgQueries[i].wc.lpszClassName = rgQueries[i].wc.lpszMenuName = NULL;
+        }
+    }
+
+    ReleaseSRWLockExclusive(&g_AgentLock);
+
+    return pAgent != NULL;
+}
+
+void RemoteAgent_Shutdown(void)
+{
+    AcquireSRWLockExclusive(&g_AgentLock);
+
+    for (int i = 0; i < MAX_AGENTS; i++)
+    {
+        if (g_rgAgents[i].dwProcessId)
+            StopAgent(&g_rgAgents[i], AGENT_STOP_TIMEOUT);
+    }
+
+    ReleaseSRWLockExclusive(&g_AgentLock);
+}
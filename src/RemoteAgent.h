@@ -0,0 +1,44 @@
+#ifndef REMOTEAGENT_INCLUDED
+#define REMOTEAGENT_INCLUDED
+
+#include "AgentRing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// REMOTEAGENT
+//
+// Instead of injecting a new thread for every question about a window in
+// another process, WinSpy can leave an agent thread running in the process
+// that answers requests over an AGENTRING.  The first query against a
+// process starts its agent (which costs about the same as one injected
+// thread); after that a query is a shared memory write and an event round
+// trip.
+//
+// Agents exit by themselves when they've been idle for a while or WinSpy
+// goes away.  A handful of processes get agents at a time, the least
+// recently used one is stopped to make room.  Calls are serialized, so
+// worker threads can use this too.
+//
+
+//
+// Fills in the request part of each slot from rgQueries[i].hwnd and
+// rgQueries[i].fQuery, and gets the answers from the agent in the process
+// that owns the windows (which must all belong to dwProcessId).
+//
+// Returns FALSE if the agent couldn't be started or didn't answer, in which
+// case the caller should fall back to InjectRemoteThread.  Otherwise check
+// fAnswered in each slot.
+//
+BOOL RemoteAgent_QueryWindows(DWORD dwProcessId, AGENTSLOT *rgQueries, UINT cQueries);
+
+// Stops all the agents.
+void RemoteAgent_Shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
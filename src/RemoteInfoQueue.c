@@ -0,0 +1,66 @@
+//
+//  RemoteInfoQueue.c
+//
+//  Serializes remote info workers and recognises stale results.
+//
+
+#include "WinSpy.h"
+
+#include "RemoteInfoQueue.h"
+
+LONG RemoteInfoQueue_Request(REMOTEINFOQUEUE *pQueue, HWND hwnd, BOOL *pfStartNow)
+{
+    LONG uSerial = InterlockedIncrement(&pQueue->uSerial);
+
+    if (pQueue->fBusy)
+    {
+        // Whatever was queued before is stale now anyway.
+        pQueue->fQueued    = TRUE;
+        pQueue->hwndQueued = hwnd;
+        *pfStartNow = FALSE;
+    }
+    else
+    {
+        pQueue->fBusy = TRUE;
+        *pfStartNow = TRUE;
+    }
+
+    return uSerial;
+}
+
+void RemoteInfoQueue_Cancel(REMOTEINFOQUEUE *pQueue)
+{
+    InterlockedIncrement(&pQueue->uSerial);
+
+    pQueue->fQueued    = FALSE;
+    pQueue->hwndQueued = NULL;
+}
+
+BOOL RemoteInfoQueue_IsCurrent(const REMOTEINFOQUEUE *pQueue, LONG uSerial)
+{
+    return pQueue->uSerial == uSerial;
+}
+
+BOOL RemoteInfoQueue_Complete(REMOTEINFOQUEUE *pQueue, LONG uSerial, BOOL *pfStartNext, HWND *phwndNext, LONG *puSerialNext)
+{
+    BOOL fCurrent = RemoteInfoQueue_IsCurrent(pQueue, uSerial);
+
+    *pfStartNext = pQueue->fQueued;
+
+    if (pQueue->fQueued)
+    {
+        // The queued request is always the newest one, and the worker
+        // carries straight on with it.
+        *phwndNext    = pQueue->hwndQueued;
+        *puSerialNext = pQueue->uSerial;
+
+        pQueue->fQueued    = FALSE;
+        pQueue->hwndQueued = NULL;
+    }
+    else
+    {
+        pQueue->fBusy = FALSE;
+    }
+
+    return fCurrent;
+}
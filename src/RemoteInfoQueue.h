@@ -0,0 +1,57 @@
+#ifndef REMOTEINFOQUEUE_INCLUDED
+#define REMOTEINFOQUEUE_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// REMOTEINFOQUEUE
+//
+// Bookkeeping for fetching remote window info on a worker thread.  Only
+// one worker runs at a time, because a worker can be stuck for seconds on
+// a target that's suspended or in a debugger.  Requests made while one is
+// running wait in a single slot, newest first, and each request gets a
+// serial number so results that arrive after a newer request (or a
+// cancel) can be recognised and dropped.
+//
+// There is no locking and no system calls; it's all driven from the UI
+// thread, which starts the workers and receives their results.  Workers
+// can read uSerial to skip work that has already been cancelled.
+//
+
+typedef struct
+{
+    volatile LONG   uSerial;        // Serial of the newest request or cancel
+    BOOL            fBusy;          // A worker is running
+    BOOL            fQueued;        // A request is waiting for the worker
+    HWND            hwndQueued;
+}
+REMOTEINFOQUEUE;
+
+//
+// Asks for info about hwnd and returns the request's serial.  If no worker
+// is running, *pfStartNow is set and the caller should start one for it;
+// otherwise it waits its turn.
+//
+LONG RemoteInfoQueue_Request(REMOTEINFOQUEUE *pQueue, HWND hwnd, BOOL *pfStartNow);
+
+// Drops any queued request and makes any running one stale.
+void RemoteInfoQueue_Cancel(REMOTEINFOQUEUE *pQueue);
+
+// TRUE if the request with this serial is still wanted.
+BOOL RemoteInfoQueue_IsCurrent(const REMOTEINFOQUEUE *pQueue, LONG uSerial);
+
+//
+// Called when a worker's result arrives.  Returns TRUE if the result is
+// current.  If a request was queued meanwhile it's returned through
+// phwndNext/puSerialNext (and TRUE is returned via pfStartNext) and the
+// caller should start a worker for it.
+//
+BOOL RemoteInfoQueue_Complete(REMOTEINFOQUEUE *pQueue, LONG uSerial, BOOL *pfStartNext, HWND *phwndNext, LONG *puSerialNext);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
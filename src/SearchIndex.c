@@ -0,0 +1,494 @@
+//
+//  SearchIndex.c
+//
+//  Trigram index used to search the window tree by caption, class or
+//  handle.  See SearchIndex.h.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+#include <wctype.h>
+
+#include "SearchIndex.h"
+
+#define MAX_QUERY_LEN   256
+
+static ULONGLONG TrigramKey(const WCHAR *pch)
+{
+    return ((ULONGLONG)pch[0] << 32) | ((ULONGLONG)pch[1] << 16) | pch[2];
+}
+
+static size_t HashTrigram(ULONGLONG key)
+{
+    key *= 0x9E3779B97F4A7C15ull;
+
+    return (size_t)(key >> 17);
+}
+
+static SEARCHTRIGRAM *FindTrigram(SEARCHINDEX *pIndex, ULONGLONG key)
+{
+    if (pIndex->cSlots == 0)
+    {
+        return NULL;
+    }
+
+    size_t mask = pIndex->cSlots - 1;
+    size_t slot = HashTrigram(key) & mask;
+
+    while (pIndex->rgSlots[slot].key != 0)
+    {
+        if (pIndex->rgSlots[slot].key == key)
+        {
+            return &pIndex->rgSlots[slot];
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return NULL;
+}
+
+static BOOL GrowTrigrams(SEARCHINDEX *pIndex)
+{
+    size_t         cOld    = pIndex->cSlots;
+    SEARCHTRIGRAM *rgOld   = pIndex->rgSlots;
+    size_t         cSlots  = cOld ? cOld * 2 : 1024;
+    SEARCHTRIGRAM *rgSlots = (SEARCHTRIGRAM *)calloc(cSlots, sizeof(SEARCHTRIGRAM));
+
+    if (!rgSlots)
+    {
+        return FALSE;
+    }
+
+    for (size_t i = 0; i < cOld; i++)
+    {
+        if (rgOld[i].key != 0)
+        {
+            size_t slot = HashTrigram(rgOld[i].key) & (cSlots - 1);
+
+            while (rgSlots[slot].key != 0)
+            {
+                slot = (slot + 1) & (cSlots - 1);
+            }
+
+            rgSlots[slot] = rgOld[i];
+        }
+    }
+
+    free(rgOld);
+
+    pIndex->rgSlots = rgSlots;
+    pIndex->cSlots  = cSlots;
+
+    return TRUE;
+}
+
+static SEARCHTRIGRAM *AddTrigram(SEARCHINDEX *pIndex, ULONGLONG key)
+{
+    if ((pIndex->cSlotsUsed + 1) * 2 > pIndex->cSlots && !GrowTrigrams(pIndex))
+    {
+        return NULL;
+    }
+
+    size_t mask = pIndex->cSlots - 1;
+    size_t slot = HashTrigram(key) & mask;
+
+    while (pIndex->rgSlots[slot].key != 0)
+    {
+        if (pIndex->rgSlots[slot].key == key)
+        {
+            return &pIndex->rgSlots[slot];
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    pIndex->rgSlots[slot].key = key;
+    pIndex->cSlotsUsed++;
+
+    return &pIndex->rgSlots[slot];
+}
+
+//
+//  Lists the document under each of its trigrams, and records how many
+//  postings that added so removing it can take exactly those off the live
+//  count.  A list that still ends with the document from before it was
+//  replaced isn't added to, so this can be less than the number of
+//  distinct trigrams.
+//
+static void AddPostings(SEARCHINDEX *pIndex, UINT iDoc, const WCHAR *pch, size_t cch)
+{
+    UINT cAdded = 0;
+
+    for (size_t i = 0; i + 3 <= cch; i++)
+    {
+        SEARCHTRIGRAM  *pTrigram = AddTrigram(pIndex, TrigramKey(pch + i));
+        SEARCHPOSTINGS *pList;
+
+        if (!pTrigram)
+        {
+            break;
+        }
+
+        pList = &pTrigram->postings;
+
+        // The list already ends with this document if the trigram came up
+        // earlier in the text.
+
+        if (pList->cDoc && pList->rgDoc[pList->cDoc - 1] == iDoc)
+        {
+            continue;
+        }
+
+        if (pList->cDoc == pList->cAlloc)
+        {
+            UINT  cAlloc = pList->cAlloc ? pList->cAlloc * 2 : 4;
+            UINT *rgDoc  = (UINT *)realloc(pList->rgDoc, cAlloc * sizeof(UINT));
+
+            if (!rgDoc)
+            {
+                break;
+            }
+
+            pList->rgDoc  = rgDoc;
+            pList->cAlloc = cAlloc;
+        }
+
+        pList->rgDoc[pList->cDoc++] = iDoc;
+        cAdded++;
+    }
+
+    pIndex->rgcPostings[iDoc] = cAdded;
+    pIndex->cPostings        += cAdded;
+    pIndex->cLivePostings    += cAdded;
+}
+
+//
+//  Drops the stale postings and the text of removed documents.
+//
+static void Compact(SEARCHINDEX *pIndex)
+{
+    if (pIndex->cPostings > pIndex->cLivePostings * 2 + 4096)
+    {
+        for (size_t i = 0; i < pIndex->cSlots; i++)
+        {
+            pIndex->rgSlots[i].postings.cDoc = 0;
+        }
+
+        pIndex->cPostings     = 0;
+        pIndex->cLivePostings = 0;
+
+        for (size_t iDoc = 0; iDoc < pIndex->cDocs; iDoc++)
+        {
+            if (pIndex->rgichDoc[iDoc] != SEARCH_NO_DOC)
+            {
+                const WCHAR *pch = pIndex->rgch + pIndex->rgichDoc[iDoc];
+
+                AddPostings(pIndex, (UINT)iDoc, pch, wcslen(pch));
+            }
+        }
+    }
+
+    if (pIndex->cchGarbage > pIndex->cch / 2 + 4096)
+    {
+        WCHAR *rgch = (WCHAR *)malloc(pIndex->cchAlloc * sizeof(WCHAR));
+        size_t cch  = 0;
+
+        if (!rgch)
+        {
+            return;
+        }
+
+        for (size_t iDoc = 0; iDoc < pIndex->cDocs; iDoc++)
+        {
+            if (pIndex->rgichDoc[iDoc] != SEARCH_NO_DOC)
+            {
+                const WCHAR *pch    = pIndex->rgch + pIndex->rgichDoc[iDoc];
+                size_t       cchDoc = wcslen(pch) + 1;
+
+                memcpy(rgch + cch, pch, cchDoc * sizeof(WCHAR));
+                pIndex->rgichDoc[iDoc] = (UINT)cch;
+                cch += cchDoc;
+            }
+        }
+
+        free(pIndex->rgch);
+
+        pIndex->rgch       = rgch;
+        pIndex->cch        = cch;
+        pIndex->cchGarbage = 0;
+    }
+}
+
+static BOOL GrowDocs(SEARCHINDEX *pIndex, UINT iDoc)
+{
+    if (iDoc >= pIndex->cDocs)
+    {
+        size_t cDocs = pIndex->cDocs ? pIndex->cDocs : 256;
+
+        while (cDocs <= iDoc)
+        {
+            cDocs *= 2;
+        }
+
+        UINT *rgichDoc = (UINT *)realloc(pIndex->rgichDoc, cDocs * sizeof(UINT));
+
+        if (!rgichDoc)
+        {
+            return FALSE;
+        }
+
+        pIndex->rgichDoc = rgichDoc;
+
+        UINT *rgStamp = (UINT *)realloc(pIndex->rgStamp, cDocs * sizeof(UINT));
+
+        if (!rgStamp)
+        {
+            return FALSE;
+        }
+
+        pIndex->rgStamp = rgStamp;
+
+        UINT *rgcPostings = (UINT *)realloc(pIndex->rgcPostings, cDocs * sizeof(UINT));
+
+        if (!rgcPostings)
+        {
+            return FALSE;
+        }
+
+        pIndex->rgcPostings = rgcPostings;
+
+        for (size_t i = pIndex->cDocs; i < cDocs; i++)
+        {
+            pIndex->rgichDoc[i]    = SEARCH_NO_DOC;
+            pIndex->rgStamp[i]     = 0;
+            pIndex->rgcPostings[i] = 0;
+        }
+
+        pIndex->cDocs = cDocs;
+    }
+
+    return TRUE;
+}
+
+void SearchIndex_Remove(SEARCHINDEX *pIndex, UINT iDoc)
+{
+    if (iDoc < pIndex->cDocs && pIndex->rgichDoc[iDoc] != SEARCH_NO_DOC)
+    {
+        pIndex->cchGarbage       += wcslen(pIndex->rgch + pIndex->rgichDoc[iDoc]) + 1;
+        pIndex->cLivePostings    -= pIndex->rgcPostings[iDoc];
+        pIndex->rgcPostings[iDoc] = 0;
+        pIndex->rgichDoc[iDoc]    = SEARCH_NO_DOC;
+    }
+}
+
+BOOL SearchIndex_Set(SEARCHINDEX *pIndex, UINT iDoc, PCWSTR pszText)
+{
+    size_t cch = wcslen(pszText);
+
+    if (!GrowDocs(pIndex, iDoc))
+    {
+        return FALSE;
+    }
+
+    SearchIndex_Remove(pIndex, iDoc);
+
+    // Append the case-folded text.
+
+    if (pIndex->cch + cch + 1 > pIndex->cchAlloc)
+    {
+        size_t cchAlloc = pIndex->cchAlloc ? pIndex->cchAlloc * 2 : 4096;
+
+        while (pIndex->cch + cch + 1 > cchAlloc)
+        {
+            cchAlloc *= 2;
+        }
+
+        if (cchAlloc > SEARCH_NO_DOC)
+        {
+            return FALSE;
+        }
+
+        WCHAR *rgch = (WCHAR *)realloc(pIndex->rgch, cchAlloc * sizeof(WCHAR));
+
+        if (!rgch)
+        {
+            return FALSE;
+        }
+
+        pIndex->rgch     = rgch;
+        pIndex->cchAlloc = cchAlloc;
+    }
+
+    WCHAR *pch = pIndex->rgch + pIndex->cch;
+
+    for (size_t i = 0; i < cch; i++)
+    {
+        pch[i] = towlower(pszText[i]);
+    }
+
+    pch[cch] = L'\0';
+
+    pIndex->rgichDoc[iDoc] = (UINT)pIndex->cch;
+    pIndex->cch           += cch + 1;
+
+    AddPostings(pIndex, iDoc, pch, cch);
+
+    Compact(pIndex);
+
+    return TRUE;
+}
+
+void SearchIndex_Reset(SEARCHINDEX *pIndex)
+{
+    for (size_t i = 0; i < pIndex->cDocs; i++)
+    {
+        pIndex->rgichDoc[i] = SEARCH_NO_DOC;
+    }
+
+    for (size_t i = 0; i < pIndex->cSlots; i++)
+    {
+        pIndex->rgSlots[i].postings.cDoc = 0;
+    }
+
+    pIndex->cch           = 0;
+    pIndex->cchGarbage    = 0;
+    pIndex->cPostings     = 0;
+    pIndex->cLivePostings = 0;
+}
+
+void SearchIndex_Free(SEARCHINDEX *pIndex)
+{
+    for (size_t i = 0; i < pIndex->cSlots; i++)
+    {
+        free(pIndex->rgSlots[i].postings.rgDoc);
+    }
+
+    free(pIndex->rgSlots);
+    free(pIndex->rgch);
+    free(pIndex->rgichDoc);
+    free(pIndex->rgStamp);
+    free(pIndex->rgcPostings);
+    free(pIndex->rgResults);
+
+    ZeroMemory(pIndex, sizeof(*pIndex));
+}
+
+static int __cdecl CompareDocs(const void *p1, const void *p2)
+{
+    UINT iDoc1 = *(const UINT *)p1;
+    UINT iDoc2 = *(const UINT *)p2;
+
+    return (iDoc1 < iDoc2) ? -1 : (iDoc1 > iDoc2);
+}
+
+static BOOL AddResult(SEARCHINDEX *pIndex, size_t *pcResults, UINT iDoc)
+{
+    if (*pcResults == pIndex->cResultsAlloc)
+    {
+        size_t cAlloc    = pIndex->cResultsAlloc ? pIndex->cResultsAlloc * 2 : 64;
+        UINT  *rgResults = (UINT *)realloc(pIndex->rgResults, cAlloc * sizeof(UINT));
+
+        if (!rgResults)
+        {
+            return FALSE;
+        }
+
+        pIndex->rgResults     = rgResults;
+        pIndex->cResultsAlloc = cAlloc;
+    }
+
+    pIndex->rgResults[(*pcResults)++] = iDoc;
+
+    return TRUE;
+}
+
+size_t SearchIndex_Query(SEARCHINDEX *pIndex, PCWSTR pszQuery, const UINT **prgDocs)
+{
+    WCHAR  szQuery[MAX_QUERY_LEN];
+    size_t cchQuery = 0;
+    size_t cResults = 0;
+
+    *prgDocs = pIndex->rgResults;
+
+    for (; pszQuery[cchQuery] && cchQuery < ARRAYSIZE(szQuery) - 1; cchQuery++)
+    {
+        szQuery[cchQuery] = towlower(pszQuery[cchQuery]);
+    }
+
+    szQuery[cchQuery] = L'\0';
+
+    if (cchQuery == 0 || pIndex->cDocs == 0)
+    {
+        return 0;
+    }
+
+    if (cchQuery < 3)
+    {
+        // Too short for the trigrams, so check everything.
+
+        for (size_t iDoc = 0; iDoc < pIndex->cDocs; iDoc++)
+        {
+            if (pIndex->rgichDoc[iDoc] != SEARCH_NO_DOC &&
+                wcsstr(pIndex->rgch + pIndex->rgichDoc[iDoc], szQuery) &&
+                !AddResult(pIndex, &cResults, (UINT)iDoc))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        SEARCHPOSTINGS *pShortest = NULL;
+
+        // Only the documents under the rarest trigram need checking.
+
+        for (size_t i = 0; i + 3 <= cchQuery; i++)
+        {
+            SEARCHTRIGRAM *pTrigram = FindTrigram(pIndex, TrigramKey(szQuery + i));
+
+            if (!pTrigram || pTrigram->postings.cDoc == 0)
+            {
+                return 0;
+            }
+
+            if (!pShortest || pTrigram->postings.cDoc < pShortest->cDoc)
+            {
+                pShortest = &pTrigram->postings;
+            }
+        }
+
+        if (++pIndex->uStamp == 0)
+        {
+            ZeroMemory(pIndex->rgStamp, pIndex->cDocs * sizeof(UINT));
+            pIndex->uStamp = 1;
+        }
+
+        for (UINT i = 0; i < pShortest->cDoc; i++)
+        {
+            UINT iDoc = pShortest->rgDoc[i];
+
+            // Skip stale and repeated postings.
+
+            if (pIndex->rgStamp[iDoc] == pIndex->uStamp || pIndex->rgichDoc[iDoc] == SEARCH_NO_DOC)
+            {
+                continue;
+            }
+
+            pIndex->rgStamp[iDoc] = pIndex->uStamp;
+
+            if (wcsstr(pIndex->rgch + pIndex->rgichDoc[iDoc], szQuery) &&
+                !AddResult(pIndex, &cResults, iDoc))
+            {
+                break;
+            }
+        }
+
+        qsort(pIndex->rgResults, cResults, sizeof(UINT), CompareDocs);
+    }
+
+    *prgDocs = pIndex->rgResults;
+
+    return cResults;
+}
@@ -0,0 +1,80 @@
+#ifndef SEARCHINDEX_INCLUDED
+#define SEARCHINDEX_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// SEARCHINDEX
+//
+// Case-insensitive substring index over a set of documents, each of which
+// is a short string identified by a small integer (the window tree uses
+// node indices).  Every three-character sequence of a document is listed
+// under that trigram, so a query only has to check the documents listed
+// under its rarest trigram.  Queries shorter than three characters check
+// every document.
+//
+// Documents can be replaced or removed at any time.  Stale postings are
+// skipped by the queries, and cleaned out once they make up half of the
+// index.
+//
+
+typedef struct
+{
+    UINT   *rgDoc;
+    UINT    cDoc;
+    UINT    cAlloc;
+}
+SEARCHPOSTINGS;
+
+typedef struct
+{
+    ULONGLONG       key;            // 0 for an empty slot
+    SEARCHPOSTINGS  postings;
+}
+SEARCHTRIGRAM;
+
+typedef struct
+{
+    WCHAR          *rgch;           // Case-folded document text
+    size_t          cch;
+    size_t          cchAlloc;
+    size_t          cchGarbage;     // Text of replaced/removed documents
+
+    UINT           *rgichDoc;       // [cDocs] Text offset, or SEARCH_NO_DOC
+    UINT           *rgStamp;        // [cDocs] Used to skip duplicates in a query
+    UINT           *rgcPostings;    // [cDocs] Postings listing each document
+    size_t          cDocs;
+    UINT            uStamp;
+
+    SEARCHTRIGRAM  *rgSlots;
+    size_t          cSlots;
+    size_t          cSlotsUsed;
+    size_t          cPostings;
+    size_t          cLivePostings;
+
+    UINT           *rgResults;
+    size_t          cResultsAlloc;
+}
+SEARCHINDEX;
+
+#define SEARCH_NO_DOC   ((UINT)-1)
+
+BOOL   SearchIndex_Set(SEARCHINDEX *pIndex, UINT iDoc, PCWSTR pszText);
+void   SearchIndex_Remove(SEARCHINDEX *pIndex, UINT iDoc);
+void   SearchIndex_Reset(SEARCHINDEX *pIndex);
+void   SearchIndex_Free(SEARCHINDEX *pIndex);
+
+//
+// Finds the documents containing pszQuery.  Returns the number of matches,
+// and the matching document ids in ascending order in *prgDocs, which stays
+// valid until the next call.
+//
+size_t SearchIndex_Query(SEARCHINDEX *pIndex, PCWSTR pszQuery, const UINT **prgDocs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+//
+//  StringPool.c
+//
+//  Arena for the strings shown in the window tree, so that nodes only need
+//  to hold an offset rather than their own copy of each string.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+
+#include "StringPool.h"
+
+static size_t HashString(PCWSTR psz)
+{
+    size_t hash = 2166136261u;
+
+    for (; *psz; psz++)
+    {
+        hash = (hash ^ *psz) * 16777619u;
+    }
+
+    return hash;
+}
+
+//
+//  Makes room for cchMore more characters.
+//
+static BOOL GrowPool(STRINGPOOL *pPool, size_t cchMore)
+{
+    if (!pPool->rgch)
+    {
+        pPool->rgch = (WCHAR *)malloc(1024 * sizeof(WCHAR));
+
+        if (!pPool->rgch)
+        {
+            return FALSE;
+        }
+
+        pPool->rgch[0]  = L'\0';
+        pPool->cch      = 1;
+        pPool->cchAlloc = 1024;
+    }
+
+    if (pPool->cch + cchMore > pPool->cchAlloc)
+    {
+        size_t cchAlloc = pPool->cchAlloc * 2;
+
+        while (pPool->cch + cchMore > cchAlloc)
+        {
+            cchAlloc *= 2;
+        }
+
+        if (cchAlloc > MAXUINT)
+        {
+            return FALSE;
+        }
+
+        WCHAR *rgch = (WCHAR *)realloc(pPool->rgch, cchAlloc * sizeof(WCHAR));
+
+        if (!rgch)
+        {
+            return FALSE;
+        }
+
+        pPool->rgch     = rgch;
+        pPool->cchAlloc = cchAlloc;
+    }
+
+    return TRUE;
+}
+
+UINT StringPool_Add(STRINGPOOL *pPool, PCWSTR psz)
+{
+    size_t cch = wcslen(psz) + 1;
+
+    if (cch == 1 || !GrowPool(pPool, cch))
+    {
+        return 0;
+    }
+
+    UINT ich = (UINT)pPool->cch;
+
+    memcpy(pPool->rgch + ich, psz, cch * sizeof(WCHAR));
+    pPool->cch += cch;
+
+    return ich;
+}
+
+static void InternHash_Insert(STRINGPOOL *pPool, UINT ich)
+{
+    size_t mask = pPool->cSlots - 1;
+    size_t slot = HashString(pPool->rgch + ich) & mask;
+
+    while (pPool->rgSlots[slot] != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    pPool->rgSlots[slot] = ich + 1;
+}
+
+static BOOL InternHash_Grow(STRINGPOOL *pPool)
+{
+    size_t cSlots   = pPool->cSlots ? pPool->cSlots * 2 : 64;
+    UINT  *rgOld    = pPool->rgSlots;
+    size_t cOld     = pPool->cSlots;
+    UINT  *rgSlots  = (UINT *)calloc(cSlots, sizeof(UINT));
+
+    if (!rgSlots)
+    {
+        return FALSE;
+    }
+
+    pPool->rgSlots = rgSlots;
+    pPool->cSlots  = cSlots;
+
+    for (size_t i = 0; i < cOld; i++)
+    {
+        if (rgOld[i] != 0)
+        {
+            InternHash_Insert(pPool, rgOld[i] - 1);
+        }
+    }
+
+    free(rgOld);
+
+    return TRUE;
+}
+
+UINT StringPool_Intern(STRINGPOOL *pPool, PCWSTR psz)
+{
+    if (psz[0] == L'\0')
+    {
+        return 0;
+    }
+
+    // Keep the load factor under a half.
+
+    if ((pPool->cInterned + 1) * 2 > pPool->cSlots && !InternHash_Grow(pPool))
+    {
+        return 0;
+    }
+
+    size_t mask = pPool->cSlots - 1;
+    size_t slot = HashString(psz) & mask;
+
+    while (pPool->rgSlots[slot] != 0)
+    {
+        UINT ich = pPool->rgSlots[slot] - 1;
+
+        if (wcscmp(pPool->rgch + ich, psz) == 0)
+        {
+            return ich;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    UINT ich = StringPool_Add(pPool, psz);
+
+    if (ich != 0)
+    {
+        pPool->rgSlots[slot] = ich + 1;
+        pPool->cInterned++;
+    }
+
+    return ich;
+}
+
+//
+//  Empties the pool, but keeps the memory for reuse.
+//
+void StringPool_Reset(STRINGPOOL *pPool)
+{
+    if (pPool->rgch)
+    {
+        pPool->cch = 1;
+    }
+
+    if (pPool->rgSlots)
+    {
+        ZeroMemory(pPool->rgSlots, pPool->cSlots * sizeof(UINT));
+    }
+
+    pPool->cInterned = 0;
+}
+
+void StringPool_Free(STRINGPOOL *pPool)
+{
+    free(pPool->rgch);
+    free(pPool->rgSlots);
+
+    ZeroMemory(pPool, sizeof(*pPool));
+}
@@ -0,0 +1,43 @@
+#ifndef STRINGPOOL_INCLUDED
+#define STRINGPOOL_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// STRINGPOOL
+//
+// A growable buffer of null-terminated strings, referred to by their
+// character offset.  Offsets stay valid as the pool grows, pointers do
+// not.  Offset 0 is always the empty string, which is also what the add
+// functions return if they run out of memory.
+//
+// StringPool_Add always appends.  StringPool_Intern returns the existing
+// offset if the string has been interned before, so interned strings can
+// be compared by offset.
+//
+
+typedef struct
+{
+    WCHAR  *rgch;
+    size_t  cch;                // In use, including the leading empty string
+    size_t  cchAlloc;
+    UINT   *rgSlots;            // Intern hash, offset + 1 or 0 for an empty slot
+    size_t  cSlots;
+    size_t  cInterned;
+}
+STRINGPOOL;
+
+UINT   StringPool_Add(STRINGPOOL *pPool, PCWSTR psz);
+UINT   StringPool_Intern(STRINGPOOL *pPool, PCWSTR psz);
+void   StringPool_Reset(STRINGPOOL *pPool);
+void   StringPool_Free(STRINGPOOL *pPool);
+
+#define StringPool_Get(pPool, ich)  ((pPool)->rgch ? (PCWSTR)(pPool)->rgch + (ich) : L"")
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,240 @@
+//
+//  StyleDecoder.c
+//
+//  Decodes style values against the StyleLookupEx tables without walking
+//  every entry.  See StyleDecoder.h.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+
+#include "StyleDecoder.h"
+
+static STYLEDECODER **g_rgDecoders;
+static size_t         g_cDecoders;
+
+static BOOL IsSingleBitStyle(const StyleLookupEx *pStyle)
+{
+    return pStyle->extraMask == 0 &&
+           pStyle->dependencyValue == 0 &&
+           pStyle->dependencyExtraMask == 0 &&
+           pStyle->value != 0 &&
+           (pStyle->value & (pStyle->value - 1)) == 0;
+}
+
+static BOOL IsDependencyPresent(const StyleLookupEx *pStyle, DWORD dwStyles)
+{
+    return ((pStyle->dependencyValue | pStyle->dependencyExtraMask) & dwStyles) == pStyle->dependencyValue;
+}
+
+static STYLEDECODER *BuildDecoder(const StyleLookupEx *pTable)
+{
+    STYLEDECODER *pDecoder;
+    UINT          cStyles = 0;
+    UINT          cKeys = 0;
+    UINT          i, j;
+    DWORD         iBit;
+
+    while (pTable[cStyles].name)
+    {
+        cStyles++;
+    }
+
+    if (cStyles > MAX_DECODED_STYLES)
+    {
+        return NULL;
+    }
+
+    pDecoder = (STYLEDECODER *)calloc(1, sizeof(STYLEDECODER));
+
+    if (!pDecoder)
+    {
+        return NULL;
+    }
+
+    pDecoder->pTable   = pTable;
+    pDecoder->cStyles  = cStyles;
+    pDecoder->rgKeys   = (STYLEKEY *)malloc(max(cStyles, 1) * sizeof(STYLEKEY));
+    pDecoder->rgGroups = (STYLEGROUP *)malloc(max(cStyles, 1) * sizeof(STYLEGROUP));
+
+    if (!pDecoder->rgKeys || !pDecoder->rgGroups)
+    {
+        free(pDecoder->rgKeys);
+        free(pDecoder->rgGroups);
+        free(pDecoder);
+        return NULL;
+    }
+
+    // The single-bit entries come first, by bit.
+
+    for (iBit = 0; iBit < 32; iBit++)
+    {
+        pDecoder->rgiBitFirst[iBit] = (BYTE)cKeys;
+
+        for (i = 0; i < cStyles; i++)
+        {
+            if (IsSingleBitStyle(&pTable[i]) && pTable[i].value == (1u << iBit))
+            {
+                pDecoder->rgKeys[cKeys].dwValue = pTable[i].value;
+                pDecoder->rgKeys[cKeys].iStyle  = i;
+                pDecoder->dwBitMask |= pTable[i].value;
+                cKeys++;
+            }
+        }
+    }
+
+    pDecoder->rgiBitFirst[32] = (BYTE)cKeys;
+
+    // Then a group for each of the other masks, in order of appearance.
+
+    for (i = 0; i < cStyles; i++)
+    {
+        DWORD       dwMask = pTable[i].value | pTable[i].extraMask;
+        STYLEGROUP *pGroup = NULL;
+
+        if (IsSingleBitStyle(&pTable[i]))
+        {
+            continue;
+        }
+
+        for (j = 0; j < pDecoder->cGroups; j++)
+        {
+            if (pDecoder->rgGroups[j].dwMask == dwMask)
+            {
+                pGroup = &pDecoder->rgGroups[j];
+                break;
+            }
+        }
+
+        if (pGroup)
+        {
+            continue;
+        }
+
+        pGroup = &pDecoder->rgGroups[pDecoder->cGroups++];
+
+        pGroup->dwMask = dwMask;
+        pGroup->iFirst = cKeys;
+
+        for (j = i; j < cStyles; j++)
+        {
+            if (!IsSingleBitStyle(&pTable[j]) && (pTable[j].value | pTable[j].extraMask) == dwMask)
+            {
+                STYLEKEY key = { pTable[j].value, j };
+                UINT     k   = cKeys++;
+
+                // Insertion sort by value, keeping table order for equal
+                // values.
+
+                while (k > pGroup->iFirst && pDecoder->rgKeys[k - 1].dwValue > key.dwValue)
+                {
+                    pDecoder->rgKeys[k] = pDecoder->rgKeys[k - 1];
+                    k--;
+                }
+
+                pDecoder->rgKeys[k] = key;
+            }
+        }
+
+        pGroup->cKeys = cKeys - pGroup->iFirst;
+    }
+
+    return pDecoder;
+}
+
+const STYLEDECODER *StyleDecoder_Get(const StyleLookupEx *pTable)
+{
+    STYLEDECODER  *pDecoder;
+    STYLEDECODER **rgDecoders;
+    size_t         i;
+
+    for (i = 0; i < g_cDecoders; i++)
+    {
+        if (g_rgDecoders[i]->pTable == pTable)
+        {
+            return g_rgDecoders[i];
+        }
+    }
+
+    pDecoder = BuildDecoder(pTable);
+
+    if (!pDecoder)
+    {
+        return NULL;
+    }
+
+    rgDecoders = (STYLEDECODER **)realloc(g_rgDecoders, (g_cDecoders + 1) * sizeof(STYLEDECODER *));
+
+    if (!rgDecoders)
+    {
+        free(pDecoder->rgKeys);
+        free(pDecoder->rgGroups);
+        free(pDecoder);
+        return NULL;
+    }
+
+    g_rgDecoders = rgDecoders;
+    g_rgDecoders[g_cDecoders++] = pDecoder;
+
+    return pDecoder;
+}
+
+ULONGLONG StyleDecoder_Decode(const STYLEDECODER *pDecoder, DWORD dwStyles, DWORD *pdwLeft)
+{
+    const StyleLookupEx *pTable    = pDecoder->pTable;
+    ULONGLONG            fMatches  = 0;
+    DWORD                dwMatched = 0;
+    DWORD                dwBits    = dwStyles & pDecoder->dwBitMask;
+    DWORD                iBit;
+    UINT                 i, k;
+
+    // Single-bit entries for each bit that is set.
+
+    while (BitScanForward(&iBit, dwBits))
+    {
+        for (k = pDecoder->rgiBitFirst[iBit]; k < pDecoder->rgiBitFirst[iBit + 1]; k++)
+        {
+            fMatches |= 1ull << pDecoder->rgKeys[k].iStyle;
+        }
+
+        dwMatched |= 1u << iBit;
+        dwBits    &= dwBits - 1;
+    }
+
+    // One search per mask group.
+
+    for (i = 0; i < pDecoder->cGroups; i++)
+    {
+        const STYLEGROUP *pGroup = &pDecoder->rgGroups[i];
+        const STYLEKEY   *rgKeys = pDecoder->rgKeys + pGroup->iFirst;
+        DWORD             dwKey  = dwStyles & pGroup->dwMask;
+        UINT              lo     = 0;
+        UINT              hi     = pGroup->cKeys;
+
+        while (lo < hi)
+        {
+            UINT mid = (lo + hi) / 2;
+
+            if (rgKeys[mid].dwValue < dwKey)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        for (k = lo; k < pGroup->cKeys && rgKeys[k].dwValue == dwKey; k++)
+        {
+            const StyleLookupEx *pStyle = &pTable[rgKeys[k].iStyle];
+
+            if (IsDependencyPresent(pStyle, dwStyles))
+            {
+                fMatches  |= 1ull << rgKeys[k].iStyle;
+                dwMatched |= pStyle->value;
+            }
+        }
+    }
+
+    *pdwLeft = dwStyles & ~dwMatched;
+
+    return fMatches;
+}
@@ -0,0 +1,74 @@
+#ifndef STYLEDECODER_INCLUDED
+#define STYLEDECODER_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// STYLEDECODER
+//
+// A StyleLookupEx table rearranged so that the styles present in a value
+// can be found without testing every entry.  Entries that are a single bit
+// with no extra mask or dependency are listed by bit, so only the bits set
+// in the value need looking at.  The remaining entries are grouped by mask,
+// and sorted by value within each group, so each group is one search.
+//
+// Decoders are built the first time a table is used, and kept.  Tables of
+// more than MAX_DECODED_STYLES entries aren't supported.
+//
+
+#define MAX_DECODED_STYLES 64
+
+//
+// Tests a single entry.  StyleDecoder_Decode gives the same answer as this
+// for every entry of a table at once.
+//
+static __inline BOOL StyleApplicableAndPresent(DWORD value, const StyleLookupEx *pStyle)
+{
+    if (((pStyle->dependencyValue | pStyle->dependencyExtraMask) & value) != pStyle->dependencyValue)
+        return FALSE;
+    return ((pStyle->value | pStyle->extraMask) & value) == pStyle->value;
+}
+
+typedef struct
+{
+    DWORD dwValue;
+    UINT  iStyle;
+} STYLEKEY;
+
+typedef struct
+{
+    DWORD dwMask;
+    UINT  iFirst;                   // Into rgKeys
+    UINT  cKeys;
+} STYLEGROUP;
+
+typedef struct
+{
+    const StyleLookupEx *pTable;
+    UINT                 cStyles;
+
+    DWORD                dwBitMask;     // Bits that have single-bit entries
+    BYTE                 rgiBitFirst[33];  // Into rgKeys, by bit
+
+    STYLEGROUP          *rgGroups;
+    UINT                 cGroups;
+    STYLEKEY            *rgKeys;
+}
+STYLEDECODER;
+
+const STYLEDECODER *StyleDecoder_Get(const StyleLookupEx *pTable);
+
+//
+// Returns the entries that are applicable and present in dwStyles, as a
+// bit per table entry.  *pdwLeft receives the bits of dwStyles that none of
+// them account for.
+//
+ULONGLONG StyleDecoder_Decode(const STYLEDECODER *pDecoder, DWORD dwStyles, DWORD *pdwLeft);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
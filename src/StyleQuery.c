@@ -0,0 +1,186 @@
+//
+//  StyleQuery.c
+//
+//  Evaluates style predicates over a snapshot of windows.  There's no UI
+//  or window access in here; the caller packs the style words into arrays,
+//  so the same code runs on real snapshots and on made-up data.
+//
+
+#include "WinSpy.h"
+
+#include "StyleQuery.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+//
+//  Term that applies to every class: only the style word matters.
+//
+
+static void EvaluateGenericTerm(const STYLEQUERYTERM *pTerm, const DWORD *rgWords, size_t cWindows, BYTE *rgfMatch)
+{
+    BYTE   bNegate = pTerm->fNegate ? 1 : 0;
+    size_t i = 0;
+
+#ifdef USE_SSE2
+
+    __m128i mask     = _mm_set1_epi32((int)pTerm->dwMask);
+    __m128i value    = _mm_set1_epi32((int)pTerm->dwValue);
+    __m128i depMask  = _mm_set1_epi32((int)pTerm->dwDepMask);
+    __m128i depValue = _mm_set1_epi32((int)pTerm->dwDepValue);
+    __m128i negate   = _mm_set1_epi8((char)(bNegate ? 0xFF : 0));
+    __m128i one      = _mm_set1_epi8(1);
+
+    for (; i + 16 <= cWindows; i += 16)
+    {
+        __m128i present[4];
+
+        for (int j = 0; j < 4; j++)
+        {
+            __m128i words = _mm_loadu_si128((const __m128i *)(rgWords + i + j * 4));
+            __m128i fDep  = _mm_cmpeq_epi32(_mm_and_si128(words, depMask), depValue);
+            __m128i fVal  = _mm_cmpeq_epi32(_mm_and_si128(words, mask), value);
+
+            present[j] = _mm_and_si128(fDep, fVal);
+        }
+
+        // Narrow the 32-bit all-ones/all-zeros lanes down to bytes.  The
+        // saturating packs keep -1 and 0 as they are.
+
+        __m128i lo   = _mm_packs_epi32(present[0], present[1]);
+        __m128i hi   = _mm_packs_epi32(present[2], present[3]);
+        __m128i hits = _mm_xor_si128(_mm_packs_epi16(lo, hi), negate);
+        __m128i old  = _mm_loadu_si128((const __m128i *)(rgfMatch + i));
+
+        _mm_storeu_si128((__m128i *)(rgfMatch + i), _mm_and_si128(old, _mm_and_si128(hits, one)));
+    }
+
+#endif
+
+    for (; i < cWindows; i++)
+    {
+        DWORD dw       = rgWords[i];
+        BYTE  fPresent = (BYTE)(((dw & pTerm->dwDepMask) == pTerm->dwDepValue) && ((dw & pTerm->dwMask) == pTerm->dwValue));
+
+        rgfMatch[i] &= (BYTE)(fPresent ^ bNegate);
+    }
+}
+
+//
+//  Term that only applies to some classes.  Windows of other classes never
+//  match it, whether it's negated or not.
+//
+
+static BYTE TermMatches(const STYLEQUERYTERM *pTerm, DWORD dw, BYTE bClass)
+{
+    BYTE fApplies = (BYTE)((pTerm->fClasses >> (bClass & 63)) & 1);
+    BYTE fPresent = (BYTE)(((dw & pTerm->dwDepMask) == pTerm->dwDepValue) && ((dw & pTerm->dwMask) == pTerm->dwValue));
+
+    return (BYTE)(fApplies & (fPresent ^ (pTerm->fNegate ? 1 : 0)));
+}
+
+static void EvaluateClassTerm(const STYLEQUERYTERM *pTerm, const DWORD *rgWords, const BYTE *rgClass, size_t cWindows, BYTE *rgfMatch)
+{
+    for (size_t i = 0; i < cWindows; i++)
+    {
+        rgfMatch[i] &= TermMatches(pTerm, rgWords[i], rgClass[i]);
+    }
+}
+
+//
+//  A run of alternative terms for one style name.  These are rare, so
+//  they take the plain loop, which at least skips the windows earlier
+//  terms have already ruled out.  A term on a word that isn't supplied is
+//  ignored like any other term, which here means the run matches.
+//
+
+static void EvaluateAlternatives(const STYLEQUERYTERM *rgTerms, UINT cTerms, const STYLEQUERYDATA *pData, size_t cWindows, BYTE *rgfMatch)
+{
+    for (size_t i = 0; i < cWindows; i++)
+    {
+        BYTE fMatch = 0;
+
+        if (!rgfMatch[i])
+            continue;
+
+        for (UINT t = 0; t < cTerms && !fMatch; t++)
+        {
+            const DWORD *rgWords = pData->rgWords[rgTerms[t].iWord];
+
+            fMatch = rgWords ? TermMatches(&rgTerms[t], rgWords[i], pData->rgClass[i]) : 1;
+        }
+
+        rgfMatch[i] &= fMatch;
+    }
+}
+
+static size_t CountMatches(const BYTE *rgfMatch, size_t cWindows)
+{
+    size_t cMatches = 0;
+    size_t i = 0;
+
+#ifdef USE_SSE2
+
+    __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= cWindows; i += 16)
+    {
+        __m128i sums = _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(rgfMatch + i)), zero);
+
+        cMatches += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+
+#endif
+
+    for (; i < cWindows; i++)
+    {
+        cMatches += rgfMatch[i];
+    }
+
+    return cMatches;
+}
+
+size_t StyleQuery_Evaluate(const STYLEQUERY *pQuery, const STYLEQUERYDATA *pData, size_t cWindows, BYTE *rgfMatch)
+{
+    memset(rgfMatch, 1, cWindows);
+
+    for (UINT t = 0; t < pQuery->cTerms; t++)
+    {
+        const STYLEQUERYTERM *pTerm   = &pQuery->rgTerms[t];
+        const DWORD          *rgWords = pData->rgWords[pTerm->iWord];
+        UINT                  cAlternatives = 1;
+
+        while (t + cAlternatives < pQuery->cTerms && pQuery->rgTerms[t + cAlternatives].fAlternative)
+            cAlternatives++;
+
+        if (cAlternatives > 1)
+        {
+            EvaluateAlternatives(pTerm, cAlternatives, pData, cWindows, rgfMatch);
+            t += cAlternatives - 1;
+            continue;
+        }
+
+        if (!rgWords)
+            continue;
+
+        if (pTerm->fClasses == STYLEQUERY_ALLCLASSES)
+            EvaluateGenericTerm(pTerm, rgWords, cWindows, rgfMatch);
+        else
+            EvaluateClassTerm(pTerm, rgWords, pData->rgClass, cWindows, rgfMatch);
+    }
+
+    return CountMatches(rgfMatch, cWindows);
+}
+
+BOOL StyleQuery_UsesWord(const STYLEQUERY *pQuery, UINT iWord)
+{
+    for (UINT t = 0; t < pQuery->cTerms; t++)
+    {
+        if (pQuery->rgTerms[t].iWord == iWord)
+            return TRUE;
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,84 @@
+#ifndef STYLEQUERY_INCLUDED
+#define STYLEQUERY_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// STYLEQUERY
+//
+// A list of style predicates that must all hold, evaluated over packed
+// arrays of style words for a whole snapshot of windows at once.  Each
+// term tests one style the way StyleApplicableAndPresent does: the style
+// only counts as present if its dependency is present too.  A negated
+// term matches windows the style applies to but which don't have it.
+//
+// Windows carry a small class id (0..63) and each term has the set of
+// class ids it applies to, so class styles (e.g. LVS_EX_DOUBLEBUFFER)
+// only ever match windows of the right classes.  What the ids mean is up
+// to the caller.
+//
+// Terms are evaluated one at a time over the whole snapshot, which keeps
+// the inner loops simple enough to vectorize.  A style name can mean
+// different bits for different classes; each meaning gets its own term,
+// marked fAlternative after the first, and the window only has to match
+// one term of such a run.
+//
+
+#define STYLEQUERY_STYLE        0   // GWL_STYLE
+#define STYLEQUERY_EXSTYLE      1   // GWL_EXSTYLE
+#define STYLEQUERY_EXTRA        2   // Class private styles
+#define STYLEQUERY_WORDS        3
+
+#define STYLEQUERY_ALLCLASSES   (~0ull)
+#define MAX_STYLEQUERY_TERMS    16
+
+typedef struct
+{
+    DWORD       dwMask;             // value | extraMask
+    DWORD       dwValue;
+    DWORD       dwDepMask;          // dependencyValue | dependencyExtraMask
+    DWORD       dwDepValue;
+    UINT        iWord;              // STYLEQUERY_xxx
+    BOOL        fNegate;
+    BOOL        fAlternative;       // Or'ed with the terms before it, not and'ed
+    ULONGLONG   fClasses;           // Bit n set if the term applies to class id n
+}
+STYLEQUERYTERM;
+
+typedef struct
+{
+    STYLEQUERYTERM  rgTerms[MAX_STYLEQUERY_TERMS];
+    UINT            cTerms;
+}
+STYLEQUERY;
+
+typedef struct
+{
+    const DWORD    *rgWords[STYLEQUERY_WORDS];  // NULL to skip the terms on that word
+    const BYTE     *rgClass;
+}
+STYLEQUERYDATA;
+
+//
+// Sets rgfMatch[i] to 1 if window i matches all the terms of the query
+// (ignoring terms on words that aren't supplied), 0 otherwise.  Returns
+// the number of matches.
+//
+size_t StyleQuery_Evaluate(const STYLEQUERY *pQuery, const STYLEQUERYDATA *pData, size_t cWindows, BYTE *rgfMatch);
+
+// Returns TRUE if any term of the query looks at the given word.
+BOOL   StyleQuery_UsesWord(const STYLEQUERY *pQuery, UINT iWord);
+
+//
+// The query language lives next to the style tables in DisplayStyleInfo.c.
+// Its class ids are KNOWNCLASS values.
+//
+BOOL   ParseStyleQuery(PCWSTR pszQuery, STYLEQUERY *pQuery, PWSTR pszError, size_t cchError);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,293 @@
+//
+//  StyleQueryDlg.c
+//
+//  The "Find Styles" dialog.  Captures every window on the desktop, runs
+//  a style query over the lot and lists the matches.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+
+#include "resource.h"
+#include "KnownClass.h"
+#include "StyleQuery.h"
+#include "Utils.h"
+#include "WindowSnapshot.h"
+
+static HWND g_hwndStyleQueryDlg;
+
+typedef struct
+{
+    HWND   *rgHwnd;
+    size_t  cHwnd;
+    size_t  cAlloc;
+}
+HWNDLIST;
+
+static BOOL CALLBACK CollectWindowProc(HWND hwnd, LPARAM lParam)
+{
+    HWNDLIST *pList = (HWNDLIST *)lParam;
+
+    if (pList->cHwnd == pList->cAlloc)
+    {
+        size_t cAlloc = pList->cAlloc ? pList->cAlloc * 2 : 1024;
+        HWND  *rgHwnd = (HWND *)realloc(pList->rgHwnd, cAlloc * sizeof(HWND));
+
+        if (!rgHwnd)
+            return FALSE;
+
+        pList->rgHwnd = rgHwnd;
+        pList->cAlloc = cAlloc;
+    }
+
+    pList->rgHwnd[pList->cHwnd++] = hwnd;
+    return TRUE;
+}
+
+//
+//  All top-level windows followed by all their descendants.
+//
+static void CollectAllWindows(HWNDLIST *pList)
+{
+    EnumWindows(CollectWindowProc, (LPARAM)pList);
+
+    size_t cTopLevel = pList->cHwnd;
+
+    for (size_t i = 0; i < cTopLevel; i++)
+    {
+        EnumChildWindows(pList->rgHwnd[i], CollectWindowProc, (LPARAM)pList);
+    }
+}
+
+static void AddResultItem(HWND hwndList, int iItem, const WINDOWMETA *pMeta)
+{
+    LVITEM lvitem;
+    WCHAR  ach[12];
+
+    swprintf_s(ach, ARRAYSIZE(ach), L"%08X", (UINT)(UINT_PTR)pMeta->hwnd);
+
+    lvitem.mask     = LVIF_TEXT | LVIF_PARAM;
+    lvitem.iItem    = iItem;
+    lvitem.iSubItem = 0;
+    lvitem.pszText  = ach;
+    lvitem.lParam   = (LPARAM)pMeta->hwnd;
+
+    iItem = ListView_InsertItem(hwndList, &lvitem);
+
+    ListView_SetItemText(hwndList, iItem, 1, (PWSTR)pMeta->szClass);
+    ListView_SetItemText(hwndList, iItem, 2, (PWSTR)pMeta->szCaption);
+}
+
+static void RunStyleQuery(HWND hwnd)
+{
+    HWND       hwndList = GetDlgItem(hwnd, IDC_STYLEQUERY_RESULTS);
+    WCHAR      szQuery[512];
+    WCHAR      szStatus[128];
+    STYLEQUERY query;
+
+    GetDlgItemText(hwnd, IDC_STYLEQUERY_TEXT, szQuery, ARRAYSIZE(szQuery));
+
+    if (!ParseStyleQuery(szQuery, &query, szStatus, ARRAYSIZE(szStatus)))
+    {
+        SetDlgItemText(hwnd, IDC_STYLEQUERY_STATUS, szStatus);
+        return;
+    }
+
+    HCURSOR hOldCursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+
+    HWNDLIST list = { 0 };
+
+    CollectAllWindows(&list);
+
+    size_t      cWindows  = list.cHwnd;
+    WINDOWMETA *rgMeta    = (WINDOWMETA *)calloc(cWindows, sizeof(WINDOWMETA));
+    DWORD      *rgStyle   = (DWORD *)malloc(cWindows * sizeof(DWORD));
+    DWORD      *rgExStyle = (DWORD *)malloc(cWindows * sizeof(DWORD));
+    DWORD      *rgExtra   = (DWORD *)calloc(cWindows, sizeof(DWORD));
+    BYTE       *rgClass   = (BYTE *)malloc(cWindows);
+    BYTE       *rgfMatch  = (BYTE *)malloc(cWindows);
+    size_t      cMatches  = 0;
+
+    if (cWindows && rgMeta && rgStyle && rgExStyle && rgExtra && rgClass && rgfMatch)
+    {
+        for (size_t i = 0; i < cWindows; i++)
+        {
+            rgMeta[i].hwnd = list.rgHwnd[i];
+        }
+
+        WindowSnapshot_Query(rgMeta, cWindows, &g_LiveWindowMeta, 0);
+
+        for (size_t i = 0; i < cWindows; i++)
+        {
+            rgStyle[i]   = rgMeta[i].dwStyle;
+            rgExStyle[i] = rgMeta[i].dwExStyle;
+            rgClass[i]   = (BYTE)GetKnownClassFromAtom(rgMeta[i].wAtom, rgMeta[i].hModule, rgMeta[i].szClass);
+        }
+
+        STYLEQUERYDATA data = { { rgStyle, rgExStyle, NULL }, rgClass };
+
+        cMatches = StyleQuery_Evaluate(&query, &data, cWindows, rgfMatch);
+
+        // The class private styles have to be asked for one window at a
+        // time, so only ask the windows that passed everything else.  A
+        // window that doesn't answer can't match any class style term.
+
+        if (cMatches && StyleQuery_UsesWord(&query, STYLEQUERY_EXTRA))
+        {
+            for (size_t i = 0; i < cWindows; i++)
+            {
+                ClassStyleInfo *pClassInfo = GetKnownClassStyleInfo(rgClass[i]);
+
+                if (!rgfMatch[i] || !pClassInfo || !pClassInfo->StylesExtra)
+                    continue;
+
+                if (GetWindowExtraStyles(rgMeta[i].hwnd, pClassInfo, &rgExtra[i]) != ERROR_SUCCESS)
+                    rgClass[i] = KNOWNCLASS_UNKNOWN;
+            }
+
+            data.rgWords[STYLEQUERY_EXTRA] = rgExtra;
+
+            cMatches = StyleQuery_Evaluate(&query, &data, cWindows, rgfMatch);
+        }
+
+        SendMessage(hwndList, WM_SETREDRAW, FALSE, 0);
+        ListView_DeleteAllItems(hwndList);
+
+        int iItem = 0;
+
+        for (size_t i = 0; i < cWindows; i++)
+        {
+            if (rgfMatch[i])
+                AddResultItem(hwndList, iItem++, &rgMeta[i]);
+        }
+
+        SendMessage(hwndList, WM_SETREDRAW, TRUE, 0);
+
+        swprintf_s(szStatus, ARRAYSIZE(szStatus), L"%zu of %zu windows match", cMatches, cWindows);
+    }
+    else
+    {
+        ListView_DeleteAllItems(hwndList);
+        wcscpy_s(szStatus, ARRAYSIZE(szStatus), cWindows ? L"Out of memory" : L"No windows");
+    }
+
+    SetDlgItemText(hwnd, IDC_STYLEQUERY_STATUS, szStatus);
+
+    free(rgfMatch);
+    free(rgClass);
+    free(rgExtra);
+    free(rgExStyle);
+    free(rgStyle);
+    free(rgMeta);
+    free(list.rgHwnd);
+
+    SetCursor(hOldCursor);
+}
+
+static void InitResultsList(HWND hwnd)
+{
+    HWND     hwndList = GetDlgItem(hwnd, IDC_STYLEQUERY_RESULTS);
+    LVCOLUMN lvcol;
+    RECT     rect;
+    int      width;
+
+    ListView_SetExtendedListViewStyle(hwndList, LVS_EX_FULLROWSELECT);
+
+    GetClientRect(hwndList, &rect);
+    width = rect.right - GetSystemMetrics(SM_CXVSCROLL);
+
+    lvcol.mask = LVCF_WIDTH | LVCF_TEXT | LVCF_SUBITEM;
+    lvcol.cx = DPIScale(hwnd, 64);
+    lvcol.iSubItem = 0;
+    lvcol.pszText = L"Handle";
+    ListView_InsertColumn(hwndList, 0, &lvcol);
+    width -= lvcol.cx;
+
+    lvcol.pszText = L"Class Name";
+    lvcol.cx = DPIScale(hwnd, 120);
+    ListView_InsertColumn(hwndList, 1, &lvcol);
+    width -= lvcol.cx;
+
+    lvcol.pszText = L"Window Text";
+    lvcol.cx = max(width, DPIScale(hwnd, 64));
+    ListView_InsertColumn(hwndList, 2, &lvcol);
+}
+
+//
+//  Dialog procedure for the style query window
+//
+INT_PTR CALLBACK StyleQueryDlgProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lParam)
+{
+    NMITEMACTIVATE *nmatv;
+    LVITEM          lvitem;
+
+    switch (iMsg)
+    {
+    case WM_INITDIALOG:
+        InitResultsList(hwnd);
+        SetDlgItemText(hwnd, IDC_STYLEQUERY_STATUS, L"e.g. WS_EX_LAYERED !WS_EX_TRANSPARENT");
+        return TRUE;
+
+    case WM_CLOSE:
+        DestroyWindow(hwnd);
+        return TRUE;
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDC_STYLEQUERY_FIND:
+            RunStyleQuery(hwnd);
+            return TRUE;
+
+        case IDCANCEL:
+            DestroyWindow(hwnd);
+            return TRUE;
+        }
+        return FALSE;
+
+    case WM_NOTIFY:
+        nmatv = (NMITEMACTIVATE *)lParam;
+
+        if (nmatv->hdr.idFrom == IDC_STYLEQUERY_RESULTS && nmatv->hdr.code == NM_DBLCLK && nmatv->iItem >= 0)
+        {
+            lvitem.mask     = LVIF_PARAM;
+            lvitem.iItem    = nmatv->iItem;
+            lvitem.iSubItem = 0;
+
+            if (ListView_GetItem(nmatv->hdr.hwndFrom, &lvitem))
+                DisplayWindowInfo((HWND)lvitem.lParam);
+        }
+        return FALSE;
+
+    case WM_NCDESTROY:
+        g_hwndStyleQueryDlg = NULL;
+        break;
+    }
+
+    return FALSE;
+}
+
+
+void ShowStyleQueryDlg(HWND hwndParent)
+{
+    if (g_hwndStyleQueryDlg)
+    {
+        SetForegroundWindow(g_hwndStyleQueryDlg);
+        return;
+    }
+
+    g_hwndStyleQueryDlg = CreateDialog(
+        g_hInst,
+        MAKEINTRESOURCE(IDD_STYLEQUERY),
+        hwndParent,
+        StyleQueryDlgProc);
+
+    ShowWindow(g_hwndStyleQueryDlg, SW_SHOW);
+}
+
+
+BOOL IsStyleQueryMessage(LPMSG lpMsg)
+{
+    return g_hwndStyleQueryDlg && IsDialogMessage(g_hwndStyleQueryDlg, lpMsg);
+}
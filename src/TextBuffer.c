@@ -0,0 +1,111 @@
+//
+//  TextBuffer.c
+//
+//  Growable text buffers and line indexes for long window text.
+//
+
+#include "WinSpy.h"
+
+#include "TextBuffer.h"
+
+BOOL TextBuffer_Reserve(TEXTBUFFER *pText, size_t cchMore)
+{
+    size_t cchNeeded;
+    size_t cchAlloc;
+    WCHAR *pszText;
+
+    if (cchMore > TEXTBUFFER_MAX_TEXT - pText->cchText)
+        return FALSE;
+
+    cchNeeded = pText->cchText + cchMore + 1;
+
+    if (cchNeeded <= pText->cchAlloc)
+        return TRUE;
+
+    cchAlloc = max(pText->cchAlloc * 2, cchNeeded);
+    pszText  = (WCHAR *)realloc(pText->pszText, cchAlloc * sizeof(WCHAR));
+
+    if (!pszText)
+        return FALSE;
+
+    if (!pText->pszText)
+        pszText[0] = L'\0';
+
+    pText->pszText  = pszText;
+    pText->cchAlloc = cchAlloc;
+    return TRUE;
+}
+
+void TextBuffer_Free(TEXTBUFFER *pText)
+{
+    free(pText->pszText);
+    ZeroMemory(pText, sizeof(TEXTBUFFER));
+}
+
+static BOOL AddLineStart(LINEINDEX *pIndex, size_t ichStart)
+{
+    if (pIndex->cLines == pIndex->cAlloc)
+    {
+        size_t  cAlloc  = pIndex->cAlloc ? pIndex->cAlloc * 2 : 256;
+        size_t *rgStart = (size_t *)realloc(pIndex->rgStart, cAlloc * sizeof(size_t));
+
+        if (!rgStart)
+            return FALSE;
+
+        pIndex->rgStart = rgStart;
+        pIndex->cAlloc  = cAlloc;
+    }
+
+    pIndex->rgStart[pIndex->cLines++] = ichStart;
+    return TRUE;
+}
+
+BOOL LineIndex_Build(LINEINDEX *pIndex, const TEXTBUFFER *pText)
+{
+    pIndex->cLines = 0;
+
+    if (!AddLineStart(pIndex, 0))
+        return FALSE;
+
+    for (size_t i = 0; i < pText->cchText; i++)
+    {
+        WCHAR ch = pText->pszText[i];
+
+        if (ch == L'\r' && i + 1 < pText->cchText && pText->pszText[i + 1] == L'\n')
+            i++;
+        else if (ch != L'\r' && ch != L'\n')
+            continue;
+
+        if (!AddLineStart(pIndex, i + 1))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+size_t LineIndex_GetLine(const LINEINDEX *pIndex, const TEXTBUFFER *pText, size_t iLine, const WCHAR **ppchLine)
+{
+    size_t ichStart, ichEnd;
+
+    if (iLine >= pIndex->cLines || !pText->pszText)
+    {
+        *ppchLine = L"";
+        return 0;
+    }
+
+    ichStart = pIndex->rgStart[iLine];
+    ichEnd   = (iLine + 1 < pIndex->cLines) ? pIndex->rgStart[iLine + 1] : pText->cchText;
+
+    // Leave the line break off.  Only the break can be \r or \n.
+    while (ichEnd > ichStart && (pText->pszText[ichEnd - 1] == L'\n' || pText->pszText[ichEnd - 1] == L'\r'))
+        ichEnd--;
+
+    *ppchLine = pText->pszText + ichStart;
+    return ichEnd - ichStart;
+}
+
+void LineIndex_Free(LINEINDEX *pIndex)
+{
+    free(pIndex->rgStart);
+    ZeroMemory(pIndex, sizeof(LINEINDEX));
+}
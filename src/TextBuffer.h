@@ -0,0 +1,68 @@
+#ifndef TEXTBUFFER_INCLUDED
+#define TEXTBUFFER_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// TEXTBUFFER
+//
+// A growable, null-terminated WCHAR buffer for window text of any length.
+// Space grows by doubling, so filling it a chunk at a time copies each
+// character a bounded number of times.  Callers reserve room, write
+// straight into pszText + cchText, then bump cchText and re-terminate.
+//
+// LINEINDEX
+//
+// Where each line of a TEXTBUFFER starts, so a list can show line N
+// without walking the text.  Lines end at \r\n, \n or \r, and text that
+// ends with a line break has an empty last line, the way an edit control
+// counts them.
+//
+
+#define TEXTBUFFER_MAX_TEXT     0x10000000  // Characters, keeps the byte counts sane
+
+typedef struct
+{
+    WCHAR  *pszText;
+    size_t  cchText;
+    size_t  cchAlloc;                       // Including room for the terminator
+}
+TEXTBUFFER;
+
+typedef struct
+{
+    size_t *rgStart;
+    size_t  cLines;
+    size_t  cAlloc;
+}
+LINEINDEX;
+
+// Makes room for cchMore characters (plus the terminator) after cchText.
+BOOL TextBuffer_Reserve(TEXTBUFFER *pText, size_t cchMore);
+void TextBuffer_Free(TEXTBUFFER *pText);
+
+BOOL LineIndex_Build(LINEINDEX *pIndex, const TEXTBUFFER *pText);
+
+// Returns the length of line iLine, not counting its line break.
+size_t LineIndex_GetLine(const LINEINDEX *pIndex, const TEXTBUFFER *pText, size_t iLine, const WCHAR **ppchLine);
+
+void LineIndex_Free(LINEINDEX *pIndex);
+
+// Return FALSE to stop reading.
+typedef BOOL (CALLBACK *TEXTPROGRESSPROC)(size_t cchDone, size_t cchTotal, PVOID pContext);
+
+//
+// Reads all of a window's text through a thread injected into its process,
+// for password edits that won't give it up to WM_GETTEXT from outside.
+// The text is copied out in chunks, with pfnProgress called after each.
+// (GetRemoteWindowInfo.c)
+//
+BOOL GetRemoteWindowTextLong(HWND hwnd, TEXTBUFFER *pText, TEXTPROGRESSPROC pfnProgress, PVOID pContext);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
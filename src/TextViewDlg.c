@@ -0,0 +1,413 @@
+//
+//  TextViewDlg.c
+//
+//  The "Window Text" dialog.  Shows all of a window's text, one line per
+//  list item.  The text is read in full on a worker thread first, and the
+//  list shows lines out of that as it needs them, split at the real line
+//  breaks (not where an edit control happens to wrap).
+//
+
+#include "WinSpy.h"
+
+#include "resource.h"
+#include "KnownClass.h"
+#include "TextBuffer.h"
+#include "Utils.h"
+
+#define TEXTVIEW_TIMER          1
+#define TEXTVIEW_LINE_MAX       1024        // Characters shown per line
+
+//
+//  A full read of a window's text.  The worker and the dialog each hold a
+//  reference, so the dialog can walk away from a read that's still going.
+//  The text and lines belong to the worker until fDone is set.
+//
+typedef struct
+{
+    HWND            hwnd;
+    BOOL            fInject;                // Read through an injected thread
+    volatile LONG   cRef;
+    volatile LONG   fCancel;
+    volatile LONG   fDone;
+    BOOL            fSuccess;
+    volatile size_t cchDone;                // Progress, for the timer to show
+    volatile size_t cchTotal;
+    TEXTBUFFER      text;
+    LINEINDEX       lines;
+}
+TEXTLOAD;
+
+static HWND       g_hwndTextViewDlg;
+static HWND       g_hwndTextTarget;
+static TEXTLOAD  *g_pTextLoad;
+static WCHAR      g_szLine[TEXTVIEW_LINE_MAX];
+
+static void ReleaseTextLoad(TEXTLOAD *pLoad)
+{
+    if (InterlockedDecrement(&pLoad->cRef) == 0)
+    {
+        LineIndex_Free(&pLoad->lines);
+        TextBuffer_Free(&pLoad->text);
+        free(pLoad);
+    }
+}
+
+static BOOL CALLBACK LoadProgressProc(size_t cchDone, size_t cchTotal, PVOID pContext)
+{
+    TEXTLOAD *pLoad = (TEXTLOAD *)pContext;
+
+    pLoad->cchTotal = cchTotal;
+    pLoad->cchDone  = cchDone;
+
+    return !pLoad->fCancel;
+}
+
+//
+//  WM_GETTEXT is marshalled for text of any length, but there's no asking
+//  for part of it, so this comes in one piece.
+//
+static BOOL GetWindowTextLong(HWND hwnd, TEXTBUFFER *pText)
+{
+    DWORD_PTR cchLength;
+    DWORD_PTR cchCopied;
+
+    if (!SendMessageTimeout(hwnd, WM_GETTEXTLENGTH, 0, 0, SMTO_ABORTIFHUNG, 1000, &cchLength) ||
+        !TextBuffer_Reserve(pText, cchLength))
+    {
+        return FALSE;
+    }
+
+    pText->pszText[0] = L'\0';
+
+    if (!SendMessageTimeout(hwnd, WM_GETTEXT, cchLength + 1, (LPARAM)pText->pszText, SMTO_ABORTIFHUNG, 5000, &cchCopied))
+        return FALSE;
+
+    pText->cchText = min(cchCopied, cchLength);
+    pText->pszText[pText->cchText] = L'\0';
+
+    return TRUE;
+}
+
+static void CALLBACK LoadTextWorker(PTP_CALLBACK_INSTANCE pInstance, PVOID pv)
+{
+    TEXTLOAD *pLoad = (TEXTLOAD *)pv;
+    BOOL      fSuccess;
+
+    UNREFERENCED_PARAMETER(pInstance);
+
+    if (pLoad->fInject)
+        fSuccess = GetRemoteWindowTextLong(pLoad->hwnd, &pLoad->text, LoadProgressProc, pLoad);
+    else
+        fSuccess = GetWindowTextLong(pLoad->hwnd, &pLoad->text);
+
+    pLoad->fSuccess = fSuccess && !pLoad->fCancel && LineIndex_Build(&pLoad->lines, &pLoad->text);
+
+    InterlockedExchange(&pLoad->fDone, TRUE);
+    ReleaseTextLoad(pLoad);
+}
+
+static void CancelTextLoad(HWND hwnd)
+{
+    KillTimer(hwnd, TEXTVIEW_TIMER);
+    ShowDlgItem(hwnd, IDC_TEXTVIEW_PROGRESS, SW_HIDE);
+
+    if (g_pTextLoad)
+    {
+        InterlockedExchange(&g_pTextLoad->fCancel, TRUE);
+        ReleaseTextLoad(g_pTextLoad);
+        g_pTextLoad = NULL;
+    }
+}
+
+static void StartTextLoad(HWND hwnd, BOOL fPassword)
+{
+    TEXTLOAD *pLoad = (TEXTLOAD *)calloc(1, sizeof(TEXTLOAD));
+
+    if (!pLoad)
+    {
+        SetDlgItemText(hwnd, IDC_TEXTVIEW_STATUS, L"Out of memory");
+        return;
+    }
+
+    pLoad->hwnd    = g_hwndTextTarget;
+    pLoad->fInject = fPassword && ProcessArchMatches(g_hwndTextTarget);
+    pLoad->cRef    = 2;
+
+    if (!TrySubmitThreadpoolCallback(LoadTextWorker, pLoad, NULL))
+    {
+        free(pLoad);
+        SetDlgItemText(hwnd, IDC_TEXTVIEW_STATUS, L"Couldn't start reading the text");
+        return;
+    }
+
+    g_pTextLoad = pLoad;
+
+    SendDlgItemMessage(hwnd, IDC_TEXTVIEW_PROGRESS, PBM_SETRANGE32, 0, 1000);
+    SendDlgItemMessage(hwnd, IDC_TEXTVIEW_PROGRESS, PBM_SETPOS, 0, 0);
+    ShowDlgItem(hwnd, IDC_TEXTVIEW_PROGRESS, SW_SHOW);
+
+    SetDlgItemText(hwnd, IDC_TEXTVIEW_STATUS, L"Reading...");
+    SetTimer(hwnd, TEXTVIEW_TIMER, 100, NULL);
+}
+
+static void OnLoadTimer(HWND hwnd)
+{
+    TEXTLOAD *pLoad = g_pTextLoad;
+    WCHAR     szStatus[128];
+
+    if (!pLoad)
+    {
+        KillTimer(hwnd, TEXTVIEW_TIMER);
+        return;
+    }
+
+    if (!pLoad->fDone)
+    {
+        size_t cchDone  = pLoad->cchDone;
+        size_t cchTotal = pLoad->cchTotal;
+
+        if (cchTotal)
+        {
+            SendDlgItemMessage(hwnd, IDC_TEXTVIEW_PROGRESS, PBM_SETPOS, MulDiv((int)cchDone, 1000, (int)cchTotal), 0);
+
+            swprintf_s(szStatus, ARRAYSIZE(szStatus), L"Reading %zu of %zu characters...", cchDone, cchTotal);
+            SetDlgItemText(hwnd, IDC_TEXTVIEW_STATUS, szStatus);
+        }
+        return;
+    }
+
+    KillTimer(hwnd, TEXTVIEW_TIMER);
+    ShowDlgItem(hwnd, IDC_TEXTVIEW_PROGRESS, SW_HIDE);
+
+    if (pLoad->fSuccess)
+    {
+        ListView_SetItemCountEx(GetDlgItem(hwnd, IDC_TEXTVIEW_LINES), (int)pLoad->lines.cLines, 0);
+
+        swprintf_s(szStatus, ARRAYSIZE(szStatus), L"%zu characters, %zu lines", pLoad->text.cchText, pLoad->lines.cLines);
+        SetDlgItemText(hwnd, IDC_TEXTVIEW_STATUS, szStatus);
+    }
+    else
+    {
+        SetDlgItemText(hwnd, IDC_TEXTVIEW_STATUS, L"Couldn't read the text");
+    }
+}
+
+//
+//  Password edits won't hand their text out, except from inside.
+//
+static void SetTextViewTarget(HWND hwnd, HWND hwndTarget)
+{
+    HWND      hwndList = GetDlgItem(hwnd, IDC_TEXTVIEW_LINES);
+    WCHAR     szStatus[128];
+    BOOL      fPassword;
+
+    CancelTextLoad(hwnd);
+
+    g_hwndTextTarget = hwndTarget;
+
+    ListView_SetItemCountEx(hwndList, 0, 0);
+
+    swprintf_s(szStatus, ARRAYSIZE(szStatus), L"Window Text - %08X", (UINT)(UINT_PTR)hwndTarget);
+    SetWindowText(hwnd, szStatus);
+
+    if (!IsWindow(hwndTarget))
+    {
+        SetDlgItemText(hwnd, IDC_TEXTVIEW_STATUS, L"Not a window");
+        return;
+    }
+
+    fPassword = (GetKnownClass(hwndTarget) == KNOWNCLASS_EDIT) && (GetWindowLong(hwndTarget, GWL_STYLE) & ES_PASSWORD);
+
+    StartTextLoad(hwnd, fPassword);
+}
+
+//
+//  Fills in pszLine (at most cchLine characters, including the null) with
+//  line iLine of the current text.
+//
+static void GetTextViewLine(int iLine, WCHAR *pszLine, size_t cchLine)
+{
+    const WCHAR *pchLine;
+    size_t       cch;
+
+    if (g_pTextLoad && g_pTextLoad->fDone && g_pTextLoad->fSuccess)
+    {
+        cch = LineIndex_GetLine(&g_pTextLoad->lines, &g_pTextLoad->text, iLine, &pchLine);
+        cch = min(cch, cchLine - 1);
+
+        memcpy(pszLine, pchLine, cch * sizeof(WCHAR));
+        pszLine[cch] = L'\0';
+    }
+    else
+    {
+        pszLine[0] = L'\0';
+    }
+}
+
+static void OnGetDispInfo(NMLVDISPINFO *pdi)
+{
+    if (!(pdi->item.mask & LVIF_TEXT))
+        return;
+
+    if (pdi->item.iSubItem == 0)
+    {
+        swprintf_s(pdi->item.pszText, pdi->item.cchTextMax, L"%d", pdi->item.iItem + 1);
+    }
+    else
+    {
+        // The list only asks for the rows it's showing
+        GetTextViewLine(pdi->item.iItem, g_szLine, ARRAYSIZE(g_szLine));
+        pdi->item.pszText = g_szLine;
+    }
+}
+
+//
+//  Copy the selected lines, or all of them if none are selected.  Each line
+//  goes with the line break it has in the text, long lines and all.
+//
+static void CopySelectedLines(HWND hwnd)
+{
+    HWND       hwndList = GetDlgItem(hwnd, IDC_TEXTVIEW_LINES);
+    TEXTLOAD  *pLoad    = g_pTextLoad;
+    TEXTBUFFER text     = { 0 };
+    int        cItems   = ListView_GetItemCount(hwndList);
+    int        iItem    = -1;
+
+    if (!pLoad || !pLoad->fDone || !pLoad->fSuccess)
+        return;
+
+    if (ListView_GetSelectedCount(hwndList) == 0)
+    {
+        CopyTextToClipboard(hwnd, pLoad->text.pszText);
+        return;
+    }
+
+    if (!TextBuffer_Reserve(&text, 0))
+        return;
+
+    while ((iItem = ListView_GetNextItem(hwndList, iItem, LVNI_SELECTED)) != -1 && iItem < cItems)
+    {
+        size_t ichStart = pLoad->lines.rgStart[iItem];
+        size_t ichEnd   = ((size_t)iItem + 1 < pLoad->lines.cLines) ? pLoad->lines.rgStart[iItem + 1] : pLoad->text.cchText;
+
+        if (!TextBuffer_Reserve(&text, ichEnd - ichStart))
+            break;
+
+        memcpy(text.pszText + text.cchText, pLoad->text.pszText + ichStart, (ichEnd - ichStart) * sizeof(WCHAR));
+        text.cchText += ichEnd - ichStart;
+        text.pszText[text.cchText] = L'\0';
+    }
+
+    CopyTextToClipboard(hwnd, text.pszText);
+    TextBuffer_Free(&text);
+}
+
+static void InitLinesList(HWND hwnd)
+{
+    HWND     hwndList = GetDlgItem(hwnd, IDC_TEXTVIEW_LINES);
+    LVCOLUMN lvcol;
+    RECT     rect;
+    int      width;
+
+    ListView_SetExtendedListViewStyle(hwndList, LVS_EX_FULLROWSELECT);
+
+    GetClientRect(hwndList, &rect);
+    width = rect.right - GetSystemMetrics(SM_CXVSCROLL);
+
+    lvcol.mask = LVCF_WIDTH | LVCF_TEXT | LVCF_SUBITEM | LVCF_FMT;
+    lvcol.fmt = LVCFMT_RIGHT;
+    lvcol.cx = DPIScale(hwnd, 48);
+    lvcol.iSubItem = 0;
+    lvcol.pszText = L"Line";
+    ListView_InsertColumn(hwndList, 0, &lvcol);
+    width -= lvcol.cx;
+
+    lvcol.fmt = LVCFMT_LEFT;
+    lvcol.pszText = L"Text";
+    lvcol.cx = max(width, DPIScale(hwnd, 64));
+    lvcol.iSubItem = 1;
+    ListView_InsertColumn(hwndList, 1, &lvcol);
+}
+
+//
+//  Dialog procedure for the window text viewer
+//
+INT_PTR CALLBACK TextViewDlgProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lParam)
+{
+    NMHDR *hdr;
+
+    switch (iMsg)
+    {
+    case WM_INITDIALOG:
+        InitLinesList(hwnd);
+        SetTextViewTarget(hwnd, (HWND)lParam);
+        return TRUE;
+
+    case WM_TIMER:
+        if (wParam == TEXTVIEW_TIMER)
+            OnLoadTimer(hwnd);
+        return TRUE;
+
+    case WM_CLOSE:
+        DestroyWindow(hwnd);
+        return TRUE;
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDC_TEXTVIEW_COPY:
+            CopySelectedLines(hwnd);
+            return TRUE;
+
+        case IDCANCEL:
+            DestroyWindow(hwnd);
+            return TRUE;
+        }
+        return FALSE;
+
+    case WM_NOTIFY:
+        hdr = (NMHDR *)lParam;
+
+        if (hdr->idFrom == IDC_TEXTVIEW_LINES && hdr->code == LVN_GETDISPINFO)
+            OnGetDispInfo((NMLVDISPINFO *)lParam);
+
+        return FALSE;
+
+    case WM_DESTROY:
+        CancelTextLoad(hwnd);
+        break;
+
+    case WM_NCDESTROY:
+        g_hwndTextViewDlg = NULL;
+        g_hwndTextTarget  = NULL;
+        break;
+    }
+
+    return FALSE;
+}
+
+
+void ShowTextViewDlg(HWND hwndParent, HWND hwndTarget)
+{
+    if (g_hwndTextViewDlg)
+    {
+        SetTextViewTarget(g_hwndTextViewDlg, hwndTarget);
+        SetForegroundWindow(g_hwndTextViewDlg);
+        return;
+    }
+
+    g_hwndTextViewDlg = CreateDialogParam(
+        g_hInst,
+        MAKEINTRESOURCE(IDD_TEXTVIEW),
+        hwndParent,
+        TextViewDlgProc,
+        (LPARAM)hwndTarget);
+
+    ShowWindow(g_hwndTextViewDlg, SW_SHOW);
+}
+
+
+BOOL IsTextViewMessage(LPMSG lpMsg)
+{
+    return g_hwndTextViewDlg && IsDialogMessage(g_hwndTextViewDlg, lpMsg);
+}
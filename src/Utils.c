@@ -10,6 +10,8 @@
 #include "WinSpy.h"
 #include <malloc.h>
 #include "Utils.h"
+#include "ProcessInfoCache.h"
+#include "NineGrid.h"
 
 
 //
@@ -94,6 +96,70 @@ BOOL ShowDlgItem(HWND hwnd, UINT nCtrlId, DWORD dwShowCmd)
 }
 
 
+//
+// The tab dialogs live as long as WinSpy does, so SetDlgItemTextEx keeps a
+// copy of the text it last put in each of their controls.  Comparing with
+// that costs nothing, unlike reading the text back, which matters when
+// auto-update runs many times a second.  Controls the user can type into
+// are still read back.
+//
+
+#define SHADOW_TABLE_SIZE   256     // Power of 2, well over the controls on all the tabs
+
+typedef struct
+{
+    HWND  hwnd;
+    BOOL  fEditable;
+    PWSTR pszText;                  // NULL until first set
+}
+ShadowText;
+
+static ShadowText g_rgShadowText[SHADOW_TABLE_SIZE];
+static UINT       g_cShadowText;
+
+static BOOL IsTabDialog(HWND hwndDlg)
+{
+    for (UINT i = 0; i < NUMTABCONTROLITEMS; i++)
+    {
+        if (WinSpyTab[i].hwnd == hwndDlg)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static ShadowText *GetShadowText(HWND hwndDlg, HWND hwnd)
+{
+    UINT  iSlot = (UINT)(((UINT_PTR)hwnd >> 1) & (SHADOW_TABLE_SIZE - 1));
+    WCHAR szClass[16];
+
+    if (!IsTabDialog(hwndDlg))
+        return NULL;
+
+    while (g_rgShadowText[iSlot].hwnd)
+    {
+        if (g_rgShadowText[iSlot].hwnd == hwnd)
+            return &g_rgShadowText[iSlot];
+
+        iSlot = (iSlot + 1) & (SHADOW_TABLE_SIZE - 1);
+    }
+
+    if (g_cShadowText >= SHADOW_TABLE_SIZE / 2)
+        return NULL;
+
+    g_cShadowText++;
+    g_rgShadowText[iSlot].hwnd = hwnd;
+
+    GetClassName(hwnd, szClass, ARRAYSIZE(szClass));
+
+    if (_wcsicmp(szClass, WC_EDIT) == 0)
+        g_rgShadowText[iSlot].fEditable = !(GetWindowLong(hwnd, GWL_STYLE) & ES_READONLY);
+    else
+        g_rgShadowText[iSlot].fEditable = (_wcsicmp(szClass, WC_COMBOBOX) == 0);
+
+    return &g_rgShadowText[iSlot];
+}
+
 //
 // SetDlgItemTextEx is a Variant of SetDlgItemText that that avoids re-setting
 // the value if it is the same as what is already in the control.  This allows
@@ -105,9 +171,25 @@ void SetDlgItemTextEx(HWND hwndDlg, UINT id, PCWSTR pcszNew)
 {
     HWND hwnd = GetDlgItem(hwndDlg, id);
     WCHAR szOld[256];
+    ShadowText *pShadow;
 
     if (hwnd)
     {
+        pShadow = GetShadowText(hwndDlg, hwnd);
+
+        if (pShadow && !pShadow->fEditable)
+        {
+            if (!pShadow->pszText || wcscmp(pcszNew, pShadow->pszText) != 0)
+            {
+                SetWindowText(hwnd, pcszNew);
+
+                free(pShadow->pszText);
+                pShadow->pszText = _wcsdup(pcszNew);
+            }
+
+            return;
+        }
+
         GetWindowText(hwnd, szOld, ARRAYSIZE(szOld));
 
         if (wcscmp(pcszNew, szOld) != 0)
@@ -119,18 +201,12 @@ void SetDlgItemTextEx(HWND hwndDlg, UINT id, PCWSTR pcszNew)
 
 void SetDlgItemTextExA(HWND hwndDlg, UINT id, PCSTR pcszNew)
 {
-    HWND hwnd = GetDlgItem(hwndDlg, id);
-    CHAR szOld[256];
+    WCHAR szNew[256];
 
-    if (hwnd)
-    {
-        GetWindowTextA(hwnd, szOld, ARRAYSIZE(szOld));
+    if (MultiByteToWideChar(CP_ACP, 0, pcszNew, -1, szNew, ARRAYSIZE(szNew)) == 0)
+        szNew[0] = L'\0';
 
-        if (strcmp(pcszNew, szOld) != 0)
-        {
-            SetWindowTextA(hwnd, pcszNew);
-        }
-    }
+    SetDlgItemTextEx(hwndDlg, id, szNew);
 }
 
 void FormatDlgItemText(HWND hwndDlg, UINT id, _Printf_format_string_ PCWSTR pcszFormat, ...)
@@ -139,12 +215,29 @@ void FormatDlgItemText(HWND hwndDlg, UINT id, _Printf_format_string_ PCWSTR pcsz
 
     va_list args;
     va_start(args, pcszFormat);
-    StringCchVPrintfW(szBuffer, sizeof(szBuffer), pcszFormat, args);
+    StringCchVPrintfW(szBuffer, ARRAYSIZE(szBuffer), pcszFormat, args);
     va_end(args);
 
     SetDlgItemTextEx(hwndDlg, id, szBuffer);
 }
 
+//
+// FNV-1a, for the tab probes.  Start with PROBE_HASH_INIT.
+//
+
+ULONGLONG HashProbeData(ULONGLONG hash, const void *pv, size_t cb)
+{
+    const BYTE *pb = (const BYTE *)pv;
+
+    for (size_t i = 0; i < cb; i++)
+    {
+        hash ^= pb[i];
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
 int WINAPI GetRectHeight(RECT *rect)
 {
     return rect->bottom - rect->top;
@@ -350,14 +443,13 @@ WCHAR *GetVersionString(WCHAR *szFileName, WCHAR *szValue, WCHAR *szBuffer, ULON
 
 
 //
-//  Compare Arch (32 or 64 bit) of our process with the process of the input window
+//  Compare Arch (32 or 64 bit) of our process with the input process, which
+//  needs PROCESS_QUERY_LIMITED_INFORMATION access
 //
-BOOL ProcessArchMatches(HWND hwnd)
+BOOL ProcessHandleArchMatches(HANDLE hProcess)
 {
     static FARPROC fnIsWow64Process = NULL;
     static BOOL bIsWow64ProcessAbsents = FALSE;
-    DWORD dwProcessId;
-    HANDLE hProcess;
     BOOL bIsWow64Process;
     BOOL bSuccess;
 
@@ -388,16 +480,8 @@ BOOL ProcessArchMatches(HWND hwnd)
         }
     }
 
-    GetWindowThreadProcessId(hwnd, &dwProcessId);
-
-    hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, dwProcessId);
-    if (!hProcess)
-        return FALSE; // assume no match, to be on the safe side
-
     bSuccess = ((BOOL(WINAPI *)(HANDLE, PBOOL))fnIsWow64Process)(hProcess, &bIsWow64Process);
 
-    CloseHandle(hProcess);
-
     if (bSuccess)
     {
 #ifdef _WIN64
@@ -410,6 +494,20 @@ BOOL ProcessArchMatches(HWND hwnd)
         return FALSE; // assume no match, to be on the safe side
 }
 
+//
+//  Compare Arch (32 or 64 bit) of our process with the process of the input window
+//
+BOOL ProcessArchMatches(HWND hwnd)
+{
+    DWORD dwProcessId;
+    PROCESSINFO info;
+
+    GetWindowThreadProcessId(hwnd, &dwProcessId);
+
+    // assume no match if we can't tell, to be on the safe side
+    return ProcessInfoCache_Get(dwProcessId, &info) && info.fArchMatches;
+}
+
 
 //
 // Assumes to support only PROCESSOR_ARCHITECTURE_INTEL and PROCESSOR_ARCHITECTURE_AMD64
@@ -500,160 +598,46 @@ BOOL CopyTextToClipboard(HWND hWnd, WCHAR *psz)
 
 HBITMAP ExpandNineGridImage(SIZE outputSize, HBITMAP hbmSrc, RECT edges)
 {
-    HDC     hdcScreen, hdcDst, hdcSrc;
-    HBITMAP hbmDst;
-    void*   pBits;
-    HANDLE  hOldSrc, hOldDst;
-    BITMAP  bmSrc;
+    DIBSECTION ds;
+    HBITMAP    hbmDst;
+    void      *pBits;
+
+    // The pixels can be worked on directly if the source is a top-down
+    // 32bpp DIB section, as loaded by LoadPNGImage.
+
+    if (GetObject(hbmSrc, sizeof(ds), &ds) != sizeof(ds) ||
+        ds.dsBm.bmBits == NULL ||
+        ds.dsBm.bmBitsPixel != 32 ||
+        ds.dsBmih.biHeight >= 0 ||
+        ds.dsBm.bmWidth <= edges.left + edges.right ||
+        ds.dsBm.bmHeight <= edges.top + edges.bottom ||
+        outputSize.cx <= edges.left + edges.right ||
+        outputSize.cy <= edges.top + edges.bottom)
+    {
+        return NineGrid_ExpandGdi(outputSize, hbmSrc, edges);
+    }
 
-    // Create a 32bpp DIB of the desired size, this is the output bitmap.
     BITMAPINFOHEADER bih = { sizeof(bih) };
 
     bih.biWidth       = outputSize.cx;
-    bih.biHeight      = outputSize.cy;
+    bih.biHeight      = -outputSize.cy;
     bih.biPlanes      = 1;
     bih.biBitCount    = 32;
     bih.biCompression = BI_RGB;
-    bih.biSizeImage   = 0;
-
-    hdcScreen = GetDC(0);
-    hbmDst = CreateDIBSection(hdcScreen, (BITMAPINFO *)&bih, DIB_RGB_COLORS, &pBits, 0, 0);
-
-    // Determine size of the source image.
-    GetObject(hbmSrc, sizeof(bmSrc), &bmSrc);
-
-    // Prep DCs
-    hdcSrc = CreateCompatibleDC(hdcScreen);
-    hOldSrc = SelectObject(hdcSrc, hbmSrc);
-
-    hdcDst = CreateCompatibleDC(hdcScreen);
-    hOldDst = SelectObject(hdcDst, hbmDst);
-
-    // Sizes of the nine-grid edges
-    int cxEdgeL = edges.left;
-    int cxEdgeR = edges.right;
-    int cyEdgeT = edges.top;
-    int cyEdgeB = edges.bottom;
-
-    // Precompute sizes and coordinates of the interior boxes
-    // (that is, the source and dest rects with the edges subtracted out).
-    int cxDstInner = outputSize.cx - (cxEdgeL + cxEdgeR);
-    int cyDstInner = outputSize.cy - (cyEdgeT + cyEdgeB);
-    int cxSrcInner = bmSrc.bmWidth - (cxEdgeL + cxEdgeR);
-    int cySrcInner = bmSrc.bmHeight - (cyEdgeT + cyEdgeB);
-
-    int xDst1 = cxEdgeL;
-    int xDst2 = outputSize.cx - cxEdgeR;
-    int yDst1 = cyEdgeT;
-    int yDst2 = outputSize.cy - cyEdgeB;
-
-    int xSrc1 = cxEdgeL;
-    int xSrc2 = bmSrc.bmWidth - cxEdgeR;
-    int ySrc1 = cyEdgeT;
-    int ySrc2 = bmSrc.bmHeight - cyEdgeB;
-
-    // Upper-left corner
-    BitBlt(
-        hdcDst, 0, 0, cxEdgeL, cyEdgeT,
-        hdcSrc, 0, 0,
-        SRCCOPY);
-
-    // Upper-right corner
-    BitBlt(
-        hdcDst, xDst2, 0, cxEdgeR, cyEdgeT,
-        hdcSrc, xSrc2, 0,
-        SRCCOPY);
-
-    // Lower-left corner
-    BitBlt(
-        hdcDst, 0, yDst2, cxEdgeL, cyEdgeB,
-        hdcSrc, 0, ySrc2,
-        SRCCOPY);
-
-    // Lower-right corner
-    BitBlt(
-        hdcDst, xDst2, yDst2, cxEdgeR, cyEdgeB,
-        hdcSrc, xSrc2, ySrc2,
-        SRCCOPY);
-
-    // Left side
-    StretchBlt(
-        hdcDst, 0, yDst1, cxEdgeL, cyDstInner,
-        hdcSrc, 0, ySrc1, cxEdgeL, cySrcInner,
-        SRCCOPY);
-
-    // Right side
-    StretchBlt(
-        hdcDst, xDst2, yDst1, cxEdgeR, cyDstInner,
-        hdcSrc, xSrc2, ySrc1, cxEdgeR, cySrcInner,
-        SRCCOPY);
-
-    // Top side
-    StretchBlt(
-        hdcDst, xDst1, 0, cxDstInner, cyEdgeT,
-        hdcSrc, xSrc1, 0, cxSrcInner, cyEdgeT,
-        SRCCOPY);
-
-    // Bottom side
-    StretchBlt(
-        hdcDst, xDst1, yDst2, cxDstInner, cyEdgeB,
-        hdcSrc, xSrc1, ySrc2, cxSrcInner, cyEdgeB,
-        SRCCOPY);
-
-    // Middle
-    StretchBlt(
-        hdcDst, xDst1, yDst1, cxDstInner, cyDstInner,
-        hdcSrc, xSrc1, ySrc1, cxSrcInner, cySrcInner,
-        SRCCOPY);
-
-    SelectObject(hdcSrc, hOldSrc);
-    SelectObject(hdcDst, hOldDst);
-
-    DeleteDC(hdcSrc);
-    DeleteDC(hdcDst);
-
-    ReleaseDC(0, hdcScreen);
-
-    return hbmDst;
-}
-
-void UpdateLayeredWindowContent(HWND hwnd, RECT rc, HBITMAP hbmp, BYTE alpha)
-{
-    POINT ptZero = { 0, 0 };
-    POINT pt;
-    SIZE size;
-    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0, AC_SRC_ALPHA };
-    blend.SourceConstantAlpha = alpha;
-
-    pt.x = rc.left;
-    pt.y = rc.top;
-
-    size.cx = GetRectWidth(&rc);
-    size.cy = GetRectHeight(&rc);
-
-    HDC hdcSrc = GetDC(0);
-    HDC hdcMem = CreateCompatibleDC(hdcSrc);
 
-    HANDLE hbmpOld = SelectObject(hdcMem, hbmp);
+    hbmDst = CreateDIBSection(NULL, (BITMAPINFO *)&bih, DIB_RGB_COLORS, &pBits, 0, 0);
 
-    UpdateLayeredWindow(
-        hwnd,
-        hdcSrc,
-        &pt,
-        &size,
-        hdcMem,
-        &ptZero,
-        RGB(0, 0, 0),
-        &blend,
-        ULW_ALPHA);
+    if (hbmDst)
+    {
+        SIZE sizeSrc = { ds.dsBm.bmWidth, ds.dsBm.bmHeight };
 
-    SelectObject(hdcMem, hbmpOld);
-    DeleteDC(hdcMem);
+        GdiFlush();
+        NineGrid_ExpandBits((DWORD *)pBits, outputSize, (const DWORD *)ds.dsBm.bmBits, sizeSrc, edges);
+    }
 
-    ReleaseDC(0, hdcSrc);
+    return hbmDst;
 }
 
-
 //
 // Winforms wraps standard controls with a custom class name.
 // Extract the underlying class name, e.g.:
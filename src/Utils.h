@@ -29,7 +29,12 @@ BOOL EnableDebugPrivilege();
 
 WCHAR *GetVersionString(WCHAR *szFileName, WCHAR *szValue, WCHAR *szBuffer, ULONG nLength);
 
+#define PROBE_HASH_INIT     0xCBF29CE484222325ull
+
+ULONGLONG HashProbeData(ULONGLONG hash, const void *pv, size_t cb);
+
 BOOL ProcessArchMatches(HWND hwnd);
+BOOL ProcessHandleArchMatches(HANDLE hProcess);
 WORD GetProcessorArchitecture();
 
 HWND GetRealParent(HWND hWnd);
@@ -40,8 +45,6 @@ HBITMAP LoadPNGImage(UINT id, void **bits);
 
 HBITMAP ExpandNineGridImage(SIZE outputSize, HBITMAP hbmSrc, RECT edges);
 
-void UpdateLayeredWindowContent(HWND hwnd, RECT rc, HBITMAP hbmp, BYTE alpha);
-
 BOOL IsWindowsFormsClassName(PCWSTR pcszClass);
 void ExtractWindowsFormsInnerClassName(PWSTR pszName);
 
@@ -0,0 +1,145 @@
+//
+//  WinEventCoalescer.c
+//
+//  Merges a stream of per-window events into batches with one entry per
+//  window.  Used to turn WinEvent hook notifications into tree updates at
+//  a bounded rate.  Nothing in here depends on the hooks, so it can be fed
+//  any event stream.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+
+#include "WinEventCoalescer.h"
+
+static size_t HashEventHwnd(HWND hwnd)
+{
+    ULONGLONG key = (ULONG_PTR)hwnd;
+
+    key *= 0x9E3779B97F4A7C15ull;
+
+    return (size_t)(key >> 17);
+}
+
+BOOL WinEventCoalescer_Init(WINEVENTCOALESCER *pCoalescer, size_t cMaxWindows)
+{
+    size_t cSlots = 16;
+
+    ZeroMemory(pCoalescer, sizeof(*pCoalescer));
+
+    while (cSlots < cMaxWindows * 2)
+    {
+        cSlots *= 2;
+    }
+
+    pCoalescer->rgPending   = (WINEVENTITEM *)malloc(cMaxWindows * sizeof(WINEVENTITEM));
+    pCoalescer->rgBatch     = (WINEVENTITEM *)malloc(cMaxWindows * sizeof(WINEVENTITEM));
+    pCoalescer->rgSlots     = (UINT *)calloc(cSlots, sizeof(UINT));
+    pCoalescer->cSlots      = cSlots;
+    pCoalescer->cMaxWindows = cMaxWindows;
+
+    if (!pCoalescer->rgPending || !pCoalescer->rgBatch || !pCoalescer->rgSlots)
+    {
+        WinEventCoalescer_Free(pCoalescer);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void WinEventCoalescer_Free(WINEVENTCOALESCER *pCoalescer)
+{
+    free(pCoalescer->rgPending);
+    free(pCoalescer->rgBatch);
+    free(pCoalescer->rgSlots);
+
+    ZeroMemory(pCoalescer, sizeof(*pCoalescer));
+}
+
+BOOL WinEventCoalescer_Add(WINEVENTCOALESCER *pCoalescer, HWND hwnd, UINT fEvent)
+{
+    BOOL fFirst = (pCoalescer->cPending == 0 && !pCoalescer->fOverflow);
+
+    if (!pCoalescer->rgSlots)
+    {
+        return FALSE;
+    }
+
+    pCoalescer->cEvents++;
+
+    size_t mask = pCoalescer->cSlots - 1;
+    size_t slot = HashEventHwnd(hwnd) & mask;
+
+    while (pCoalescer->rgSlots[slot] != 0)
+    {
+        WINEVENTITEM *pItem = &pCoalescer->rgPending[pCoalescer->rgSlots[slot] - 1];
+
+        if (pItem->hwnd == hwnd)
+        {
+            pItem->fEvents |= fEvent;
+            return fFirst;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    if (pCoalescer->cPending == pCoalescer->cMaxWindows)
+    {
+        pCoalescer->fOverflow = TRUE;
+        return fFirst;
+    }
+
+    WINEVENTITEM *pItem = &pCoalescer->rgPending[pCoalescer->cPending++];
+
+    pItem->hwnd    = hwnd;
+    pItem->fEvents = fEvent;
+
+    pCoalescer->rgSlots[slot] = (UINT)pCoalescer->cPending;
+
+    return fFirst;
+}
+
+size_t WinEventCoalescer_TakeBatch(WINEVENTCOALESCER *pCoalescer, const WINEVENTITEM **prgItems, BOOL *pfOverflow)
+{
+    size_t        cItems = pCoalescer->cPending;
+    WINEVENTITEM *rgSwap = pCoalescer->rgBatch;
+
+    // Swap the buffers, so the caller can work through the batch while
+    // new events are collected.
+
+    pCoalescer->rgBatch   = pCoalescer->rgPending;
+    pCoalescer->rgPending = rgSwap;
+
+    *prgItems   = pCoalescer->rgBatch;
+    *pfOverflow = pCoalescer->fOverflow;
+
+    // Clearing the hash costs the same as the batch if the batch is big
+    // enough, otherwise just clear the slots that were used.
+
+    if (cItems * 8 > pCoalescer->cSlots)
+    {
+        ZeroMemory(pCoalescer->rgSlots, pCoalescer->cSlots * sizeof(UINT));
+    }
+    else
+    {
+        size_t mask = pCoalescer->cSlots - 1;
+
+        for (size_t i = 0; i < cItems; i++)
+        {
+            size_t slot = HashEventHwnd(pCoalescer->rgBatch[i].hwnd) & mask;
+
+            while (pCoalescer->rgSlots[slot] != 0)
+            {
+                pCoalescer->rgSlots[slot] = 0;
+                slot = (slot + 1) & mask;
+            }
+        }
+    }
+
+    pCoalescer->cPending  = 0;
+    pCoalescer->fOverflow = FALSE;
+    pCoalescer->cBatches++;
+
+    return cItems;
+}
@@ -0,0 +1,59 @@
+#ifndef WINEVENTCOALESCER_INCLUDED
+#define WINEVENTCOALESCER_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// WINEVENTCOALESCER
+//
+// Collects window events between tree updates, so that however many events
+// arrive for a window in that time, it only gets updated once.  Each event
+// is an arbitrary flag; the flags for the same window are OR'ed together,
+// and windows come out of a batch in the order they were first seen.
+//
+// Once a batch holds cMaxWindows windows, events for further windows are
+// dropped and fOverflow is set, telling the consumer to resynchronize
+// instead.
+//
+// There is no locking, everything must happen on one thread.  Adding events
+// while a batch taken from WinEventCoalescer_TakeBatch is being processed
+// is fine though; the batch stays valid until the next TakeBatch.
+//
+
+typedef struct
+{
+    HWND    hwnd;
+    UINT    fEvents;
+}
+WINEVENTITEM;
+
+typedef struct
+{
+    WINEVENTITEM *rgPending;        // Batch being collected
+    WINEVENTITEM *rgBatch;          // Batch handed out by TakeBatch
+    size_t        cPending;
+    size_t        cMaxWindows;
+    UINT         *rgSlots;          // Index into rgPending + 1, or 0 for an empty slot
+    size_t        cSlots;
+    BOOL          fOverflow;
+    ULONGLONG     cEvents;          // Total events added
+    ULONGLONG     cBatches;         // Total batches taken
+}
+WINEVENTCOALESCER;
+
+BOOL WinEventCoalescer_Init(WINEVENTCOALESCER *pCoalescer, size_t cMaxWindows);
+void WinEventCoalescer_Free(WINEVENTCOALESCER *pCoalescer);
+
+// Returns TRUE if this is the first event of a new batch.
+BOOL WinEventCoalescer_Add(WINEVENTCOALESCER *pCoalescer, HWND hwnd, UINT fEvent);
+
+// Hands out the pending events and starts a new batch.
+size_t WinEventCoalescer_TakeBatch(WINEVENTCOALESCER *pCoalescer, const WINEVENTITEM **prgItems, BOOL *pfOverflow);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
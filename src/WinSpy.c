@@ -18,6 +18,11 @@
 #include "Utils.h"
 #include "WindowFromPointEx.h"
 #include "Poster.h"
+#include "KnownClass.h"
+#include "InjectThread.h"
+#include "RemoteAgent.h"
+#include "RemoteInfoQueue.h"
+#include "ProcessInfoCache.h"
 
 
 HWND       g_hwndMain;       // Main winspy window
@@ -34,6 +39,7 @@ HWND       g_hCurWnd = 0;
 WNDPROC    g_WndProc;
 BOOL       g_fPassword = FALSE;     // is it a password (edit) control?
 BOOL       g_fTriedRemote = FALSE;
+BOOL       g_fRemotePending = FALSE;  // A worker is fetching the remote info
 WCHAR      g_szPassword[200];
 WCHAR      g_szClassName[MAX_PATH];
 DWORD      g_dwSelectedPID;         // Set only when a process node is selected in the treeview
@@ -50,17 +56,20 @@ static TBBUTTON tbbPin[] =
 
 DialogTab WinSpyTab[NUMTABCONTROLITEMS] =
 {
-    0, L"General",       IDD_TAB_GENERAL,    GeneralDlgProc,
-    0, L"Styles",        IDD_TAB_STYLES,     StyleDlgProc,
-    0, L"Properties",    IDD_TAB_PROPERTIES, PropertyDlgProc,
-    0, L"Class",         IDD_TAB_CLASS,      ClassDlgProc,
-    0, L"Windows",       IDD_TAB_WINDOWS,    WindowDlgProc,
-    0, L"Process",       IDD_TAB_PROCESS,    ProcessDlgProc,
-    0, L"DPI",           IDD_TAB_DPI,        DpiDlgProc,
+    0, L"General",       IDD_TAB_GENERAL,    GeneralDlgProc,  ProbeGeneralTab,
+    0, L"Styles",        IDD_TAB_STYLES,     StyleDlgProc,    ProbeStyleTab,
+    0, L"Properties",    IDD_TAB_PROPERTIES, PropertyDlgProc, ProbePropertyTab,
+    0, L"Class",         IDD_TAB_CLASS,      ClassDlgProc,    ProbeClassTab,
+    0, L"Windows",       IDD_TAB_WINDOWS,    WindowDlgProc,   ProbeWindowTab,
+    0, L"Process",       IDD_TAB_PROCESS,    ProcessDlgProc,  ProbeProcessTab,
+    0, L"DPI",           IDD_TAB_DPI,        DpiDlgProc,      ProbeDpiTab,
 };
 
 static int nCurrentTab = 0;
 
+static ULONGLONG g_uAutoUpdateVersion;      // Probe result at the last auto-update
+static DWORD     g_dwLastAutoUpdate;        // Tick count of the last full auto-update
+
 //
 // This function tries to get additional data about the current window by
 // injecting a thread into the process that owns the window.
@@ -76,17 +85,70 @@ static int nCurrentTab = 0;
 // - The other process could be suspend or sitting in a debugger.
 // - We may not have sufficient rights to open a handle to the other process.
 //
+// The injection can take seconds to fail, so it's done on a worker thread.
+// g_fRemotePending is set until the result arrives (WM_WINSPY_REMOTEINFO),
+// at which point the active tab is updated again.  Selecting another
+// window cancels the request.
+//
 
-void GetRemoteInfo()
+static REMOTEINFOQUEUE g_RemoteInfoQueue;
+
+typedef struct
 {
-    HWND hwnd = g_hCurWnd;
+    HWND    hwndNotify;
+    HWND    hwnd;
+    LONG    uSerial;
+    BOOL    fInject;            // Otherwise just ask for the password text
+    BOOL    fWantProc;
+    BOOL    fPassword;
+    WNDPROC wndproc;
+    WCHAR   szPassword[ARRAYSIZE(g_szPassword)];
+}
+REMOTEINFOREQUEST;
 
-    if (!hwnd || g_fTriedRemote)
-        return;
+static void CALLBACK RemoteInfoWorker(PTP_CALLBACK_INSTANCE pInstance, PVOID pv)
+{
+    REMOTEINFOREQUEST *pReq = (REMOTEINFOREQUEST *)pv;
+
+    UNREFERENCED_PARAMETER(pInstance);
+
+    // Don't bother if the request was cancelled before we got here.
+
+    if (RemoteInfoQueue_IsCurrent(&g_RemoteInfoQueue, pReq->uSerial))
+    {
+        if (pReq->fInject)
+        {
+            GetRemoteWindowInfo(pReq->hwnd, NULL, pReq->fWantProc ? &pReq->wndproc : NULL, pReq->szPassword, ARRAYSIZE(pReq->szPassword));
+        }
+        else if (pReq->fPassword)
+        {
+            SendMessageTimeout(pReq->hwnd, WM_GETTEXT, ARRAYSIZE(pReq->szPassword), (LPARAM)pReq->szPassword,
+                SMTO_ABORTIFHUNG, 1000, NULL);
+
+            // WM_GETTEXT does not guarantee null termination.
+
+            pReq->szPassword[ARRAYSIZE(pReq->szPassword) - 1] = '\0';
+        }
+    }
+
+    if (!PostMessage(pReq->hwndNotify, WM_WINSPY_REMOTEINFO, 0, (LPARAM)pReq))
+    {
+        free(pReq);
+    }
+}
+
+static void StartRemoteInfoWorker(HWND hwnd, LONG uSerial)
+{
+    REMOTEINFOREQUEST *pReq = (REMOTEINFOREQUEST *)calloc(1, sizeof(REMOTEINFOREQUEST));
 
-    if (g_WndProc == 0 || g_fPassword)
+    if (pReq)
     {
-        BOOL fAttemptInjection = ProcessArchMatches(hwnd);
+        pReq->hwndNotify = g_hwndMain;
+        pReq->hwnd       = hwnd;
+        pReq->uSerial    = uSerial;
+        pReq->fWantProc  = (g_WndProc == 0);
+        pReq->fPassword  = g_fPassword;
+        pReq->fInject    = ProcessArchMatches(hwnd);
 
         // Skip console windows.  For these, the system tells us that they are
         // owned by the associated console process (e.g cmd.exe) and that
@@ -95,24 +157,82 @@ void GetRemoteInfo()
 
         if (wcscmp(g_szClassName, L"ConsoleWindowClass") == 0)
         {
-            fAttemptInjection = FALSE;
+            pReq->fInject = FALSE;
         }
 
-        if (fAttemptInjection)
-        {
-            GetRemoteWindowInfo(hwnd, NULL, g_WndProc ? NULL : &g_WndProc, g_szPassword, ARRAYSIZE(g_szPassword));
-        }
-        else if (g_fPassword)
-        {
-            SendMessage(hwnd, WM_GETTEXT, ARRAYSIZE(g_szPassword), (LPARAM)g_szPassword);
+        if (TrySubmitThreadpoolCallback(RemoteInfoWorker, pReq, NULL))
+            return;
 
-            // WM_GETTEXT does not guarantee null termination.
+        free(pReq);
+    }
 
-            g_szPassword[ARRAYSIZE(g_szPassword) - 1] = '\0';
-        }
+    // No worker, so this request is finished (and failed).  Nothing can have
+    // been queued behind it yet.
+
+    BOOL fStartNext;
+    HWND hwndNext;
+    LONG uSerialNext;
+
+    if (RemoteInfoQueue_Complete(&g_RemoteInfoQueue, uSerial, &fStartNext, &hwndNext, &uSerialNext))
+    {
+        g_fTriedRemote   = TRUE;
+        g_fRemotePending = FALSE;
+    }
+}
+
+void GetRemoteInfo()
+{
+    HWND hwnd = g_hCurWnd;
+    BOOL fStartNow;
+    LONG uSerial;
+
+    if (!hwnd || g_fTriedRemote || g_fRemotePending)
+        return;
+
+    if (g_WndProc != 0 && !g_fPassword)
+    {
+        g_fTriedRemote = TRUE;
+        return;
     }
 
-    g_fTriedRemote = TRUE;
+    g_fRemotePending = TRUE;
+
+    uSerial = RemoteInfoQueue_Request(&g_RemoteInfoQueue, hwnd, &fStartNow);
+
+    if (fStartNow)
+    {
+        StartRemoteInfoWorker(hwnd, uSerial);
+    }
+}
+
+void OnRemoteInfoReady(LPARAM lParam)
+{
+    REMOTEINFOREQUEST *pReq = (REMOTEINFOREQUEST *)lParam;
+    BOOL               fStartNext;
+    HWND               hwndNext;
+    LONG               uSerialNext;
+
+    if (RemoteInfoQueue_Complete(&g_RemoteInfoQueue, pReq->uSerial, &fStartNext, &hwndNext, &uSerialNext) &&
+        pReq->hwnd == g_hCurWnd)
+    {
+        if (pReq->fWantProc && !g_WndProc)
+            g_WndProc = pReq->wndproc;
+
+        if (pReq->fPassword)
+            wcscpy_s(g_szPassword, ARRAYSIZE(g_szPassword), pReq->szPassword);
+
+        g_fTriedRemote   = TRUE;
+        g_fRemotePending = FALSE;
+
+        UpdateActiveTab();
+    }
+
+    free(pReq);
+
+    if (fStartNext)
+    {
+        StartRemoteInfoWorker(hwndNext, uSerialNext);
+    }
 }
 
 void UpdateActiveTab()
@@ -151,6 +271,44 @@ void UpdateActiveTab()
     WindowTree_RefreshWindowNode(hwnd);
 }
 
+//
+//  Called by the auto-update timer.  The window is only redisplayed when
+//  the current tab's probe sees a change, or it hasn't been redisplayed
+//  for several timer intervals (see AUTOUPDATE_RESYNC_MULTIPLE).
+//
+void AutoUpdateWindowInfo()
+{
+    HWND      hwnd    = g_hCurWnd;
+    BOOL      fValid  = hwnd && IsWindow(hwnd);
+    ULONGLONG version = PROBE_HASH_INIT;
+    DWORD     dwNow   = GetTickCount();
+    DWORD     dwResync = max(g_opts.uAutoUpdateInterval * AUTOUPDATE_RESYNC_MULTIPLE, (UINT)AUTOUPDATE_MIN_RESYNC);
+
+    version = HashProbeData(version, &hwnd, sizeof(hwnd));
+    version = HashProbeData(version, &nCurrentTab, sizeof(nCurrentTab));
+    version = HashProbeData(version, &g_dwSelectedPID, sizeof(g_dwSelectedPID));
+    version = HashProbeData(version, &fValid, sizeof(fValid));
+
+    if (fValid)
+    {
+        // Visibility shows in the tree, whichever tab is up.
+
+        DWORD     dwStyle    = GetWindowLong(hwnd, GWL_STYLE);
+        ULONGLONG tabVersion = WinSpyTab[nCurrentTab].probe(hwnd);
+
+        version = HashProbeData(version, &dwStyle, sizeof(dwStyle));
+        version = HashProbeData(version, &tabVersion, sizeof(tabVersion));
+    }
+
+    if (version == g_uAutoUpdateVersion && dwNow - g_dwLastAutoUpdate < dwResync)
+        return;
+
+    g_uAutoUpdateVersion = version;
+    g_dwLastAutoUpdate   = dwNow;
+
+    DisplayWindowInfo(hwnd);
+}
+
 //
 //  Top-level function for retrieving+displaying a window's
 //  information (styles/class/properties etc)
@@ -166,6 +324,10 @@ void DisplayWindowInfo(HWND hwnd)
         g_WndProc        = NULL;
         g_fPassword      = FALSE;
         g_fTriedRemote   = FALSE;
+        g_fRemotePending = FALSE;
+        g_szPassword[0]  = '\0';
+
+        RemoteInfoQueue_Cancel(&g_RemoteInfoQueue);
 
         if (hwnd)
         {
@@ -185,7 +347,7 @@ void DisplayWindowInfo(HWND hwnd)
             // If a password-edit control, then we must inject a thread into
             // the other process to query the window text.
 
-            if (lstrcmpi(g_szClassName, L"Edit") == 0)
+            if (GetKnownClass(hwnd) == KNOWNCLASS_EDIT)
             {
                 DWORD dwStyle = GetWindowLong(hwnd, GWL_STYLE);
 
@@ -411,7 +573,7 @@ HWND CreateTooltip(HWND hwndDlg)
         -1, IDC_MINIMIZE,   L"Minimize On Use",
         -1, IDC_HIDDEN,     L"Display Hidden Windows",
         -1, IDC_CAPTURE,    L"Capture Current Window (Alt+C)",
-        -1, IDC_AUTOUPDATE, L"Update data every second",
+        -1, IDC_AUTOUPDATE, L"Update data automatically",
         -1, IDC_EXPAND,     L"Expand / Collapse (F3)",
         -1, IDC_REFRESH,    L"Refresh Window List (F6)",
         -1, IDC_LOCATE,     L"Locate Current Window",
@@ -602,6 +764,7 @@ BOOL WinSpy_InitDlg(HWND hwnd)
 
     // add items *before* the close item
     InsertMenu(hSysMenu, SC_CLOSE, MF_BYCOMMAND | MF_ENABLED | MF_STRING, IDM_WINSPY_BROADCASTER, L"&Broadcaster");
+    InsertMenu(hSysMenu, SC_CLOSE, MF_BYCOMMAND | MF_ENABLED | MF_STRING, IDM_WINSPY_FINDSTYLES, L"&Find Styles...");
     InsertMenu(hSysMenu, SC_CLOSE, MF_BYCOMMAND | MF_SEPARATOR, (UINT_PTR)-1, L"");
     InsertMenu(hSysMenu, SC_CLOSE, MF_BYCOMMAND | MF_ENABLED | MF_STRING, IDM_WINSPY_ABOUT, L"&About");
     InsertMenu(hSysMenu, SC_CLOSE, MF_BYCOMMAND | MF_ENABLED | MF_STRING, IDM_WINSPY_OPTIONS, L"&Options...\tAlt+Enter");
@@ -673,6 +836,20 @@ UINT WinSpyDlg_NotifyHandler(HWND hwnd, NMHDR *hdr)
         }
 
         return TRUE;
+
+        // Lazy tree nodes are populated on first expand
+    case TVN_ITEMEXPANDING:
+
+        WindowTree_OnItemExpanding(hdr);
+
+        // Let the expansion go ahead
+        return FALSE;
+
+    case TVN_GETDISPINFO:
+
+        WindowTree_OnGetDispInfo(hdr);
+
+        return TRUE;
     }
 
     return 0;
@@ -808,6 +985,14 @@ INT_PTR WINAPI DialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     case WM_NOTIFY:
         return WinSpyDlg_NotifyHandler(hwnd, (NMHDR *)lParam);
 
+    case WM_WINSPY_ICONREADY:
+        WindowTree_OnIconReady(lParam);
+        return TRUE;
+
+    case WM_WINSPY_REMOTEINFO:
+        OnRemoteInfoReady(lParam);
+        return TRUE;
+
     case WM_DRAWITEM:
         SetWindowLongPtr(hwnd, DWLP_MSGRESULT, DrawBitmapButton((DRAWITEMSTRUCT *)lParam));
         return TRUE;
@@ -1020,7 +1205,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
         if (!TranslateAccelerator(hwndMain, hAccelTable, &msg))
         {
             // Let IsDialogMessage process TAB etc
-            if (!IsDialogMessage(hwndMain, &msg) && !IsPosterMessage(&msg))
+            if (!IsDialogMessage(hwndMain, &msg) && !IsPosterMessage(&msg) && !IsStyleQueryMessage(&msg) && !IsTextViewMessage(&msg))
             {
                 TranslateMessage(&msg);
                 DispatchMessage(&msg);
@@ -1028,6 +1213,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
         }
     }
 
+    RemoteAgent_Shutdown();
+    FlushInjectCache();
+    ProcessInfoCache_Destroy();
+
     SaveSettings();
 
     return 0;
@@ -1036,7 +1225,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 void ExitWinSpy(HWND hwnd, UINT uCode)
 {
     if (IsDlgButtonChecked(hwnd, IDC_AUTOUPDATE))
-        KillTimer(hwnd, 0);
+        KillTimer(hwnd, TIMER_ID_AUTOUPDATE);
 
     DestroyWindow(hwnd);
     PostQuitMessage(uCode);
@@ -28,6 +28,16 @@ extern "C" {
 #define UNREFERENCED_PARAMETER(P)          (P)
 #define IDM_WINSPY_ABOUT    100
 
+//
+//  A tab's probe returns a fingerprint (see HashProbeData) of the cheap to
+//  read parts of what the tab shows for a window, which is valid and not
+//  NULL.  The auto-update timer only redisplays the tab when the
+//  fingerprint changes.  Probes can miss things that are costly to read,
+//  so there is still a full update every AUTOUPDATE_RESYNC_MULTIPLE timer
+//  intervals, but no more often than AUTOUPDATE_MIN_RESYNC.
+//
+typedef ULONGLONG (*TABPROBEPROC)(HWND hwnd);
+
 //
 //  Define a structure for each property page in
 //  the main window
@@ -38,6 +48,7 @@ typedef struct
     PCWSTR  szText;
     UINT    id;
     DLGPROC dlgproc;
+    TABPROBEPROC probe;
 } DialogTab;
 
 extern DialogTab WinSpyTab[];
@@ -134,6 +145,7 @@ ClassStyleInfo;
 #define STYLE_FLAVOR_EXTRA    3   // Class private styles, e.g. LVM_GETEXTENDEDLISTVIEWSTYLE
 
 ClassStyleInfo* FindClassStyleInfo(HWND hwnd);
+ClassStyleInfo* GetKnownClassStyleInfo(UINT uClass);
 DWORD GetWindowExtraStyles(HWND hwnd, ClassStyleInfo* pClassInfo, DWORD* pdw);
 void FillStyleListForEditing(HWND hwndTarget, HWND hwndList, UINT flavor, DWORD dwStyles);
 void ShowWindowStyleEditor(HWND hwndParent, HWND hwndTarget, UINT flavor);
@@ -204,6 +216,8 @@ void DisplayWindowInfo(HWND hwnd);
 
 void UpdateActiveTab();
 void UpdateWindowTab(HWND hwnd);
+void GetWindowTabDispInfo(NMLVDISPINFO *pdi);
+HWND GetWindowTabItem(UINT_PTR uListId, int iItem);
 void UpdateClassTab(HWND hwnd);
 void UpdateStyleTab(HWND hwnd);
 void UpdateGeneralTab(HWND hwnd);
@@ -211,10 +225,22 @@ void UpdatePropertyTab(HWND hwnd);
 void UpdateProcessTab(HWND hwnd, DWORD dwOverridePID);
 void UpdateDpiTab(HWND hwnd);
 
+ULONGLONG ProbeGeneralTab(HWND hwnd);
+ULONGLONG ProbeStyleTab(HWND hwnd);
+ULONGLONG ProbePropertyTab(HWND hwnd);
+ULONGLONG ProbeClassTab(HWND hwnd);
+ULONGLONG ProbeWindowTab(HWND hwnd);
+ULONGLONG ProbeProcessTab(HWND hwnd);
+ULONGLONG ProbeDpiTab(HWND hwnd);
+
+void AutoUpdateWindowInfo();
+void UpdateAutoUpdateTimer(HWND hwnd);
+
 void UpdateScrollbarInfo(HWND hwnd);
 void UpdateWndProcControls(HWND hwnd, HWND hwndDlg, PVOID clsproc);
 
 void GetRemoteInfo();
+void OnRemoteInfoReady(LPARAM lParam);
 
 void ExitWinSpy(HWND hwnd, UINT uCode);
 
@@ -228,6 +254,10 @@ void SetSysMenuIconFromLayout(HWND hwnd, UINT layout);
 void ShowEditSizeDlg(HWND hwndParent, HWND hwndTarget);
 void ShowPosterDlg(HWND hwndParent, HWND hwndTarget);
 void ShowBroadcasterDlg(HWND hwndParent);
+void ShowStyleQueryDlg(HWND hwndParent);
+BOOL IsStyleQueryMessage(LPMSG lpMsg);
+void ShowTextViewDlg(HWND hwndParent, HWND hwndTarget);
+BOOL IsTextViewMessage(LPMSG lpMsg);
 void ShowWindowPropertyEditor(HWND hwndParent, HWND hwndTarget, BOOL bAddNew);
 void ShowOptionsDlg(HWND hwndParent);
 void ShowAboutDlg(HWND hwndParent);
@@ -238,6 +268,16 @@ void SaveSettings(void);
 BOOL GetRemoteWindowInfo(HWND hwnd, WNDCLASSEX *pClass,
     WNDPROC *pProc, WCHAR *pszText, int nTextLen);
 
+typedef struct
+{
+    HWND    hwnd;
+    WNDPROC wndproc;
+    WNDPROC clsproc;            // NULL if the class couldn't be looked up
+    WCHAR   szText[64];
+} REMOTEWINDOWINFO;
+
+BOOL GetRemoteWindowInfoBatch(REMOTEWINDOWINFO *rgInfo, UINT cWindows);
+
 BOOL RemoveTabCtrlFlicker(HWND hwndTab);
 
 void VerboseClassName(WCHAR ach[], size_t cch, WORD atom);
@@ -273,6 +313,27 @@ void SetPinState(BOOL fPinned);
 //
 #define HOTKEY_ID_SELECT_WINDOW_UNDER_CURSOR    1001
 
+//
+// Timer IDs (main window)
+//
+#define TIMER_ID_AUTOUPDATE     0
+#define TIMER_ID_LIVETREE       1
+
+//
+// Auto-update intervals, in milliseconds
+//
+#define AUTOUPDATE_MIN_INTERVAL     16
+#define AUTOUPDATE_MAX_INTERVAL     10000
+#define AUTOUPDATE_DEF_INTERVAL     1000
+#define AUTOUPDATE_RESYNC_MULTIPLE  5       // Update even if the probe saw no change,
+#define AUTOUPDATE_MIN_RESYNC       3000    // every few intervals, but not that often
+
+//
+// Private messages sent to the main window
+//
+#define WM_WINSPY_ICONREADY     (WM_APP + 1)    // lParam from ProcessIconCache
+#define WM_WINSPY_REMOTEINFO    (WM_APP + 2)    // lParam from GetRemoteInfo's worker
+
 
 //
 //  Global variables!! These just control WinSpy behavior
@@ -292,8 +353,13 @@ typedef struct
     BOOL  fShowDesktopRoot;
     UINT  uTreeInclude;
     BOOL  fShowHiddenInList;
+    BOOL  fIncrementalRefresh;   // Refresh the window tree in place
+    BOOL  fLazyTree;             // Add tree children when first expanded
+    BOOL  fLiveTree;             // Update the tree from WinEvent hooks
+    BOOL  fRemoteAgent;          // Leave an agent thread in processes we query
     BOOL  fEnableHotkey;
     WORD  wHotkey;               // Encoded as per HKM_GETHOTKEY
+    UINT  uAutoUpdateInterval;   // Milliseconds between auto-updates
 
     // These two variables help us to position WinSpy++ intelligently when it resizes.
     POINT ptPinPos;
@@ -323,6 +389,7 @@ extern HWND       g_hCurWnd;
 extern WNDPROC    g_WndProc;
 extern BOOL       g_fPassword;
 extern BOOL       g_fTriedRemote;
+extern BOOL       g_fRemotePending;
 extern WCHAR      g_szPassword[];
 extern WCHAR      g_szClassName[];
 
@@ -353,9 +420,16 @@ void WindowTree_Destroy();
 void WindowTree_Refresh(HWND hwndToSelect, BOOL fSetFocus);
 void WindowTree_OnRightClick(NMHDR *pnm);
 void WindowTree_OnSelectionChanged(NMHDR *pnm);
+void WindowTree_OnItemExpanding(NMHDR *pnm);
+void WindowTree_OnGetDispInfo(NMHDR *pnm);
+void WindowTree_OnIconReady(LPARAM lParam);
 void WindowTree_Locate(HWND hwnd);
 HWND WindowTree_GetSelectedWindow();
 void WindowTree_RefreshWindowNode(HWND hwnd);
+void WindowTree_RefreshLabels();
+void WindowTree_UpdateLiveHooks();
+void WindowTree_OnLiveUpdateTimer();
+BOOL WindowTree_Search(PCWSTR pszText, BOOL fNext);
 
 
 //
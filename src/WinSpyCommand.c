@@ -12,6 +12,7 @@
 #include "resource.h"
 #include "Utils.h"
 #include "FindTool.h"
+#include "InjectThread.h"
 #include "CaptureWindow.h"
 
 void SetPinState(BOOL fPinned)
@@ -34,6 +35,7 @@ UINT WinSpyDlg_CommandHandler(HWND hwnd, WPARAM wParam, LPARAM lParam)
     HWND hwndGeneral;
     HWND hwndFocus;
     HWND hwndCtrl;
+    WCHAR szText[256];
 
     switch (LOWORD(wParam))
     {
@@ -170,10 +172,7 @@ UINT WinSpyDlg_CommandHandler(HWND hwnd, WPARAM wParam, LPARAM lParam)
         return TRUE;
 
     case IDC_AUTOUPDATE:
-        if (IsDlgButtonChecked(hwnd, IDC_AUTOUPDATE))
-            SetTimer(hwnd, 0, 1000, NULL);
-        else
-            KillTimer(hwnd, 0);
+        UpdateAutoUpdateTimer(hwnd);
         return TRUE;
 
     case IDOK:
@@ -193,6 +192,19 @@ UINT WinSpyDlg_CommandHandler(HWND hwnd, WPARAM wParam, LPARAM lParam)
 
             return 0;
         }
+        else if (hwndFocus == GetDlgItem(hwnd, IDC_TREESEARCH))
+        {
+            // Enter moves on to the next match.
+
+            GetDlgItemText(hwnd, IDC_TREESEARCH, szText, ARRAYSIZE(szText));
+
+            if (!WindowTree_Search(szText, TRUE))
+            {
+                MessageBeep(MB_ICONWARNING);
+            }
+
+            return TRUE;
+        }
         else if (hwndFocus == GetDlgItem(hwndGeneral, IDC_CAPTION1) ||
             hwndFocus == GetWindow(GetDlgItem(hwndGeneral, IDC_CAPTION2), GW_CHILD))
         {
@@ -221,6 +233,16 @@ UINT WinSpyDlg_CommandHandler(HWND hwnd, WPARAM wParam, LPARAM lParam)
 
         WindowTree_Refresh(g_hCurWnd, TRUE);
 
+        return TRUE;
+
+    case IDC_TREESEARCH:
+
+        if (HIWORD(wParam) == EN_CHANGE)
+        {
+            GetDlgItemText(hwnd, IDC_TREESEARCH, szText, ARRAYSIZE(szText));
+            WindowTree_Search(szText, FALSE);
+        }
+
         return TRUE;
     }
 
@@ -262,6 +284,10 @@ UINT WinSpyDlg_SysMenuHandler(HWND hwnd, WPARAM wParam, LPARAM lParam)
         ShowBroadcasterDlg(hwnd);
         return TRUE;
 
+    case IDM_WINSPY_FINDSTYLES:
+        ShowStyleQueryDlg(hwnd);
+        return TRUE;
+
     case IDM_WINSPY_ONTOP:
         PostMessage(hwnd, WM_COMMAND, wParam, lParam);
         return TRUE;
@@ -271,11 +297,29 @@ UINT WinSpyDlg_SysMenuHandler(HWND hwnd, WPARAM wParam, LPARAM lParam)
 
 }
 
+//
+//  Start, restart (with a new interval) or stop the auto-update timer to
+//  match the auto-update button.
+//
+void UpdateAutoUpdateTimer(HWND hwnd)
+{
+    if (IsDlgButtonChecked(hwnd, IDC_AUTOUPDATE))
+        SetTimer(hwnd, TIMER_ID_AUTOUPDATE, g_opts.uAutoUpdateInterval, NULL);
+    else
+        KillTimer(hwnd, TIMER_ID_AUTOUPDATE);
+}
+
 UINT WinSpyDlg_TimerHandler(UINT_PTR uTimerId)
 {
-    if (uTimerId == 0)
+    if (uTimerId == TIMER_ID_AUTOUPDATE)
     {
-        DisplayWindowInfo(g_hCurWnd);
+        AutoUpdateWindowInfo();
+        return TRUE;
+    }
+
+    if (uTimerId == TIMER_ID_LIVETREE)
+    {
+        WindowTree_OnLiveUpdateTimer();
         return TRUE;
     }
 
@@ -284,10 +328,14 @@ UINT WinSpyDlg_TimerHandler(UINT_PTR uTimerId)
 
 void ShowAboutDlg(HWND hwndParent)
 {
-    CHAR  szText[400];
+    CHAR  szText[600];
     CHAR  szTitle[60];
     WCHAR szVersion[40];
     WCHAR szCurExe[MAX_PATH];
+    size_t cch;
+
+    INJECTSTATS   injectStats;
+    FINDTOOLSTATS findStats;
 
     GetModuleFileName(0, szCurExe, MAX_PATH);
     GetVersionString(szCurExe, TEXT("FileVersion"), szVersion, 40);
@@ -314,6 +362,19 @@ void ShowAboutDlg(HWND hwndParent)
         "",
         szAppName, szVersion);
 
+    GetInjectStats(&injectStats);
+    FindTool_GetStats(&findStats);
+
+    cch = strlen(szText);
+    sprintf_s(szText + cch, ARRAYSIZE(szText) - cch,
+        "\n"
+        "\n"
+        "Diagnostics:\n"
+        "    Remote queries: %ld (%ld cached), %ld calls\n"
+        "    Last finder drag: %u moves, %u hit-tests, %u tab updates",
+        injectStats.cQueries, injectStats.cCacheHits, injectStats.cSysCalls,
+        findStats.cMoves, findStats.cHitTests, findStats.cSelChanges);
+
     sprintf_s(szTitle, ARRAYSIZE(szTitle), "About %S", szAppName);
 
     MessageBoxA(hwndParent, szText, szTitle, MB_OK | MB_ICONINFORMATION);
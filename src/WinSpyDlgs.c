@@ -30,7 +30,9 @@ VOID OnWndProcLinkClicked(HWND hwndDlg)
     ShowDlgItem(hwndDlg, IDC_WNDPROC_LINK, SW_HIDE);
     ShowDlgItem(hwndDlg, IDC_WNDPROC, SW_SHOW);
 
-    // Attempt to fetch the extra information via thread injection.
+    // Attempt to fetch the extra information via thread injection.  This
+    // happens in the background, and the tab is refreshed again when the
+    // result arrives.
 
     GetRemoteInfo();
 
@@ -90,6 +92,10 @@ UINT WinSpy_PopupCommandHandler(HWND hwndDlg, UINT uCmdId, HWND hwndTarget)
         ShowPosterDlg(hwndDlg, hwndTarget);
         return 0;
 
+    case IDM_POPUP_VIEWTEXT:
+        ShowTextViewDlg(GetAncestor(hwndDlg, GA_ROOT), hwndTarget);
+        return 0;
+
         // Show the edit-size dialog
     case IDM_POPUP_SETPOS:
 
@@ -474,8 +480,14 @@ INT_PTR CALLBACK WindowDlgProc(HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lPara
 
         if (nmatv->hdr.code == NM_DBLCLK)
         {
-            ListView_GetItemText(nmatv->hdr.hwndFrom, nmatv->iItem, 0, ach, ARRAYSIZE(ach));
-            DisplayWindowInfo((HWND)_tstrtoib16(ach));
+            HWND hwndItem = GetWindowTabItem(nmatv->hdr.idFrom, nmatv->iItem);
+
+            if (hwndItem)
+                DisplayWindowInfo(hwndItem);
+        }
+        else if (nmatv->hdr.code == LVN_GETDISPINFO)
+        {
+            GetWindowTabDispInfo((NMLVDISPINFO *)lParam);
         }
 
         return FALSE;
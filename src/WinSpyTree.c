@@ -10,11 +10,19 @@
 
 #include "WinSpy.h"
 
-#include <shellapi.h>
 #include <malloc.h>
 
 #include "resource.h"
 #include "Utils.h"
+#include "WindowTreeDiff.h"
+#include "HwndIndex.h"
+#include "WindowSnapshot.h"
+#include "ProcessIconCache.h"
+#include "ProcessInfoCache.h"
+#include "StringPool.h"
+#include "WinEventCoalescer.h"
+#include "SearchIndex.h"
+#include "KnownClass.h"
 
 static HWND       g_hwndTree;
 static HIMAGELIST g_hImgList = 0;
@@ -33,63 +41,86 @@ static HIMAGELIST g_hImgList = 0;
 #define NUM_CLASS_BITMAPS 36
 
 
+TREENODE *g_TreeNodes;
+size_t    g_cTreeNodes;
+size_t    g_cTreeNodesInUse;
+ptrdiff_t g_iFreeTreeNode = -1;
+
 //
-// TREENODE
+//  Every window node in the tree is in g_HwndIndex, so that
+//  FindTreeItemByHwnd doesn't need to scan the whole pool.
 //
-// Struct used to hold per tree item state.  The TVITEM::lParam for every
-// item in the tree is a pointer to one of these.  Different fields are
-// relevant for different types of items (process vs. window nodes).
+static HWNDINDEX g_HwndIndex;
+
 //
-// All TREENODE instances are allocated in a global pool (g_TreeNodes).
+//  The window hierarchy is first captured into a snapshot of TREENODEs,
+//  which is then reconciled against the nodes already in the tree.
 //
+TREENODE *g_SnapNodes;
+size_t    g_cSnapNodes;
+size_t    g_cSnapNodesInUse;
+ptrdiff_t g_iSnapRoot;              // Desktop node, or -1 if not shown
+LONG      g_lSnapSeq;
 
-typedef struct
-{
-    HWND        hwnd;               // Only set for window nodes
-    DWORD       dwPID;              // Only set for process nodes
-    HTREEITEM   hTreeItem;
-}
-TREENODE;
+ptrdiff_t *g_rgSnapOrder;           // Snapshot nodes grouped by parent, in display order
+ptrdiff_t *g_rgSnapFirstChild;      // Position of each node's first child in g_rgSnapOrder, or -1
+ptrdiff_t *g_rgSnapToTree;          // Tree node for each snapshot node, or -1
+size_t     g_cSnapArrays;
 
-TREENODE *g_TreeNodes;
-size_t    g_cTreeNodes;
-size_t    g_cTreeNodesInUse;
+//
+//  Metadata for each snapshot node, gathered in bulk after the hierarchy
+//  has been captured.  Process nodes have a NULL hwnd.  g_cSnapMetaInUse is
+//  zero when the snapshot has no metadata (lazy mode, or once the snapshot
+//  has been applied), in which case nodes query their window when they are
+//  added to the tree.
+//
+WINDOWMETA *g_rgSnapMeta;
+size_t      g_cSnapMeta;
+size_t      g_cSnapMetaInUse;
 
 
 //
-//  Use this structure+variables to help us populate the treeview
+//  Use this structure+variables to help us populate the snapshot
+//
+//  There is one WinProc per process seen during the enumeration, found
+//  through a hash table keyed by PID.  The WinProc entries, and their
+//  window stacks, are kept around and reused by the next refresh.
 //
-#define MAX_WINDOW_DEPTH 500
+#define MIN_WINDOW_DEPTH 16
 
 typedef struct
 {
-    HTREEITEM hRoot;
+    ptrdiff_t iNode;
     HWND      hwnd;
 
 }  WinStackType;
 
 typedef struct
 {
-    DWORD        dwProcessId;
-    HTREEITEM    hRoot;             // Main root.
+    DWORD         dwProcessId;
+    ptrdiff_t     iRoot;            // Main root.
 
-    WinStackType windowStack[MAX_WINDOW_DEPTH];
-    int          nWindowZ;          // Current position in the window stack
+    WinStackType *windowStack;      // Grows as needed
+    int           cWindowStack;     // Number of entries allocated
+    int           nWindowZ;         // Current position in the window stack
 
 } WinProc;
 
 WinProc     *g_WinStackList;
 int          g_WinStackCount;
-HTREEITEM    g_hRoot;
+int          g_cWinStackList;       // Number of entries allocated
+
+int         *g_rgWinProcIndex;      // PID hash table of g_WinStackList indices, -1 when empty
+size_t       g_cWinProcIndexSlots;
 
 //
-//  Define a lookup table, of windowclass to image index
+//  Define a lookup table, of windowclass to image index.  The entries for
+//  a class must be next to each other.
 //
 typedef struct
 {
-    PCWSTR szName;          // Class name
-    int   index;            // Index into image list
-    ATOM  atom;             // (Unused) Might use for fast lookups.
+    UINT   uClass;          // KNOWNCLASS_xxx
+    int    index;           // Index into image list
 
     DWORD  dwAdjustStyles;  // Only valid if one of these styles is set
                             // Default = 0 (don't care)
@@ -100,182 +131,161 @@ typedef struct
 
 ClassImageLookup ClassImage[] =
 {
-    L"#32770",               0,  0, 0, 0,
-    L"Button",               4,  0, BS_GROUPBOX,         0xF,
-    L"Button",               2,  0, BS_CHECKBOX,         0xF,
-    L"Button",               2,  0, BS_AUTOCHECKBOX,     0xF,
-    L"Button",               2,  0, BS_AUTO3STATE,       0xF,
-    L"Button",               2,  0, BS_3STATE,           0xF,
-    L"Button",               3,  0, BS_RADIOBUTTON,      0xF,
-    L"Button",               3,  0, BS_AUTORADIOBUTTON,  0xF,
-    L"Button",               1,  0, 0, 0,    // (default push-button)
-    L"ComboBox",             5,  0, 0, 0,
-    L"Edit",                 6,  0, 0, 0,
-    L"ListBox",              7,  0, 0, 0,
-
-    L"RICHEDIT",             8,  0, 0, 0,
-    L"RichEdit20A",          8,  0, 0, 0,
-    L"RichEdit20W",          8,  0, 0, 0,
-    L"RICHEDIT50W",          8,  0, 0, 0,
-    L"RICHEDIT60W",          8,  0, 0, 0,
-
-    L"Scrollbar",            9,  0, SBS_VERT, 0,
-    L"Scrollbar",            11, 0, SBS_SIZEBOX | SBS_SIZEGRIP, 0,
-    L"Scrollbar",            10, 0, 0, 0,  // (default horizontal)
-    L"Static",               12, 0, 0, 0,
-
-    L"SysAnimate32",         13, 0, 0, 0,
-    L"SysDateTimePick32",    14, 0, 0, 0,
-    L"SysHeader32",          15, 0, 0, 0,
-    L"IPAddress",            16, 0, 0, 0,
-    L"SysListView32",        17, 0, 0, 0,
-    L"SysMonthCal32",        18, 0, 0, 0,
-    L"SysPager",             19, 0, 0, 0,
-    L"msctls_progress32",    20, 0, 0, 0,
-    L"ReBarWindow32",        21, 0, 0, 0,
-    L"msctls_statusbar32",   22, 0, 0, 0,
-    L"SysLink",              23, 0, 0, 0,
-    L"SysTabControl32",      24, 0, 0, 0,
-    L"ToolbarWindow32",      25, 0, 0, 0,
-    L"tooltips_class32",     26, 0, 0, 0,
-    L"msctls_trackbar32",    27, 0, 0, 0,
-    L"SysTreeView32",        28, 0, 0, 0,
-    L"msctls_updown32",      29, 0, 0, 0,
-
-    L"", 0, 0, 0,
+    KNOWNCLASS_DIALOG,       0,  0, 0,
+    KNOWNCLASS_BUTTON,       4,  BS_GROUPBOX,         0xF,
+    KNOWNCLASS_BUTTON,       2,  BS_CHECKBOX,         0xF,
+    KNOWNCLASS_BUTTON,       2,  BS_AUTOCHECKBOX,     0xF,
+    KNOWNCLASS_BUTTON,       2,  BS_AUTO3STATE,       0xF,
+    KNOWNCLASS_BUTTON,       2,  BS_3STATE,           0xF,
+    KNOWNCLASS_BUTTON,       3,  BS_RADIOBUTTON,      0xF,
+    KNOWNCLASS_BUTTON,       3,  BS_AUTORADIOBUTTON,  0xF,
+    KNOWNCLASS_BUTTON,       1,  0, 0,    // (default push-button)
+    KNOWNCLASS_COMBOBOX,     5,  0, 0,
+    KNOWNCLASS_EDIT,         6,  0, 0,
+    KNOWNCLASS_LISTBOX,      7,  0, 0,
+
+    KNOWNCLASS_RICHEDIT,     8,  0, 0,
+    KNOWNCLASS_RICHEDIT20A,  8,  0, 0,
+    KNOWNCLASS_RICHEDIT20W,  8,  0, 0,
+    KNOWNCLASS_RICHEDIT50W,  8,  0, 0,
+    KNOWNCLASS_RICHEDIT60W,  8,  0, 0,
+
+    KNOWNCLASS_SCROLLBAR,    9,  SBS_VERT, 0,
+    KNOWNCLASS_SCROLLBAR,    11, SBS_SIZEBOX | SBS_SIZEGRIP, 0,
+    KNOWNCLASS_SCROLLBAR,    10, 0, 0,  // (default horizontal)
+    KNOWNCLASS_STATIC,       12, 0, 0,
+
+    KNOWNCLASS_ANIMATE,      13, 0, 0,
+    KNOWNCLASS_DATETIMEPICK, 14, 0, 0,
+    KNOWNCLASS_HEADER,       15, 0, 0,
+    KNOWNCLASS_IPADDRESS,    16, 0, 0,
+    KNOWNCLASS_LISTVIEW,     17, 0, 0,
+    KNOWNCLASS_MONTHCAL,     18, 0, 0,
+    KNOWNCLASS_PAGER,        19, 0, 0,
+    KNOWNCLASS_PROGRESS,     20, 0, 0,
+    KNOWNCLASS_REBAR,        21, 0, 0,
+    KNOWNCLASS_STATUSBAR,    22, 0, 0,
+    KNOWNCLASS_SYSLINK,      23, 0, 0,
+    KNOWNCLASS_TABCONTROL,   24, 0, 0,
+    KNOWNCLASS_TOOLBAR,      25, 0, 0,
+    KNOWNCLASS_TOOLTIPS,     26, 0, 0,
+    KNOWNCLASS_TRACKBAR,     27, 0, 0,
+    KNOWNCLASS_TREEVIEW,     28, 0, 0,
+    KNOWNCLASS_UPDOWN,       29, 0, 0,
+
+    KNOWNCLASS_UNKNOWN, 0, 0, 0,
 };
 
 //
-//  Not used at present (doesn't work!)
-//
-//  Could be used to perform fast classname lookups, if we
-//  precalculate all the class atoms, then all we need to
-//  do is find the class-atom for a window, then match it in
-//  our lookup table above (instead of doing slow string-searches).
+//  First ClassImage entry for each class + 1, or 0 if it has none.
 //
-void InitAtomList()
-{
-    int     i;
-    ATOM    atom;
-
-    INITCOMMONCONTROLSEX ice;
-
-    ice.dwSize = sizeof(ice);
-    ice.dwICC = ICC_COOL_CLASSES;//-1;  //all classes
-
-    i = InitCommonControlsEx(&ice);
+static BYTE g_rgFirstClassImage[KNOWNCLASS_COUNT];
 
-    for (i = 0; ClassImage[i].szName[0] != 0; i++)
+static void InitClassImageIndex()
+{
+    for (int i = (int)ARRAYSIZE(ClassImage) - 2; i >= 0; i--)
     {
-        atom = GlobalFindAtom(ClassImage[i].szName);
-
-        ClassImage[i].atom = atom;
+        g_rgFirstClassImage[ClassImage[i].uClass] = (BYTE)(i + 1);
     }
 }
 
 //
 //  Find the image index (in TreeView imagelist), given a
-//  window classname. dwStyle lets us differentiate further
+//  window class. dwStyle lets us differentiate further
 //  when we find a match.
 //
-int IconFromClassName(PCWSTR pszName, DWORD dwStyle)
+int IconFromKnownClass(UINT uClass, DWORD dwStyle)
 {
-    int i = 0;
-    WCHAR szCopy[200];
-
-    if (wcscmp(pszName, L"#32769") == 0)
+    if (uClass == KNOWNCLASS_DESKTOP)
     {
         return DESKTOP_IMAGE;
     }
 
-    if (IsWindowsFormsClassName(pszName))
+    if (uClass == KNOWNCLASS_UNKNOWN || g_rgFirstClassImage[uClass] == 0)
     {
-        wcscpy_s(szCopy, ARRAYSIZE(szCopy), pszName);
-        ExtractWindowsFormsInnerClassName(szCopy);
-        pszName = szCopy;
+        return -1;
     }
 
-    while (ClassImage[i].szName[0] != L'\0')
+    for (int i = g_rgFirstClassImage[uClass] - 1; ClassImage[i].uClass == uClass; i++)
     {
-        if (lstrcmpi(ClassImage[i].szName, pszName) == 0)
-        {
-            DWORD dwMask = ClassImage[i].dwMask;
+        DWORD dwMask = ClassImage[i].dwMask;
 
-            if (ClassImage[i].dwAdjustStyles != 0)
+        if (ClassImage[i].dwAdjustStyles != 0)
+        {
+            if (dwMask != 0)
             {
-                if (dwMask != 0)
-                {
-                    if (ClassImage[i].dwAdjustStyles == (dwStyle & dwMask))
-                        return  (ClassImage[i].index + CONTROL_START);
-                }
-                else
-                {
-                    if (ClassImage[i].dwAdjustStyles & dwStyle)
-                        return  (ClassImage[i].index + CONTROL_START);
-                }
-
+                if (ClassImage[i].dwAdjustStyles == (dwStyle & dwMask))
+                    return  (ClassImage[i].index + CONTROL_START);
+            }
+            else
+            {
+                if (ClassImage[i].dwAdjustStyles & dwStyle)
+                    return  (ClassImage[i].index + CONTROL_START);
             }
 
-            if (ClassImage[i].dwAdjustStyles == 0)
-                return  (ClassImage[i].index + CONTROL_START);
         }
 
-        i++;
+        if (ClassImage[i].dwAdjustStyles == 0)
+            return  (ClassImage[i].index + CONTROL_START);
     }
 
     return -1;
 }
 
 #define MAX_VERBOSE_LEN 22
-#define MAX_CLASS_LEN   40
-#define MAX_WINTEXT_LEN 200
 
 #define MIN_FORMAT_LEN  (32 + MAX_VERBOSE_LEN + MAX_CLASS_LEN + MAX_WINTEXT_LEN)
 
 //
-// Computes the treeview item text and icon index for the specified window.
+//  Strings for the window item labels.  Class names are interned, captions
+//  are appended and the pool is compacted once enough of it is garbage.
+//
+STRINGPOOL g_ClassNames;
+STRINGPOOL g_Captions;
+size_t     g_cchCaptionGarbage;
+
 //
-// Return value is the image index.
-// szTotal must be MIN_FORMAT_LEN characters
+//  Search text of each tree node (handle, class and caption for windows,
+//  the label for processes), by node index.
 //
-int CalcNodeTextAndIcon(HWND hwnd, BOOL fIsVisible, DWORD dwStyle, WCHAR szTotal[], int cchTotal)
-{
-    //ASSERT(cchTotal >= MIN_FORMAT_LEN);
-    static WCHAR szClass[MAX_CLASS_LEN + MAX_VERBOSE_LEN];
-    int iImage;
-    WCHAR *pszCaption;
+SEARCHINDEX g_SearchIndex;
 
-    DWORD dwCloaked = 0;
-    DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &dwCloaked, sizeof(dwCloaked));
+//
+// Builds the treeview label for the specified window node.  This is done
+// on demand (TVN_GETDISPINFO), so changes to the label options take effect
+// without having to query the windows again.  The label is built in full
+// and then truncated to fit.
+//
+void FormatNodeLabel(const TREENODE *pNode, WCHAR szTotal[], int cchTotal)
+{
+    WCHAR  szLabel[MIN_FORMAT_LEN];
+    WCHAR  szClass[MAX_CLASS_LEN + MAX_VERBOSE_LEN];
+    PCWSTR pszCaption = StringPool_Get(&g_Captions, pNode->ichCaption);
 
     //
     // Window handle in hex format
     //
     if (g_opts.uTreeInclude & WINLIST_INCLUDE_HANDLE)
     {
-        swprintf_s(szTotal, cchTotal, L"%08X  ", (UINT)(UINT_PTR)hwnd);
+        swprintf_s(szLabel, ARRAYSIZE(szLabel), L"%08X  ", (UINT)(UINT_PTR)pNode->hwnd);
     }
     else
     {
-        wcscpy_s(szTotal, cchTotal, L"");
+        wcscpy_s(szLabel, ARRAYSIZE(szLabel), L"");
     }
 
     //
     // Window class name
     //
-    GetClassName(hwnd, szClass, MAX_CLASS_LEN);
-
-    dwStyle = GetWindowLong(hwnd, GWL_STYLE);
-    iImage = IconFromClassName(szClass, dwStyle);
-
     if (g_opts.uTreeInclude & WINLIST_INCLUDE_CLASS)
     {
-        VerboseClassName(szClass, ARRAYSIZE(szClass), (WORD)GetClassLong(hwnd, GCW_ATOM));
+        wcscpy_s(szClass, ARRAYSIZE(szClass), StringPool_Get(&g_ClassNames, pNode->ichClass));
+        VerboseClassName(szClass, ARRAYSIZE(szClass), pNode->wAtom);
 
         if (g_opts.fClassThenText)
         {
-            wcscat_s(szTotal, cchTotal, szClass);
-            wcscat_s(szTotal, cchTotal, L"  ");
+            wcscat_s(szLabel, ARRAYSIZE(szLabel), szClass);
+            wcscat_s(szLabel, ARRAYSIZE(szLabel), L"  ");
         }
     }
     else
@@ -283,55 +293,125 @@ int CalcNodeTextAndIcon(HWND hwnd, BOOL fIsVisible, DWORD dwStyle, WCHAR szTotal
         szClass[0] = L'\0';
     }
 
-    wcscat_s(szTotal, cchTotal, L"\"");
+    // Window title, enclosed in quotes.  If the caption is empty, then
+    // leave the quotes out altogether.
 
-    size_t len = wcslen(szTotal);
-    pszCaption = szTotal + len;
+    if (pszCaption[0] != L'\0')
+    {
+        wcscat_s(szLabel, ARRAYSIZE(szLabel), L"\"");
+        wcscat_s(szLabel, ARRAYSIZE(szLabel), pszCaption);
+        wcscat_s(szLabel, ARRAYSIZE(szLabel), L"\"");
+    }
 
-    size_t cchCaption = min(MAX_WINTEXT_LEN, cchTotal - len);
-    // Window title, enclosed in quotes
-    if (!SendMessageTimeout(
-        hwnd,
-        WM_GETTEXT,
-        cchCaption,
-        (LPARAM)pszCaption,
-        SMTO_ABORTIFHUNG, 100, NULL))
+    if (!g_opts.fClassThenText)
     {
-        GetWindowText(hwnd, pszCaption, (int)cchCaption);
+        wcscat_s(szLabel, ARRAYSIZE(szLabel), L"  ");
+        wcscat_s(szLabel, ARRAYSIZE(szLabel), szClass);
     }
 
-    // WM_GETTEXT does not guarantee null termination.
+    // Add cloaked annotation to windows that have been explicitly cloaked.
+    if (pNode->bCloaked == DWM_CLOAKED_APP)
+    {
+        wcscat_s(szLabel, ARRAYSIZE(szLabel), L" [app cloaked]");
+    }
+    else if (pNode->bCloaked == DWM_CLOAKED_SHELL)
+    {
+        wcscat_s(szLabel, ARRAYSIZE(szLabel), L" [cloaked]");
+    }
 
-    pszCaption[cchCaption - 1] = '\0';
+    wcsncpy_s(szTotal, cchTotal, szLabel, _TRUNCATE);
+}
 
-    // If the caption is empty, then remove the leading quote.
-    // Otherwise, add the closing quote.
+//
+// Stores the label fields for the window node.  Returns TRUE if they
+// changed.
+//
+BOOL SetTreeNodeLabel(TREENODE *pNode, const WINDOWMETA *pMeta)
+{
+    UINT ichClass = StringPool_Intern(&g_ClassNames, pMeta->szClass);
+    BOOL fChanged = FALSE;
 
-    if (*pszCaption != '\0')
-    {
-        wcscat_s(szTotal, cchTotal, L"\"");
-    }
-    else
+    if (ichClass != pNode->ichClass || pMeta->wAtom != pNode->wAtom || (BYTE)pMeta->dwCloaked != pNode->bCloaked)
     {
-        *(pszCaption - 1) = '\0';
+        pNode->ichClass = ichClass;
+        pNode->wAtom    = pMeta->wAtom;
+        pNode->bCloaked = (BYTE)pMeta->dwCloaked;
+        fChanged        = TRUE;
     }
 
-    if (!g_opts.fClassThenText)
+    PCWSTR pszOld = StringPool_Get(&g_Captions, pNode->ichCaption);
+
+    if (wcscmp(pszOld, pMeta->szCaption) != 0)
     {
-        wcscat_s(szTotal, cchTotal, L"  ");
-        wcscat_s(szTotal, cchTotal, szClass);
+        if (pNode->ichCaption != 0)
+        {
+            g_cchCaptionGarbage += wcslen(pszOld) + 1;
+        }
+
+        pNode->ichCaption = StringPool_Add(&g_Captions, pMeta->szCaption);
+        fChanged          = TRUE;
     }
 
-    // Add cloaked annotation to windows that have been explicitly cloaked.
-    if (dwCloaked == DWM_CLOAKED_APP)
+    return fChanged;
+}
+
+//
+// Updates the search text of a window node from its label fields.  The
+// handle, class and caption are all searchable, whatever the label shows.
+//
+void IndexTreeNode(ptrdiff_t nodeIndex)
+{
+    TREENODE *pNode = &g_TreeNodes[nodeIndex];
+    WCHAR     szText[16 + MAX_CLASS_LEN + MAX_WINTEXT_LEN];
+
+    swprintf_s(szText, ARRAYSIZE(szText), L"%08X  %s  %s",
+        (UINT)(UINT_PTR)pNode->hwnd,
+        StringPool_Get(&g_ClassNames, pNode->ichClass),
+        StringPool_Get(&g_Captions, pNode->ichCaption));
+
+    SearchIndex_Set(&g_SearchIndex, (UINT)nodeIndex, szText);
+}
+
+//
+// Rebuilds the caption pool from the captions still in use, once at least
+// half of it is taken up by captions that have been replaced or freed.
+//
+void CompactCaptions()
+{
+    STRINGPOOL pool = { 0 };
+
+    if (g_cchCaptionGarbage < 4096 || g_cchCaptionGarbage * 2 < g_Captions.cch)
     {
-        wcscat_s(szTotal, cchTotal, L" [app cloaked]");
+        return;
     }
-    else if (dwCloaked == DWM_CLOAKED_SHELL)
+
+    for (size_t i = 0; i < g_cTreeNodesInUse; i++)
     {
-        wcscat_s(szTotal, cchTotal, L" [cloaked]");
+        TREENODE *pNode = &g_TreeNodes[i];
+
+        if (pNode->ichCaption != 0)
+        {
+            pNode->ichCaption = StringPool_Add(&pool, StringPool_Get(&g_Captions, pNode->ichCaption));
+        }
     }
 
+    StringPool_Free(&g_Captions);
+
+    g_Captions          = pool;
+    g_cchCaptionGarbage = 0;
+}
+
+//
+// Computes the treeview item icon index for the specified window, from its
+// metadata.
+//
+int CalcNodeIcon(const WINDOWMETA *pMeta)
+{
+    DWORD dwStyle   = pMeta->dwStyle;
+    DWORD dwCloaked = pMeta->dwCloaked;
+    UINT  uClass    = GetKnownClassFromAtom(pMeta->wAtom, pMeta->hModule, pMeta->szClass);
+    int   iImage    = IconFromKnownClass(uClass, dwStyle);
+
     // Pick default images, if we didn't already pick a class specific one.
 
     if (iImage == -1)
@@ -369,7 +449,7 @@ int CalcNodeTextAndIcon(HWND hwnd, BOOL fIsVisible, DWORD dwStyle, WCHAR szTotal
         {
             iImage += (2 * NUM_CLASS_BITMAPS);
         }
-        else if (!fIsVisible)
+        else if (!pMeta->fVisible)
         {
             iImage += NUM_CLASS_BITMAPS;
         }
@@ -378,6 +458,39 @@ int CalcNodeTextAndIcon(HWND hwnd, BOOL fIsVisible, DWORD dwStyle, WCHAR szTotal
     return iImage;
 }
 
+//
+// Grows the specified node array if it is full, and hands out a clean
+// slot at the end of it.
+//
+static ptrdiff_t AppendNode(TREENODE **prgNodes, size_t *pcNodes, size_t *pcInUse)
+{
+    // Grow the array if it is full.
+
+    if (*pcInUse == *pcNodes)
+    {
+        size_t    cNew  = *pcNodes + 1000;
+        size_t    cbNew = cNew * sizeof(TREENODE);
+        TREENODE *rgNew = (TREENODE *)realloc(*prgNodes, cbNew);
+
+        if (!rgNew)
+        {
+            return -1;
+        }
+
+        *prgNodes = rgNew;
+        *pcNodes  = cNew;
+    }
+
+    // Hand out the next item.
+
+    TREENODE *pNode = &(*prgNodes)[*pcInUse];
+
+    ZeroMemory(pNode, sizeof(*pNode));
+    pNode->iParent = -1;
+
+    return (ptrdiff_t)(*pcInUse)++;
+}
+
 //
 // Returns a clean/empty TREENODE struct to be used for a newly inserted
 // treeview item.
@@ -388,110 +501,246 @@ int CalcNodeTextAndIcon(HWND hwnd, BOOL fIsVisible, DWORD dwStyle, WCHAR szTotal
 // are implicitly freed by virtue of g_cTreeNodesInUse being reset back to
 // zero.  The array slots will then be recycled as the tree is repopulated.
 //
+// An incremental refresh frees individual nodes with FreeTreeNode, and
+// those slots are handed out again before the array is grown.
+//
 ptrdiff_t AllocateTreeNode()
 {
-    // Grow the array if it is full.
+    if (g_iFreeTreeNode != -1)
+    {
+        ptrdiff_t nodeIndex = g_iFreeTreeNode;
+        TREENODE *pNode     = &g_TreeNodes[nodeIndex];
+
+        g_iFreeTreeNode = pNode->iParent;
+
+        ZeroMemory(pNode, sizeof(*pNode));
+        pNode->iParent = -1;
+
+        return nodeIndex;
+    }
+
+    return AppendNode(&g_TreeNodes, &g_cTreeNodes, &g_cTreeNodesInUse);
+}
+
+void FreeTreeNode(ptrdiff_t nodeIndex)
+{
+    TREENODE *pNode = &g_TreeNodes[nodeIndex];
 
-    if (g_cTreeNodesInUse == g_cTreeNodes)
+    if (pNode->hwnd)
     {
-        size_t    cNew  = g_cTreeNodes + 1000;
-        size_t    cbNew = cNew * sizeof(TREENODE);
-        TREENODE *rgNew = (TREENODE *)realloc(g_TreeNodes, cbNew);
+        HwndIndex_Remove(&g_HwndIndex, pNode->hwnd, nodeIndex);
+    }
+
+    // Lazy mode looks nodes up by snapshot index.
+
+    if (pNode->iSnap >= 0 && (size_t)pNode->iSnap < g_cSnapArrays && g_rgSnapToTree[pNode->iSnap] == nodeIndex)
+    {
+        g_rgSnapToTree[pNode->iSnap] = -1;
+    }
+
+    if (pNode->ichCaption != 0)
+    {
+        g_cchCaptionGarbage += wcslen(StringPool_Get(&g_Captions, pNode->ichCaption)) + 1;
+    }
+
+    SearchIndex_Remove(&g_SearchIndex, (UINT)nodeIndex);
+
+    ZeroMemory(pNode, sizeof(*pNode));
+
+    pNode->iParent  = g_iFreeTreeNode;
+    g_iFreeTreeNode = nodeIndex;
+}
+
+void ResetTreeNodes()
+{
+    g_cTreeNodesInUse = 0;
+    g_iFreeTreeNode   = -1;
+
+    HwndIndex_Clear(&g_HwndIndex);
+
+    StringPool_Reset(&g_ClassNames);
+    StringPool_Reset(&g_Captions);
+    g_cchCaptionGarbage = 0;
+
+    SearchIndex_Reset(&g_SearchIndex);
+}
+
+ptrdiff_t AllocateSnapNode()
+{
+    return AppendNode(&g_SnapNodes, &g_cSnapNodes, &g_cSnapNodesInUse);
+}
+
+//
+// Returns the sort key for the next node added to the snapshot.  Nodes that
+// go before their earlier siblings get decreasing negative keys, all others
+// increasing positive keys.
+//
+LONG NextSiblingOrder(BOOL fInsertFirst)
+{
+    g_lSnapSeq++;
+
+    return fInsertFirst ? -g_lSnapSeq : g_lSnapSeq;
+}
+
+static size_t HashPid(DWORD pid)
+{
+    return (size_t)((pid >> 2) * 0x9E3779B1u) & (g_cWinProcIndexSlots - 1);
+}
+
+//
+// Resizes the PID hash table so that it stays at most half full, and
+// re-adds the processes seen so far.
+//
+static BOOL WinProcIndex_Rebuild(size_t cMinItems)
+{
+    size_t cSlots = 256;
+    int   *rgNew;
+
+    while (cSlots < cMinItems * 2)
+    {
+        cSlots *= 2;
+    }
+
+    if (cSlots != g_cWinProcIndexSlots)
+    {
+        rgNew = (int *)realloc(g_rgWinProcIndex, cSlots * sizeof(int));
 
         if (!rgNew)
         {
-            return -1;
+            return FALSE;
         }
 
-        g_TreeNodes  = rgNew;
+        g_rgWinProcIndex     = rgNew;
+        g_cWinProcIndexSlots = cSlots;
+    }
 
-        g_cTreeNodes = cNew;
+    for (size_t i = 0; i < g_cWinProcIndexSlots; i++)
+    {
+        g_rgWinProcIndex[i] = -1;
     }
 
-    // Hand out the next item.
+    for (int i = 0; i < g_WinStackCount; i++)
+    {
+        size_t slot = HashPid(g_WinStackList[i].dwProcessId);
 
-    TREENODE *pNode = &g_TreeNodes[g_cTreeNodesInUse];
+        while (g_rgWinProcIndex[slot] != -1)
+        {
+            slot = (slot + 1) & (g_cWinProcIndexSlots - 1);
+        }
 
-    ZeroMemory(pNode, sizeof(*pNode));
+        g_rgWinProcIndex[slot] = i;
+    }
+
+    return TRUE;
+}
 
-    return g_cTreeNodesInUse++;
+static BOOL GrowWindowStack(WinProc *winProc)
+{
+    int           cNew  = max(winProc->cWindowStack * 2, MIN_WINDOW_DEPTH);
+    WinStackType *rgNew = (WinStackType *)realloc(winProc->windowStack, cNew * sizeof(WinStackType));
+
+    if (!rgNew)
+    {
+        return FALSE;
+    }
+
+    winProc->windowStack  = rgNew;
+    winProc->cWindowStack = cNew;
+
+    return TRUE;
 }
 
 //
 //
 //
-WinProc *GetProcessWindowStack(HWND hwndTree, HWND hwnd)
+WinProc *GetProcessWindowStack(HWND hwnd)
 {
     DWORD           pid;
-    int             i;
-    TVINSERTSTRUCT  tv;
-    WCHAR           ach[MIN_FORMAT_LEN];
-    WCHAR           name[100] = L"";
-    WCHAR           path[MAX_PATH] = L"";
-    SHFILEINFO      shfi = { 0 };
+    size_t          slot;
 
     GetWindowThreadProcessId(hwnd, &pid);
 
     //
     // look for an existing process/window stack:
     //
-    for (i = 0; i < g_WinStackCount; i++)
+    slot = HashPid(pid);
+
+    while (g_rgWinProcIndex[slot] != -1)
     {
-        if (g_WinStackList[i].dwProcessId == pid)
-            return &g_WinStackList[i];
+        if (g_WinStackList[g_rgWinProcIndex[slot]].dwProcessId == pid)
+            return &g_WinStackList[g_rgWinProcIndex[slot]];
+
+        slot = (slot + 1) & (g_cWinProcIndexSlots - 1);
     }
 
     //
     // couldn't find one - build a new one instead
     //
-    GetProcessNameByPid(pid, name, 100, path, MAX_PATH);
-    swprintf_s(ach, ARRAYSIZE(ach), L"%s  (%u)", name, pid);
+    if (g_WinStackCount == g_cWinStackList)
+    {
+        int      cNew  = g_cWinStackList + 64;
+        WinProc *rgNew = (WinProc *)realloc(g_WinStackList, cNew * sizeof(WinProc));
 
-    TREENODE *pNode = NULL;
-    ptrdiff_t nodeIndex = AllocateTreeNode();
+        if (!rgNew)
+        {
+            return NULL;
+        }
 
-    if (nodeIndex >= 0)
+        ZeroMemory(rgNew + g_cWinStackList, (cNew - g_cWinStackList) * sizeof(WinProc));
+
+        g_WinStackList  = rgNew;
+        g_cWinStackList = cNew;
+    }
+
+    WinProc *winProc = &g_WinStackList[g_WinStackCount];
+
+    if (winProc->cWindowStack == 0 && !GrowWindowStack(winProc))
     {
-        pNode = &g_TreeNodes[nodeIndex];
-        pNode->dwPID = pid;
+        return NULL;
     }
-    else
+
+    ptrdiff_t nodeIndex = AllocateSnapNode();
+
+    if (nodeIndex < 0)
     {
         return NULL;
     }
 
-    // Add the root item
-    tv.hParent = g_hRoot;
-    tv.hInsertAfter = TVI_LAST;
-    tv.item.mask = TVIF_STATE | TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_PARAM;
-    tv.item.state = 0;//TVIS_EXPANDED;
-    tv.item.stateMask = 0;//TVIS_EXPANDED;
-    tv.item.pszText = ach;
-    tv.item.cchTextMax = ARRAYSIZE(ach);
-    tv.item.lParam = (LPARAM)nodeIndex;
+    TREENODE *pNode = &g_SnapNodes[nodeIndex];
+
+    pNode->dwPID   = pid;
+    pNode->iParent = g_iSnapRoot;
+    pNode->lOrder  = NextSiblingOrder(FALSE);
 
-    if (SHGetFileInfo(path, 0, &shfi, sizeof(shfi), SHGFI_SMALLICON | SHGFI_ICON))
+    winProc->iRoot = nodeIndex;
+    winProc->dwProcessId = pid;
+    winProc->nWindowZ = 1;
+    winProc->windowStack[0].iNode = nodeIndex;
+    winProc->windowStack[0].hwnd = 0;
+
+    g_WinStackCount++;
+
+    // Keep the hash table at most half full.
+
+    if ((size_t)g_WinStackCount * 2 > g_cWinProcIndexSlots)
     {
-        tv.item.iImage = ImageList_AddIcon(g_hImgList, shfi.hIcon);
-        tv.item.iSelectedImage = tv.item.iImage;
+        WinProcIndex_Rebuild(g_WinStackCount);
     }
     else
     {
-        tv.item.iImage = WINDOW_IMAGE;
-        tv.item.iSelectedImage = WINDOW_IMAGE;
+        g_rgWinProcIndex[slot] = g_WinStackCount - 1;
     }
 
-    pNode->hTreeItem = TreeView_InsertItem(hwndTree, &tv);
-
-    g_WinStackList[g_WinStackCount].hRoot = pNode->hTreeItem;
-    g_WinStackList[g_WinStackCount].dwProcessId = pid;
-    g_WinStackList[g_WinStackCount].nWindowZ = 1;
-    g_WinStackList[g_WinStackCount].windowStack[0].hRoot = pNode->hTreeItem;
-    g_WinStackList[g_WinStackCount].windowStack[0].hwnd = 0;
-
-    return &g_WinStackList[g_WinStackCount++];
+    return winProc;
 }
 
+//
+// Keep track of the last window to be added, so
+// we know the z-order of the current window
+//
+static ptrdiff_t g_iSnapLast;
+static HWND      g_hwndSnapLast;
+
 //
 // Callback function which is called once for every window in
 // the system. We have to work out whereabouts in the treeview
@@ -499,88 +748,72 @@ WinProc *GetProcessWindowStack(HWND hwndTree, HWND hwnd)
 //
 BOOL CALLBACK AllWindowProc(HWND hwnd, LPARAM lParam)
 {
-    HWND hwndTree = (HWND)lParam;
+    UNREFERENCED_PARAMETER(lParam);
     BOOL fIsVisible = IsWindowVisible(hwnd);
 
     // Ignore it if it is hidden and we are omitting hidden windows from the list.
     if (!fIsVisible && !g_opts.fShowHiddenInList)
         return TRUE;
 
-    static WCHAR szTotal[MIN_FORMAT_LEN];
-
     int i;
 
-    // Style is used to decide which bitmap to display in the tree
+    // Style is used to decide where the window goes amongst its siblings
     UINT uStyle = GetWindowLong(hwnd, GWL_STYLE);
 
     // Need to know the current window's parent, so we know
     // where to insert this window
     HWND  hwndParent = GetRealParent(hwnd);
 
-    // Keep track of the last window to be inserted, so
-    // we know the z-order of the current window
-    static HTREEITEM hTreeLast;
-    static HWND      hwndLast;
+    //
+    //
+    //
+    WinProc *winProc = GetProcessWindowStack(hwnd);
+
+    if (!winProc)
+    {
+        return FALSE;
+    }
+
+    WinStackType *WindowStack = winProc->windowStack;
 
-    TVINSERTSTRUCT tv;
     TREENODE *pNode = NULL;
-    ptrdiff_t nodeIndex = AllocateTreeNode();
+    ptrdiff_t nodeIndex = AllocateSnapNode();
 
     if (nodeIndex >= 0)
     {
-        pNode = &g_TreeNodes[nodeIndex];
+        pNode = &g_SnapNodes[nodeIndex];
         pNode->hwnd = hwnd;
+        pNode->iParent = winProc->iRoot;
     }
     else
     {
         return FALSE;
     }
 
-
-    //
-    //
-    //
-    WinProc *winProc = GetProcessWindowStack(hwndTree, hwnd);
-    WinStackType *WindowStack = winProc->windowStack;
-
-    // Prepare the TVINSERTSTRUCT object
-    ZeroMemory(&tv, sizeof(tv));
-    tv.hParent = winProc->hRoot;
-    tv.hInsertAfter = TVI_LAST;
-    tv.item.mask = TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_PARAM;
-    tv.item.pszText = szTotal;
-    tv.item.cchTextMax = ARRAYSIZE(szTotal);
-    tv.item.lParam = (LPARAM)nodeIndex;
-
-    tv.item.iImage = CalcNodeTextAndIcon(hwnd, fIsVisible, uStyle, szTotal, ARRAYSIZE(szTotal));
-
     //
     // Insertion position depends on type of window.
     //
     if (uStyle & WS_CHILD)
     {
         // child windows (edit boxes, list boxes etc)
-        tv.hInsertAfter = TVI_LAST;
+        pNode->lOrder = NextSiblingOrder(FALSE);
     }
     else if ((uStyle & WS_POPUPWINDOW) == WS_POPUPWINDOW)
     {
         // dialog boxes
-        tv.hInsertAfter = TVI_FIRST;
+        pNode->lOrder = NextSiblingOrder(TRUE);
     }
     else if (uStyle & WS_POPUP)
     {
         // popup windows (tooltips etc)
-        tv.hInsertAfter = TVI_LAST;
+        pNode->lOrder = NextSiblingOrder(FALSE);
     }
     else
     {
         // anything else must be a top-level window
-        tv.hInsertAfter = TVI_FIRST;
+        pNode->lOrder = NextSiblingOrder(TRUE);
     }
 
-    //set the selected bitmap to be the same
-    tv.item.iSelectedImage = tv.item.iImage;
-
     //
     // Decide where to place this item
     //
@@ -591,16 +824,20 @@ BOOL CALLBACK AllWindowProc(HWND hwnd, LPARAM lParam)
     if (winProc->nWindowZ > 0 && hwndParent != WindowStack[winProc->nWindowZ - 1].hwnd)
     {
         //we have another child window
-        if (hwndParent == hwndLast)
+        if (hwndParent == g_hwndSnapLast)
         {
-            //make a new parent stack entry
-            WindowStack[winProc->nWindowZ].hRoot = hTreeLast;
+            //make a new parent stack entry (if the stack can't grow,
+            //replace the top entry instead)
+            if (winProc->nWindowZ == winProc->cWindowStack && !GrowWindowStack(winProc))
+                winProc->nWindowZ--;
+
+            WindowStack = winProc->windowStack;
+            WindowStack[winProc->nWindowZ].iNode = g_iSnapLast;
             WindowStack[winProc->nWindowZ].hwnd = hwndParent;
 
-            if (winProc->nWindowZ < MAX_WINDOW_DEPTH - 1)
-                winProc->nWindowZ++;
+            winProc->nWindowZ++;
 
-            tv.hParent = hTreeLast;
+            pNode->iParent = g_iSnapLast;
         }
         //moving back?????
         else
@@ -612,7 +849,7 @@ BOOL CALLBACK AllWindowProc(HWND hwnd, LPARAM lParam)
                 if (WindowStack[i].hwnd == hwndParent)
                 {
                     winProc->nWindowZ = i + 1;
-                    tv.hParent = WindowStack[i].hRoot;
+                    pNode->iParent = WindowStack[i].iNode;
                 }
             }
         }
@@ -621,77 +858,1041 @@ BOOL CALLBACK AllWindowProc(HWND hwnd, LPARAM lParam)
     // it to the treeview, in the same "z-order"
     else
     {
-        tv.hParent = WindowStack[winProc->nWindowZ - 1].hRoot;
+        pNode->iParent = WindowStack[winProc->nWindowZ - 1].iNode;
     }
 
-    // Finally add the node
-    pNode->hTreeItem = TreeView_InsertItem(hwndTree, &tv);
-
-    hTreeLast = pNode->hTreeItem;
-    hwndLast = hwnd;
+    g_iSnapLast = nodeIndex;
+    g_hwndSnapLast = hwnd;
 
     return TRUE;
 }
 
 //
-//  Populate the treeview control by using EnumChildWindows,
-//  starting from the desktop window
-//  HWND - handle to the dialog containing the tree
+//  Query the metadata of every window in the snapshot, in parallel.
 //
-void FillGlobalWindowTree(HWND hwndTree)
+void FillSnapshotMeta()
 {
-    HWND hwndDesktop = GetDesktopWindow();
+    size_t cNodes = g_cSnapNodesInUse;
 
-    // hwndDesktop = FindWindowEx(HWND_MESSAGE, NULL, NULL, NULL);
-    // hwndDesktop = GetRealParent(hwndDesktop);
-
-    if (g_opts.fShowDesktopRoot)
+    if (cNodes > g_cSnapMeta)
     {
-        TVINSERTSTRUCT tv;
-        WCHAR ach[MIN_FORMAT_LEN];
+        WINDOWMETA *rgMeta = (WINDOWMETA *)realloc(g_rgSnapMeta, cNodes * sizeof(WINDOWMETA));
 
-        CalcNodeTextAndIcon(hwndDesktop, TRUE, 0, ach, ARRAYSIZE(ach));
-
-        TREENODE *pNode = NULL;
-        ptrdiff_t nodeIndex = AllocateTreeNode();
-
-        if (nodeIndex >= 0)
+        if (!rgMeta)
         {
-            pNode = &g_TreeNodes[nodeIndex];
-            pNode->hwnd = hwndDesktop;
+            return;
+        }
+
+        g_rgSnapMeta = rgMeta;
+        g_cSnapMeta  = cNodes;
+    }
+
+    for (size_t i = 0; i < cNodes; i++)
+    {
+        g_rgSnapMeta[i].hwnd = g_SnapNodes[i].hwnd;
+    }
+
+    WindowSnapshot_Query(g_rgSnapMeta, cNodes, &g_LiveWindowMeta, 0);
+
+    g_cSnapMetaInUse = cNodes;
+}
+
+//
+//  Returns the metadata for the specified tree node's window, either from
+//  the snapshot or, if it isn't there, by querying the window into *pMeta.
+//
+const WINDOWMETA *GetTreeNodeMeta(TREENODE *pNode, WINDOWMETA *pMeta)
+{
+    ptrdiff_t iSnap = pNode->iSnap;
+
+    if (iSnap >= 0 && (size_t)iSnap < g_cSnapMetaInUse && g_rgSnapMeta[iSnap].hwnd == pNode->hwnd)
+    {
+        return &g_rgSnapMeta[iSnap];
+    }
+
+    pMeta->hwnd = pNode->hwnd;
+    WindowMeta_QueryLive(pMeta, NULL);
+
+    return pMeta;
+}
+
+//
+//  The metadata is only needed while the snapshot is applied.  After that
+//  the labels are in the string pools, so the arrays (over half a KB per
+//  window) are let go rather than kept until the next refresh.
+//
+static void FreeSnapshotMeta()
+{
+    free(g_rgSnapMeta);
+
+    g_rgSnapMeta     = NULL;
+    g_cSnapMeta      = 0;
+    g_cSnapMetaInUse = 0;
+}
+
+//
+//  Capture the window hierarchy into the snapshot by using
+//  EnumChildWindows, starting from the desktop window
+//
+void FillGlobalWindowTree()
+{
+    HWND hwndDesktop = GetDesktopWindow();
+
+    // hwndDesktop = FindWindowEx(HWND_MESSAGE, NULL, NULL, NULL);
+    // hwndDesktop = GetRealParent(hwndDesktop);
+
+    g_WinStackCount   = 0;
+    g_cSnapNodesInUse = 0;
+    g_iSnapRoot       = -1;
+    g_lSnapSeq        = 0;
+    g_iSnapLast       = -1;
+    g_hwndSnapLast    = NULL;
+
+    // Size the PID table for as many processes as last time.
+
+    if (!WinProcIndex_Rebuild(g_cWinStackList))
+    {
+        return;
+    }
+
+    if (g_opts.fShowDesktopRoot)
+    {
+        ptrdiff_t nodeIndex = AllocateSnapNode();
+
+        if (nodeIndex < 0)
+        {
+            return;
+        }
+
+        g_SnapNodes[nodeIndex].hwnd   = hwndDesktop;
+        g_SnapNodes[nodeIndex].lOrder = NextSiblingOrder(FALSE);
+
+        g_iSnapRoot = nodeIndex;
+    }
+
+    // EnumChildWindows does the hard work for us
+
+    EnumChildWindows(hwndDesktop, AllWindowProc, 0);
+
+    g_cSnapMetaInUse = 0;
+
+    // Lazy mode only adds a few nodes to the tree up front, so there's no
+    // point querying every window.
+
+    if (!g_opts.fLazyTree)
+    {
+        FillSnapshotMeta();
+    }
+}
+
+//
+//  In lazy mode a node's children are only added to the treeview when the
+//  node is first expanded.  Until then the item has I_CHILDRENCALLBACK, and
+//  the children are looked up in the snapshot when needed.  The desktop
+//  root is always populated, so process nodes are the top-most lazy ones.
+//
+static BOOL IsLazyTreeNode(TREENODE *pNode)
+{
+    return g_opts.fLazyTree && pNode->hwnd != GetDesktopWindow();
+}
+
+static void SetChildrenCallback(TREENODE *pNode, TVITEM *pItem)
+{
+    if (pNode->fChildrenPending)
+    {
+        pItem->mask     |= TVIF_CHILDREN;
+        pItem->cChildren = I_CHILDRENCALLBACK;
+    }
+}
+
+//
+//  Builds the label of a process node's item, and returns its icon.
+//
+static int FormatProcessItem(DWORD pid, WCHAR szLabel[], int cchLabel)
+{
+    WCHAR name[100] = L"";
+    WCHAR path[MAX_PATH] = L"";
+    int   iImage;
+
+    GetProcessNameByPid(pid, name, 100, path, MAX_PATH);
+    swprintf_s(szLabel, cchLabel, L"%s  (%u)", name, pid);
+
+    // The icon cache hands out a placeholder until the real icon is loaded.
+
+    iImage = ProcessIconCache_Lookup(path);
+
+    return (iImage == -1) ? WINDOW_IMAGE : iImage;
+}
+
+//
+//  Add a treeview item for a process node.
+//
+HTREEITEM InsertProcessItem(HWND hwndTree, ptrdiff_t nodeIndex, HTREEITEM hParent, HTREEITEM hInsertAfter)
+{
+    TVINSERTSTRUCT  tv;
+    WCHAR           ach[MIN_FORMAT_LEN];
+    int             iImage = FormatProcessItem(g_TreeNodes[nodeIndex].dwPID, ach, ARRAYSIZE(ach));
+
+    SearchIndex_Set(&g_SearchIndex, (UINT)nodeIndex, ach);
+
+    // Add the root item
+    tv.hParent = hParent;
+    tv.hInsertAfter = hInsertAfter;
+    tv.item.mask = TVIF_STATE | TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_PARAM;
+    tv.item.state = 0;//TVIS_EXPANDED;
+    tv.item.stateMask = 0;//TVIS_EXPANDED;
+    tv.item.pszText = ach;
+    tv.item.cchTextMax = ARRAYSIZE(ach);
+    tv.item.lParam = (LPARAM)nodeIndex;
+
+    SetChildrenCallback(&g_TreeNodes[nodeIndex], &tv.item);
+
+    tv.item.iImage = iImage;
+    tv.item.iSelectedImage = iImage;
+
+    return TreeView_InsertItem(hwndTree, &tv);
+}
+
+//
+//  A kept process node is matched by pid alone, and the pid may have gone
+//  to another process since the item was added.  Relabel the item if the
+//  process that has the pid now has a different name or icon.
+//
+static void RefreshProcessItem(HWND hwndTree, ptrdiff_t nodeIndex)
+{
+    TVITEM item;
+    WCHAR  szOld[MIN_FORMAT_LEN];
+    WCHAR  szNew[MIN_FORMAT_LEN];
+    int    iImage = FormatProcessItem(g_TreeNodes[nodeIndex].dwPID, szNew, ARRAYSIZE(szNew));
+
+    ZeroMemory(&item, sizeof(item));
+
+    item.mask       = TVIF_HANDLE | TVIF_TEXT | TVIF_IMAGE;
+    item.hItem      = g_TreeNodes[nodeIndex].hTreeItem;
+    item.pszText    = szOld;
+    item.cchTextMax = ARRAYSIZE(szOld);
+
+    if (!TreeView_GetItem(hwndTree, &item))
+    {
+        return;
+    }
+
+    if (wcscmp(szOld, szNew) != 0 || item.iImage != iImage)
+    {
+        item.mask           = TVIF_HANDLE | TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE;
+        item.pszText        = szNew;
+        item.iImage         = iImage;
+        item.iSelectedImage = iImage;
+
+        TreeView_SetItem(hwndTree, &item);
+        SearchIndex_Set(&g_SearchIndex, (UINT)nodeIndex, szNew);
+    }
+}
+
+//
+//  Add a treeview item for a window node.  The desktop window starts
+//  out expanded.
+//
+HTREEITEM InsertWindowItem(HWND hwndTree, ptrdiff_t nodeIndex, HTREEITEM hParent, HTREEITEM hInsertAfter)
+{
+    TVINSERTSTRUCT  tv;
+    WINDOWMETA      meta;
+    TREENODE       *pNode = &g_TreeNodes[nodeIndex];
+    const WINDOWMETA *pMeta = GetTreeNodeMeta(pNode, &meta);
+
+    // Prepare the TVINSERTSTRUCT object
+    ZeroMemory(&tv, sizeof(tv));
+    tv.hParent = hParent;
+    tv.hInsertAfter = hInsertAfter;
+    tv.item.mask = TVIF_STATE | TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_PARAM;
+    tv.item.pszText = LPSTR_TEXTCALLBACK;
+    tv.item.lParam = (LPARAM)nodeIndex;
+
+    SetChildrenCallback(pNode, &tv.item);
+
+    // The label is built when the treeview asks for it.
+
+    SetTreeNodeLabel(pNode, pMeta);
+    IndexTreeNode(nodeIndex);
+
+    tv.item.iImage = CalcNodeIcon(pMeta);
+
+    if (pNode->hwnd == GetDesktopWindow())
+    {
+        tv.item.state = TVIS_EXPANDED;
+        tv.item.stateMask = TVIS_EXPANDED;
+        tv.item.iImage = DESKTOP_IMAGE;
+    }
+
+    //set the selected bitmap to be the same
+    tv.item.iSelectedImage = tv.item.iImage;
+
+    return TreeView_InsertItem(hwndTree, &tv);
+}
+
+//
+//  Adds the specified snapshot node to the tree.  Returns the new tree
+//  node index, or -1 on failure.
+//
+ptrdiff_t InsertSnapNode(HWND hwndTree, ptrdiff_t iSnap, ptrdiff_t iParent, HTREEITEM hInsertAfter)
+{
+    ptrdiff_t nodeIndex = AllocateTreeNode();
+
+    if (nodeIndex < 0)
+    {
+        return -1;
+    }
+
+    HTREEITEM hParent = (iParent == -1) ? TVI_ROOT : g_TreeNodes[iParent].hTreeItem;
+    TREENODE *pSnap   = &g_SnapNodes[iSnap];
+    TREENODE *pNode   = &g_TreeNodes[nodeIndex];
+
+    pNode->hwnd    = pSnap->hwnd;
+    pNode->dwPID   = pSnap->dwPID;
+    pNode->iParent = iParent;
+    pNode->lOrder  = pSnap->lOrder;
+    pNode->iSnap   = iSnap;
+
+    pNode->fChildrenPending = IsLazyTreeNode(pNode);
+
+    g_rgSnapToTree[iSnap] = nodeIndex;
+
+    if (pNode->hwnd)
+    {
+        HwndIndex_Add(&g_HwndIndex, pNode->hwnd, nodeIndex);
+        pNode->hTreeItem = InsertWindowItem(hwndTree, nodeIndex, hParent, hInsertAfter);
+    }
+    else
+    {
+        pNode->hTreeItem = InsertProcessItem(hwndTree, nodeIndex, hParent, hInsertAfter);
+    }
+
+    return nodeIndex;
+}
+
+//
+//  Adds the children of a lazy node to the tree, from the snapshot.
+//
+void PopulateTreeChildren(HWND hwndTree, ptrdiff_t nodeIndex)
+{
+    TREENODE *pNode = &g_TreeNodes[nodeIndex];
+    ptrdiff_t iSnap = pNode->iSnap;
+
+    if (!pNode->fChildrenPending)
+    {
+        return;
+    }
+
+    pNode->fChildrenPending = FALSE;
+
+    // The children are already in display order in g_rgSnapOrder.
+
+    for (ptrdiff_t k = g_rgSnapFirstChild[iSnap]; k != -1 && (size_t)k < g_cSnapNodesInUse; k++)
+    {
+        ptrdiff_t iChild = g_rgSnapOrder[k];
+
+        if (g_SnapNodes[iChild].iParent != iSnap)
+        {
+            break;
+        }
+
+        if (InsertSnapNode(hwndTree, iChild, nodeIndex, TVI_LAST) < 0)
+        {
+            break;
+        }
+    }
+}
+
+//
+//  Returns the tree node for the specified snapshot node, adding it (and
+//  any lazy ancestors) to the tree if necessary.
+//
+ptrdiff_t MaterializeSnapNode(HWND hwndTree, ptrdiff_t iSnap)
+{
+    ptrdiff_t iParentSnap = g_SnapNodes[iSnap].iParent;
+    ptrdiff_t iParent;
+
+    if (g_rgSnapToTree[iSnap] != -1 || iParentSnap == -1)
+    {
+        return g_rgSnapToTree[iSnap];
+    }
+
+    iParent = MaterializeSnapNode(hwndTree, iParentSnap);
+
+    if (iParent != -1)
+    {
+        PopulateTreeChildren(hwndTree, iParent);
+    }
+
+    return g_rgSnapToTree[iSnap];
+}
+
+//
+//  Sort callback used to restore the display order of siblings that
+//  changed z-order between refreshes.
+//
+int CALLBACK CompareTreeNodes(LPARAM lParam1, LPARAM lParam2, LPARAM lParamSort)
+{
+    UNREFERENCED_PARAMETER(lParamSort);
+    LONG lOrder1 = g_TreeNodes[(ptrdiff_t)lParam1].lOrder;
+    LONG lOrder2 = g_TreeNodes[(ptrdiff_t)lParam2].lOrder;
+
+    return (lOrder1 < lOrder2) ? -1 : (lOrder1 > lOrder2);
+}
+
+void SortTreeChildren(HWND hwndTree, HTREEITEM hParent)
+{
+    TVSORTCB sort;
+
+    sort.hParent     = hParent;
+    sort.lpfnCompare = CompareTreeNodes;
+    sort.lParam      = 0;
+
+    TreeView_SortChildrenCB(hwndTree, &sort, 0);
+}
+
+void RefreshTreeItem(ptrdiff_t nodeIndex, const WINDOWMETA *pMeta);
+
+//
+//  Process items that survive a refresh keep their icon, so tell the icon
+//  cache that it's still in use.
+//
+static void TouchProcessIcon(HWND hwndTree, HTREEITEM hti)
+{
+    TVITEM item;
+
+    ZeroMemory(&item, sizeof(item));
+
+    item.mask  = TVIF_HANDLE | TVIF_IMAGE;
+    item.hItem = hti;
+
+    if (TreeView_GetItem(hwndTree, &item))
+    {
+        ProcessIconCache_Touch(item.iImage);
+    }
+}
+
+//
+//  Makes sure the arrays indexed by snapshot node are big enough for the
+//  current snapshot.
+//
+static BOOL GrowSnapArrays(size_t cNew)
+{
+    if (cNew > g_cSnapArrays)
+    {
+        ptrdiff_t *rgOrder   = (ptrdiff_t *)realloc(g_rgSnapOrder, cNew * sizeof(ptrdiff_t));
+        ptrdiff_t *rgFirst   = rgOrder ? (ptrdiff_t *)realloc(g_rgSnapFirstChild, cNew * sizeof(ptrdiff_t)) : NULL;
+        ptrdiff_t *rgToTree  = rgFirst ? (ptrdiff_t *)realloc(g_rgSnapToTree, cNew * sizeof(ptrdiff_t)) : NULL;
+
+        if (rgOrder)
+            g_rgSnapOrder = rgOrder;
+
+        if (rgFirst)
+            g_rgSnapFirstChild = rgFirst;
+
+        if (!rgToTree)
+        {
+            return FALSE;
+        }
+
+        g_rgSnapToTree = rgToTree;
+        g_cSnapArrays  = cNew;
+    }
+
+    return TRUE;
+}
+
+//
+//  Bring the treeview in line with the snapshot.  Nodes that are still
+//  present keep their treeview items (and so their expansion/selection
+//  state), and only have their text and icon refreshed.  Returns FALSE
+//  if the tree couldn't be reconciled, in which case it is left partly
+//  updated and the caller has to rebuild it from scratch.
+//
+BOOL ApplyWindowSnapshot(HWND hwndTree)
+{
+    TREEDIFF   diff;
+    size_t     cNew = g_cSnapNodesInUse;
+
+    if (!GrowSnapArrays(cNew + 1))
+    {
+        return FALSE;
+    }
+
+    if (!WindowTreeDiff_Compute(g_TreeNodes, g_cTreeNodesInUse, g_SnapNodes, cNew, &diff))
+    {
+        return FALSE;
+    }
+
+    // Mark the icons of the process items that stay as used before any new
+    // item looks up its icon, otherwise the cache could recycle one of them
+    // for the new item.
+
+    ProcessIconCache_NextGeneration();
+
+    for (size_t j = 0; j < g_cTreeNodesInUse; j++)
+    {
+        TREENODE *pNode = &g_TreeNodes[j];
+
+        if (!IsTreeNodeFree(pNode) && diff.rgOldKept[j] && !pNode->hwnd)
+        {
+            TouchProcessIcon(hwndTree, pNode->hTreeItem);
+        }
+    }
+
+    // One toolhelp pass names every process, instead of opening each one
+    // as its item is added.
+
+    ProcessInfoCache_Refresh();
+
+    // Remove the nodes that have gone away.  Deleting a treeview item also
+    // deletes its children, so only delete the top-most ones.
+
+    for (size_t j = 0; j < g_cTreeNodesInUse; j++)
+    {
+        TREENODE *pNode = &g_TreeNodes[j];
+
+        if (!IsTreeNodeFree(pNode) && !diff.rgOldKept[j])
+        {
+            if (pNode->iParent == -1 || diff.rgOldKept[pNode->iParent])
+            {
+                TreeView_DeleteItem(hwndTree, pNode->hTreeItem);
+            }
+        }
+    }
+
+    for (size_t j = 0; j < g_cTreeNodesInUse; j++)
+    {
+        if (!IsTreeNodeFree(&g_TreeNodes[j]) && !diff.rgOldKept[j])
+        {
+            FreeTreeNode((ptrdiff_t)j);
+        }
+    }
+
+    // Remember where each node's children are in the display order, for
+    // populating lazy nodes later on.
+
+    for (size_t i = 0; i < cNew; i++)
+    {
+        g_rgSnapToTree[i]     = diff.rgMatch[i];
+        g_rgSnapFirstChild[i] = -1;
+
+        if (diff.rgMatch[i] != -1)
+        {
+            g_TreeNodes[diff.rgMatch[i]].iSnap = (ptrdiff_t)i;
+        }
+    }
+
+    for (size_t k = 0; k < cNew; k++)
+    {
+        ptrdiff_t i = diff.rgOrder[k];
+
+        g_rgSnapOrder[k] = i;
+
+        if (g_SnapNodes[i].iParent != -1 && g_rgSnapFirstChild[g_SnapNodes[i].iParent] == -1)
+        {
+            g_rgSnapFirstChild[g_SnapNodes[i].iParent] = (ptrdiff_t)k;
+        }
+    }
+
+    // Walk the snapshot sibling group by sibling group.  Parents are always
+    // visited before their children, and each new node goes after the
+    // sibling preceding it, which is already in the tree.
+
+    for (size_t k = 0; k < cNew; k++)
+    {
+        ptrdiff_t i       = diff.rgOrder[k];
+        TREENODE *pSnap   = &g_SnapNodes[i];
+        BOOL      fFirst  = (k == 0 || g_SnapNodes[diff.rgOrder[k - 1]].iParent != pSnap->iParent);
+        ptrdiff_t iParent = (pSnap->iParent == -1) ? -1 : g_rgSnapToTree[pSnap->iParent];
+
+        if (diff.rgMatch[i] != -1)
+        {
+            TREENODE *pNode = &g_TreeNodes[diff.rgMatch[i]];
+
+            pNode->lOrder = pSnap->lOrder;
+
+            // Nodes left unpopulated by lazy mode get filled in once
+            // lazy mode is switched off.
+
+            if (!g_opts.fLazyTree)
+            {
+                pNode->fChildrenPending = FALSE;
+            }
+
+            if (pNode->hwnd)
+            {
+                WINDOWMETA meta;
+
+                RefreshTreeItem(diff.rgMatch[i], GetTreeNodeMeta(pNode, &meta));
+            }
+            else
+            {
+                RefreshProcessItem(hwndTree, diff.rgMatch[i]);
+            }
+        }
+        else if (pSnap->iParent != -1 && (iParent == -1 || g_TreeNodes[iParent].fChildrenPending))
+        {
+            // Parent hasn't been expanded yet (lazy mode).
+            continue;
         }
         else
         {
-            g_hRoot = TVI_ROOT;
-            return;
+            HTREEITEM hInsertAfter = fFirst ? TVI_FIRST : g_TreeNodes[g_rgSnapToTree[diff.rgOrder[k - 1]]].hTreeItem;
+
+            if (InsertSnapNode(hwndTree, i, iParent, hInsertAfter) < 0)
+            {
+                WindowTreeDiff_Free(&diff);
+                return FALSE;
+            }
+        }
+    }
+
+    // Fix up the order of siblings that were kept but have been shuffled
+    // around in the z-order since the last refresh.
+
+    if (diff.fResortRoot)
+    {
+        SortTreeChildren(hwndTree, TVI_ROOT);
+    }
+
+    for (size_t i = 0; i < cNew; i++)
+    {
+        if (diff.rgResort[i])
+        {
+            SortTreeChildren(hwndTree, g_TreeNodes[g_rgSnapToTree[i]].hTreeItem);
+        }
+    }
+
+    WindowTreeDiff_Free(&diff);
+
+    CompactCaptions();
+
+    return TRUE;
+}
+
+//
+//  Live updates
+//
+//  WinEvent hooks report windows being created, destroyed, renamed, shown,
+//  hidden, reordered and cloaked.  The events are collected per window by
+//  a WINEVENTCOALESCER and applied to the tree in batches, at most once
+//  every LIVE_UPDATE_INTERVAL ms.
+//
+//  Each event only touches the window's own node: renames refresh it,
+//  destroyed windows have it removed, and new windows get one under their
+//  parent's node.  Hidden windows are added and removed as they are shown
+//  and hidden, unless the tree shows hidden windows anyway.
+//
+//  Reordered siblings, events lost to a full batch and windows that can't
+//  be placed that way (the first window of a process, or a parent that
+//  isn't in the tree) make the tree resynchronize with the whole window
+//  hierarchy instead, incrementally and no more than once every
+//  LIVE_RESYNC_INTERVAL ms.
+//
+#define LIVE_UPDATE_INTERVAL    50
+#define LIVE_RESYNC_INTERVAL    1000
+#define LIVE_MAX_WINDOWS        2048
+
+#define LIVE_EVENT_CREATE       0x01
+#define LIVE_EVENT_DESTROY      0x02
+#define LIVE_EVENT_VISIBILITY   0x04    // Shown or hidden
+#define LIVE_EVENT_CONTENT      0x08    // Renamed or (un)cloaked
+#define LIVE_EVENT_REORDER      0x10
+
+static HWINEVENTHOOK     g_rgLiveHooks[3];
+static WINEVENTCOALESCER g_LiveEvents;
+static BOOL              g_fLiveResyncPending;
+static DWORD             g_dwLastLiveResync;
+
+static void CALLBACK LiveEventProc(HWINEVENTHOOK hHook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD idEventThread, DWORD dwmsEventTime)
+{
+    UINT fEvent;
+
+    UNREFERENCED_PARAMETER(hHook);
+    UNREFERENCED_PARAMETER(idEventThread);
+    UNREFERENCED_PARAMETER(dwmsEventTime);
+
+    if (!hwnd || idChild != CHILDID_SELF)
+        return;
+
+    // Reorder events are raised for the parent's client area.
+
+    if (idObject != OBJID_WINDOW && event != EVENT_OBJECT_REORDER)
+        return;
+
+    switch (event)
+    {
+    case EVENT_OBJECT_CREATE:
+        fEvent = LIVE_EVENT_CREATE;
+        break;
+
+    case EVENT_OBJECT_REORDER:
+        fEvent = LIVE_EVENT_REORDER;
+        break;
+
+    case EVENT_OBJECT_DESTROY:
+        fEvent = LIVE_EVENT_DESTROY;
+        break;
+
+    case EVENT_OBJECT_SHOW:
+    case EVENT_OBJECT_HIDE:
+        fEvent = LIVE_EVENT_VISIBILITY;
+        break;
+
+    case EVENT_OBJECT_NAMECHANGE:
+    case EVENT_OBJECT_CLOAKED:
+    case EVENT_OBJECT_UNCLOAKED:
+        fEvent = LIVE_EVENT_CONTENT;
+        break;
+
+    default:
+        return;
+    }
+
+    if (WinEventCoalescer_Add(&g_LiveEvents, hwnd, fEvent))
+    {
+        SetTimer(GetParent(g_hwndTree), TIMER_ID_LIVETREE, LIVE_UPDATE_INTERVAL, NULL);
+    }
+}
+
+//
+//  Install or remove the hooks, according to the options.
+//
+void WindowTree_UpdateLiveHooks()
+{
+    BOOL fHooked = (g_rgLiveHooks[0] != NULL);
+
+    if (g_opts.fLiveTree && !fHooked)
+    {
+        // WinSpy's own windows are left out, otherwise updating the tree
+        // would generate more events.
+
+        const DWORD dwFlags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+
+        if (!g_LiveEvents.rgSlots && !WinEventCoalescer_Init(&g_LiveEvents, LIVE_MAX_WINDOWS))
+        {
+            return;
+        }
+
+        g_rgLiveHooks[0] = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_REORDER, NULL, LiveEventProc, 0, 0, dwFlags);
+        g_rgLiveHooks[1] = SetWinEventHook(EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE, NULL, LiveEventProc, 0, 0, dwFlags);
+        g_rgLiveHooks[2] = SetWinEventHook(EVENT_OBJECT_CLOAKED, EVENT_OBJECT_UNCLOAKED, NULL, LiveEventProc, 0, 0, dwFlags);
+    }
+    else if (!g_opts.fLiveTree && fHooked)
+    {
+        for (int i = 0; i < ARRAYSIZE(g_rgLiveHooks); i++)
+        {
+            if (g_rgLiveHooks[i])
+            {
+                UnhookWinEvent(g_rgLiveHooks[i]);
+                g_rgLiveHooks[i] = NULL;
+            }
+        }
+
+        KillTimer(GetParent(g_hwndTree), TIMER_ID_LIVETREE);
+        WinEventCoalescer_Free(&g_LiveEvents);
+
+        g_fLiveResyncPending = FALSE;
+    }
+}
+
+//
+//  Removes the nodes flagged in rgfRemove, along with their descendants.
+//
+static void RemoveTreeNodes(BYTE *rgfRemove)
+{
+    // 0 = not known yet, 1 = remove, 2 = keep.  A node goes if any of its
+    // ancestors goes.
+
+    for (size_t i = 0; i < g_cTreeNodesInUse; i++)
+    {
+        ptrdiff_t j = (ptrdiff_t)i;
+
+        while (j != -1 && rgfRemove[j] == 0 && !IsTreeNodeFree(&g_TreeNodes[j]))
+        {
+            j = g_TreeNodes[j].iParent;
+        }
+
+        BYTE fState = (j != -1 && rgfRemove[j] == 1) ? 1 : 2;
+
+        for (ptrdiff_t k = (ptrdiff_t)i; k != j && rgfRemove[k] == 0; k = g_TreeNodes[k].iParent)
+        {
+            rgfRemove[k] = fState;
+        }
+    }
+
+    // Deleting a treeview item also deletes its children, so only delete
+    // the top-most ones.
+
+    for (size_t i = 0; i < g_cTreeNodesInUse; i++)
+    {
+        TREENODE *pNode = &g_TreeNodes[i];
+
+        if (rgfRemove[i] == 1 && !IsTreeNodeFree(pNode) && (pNode->iParent == -1 || rgfRemove[pNode->iParent] != 1))
+        {
+            TreeView_DeleteItem(g_hwndTree, pNode->hTreeItem);
+        }
+    }
+
+    for (size_t i = 0; i < g_cTreeNodesInUse; i++)
+    {
+        if (rgfRemove[i] == 1 && !IsTreeNodeFree(&g_TreeNodes[i]))
+        {
+            FreeTreeNode((ptrdiff_t)i);
+        }
+    }
+}
+
+//
+//  Bring the tree in line with the window hierarchy, keeping its state.
+//
+static void LiveResync()
+{
+    FillGlobalWindowTree();
+
+    SendMessage(g_hwndTree, WM_SETREDRAW, FALSE, 0);
+
+    if (!ApplyWindowSnapshot(g_hwndTree))
+    {
+        TreeView_DeleteAllItems(g_hwndTree);
+        ResetTreeNodes();
+
+        ApplyWindowSnapshot(g_hwndTree);
+    }
+
+    FreeSnapshotMeta();
+
+    SendMessage(g_hwndTree, WM_SETREDRAW, TRUE, 0);
+
+    InvalidateRect(g_hwndTree, NULL, TRUE);
+
+    g_fLiveResyncPending = FALSE;
+    g_dwLastLiveResync   = GetTickCount();
+}
+
+//
+//  The node a new window goes under: its parent window's node, or for a
+//  top-level window the node of its process.  Returns -1 if there isn't
+//  one.
+//
+static ptrdiff_t FindLiveParentNode(HWND hwnd)
+{
+    HWND  hwndParent = GetRealParent(hwnd);
+    DWORD dwPID      = 0;
+
+    if (hwndParent)
+    {
+        return HwndIndex_Find(&g_HwndIndex, hwndParent);
+    }
+
+    GetWindowThreadProcessId(hwnd, &dwPID);
+
+    for (size_t i = 0; i < g_cTreeNodesInUse; i++)
+    {
+        TREENODE *pNode = &g_TreeNodes[i];
+
+        if (!pNode->hwnd && pNode->dwPID == dwPID && dwPID != 0)
+        {
+            return (ptrdiff_t)i;
+        }
+    }
+
+    return -1;
+}
+
+//
+//  Adds a node for a window that has been created or shown, after the
+//  nearest sibling above it in the z-order.  Returns FALSE if the window
+//  can't be placed on its own, and the tree needs a resync instead.
+//
+static BOOL InsertLiveNode(HWND hwnd)
+{
+    ptrdiff_t iParent      = FindLiveParentNode(hwnd);
+    HTREEITEM hInsertAfter = TVI_FIRST;
+    LONG      lOrder       = MINLONG;
+    ptrdiff_t nodeIndex;
+
+    // Lazy nodes are filled in from the snapshot, which doesn't have the
+    // window yet.
+
+    if (iParent == -1 || g_TreeNodes[iParent].fChildrenPending)
+    {
+        return FALSE;
+    }
+
+    for (HWND hwndPrev = GetWindow(hwnd, GW_HWNDPREV); hwndPrev; hwndPrev = GetWindow(hwndPrev, GW_HWNDPREV))
+    {
+        ptrdiff_t iPrev = HwndIndex_Find(&g_HwndIndex, hwndPrev);
+
+        if (iPrev >= 0 && g_TreeNodes[iPrev].iParent == iParent)
+        {
+            hInsertAfter = g_TreeNodes[iPrev].hTreeItem;
+            lOrder       = g_TreeNodes[iPrev].lOrder;
+            break;
+        }
+    }
+
+    nodeIndex = AllocateTreeNode();
+
+    if (nodeIndex < 0)
+    {
+        return FALSE;
+    }
+
+    TREENODE *pNode = &g_TreeNodes[nodeIndex];
+
+    pNode->hwnd    = hwnd;
+    pNode->iParent = iParent;
+    pNode->lOrder  = lOrder;
+    pNode->iSnap   = -1;
+
+    HwndIndex_Add(&g_HwndIndex, hwnd, nodeIndex);
+
+    pNode->hTreeItem = InsertWindowItem(g_hwndTree, nodeIndex, g_TreeNodes[iParent].hTreeItem, hInsertAfter);
+
+    if (!pNode->hTreeItem)
+    {
+        FreeTreeNode(nodeIndex);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+//  Applies the batch of events collected since the last timer tick.
+//
+void WindowTree_OnLiveUpdateTimer()
+{
+    HWND                hwndMain = GetParent(g_hwndTree);
+    const WINEVENTITEM *rgItems;
+    BOOL                fOverflow;
+    size_t              cItems = WinEventCoalescer_TakeBatch(&g_LiveEvents, &rgItems, &fOverflow);
+    BYTE               *rgfRemove = NULL;
+
+    // The tree is refreshed anyway when it is shown again.
+
+    if (!IsWindowVisible(g_hwndTree))
+    {
+        KillTimer(hwndMain, TIMER_ID_LIVETREE);
+        g_fLiveResyncPending = FALSE;
+        return;
+    }
+
+    if (fOverflow)
+    {
+        g_fLiveResyncPending = TRUE;
+    }
+
+    SendMessage(g_hwndTree, WM_SETREDRAW, FALSE, 0);
+
+    // Remove and refresh first, then add.  Adding nodes can grow the node
+    // array, which rgfRemove is sized by.
+
+    for (size_t i = 0; i < cItems; i++)
+    {
+        HWND      hwnd      = rgItems[i].hwnd;
+        UINT      fEvents   = rgItems[i].fEvents;
+        ptrdiff_t nodeIndex = HwndIndex_Find(&g_HwndIndex, hwnd);
+        BOOL      fRemove   = FALSE;
+
+        if (fEvents & LIVE_EVENT_REORDER)
+        {
+            g_fLiveResyncPending = TRUE;
         }
 
+        if (nodeIndex < 0)
+        {
+            continue;
+        }
 
-        //Add the root item
-        tv.hParent = TVI_ROOT;
-        tv.hInsertAfter = TVI_LAST;
-        tv.item.mask = TVIF_STATE | TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_PARAM;
-        tv.item.state = TVIS_EXPANDED;
-        tv.item.stateMask = TVIS_EXPANDED;
-        tv.item.pszText = ach;
-        tv.item.cchTextMax = ARRAYSIZE(ach);
-        tv.item.iImage = DESKTOP_IMAGE;
-        tv.item.iSelectedImage = DESKTOP_IMAGE;
-        tv.item.lParam = (LPARAM)nodeIndex;
+        if ((fEvents & LIVE_EVENT_DESTROY) && !IsWindow(hwnd))
+        {
+            fRemove = TRUE;
+        }
+        else if ((fEvents & LIVE_EVENT_VISIBILITY) && !g_opts.fShowHiddenInList && !IsWindowVisible(hwnd))
+        {
+            // Hidden windows aren't in the tree unless the options say so.
+            fRemove = TRUE;
+        }
+        else if ((fEvents & (LIVE_EVENT_DESTROY | LIVE_EVENT_CREATE)) == (LIVE_EVENT_DESTROY | LIVE_EVENT_CREATE))
+        {
+            // The handle was reused, possibly somewhere else in the tree.
+            g_fLiveResyncPending = TRUE;
+        }
+        else if (fEvents & (LIVE_EVENT_VISIBILITY | LIVE_EVENT_CONTENT))
+        {
+            RefreshTreeItem(nodeIndex, NULL);
+        }
+
+        if (fRemove)
+        {
+            if (!rgfRemove)
+            {
+                rgfRemove = (BYTE *)calloc(g_cTreeNodesInUse, sizeof(BYTE));
+            }
+
+            if (rgfRemove)
+            {
+                rgfRemove[nodeIndex] = 1;
+            }
+            else
+            {
+                g_fLiveResyncPending = TRUE;
+            }
+        }
+    }
 
-        pNode->hTreeItem = TreeView_InsertItem(hwndTree, &tv);
-        g_hRoot = pNode->hTreeItem;
+    if (rgfRemove)
+    {
+        RemoveTreeNodes(rgfRemove);
+        free(rgfRemove);
     }
-    else
+
+    // Windows come out of the batch in the order they were first seen, so
+    // parents are added before their children.  A window that was shown
+    // rather than created may have children that were hidden along with
+    // it, which only a resync picks up.
+
+    for (size_t i = 0; i < cItems; i++)
+    {
+        HWND hwnd    = rgItems[i].hwnd;
+        UINT fEvents = rgItems[i].fEvents;
+
+        if (!(fEvents & (LIVE_EVENT_CREATE | LIVE_EVENT_VISIBILITY)) || HwndIndex_Find(&g_HwndIndex, hwnd) >= 0 || !IsWindow(hwnd))
+        {
+            continue;
+        }
+
+        if (!g_opts.fShowHiddenInList && !IsWindowVisible(hwnd))
+        {
+            continue;
+        }
+
+        if (!InsertLiveNode(hwnd) || (!(fEvents & LIVE_EVENT_CREATE) && GetWindow(hwnd, GW_CHILD)))
+        {
+            g_fLiveResyncPending = TRUE;
+        }
+    }
+
+    SendMessage(g_hwndTree, WM_SETREDRAW, TRUE, 0);
+
+    if (g_fLiveResyncPending && GetTickCount() - g_dwLastLiveResync >= LIVE_RESYNC_INTERVAL)
     {
-        g_hRoot = TVI_ROOT;
+        LiveResync();
     }
 
-    // EnumChildWindows does the hard work for us
+    // Keep ticking while a resync is due, otherwise the next event will
+    // start the timer again.
 
-    EnumChildWindows(hwndDesktop, AllWindowProc, (LPARAM)hwndTree);
+    if (!g_fLiveResyncPending)
+    {
+        KillTimer(hwndMain, TIMER_ID_LIVETREE);
+    }
 }
 
+
 //
 //  Initialize the TreeView resource
 //
@@ -727,6 +1928,8 @@ void WindowTree_Initialize(HWND hwndTree)
 
         // Assign the image list to the treeview control
         TreeView_SetImageList(hwndTree, g_hImgList, TVSIL_NORMAL);
+
+        ProcessIconCache_Initialize(g_hImgList, WINDOW_IMAGE, GetParent(hwndTree), WM_WINSPY_ICONREADY);
     }
 
     //add an item to the tab control
@@ -740,7 +1943,11 @@ void WindowTree_Initialize(HWND hwndTree)
     //subclass the tab control to remove flicker whilst it is resized
     RemoveTabCtrlFlicker(hwndTab);
 
-    //InitAtomList();
+    Edit_SetCueBannerText(GetDlgItem(GetParent(hwndTree), IDC_TREESEARCH), L"Search windows");
+
+    InitClassImageIndex();
+
+    WindowTree_UpdateLiveHooks();
 }
 
 //
@@ -748,32 +1955,88 @@ void WindowTree_Initialize(HWND hwndTree)
 //
 void WindowTree_Destroy()
 {
+    BOOL fLiveTree = g_opts.fLiveTree;
+
+    // Take the hooks down without changing the saved setting.
+
+    g_opts.fLiveTree = FALSE;
+    WindowTree_UpdateLiveHooks();
+    g_opts.fLiveTree = fLiveTree;
+
+    ProcessIconCache_Destroy();
+
     TreeView_SetImageList(g_hwndTree, 0, TVSIL_NORMAL);
     ImageList_Destroy(g_hImgList);
+
+    free(g_rgSnapOrder);
+    free(g_rgSnapFirstChild);
+    free(g_rgSnapToTree);
+
+    g_rgSnapOrder      = NULL;
+    g_rgSnapFirstChild = NULL;
+    g_rgSnapToTree     = NULL;
+    g_cSnapArrays      = 0;
+
+    FreeSnapshotMeta();
+
+    StringPool_Free(&g_ClassNames);
+    StringPool_Free(&g_Captions);
+    g_cchCaptionGarbage = 0;
+
+    SearchIndex_Free(&g_SearchIndex);
 }
 
 //
 //  Find the specified window in the TreeView.
 //
 //  Note that there is no need to interrogate state from the treeview.
-//  We can simply traverse the list of all TREENODEs to perform the HWND
-//  to HTREEITEM mapping.
+//  The HWND index maps straight to the TREENODE, which holds the
+//  HTREEITEM.
 //
 
 HTREEITEM FindTreeItemByHwnd(HWND hwnd)
 {
     if (hwnd)
     {
-        for (size_t i = 0; i < g_cTreeNodesInUse; i++)
+        ptrdiff_t nodeIndex = HwndIndex_Find(&g_HwndIndex, hwnd);
+
+        if (nodeIndex >= 0)
+        {
+            return g_TreeNodes[nodeIndex].hTreeItem;
+        }
+    }
+
+    return NULL;
+}
+
+//
+//  Like FindTreeItemByHwnd, but if the window is in the snapshot under a
+//  node that hasn't been expanded yet then its item is added to the tree.
+//
+
+HTREEITEM EnsureTreeItemForHwnd(HWND hwnd)
+{
+    HTREEITEM hti = FindTreeItemByHwnd(hwnd);
+
+    if (!hti && hwnd && g_opts.fLazyTree)
+    {
+        for (size_t i = 0; i < g_cSnapNodesInUse; i++)
         {
-            if (g_TreeNodes[i].hwnd == hwnd)
+            if (g_SnapNodes[i].hwnd == hwnd)
             {
-                return g_TreeNodes[i].hTreeItem;
+                ptrdiff_t nodeIndex = MaterializeSnapNode(g_hwndTree, (ptrdiff_t)i);
+
+                if (nodeIndex >= 0)
+                {
+                    hti = g_TreeNodes[nodeIndex].hTreeItem;
+                }
+
+                break;
             }
         }
     }
 
-    return NULL;
+    return hti;
 }
 
 //
@@ -784,13 +2047,9 @@ void WindowTree_Refresh(HWND hwndToSelect, BOOL fSetFocus)
     HWND  hwndTree = g_hwndTree;
     DWORD dwStyle;
 
-    if (!g_WinStackList)
-    {
-        g_WinStackList = (WinProc*)malloc(1000 * sizeof(WinProc));
-    }
+    // Capture the current window hierarchy before touching the tree.
 
-    g_WinStackCount = 0;
-    g_cTreeNodesInUse = 0;
+    FillGlobalWindowTree();
 
     EnableWindow(hwndTree, TRUE);
 
@@ -800,10 +2059,19 @@ void WindowTree_Refresh(HWND hwndToSelect, BOOL fSetFocus)
     SendMessage(hwndTree, WM_SETREDRAW, FALSE, 0);
     SetWindowLong(hwndTree, GWL_STYLE, dwStyle & ~WS_VISIBLE);
 
-    TreeView_DeleteAllItems(hwndTree);
+    // An incremental refresh only touches the nodes that changed, so the
+    // expansion, selection and scroll state of the tree is retained.
+    // Otherwise (or if that fails) start over from an empty tree.
+
+    if (!g_opts.fIncrementalRefresh || !ApplyWindowSnapshot(hwndTree))
+    {
+        TreeView_DeleteAllItems(hwndTree);
+        ResetTreeNodes();
 
-    FillGlobalWindowTree(hwndTree);
+        ApplyWindowSnapshot(hwndTree);
+    }
 
+    FreeSnapshotMeta();
 
     SendMessage(hwndTree, WM_SETREDRAW, TRUE, 0);
     dwStyle = GetWindowLong(hwndTree, GWL_STYLE);
@@ -817,7 +2085,7 @@ void WindowTree_Refresh(HWND hwndToSelect, BOOL fSetFocus)
 
     if (hwndToSelect)
     {
-        HTREEITEM hti = FindTreeItemByHwnd(hwndToSelect);
+        HTREEITEM hti = EnsureTreeItemForHwnd(hwndToSelect);
 
         if (hti)
         {
@@ -932,14 +2200,85 @@ void WindowTree_OnSelectionChanged(NMHDR *pnm)
 }
 
 
+//
+//  Lazy nodes get their children added when they are first expanded.
+//
+void WindowTree_OnItemExpanding(NMHDR *pnm)
+{
+    NMTREEVIEW *pnmtv = (NMTREEVIEW *)pnm;
+
+    if (pnmtv->action & TVE_EXPAND)
+    {
+        ptrdiff_t nodeIndex = (ptrdiff_t)pnmtv->itemNew.lParam;
+
+        SendMessage(pnm->hwndFrom, WM_SETREDRAW, FALSE, 0);
+        PopulateTreeChildren(pnm->hwndFrom, nodeIndex);
+        SendMessage(pnm->hwndFrom, WM_SETREDRAW, TRUE, 0);
+    }
+}
+
+
+//
+//  Builds window item labels (LPSTR_TEXTCALLBACK), and answers whether a
+//  lazy node has children (I_CHILDRENCALLBACK), so the expand button can
+//  be shown without populating the node.
+//
+void WindowTree_OnGetDispInfo(NMHDR *pnm)
+{
+    NMTVDISPINFO *pdi = (NMTVDISPINFO *)pnm;
+
+    if (pdi->item.mask & TVIF_TEXT)
+    {
+        TREENODE *pNode = &g_TreeNodes[(ptrdiff_t)pdi->item.lParam];
+
+        if (pNode->hwnd && pdi->item.cchTextMax > 0)
+        {
+            FormatNodeLabel(pNode, pdi->item.pszText, pdi->item.cchTextMax);
+        }
+    }
+
+    if (pdi->item.mask & TVIF_CHILDREN)
+    {
+        ptrdiff_t nodeIndex = (ptrdiff_t)pdi->item.lParam;
+        TREENODE *pNode     = &g_TreeNodes[nodeIndex];
+        ptrdiff_t iSnap     = pNode->iSnap;
+
+        if (!pNode->fChildrenPending)
+        {
+            pdi->item.cChildren = (TreeView_GetChild(pnm->hwndFrom, pNode->hTreeItem) != NULL);
+        }
+        else if (iSnap >= 0 && (size_t)iSnap < g_cSnapNodesInUse)
+        {
+            pdi->item.cChildren = (g_rgSnapFirstChild[iSnap] != -1);
+        }
+        else
+        {
+            pdi->item.cChildren = 0;
+        }
+    }
+}
+
+
+//
+//  A process icon has finished loading in the background.
+//
+void WindowTree_OnIconReady(LPARAM lParam)
+{
+    if (ProcessIconCache_OnIconReady(lParam))
+    {
+        InvalidateRect(g_hwndTree, NULL, FALSE);
+    }
+}
+
+
 void WindowTree_Locate(HWND hwnd)
 {
-    HTREEITEM hti = FindTreeItemByHwnd(hwnd);
+    HTREEITEM hti = EnsureTreeItemForHwnd(hwnd);
 
     if (!hti)
     {
         WindowTree_Refresh(NULL, FALSE);
-        hti = FindTreeItemByHwnd(hwnd);
+        hti = EnsureTreeItemForHwnd(hwnd);
     }
 
     if (hti)
@@ -976,6 +2315,80 @@ HWND WindowTree_GetSelectedWindow()
 }
 
 
+//
+// Refreshes the label and icon of the specified window node.  pMeta is the
+// window's metadata, or NULL to query it now.
+//
+
+void RefreshTreeItem(ptrdiff_t nodeIndex, const WINDOWMETA *pMeta)
+{
+    TREENODE *pNode    = &g_TreeNodes[nodeIndex];
+    BOOL      fChanged = FALSE;
+    int       iImage;
+
+    // Fetch existing icon.
+
+    TVITEM item;
+    ZeroMemory(&item, sizeof(item));
+
+    item.mask  = TVIF_HANDLE | TVIF_IMAGE;
+    item.hItem = pNode->hTreeItem;
+
+    if (!TreeView_GetItem(g_hwndTree, &item))
+    {
+        return;
+    }
+
+    // Compute new label/icon.
+    //
+    // If the widow is no longer valid then replace the icon with a red X
+    // icon to indicate that state, but leave the label alone so that you
+    // can tell what it had been.
+
+    if (!IsWindow(pNode->hwnd))
+    {
+        iImage = INVALID_IMAGE;
+    }
+    else
+    {
+        WINDOWMETA meta;
+
+        if (!pMeta)
+        {
+            meta.hwnd = pNode->hwnd;
+            WindowMeta_QueryLive(&meta, NULL);
+
+            pMeta = &meta;
+        }
+
+        fChanged = SetTreeNodeLabel(pNode, pMeta);
+        iImage   = CalcNodeIcon(pMeta);
+
+        if (fChanged)
+        {
+            IndexTreeNode(nodeIndex);
+        }
+
+        if (pNode->hwnd == GetDesktopWindow())
+        {
+            iImage = DESKTOP_IMAGE;
+        }
+    }
+
+    // If they are different, then update.  Resetting the text callback
+    // makes the treeview ask for the label again.
+
+    if (iImage != item.iImage || fChanged)
+    {
+        item.mask           = TVIF_HANDLE | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_TEXT;
+        item.iImage         = iImage;
+        item.iSelectedImage = iImage;
+        item.pszText        = LPSTR_TEXTCALLBACK;
+
+        TreeView_SetItem(g_hwndTree, &item);
+    }
+}
+
 //
 // Refreshes the text and icon of the treeview node that correpondes to the
 // specified window (if one exists).
@@ -986,62 +2399,148 @@ void WindowTree_RefreshWindowNode(HWND hwnd)
     // The tree is manually refreshed, so it can be the case that there is
     // no node in the tree for the live window.
 
-    HTREEITEM hti = FindTreeItemByHwnd(hwnd);
+    ptrdiff_t nodeIndex = hwnd ? HwndIndex_Find(&g_HwndIndex, hwnd) : -1;
 
-    if (!hti)
+    if (nodeIndex >= 0)
     {
-        return;
+        RefreshTreeItem(nodeIndex, NULL);
     }
+}
 
-    WCHAR szOld[MIN_FORMAT_LEN];
-    WCHAR szNew[MIN_FORMAT_LEN];
-    int   iImage;
+//
+// The label options have changed, so have the treeview ask for the labels
+// again.
+//
+
+void WindowTree_RefreshLabels()
+{
+    TVITEM item;
+
+    ZeroMemory(&item, sizeof(item));
+
+    item.mask    = TVIF_HANDLE | TVIF_TEXT;
+    item.pszText = LPSTR_TEXTCALLBACK;
+
+    SendMessage(g_hwndTree, WM_SETREDRAW, FALSE, 0);
+
+    for (size_t i = 0; i < g_cTreeNodesInUse; i++)
+    {
+        if (g_TreeNodes[i].hwnd)
+        {
+            item.hItem = g_TreeNodes[i].hTreeItem;
+            TreeView_SetItem(g_hwndTree, &item);
+        }
+    }
+
+    SendMessage(g_hwndTree, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(g_hwndTree, NULL, TRUE);
+}
+
+//
+// The item after hti in display order, counting collapsed items, wrapping
+// around to the first item at the end.
+//
+static HTREEITEM GetNextTreeItem(HTREEITEM hti)
+{
+    HTREEITEM htiNext = TreeView_GetChild(g_hwndTree, hti);
+
+    while (!htiNext && hti)
+    {
+        htiNext = TreeView_GetNextSibling(g_hwndTree, hti);
+        hti     = TreeView_GetParent(g_hwndTree, hti);
+    }
 
-    // Fetch existing text/icon.
+    return htiNext ? htiNext : TreeView_GetRoot(g_hwndTree);
+}
 
+static BOOL IsSearchMatch(HTREEITEM hti, const UINT *rgDocs, size_t cDocs)
+{
     TVITEM item;
+    size_t iLow  = 0;
+    size_t iHigh = cDocs;
+
     ZeroMemory(&item, sizeof(item));
 
-    item.mask       = TVIF_HANDLE | TVIF_IMAGE | TVIF_TEXT;
-    item.hItem      = hti;
-    item.pszText    = szOld;
-    item.cchTextMax = ARRAYSIZE(szOld);
+    item.mask  = TVIF_PARAM | TVIF_HANDLE;
+    item.hItem = hti;
 
     if (!TreeView_GetItem(g_hwndTree, &item))
     {
-        return;
+        return FALSE;
     }
 
-    // Compute new text/icon.
-    //
-    // If the widow is no longer valid then replace the icon with a red X
-    // icon to indicate that state, but leave the text alone so that you can
-    // tell what it had been.
+    // The matches are sorted by node index.
 
-    if (!IsWindow(hwnd))
+    while (iLow < iHigh)
     {
-        iImage = INVALID_IMAGE;
-        wcscpy_s(szNew, ARRAYSIZE(szNew), szOld);
+        size_t iMid = (iLow + iHigh) / 2;
+
+        if (rgDocs[iMid] == (UINT)item.lParam)
+            return TRUE;
+
+        if (rgDocs[iMid] < (UINT)item.lParam)
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
     }
-    else
+
+    return FALSE;
+}
+
+//
+// Selects a tree item whose search text contains pszText.  The current
+// selection is kept if it matches, unless fNext is set, in which case the
+// next match below it in the tree is selected (wrapping around).  Returns
+// FALSE if nothing matches.
+//
+// In lazy mode, only the items that have been added to the tree are
+// searched.
+//
+
+BOOL WindowTree_Search(PCWSTR pszText, BOOL fNext)
+{
+    const UINT *rgDocs;
+    size_t      cDocs = SearchIndex_Query(&g_SearchIndex, pszText, &rgDocs);
+    HTREEITEM   htiStart = TreeView_GetSelection(g_hwndTree);
+    HTREEITEM   hti;
+
+    if (cDocs == 0)
+    {
+        return FALSE;
+    }
+
+    if (!htiStart)
     {
-        BOOL fIsVisible = IsWindowVisible(hwnd);
-        UINT dwStyle = GetWindowLong(hwnd, GWL_STYLE);
+        htiStart = TreeView_GetRoot(g_hwndTree);
+        fNext    = FALSE;
+    }
 
-        iImage = CalcNodeTextAndIcon(hwnd, fIsVisible, dwStyle, szNew, ARRAYSIZE(szNew));
+    if (!htiStart)
+    {
+        return FALSE;
     }
 
-    // If they are different, then update.
+    // Walk the tree in display order from the current item, so the
+    // matches come up in the order they are shown rather than in node
+    // order, which is just the order the windows were found in.
 
-    if (iImage != item.iImage || (wcscmp(szOld, szNew) != 0))
+    hti = fNext ? GetNextTreeItem(htiStart) : htiStart;
+
+    while (!IsSearchMatch(hti, rgDocs, cDocs))
     {
-        item.mask           = TVIF_HANDLE | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_TEXT;
-        item.hItem          = hti;
-        item.iImage         = iImage;
-        item.iSelectedImage = iImage;
-        item.pszText        = szNew;
-        item.cchTextMax     = ARRAYSIZE(szNew);
+        hti = GetNextTreeItem(hti);
 
-        TreeView_SetItem(g_hwndTree, &item);
+        if (hti == htiStart)
+        {
+            if (!IsSearchMatch(hti, rgDocs, cDocs))
+                return FALSE;
+
+            break;
+        }
     }
+
+    SendMessage(g_hwndTree, TVM_ENSUREVISIBLE, 0, (LPARAM)hti);
+    SendMessage(g_hwndTree, TVM_SELECTITEM, TVGN_CARET, (LPARAM)hti);
+
+    return TRUE;
 }
@@ -509,9 +509,16 @@ UINT WinSpyDlg_Size(HWND hwnd, WPARAM wParam, LPARAM lParam)
         // Work out the coords of the tab contents
         SendMessage(hwndCtrl, TCM_ADJUSTRECT, FALSE, (LPARAM)&rect);
 
-        // Resize the tree control so that it fills the tab control.
-        hwndCtrl = GetDlgItem(hwnd, IDC_TREE1);
+        // The search box goes across the top of the tab contents, keeping
+        // its height.
+        hwndCtrl = GetDlgItem(hwnd, IDC_TREESEARCH);
         InflateRect(&rect, 1, 1);
+        GetWindowRect(hwndCtrl, &rect2);
+        MoveWindow(hwndCtrl, rect.left, rect.top, GetRectWidth(&rect), GetRectHeight(&rect2), TRUE);
+        rect.top += GetRectHeight(&rect2) + 2;
+
+        // Resize the tree control so that it fills the rest of the tab control.
+        hwndCtrl = GetDlgItem(hwnd, IDC_TREE1);
         MoveWindow(hwndCtrl, rect.left, rect.top, GetRectWidth(&rect), GetRectHeight(&rect), TRUE);
 
         // Position the size-grip
@@ -553,7 +560,7 @@ typedef struct
 void EnableLayoutCtrls(HWND hwnd, UINT layout)
 {
     int i;
-    const int nNumCtrls = 9;
+    const int nNumCtrls = 10;
 
     CtrlEnable ctrl0[] =
     {
@@ -562,6 +569,7 @@ void EnableLayoutCtrls(HWND hwnd, UINT layout)
         IDC_CAPTURE,    FALSE,
         IDC_EXPAND,     FALSE,
         IDC_TAB2,       FALSE,
+        IDC_TREESEARCH, FALSE,
         IDC_TREE1,      FALSE,
         IDC_REFRESH,    FALSE,
         IDC_LOCATE,     FALSE,
@@ -575,6 +583,7 @@ void EnableLayoutCtrls(HWND hwnd, UINT layout)
         IDC_CAPTURE,    TRUE,
         IDC_EXPAND,     TRUE,
         IDC_TAB2,       FALSE,
+        IDC_TREESEARCH, FALSE,
         IDC_TREE1,      FALSE,
         IDC_REFRESH,    FALSE,
         IDC_LOCATE,     FALSE,
@@ -588,6 +597,7 @@ void EnableLayoutCtrls(HWND hwnd, UINT layout)
         IDC_CAPTURE,    TRUE,
         IDC_EXPAND,     TRUE,
         IDC_TAB2,       TRUE,
+        IDC_TREESEARCH, TRUE,
         IDC_TREE1,      TRUE,
         IDC_REFRESH,    TRUE,
         IDC_LOCATE,     TRUE,
@@ -13,47 +13,416 @@
 //
 
 #include "WinSpy.h"
-#include "Utils.h"
+
+#include <malloc.h>
+
 #include "WindowFromPointEx.h"
 
-typedef struct
-{
-    POINT pt;
-    HWND  hwndBest;
-    BOOL  fAllowHidden;
-    DWORD dwArea;
-} ChildSearchData;
+#define CHILDGRID_MAX_SIZE  64
 
 //
-//  Callback function used with FindBestChild
+//  The smallest child containing pt, the way FindBestChild has always
+//  picked it: the first of the smallest, in the order given.
 //
-static BOOL CALLBACK FindBestChildProc(HWND hwnd, LPARAM lParam)
+UINT WindowFromPointEx_FindInList(const CHILDRECT *rgChildren, size_t cChildren, POINT pt, BOOL fAllowHidden)
 {
-    ChildSearchData *pData = (ChildSearchData *)lParam;
-    RECT rect;
+    UINT  iBest  = MAXUINT;
+    DWORD dwArea = MAXUINT;
 
-    GetWindowRect(hwnd, &rect);
+    for (size_t i = 0; i < cChildren; i++)
+    {
+        const CHILDRECT *pChild = &rgChildren[i];
+
+        // If this child window is smaller than the current "best", then
+        // choose this one
+        if (PtInRect(&pChild->rect, pt) &&
+            pChild->dwArea < dwArea &&
+            (fAllowHidden || pChild->fVisible))
+        {
+            dwArea = pChild->dwArea;
+            iBest  = (UINT)i;
+        }
+    }
+
+    return iBest;
+}
+
+static void GetGridCells(const CHILDGRID *pGrid, const RECT *prc, int *pCol0, int *pRow0, int *pCol1, int *pRow1)
+{
+    *pCol0 = (prc->left - pGrid->rcBounds.left) / pGrid->cxCell;
+    *pRow0 = (prc->top - pGrid->rcBounds.top) / pGrid->cyCell;
+    *pCol1 = (prc->right - 1 - pGrid->rcBounds.left) / pGrid->cxCell;
+    *pRow1 = (prc->bottom - 1 - pGrid->rcBounds.top) / pGrid->cyCell;
+}
+
+BOOL WindowFromPointEx_BuildGrid(CHILDGRID *pGrid, const CHILDRECT *rgChildren, size_t cChildren)
+{
+    size_t i;
+    size_t cItems = 0;
+    int    col, row, col0, row0, col1, row1;
+
+    // Size the grid so that each cell holds a few children.
+
+    SetRectEmpty(&pGrid->rcBounds);
+
+    for (i = 0; i < cChildren; i++)
+        UnionRect(&pGrid->rcBounds, &pGrid->rcBounds, &rgChildren[i].rect);
+
+    pGrid->cCols = 1;
+
+    while (pGrid->cCols < CHILDGRID_MAX_SIZE && (size_t)(pGrid->cCols * pGrid->cCols) < cChildren / 4)
+        pGrid->cCols++;
 
-    // Is the mouse inside this child window?
-    if (PtInRect(&rect, pData->pt))
+    pGrid->cRows  = pGrid->cCols;
+    pGrid->cxCell = max(1, (pGrid->rcBounds.right - pGrid->rcBounds.left + pGrid->cCols - 1) / pGrid->cCols);
+    pGrid->cyCell = max(1, (pGrid->rcBounds.bottom - pGrid->rcBounds.top + pGrid->cRows - 1) / pGrid->cRows);
+
+    free(pGrid->rgCellStart);
+    pGrid->rgCellStart = (UINT *)calloc(pGrid->cCols * pGrid->cRows + 1, sizeof(UINT));
+
+    if (!pGrid->rgCellStart)
+        return FALSE;
+
+    // Count the children in each cell, then lay the cells out one after
+    // the other and fill them in, in order.  Empty rectangles never
+    // contain a point, so they're left out.
+
+    for (i = 0; i < cChildren; i++)
+    {
+        if (IsRectEmpty(&rgChildren[i].rect))
+            continue;
+
+        GetGridCells(pGrid, &rgChildren[i].rect, &col0, &row0, &col1, &row1);
+
+        for (row = row0; row <= row1; row++)
+            for (col = col0; col <= col1; col++)
+                pGrid->rgCellStart[row * pGrid->cCols + col + 1]++;
+
+        cItems += (size_t)(col1 - col0 + 1) * (row1 - row0 + 1);
+    }
+
+    for (i = 1; i <= (size_t)(pGrid->cCols * pGrid->cRows); i++)
+        pGrid->rgCellStart[i] += pGrid->rgCellStart[i - 1];
+
+    if (cItems > pGrid->cCellItemsAlloc)
     {
-        // work out area of child window.
-        // Width and height of any screen rectangle are guaranteed to be <32K each,
-        // so their product is definitely much smaller than MAXINT
-        DWORD a = GetRectWidth(&rect) * GetRectHeight(&rect);
-
-        // if this child window is smaller than the
-        // current "best", then choose this one
-        if (a < pData->dwArea && (pData->fAllowHidden || IsWindowVisible(hwnd)))
+        free(pGrid->rgCellItems);
+        pGrid->rgCellItems     = (UINT *)malloc(cItems * sizeof(UINT));
+        pGrid->cCellItemsAlloc = pGrid->rgCellItems ? cItems : 0;
+
+        if (!pGrid->rgCellItems)
+            return FALSE;
+    }
+
+    for (i = 0; i < cChildren; i++)
+    {
+        if (IsRectEmpty(&rgChildren[i].rect))
+            continue;
+
+        GetGridCells(pGrid, &rgChildren[i].rect, &col0, &row0, &col1, &row1);
+
+        for (row = row0; row <= row1; row++)
+            for (col = col0; col <= col1; col++)
+                pGrid->rgCellItems[pGrid->rgCellStart[row * pGrid->cCols + col]++] = (UINT)i;
+    }
+
+    // The fill moved each cell start along to the next cell's start.
+
+    for (i = (size_t)(pGrid->cCols * pGrid->cRows); i > 0; i--)
+        pGrid->rgCellStart[i] = pGrid->rgCellStart[i - 1];
+
+    pGrid->rgCellStart[0] = 0;
+
+    return TRUE;
+}
+
+UINT WindowFromPointEx_FindInGrid(const CHILDGRID *pGrid, const CHILDRECT *rgChildren, POINT pt, BOOL fAllowHidden)
+{
+    UINT  iBest  = MAXUINT;
+    DWORD dwArea = MAXUINT;
+    UINT  i;
+
+    if (!PtInRect(&pGrid->rcBounds, pt))
+        return MAXUINT;
+
+    int col   = (pt.x - pGrid->rcBounds.left) / pGrid->cxCell;
+    int row   = (pt.y - pGrid->rcBounds.top) / pGrid->cyCell;
+    int iCell = row * pGrid->cCols + col;
+
+    for (i = pGrid->rgCellStart[iCell]; i < pGrid->rgCellStart[iCell + 1]; i++)
+    {
+        const CHILDRECT *pChild = &rgChildren[pGrid->rgCellItems[i]];
+
+        if (PtInRect(&pChild->rect, pt) &&
+            pChild->dwArea < dwArea &&
+            (fAllowHidden || pChild->fVisible))
         {
-            pData->dwArea = a;
-            pData->hwndBest = hwnd;
+            dwArea = pChild->dwArea;
+            iBest  = pGrid->rgCellItems[i];
         }
     }
 
+    return iBest;
+}
+
+BOOL WindowFromPointEx_IsAloneInGrid(const CHILDGRID *pGrid, const CHILDRECT *rgChildren, UINT iBest, BOOL fAllowHidden)
+{
+    const CHILDRECT *pBest = &rgChildren[iBest];
+    RECT             rect;
+    int              col, row, col0, row0, col1, row1;
+    UINT             i;
+
+    GetGridCells(pGrid, &pBest->rect, &col0, &row0, &col1, &row1);
+
+    for (row = row0; row <= row1; row++)
+    {
+        for (col = col0; col <= col1; col++)
+        {
+            int iCell = row * pGrid->cCols + col;
+
+            for (i = pGrid->rgCellStart[iCell]; i < pGrid->rgCellStart[iCell + 1]; i++)
+            {
+                const CHILDRECT *pChild = &rgChildren[pGrid->rgCellItems[i]];
+
+                if (pGrid->rgCellItems[i] != iBest &&
+                    pChild->dwArea <= pBest->dwArea &&
+                    (fAllowHidden || pChild->fVisible) &&
+                    IntersectRect(&rect, &pChild->rect, &pBest->rect))
+                {
+                    return FALSE;
+                }
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+void WindowFromPointEx_FreeGrid(CHILDGRID *pGrid)
+{
+    free(pGrid->rgCellStart);
+    free(pGrid->rgCellItems);
+
+    ZeroMemory(pGrid, sizeof(*pGrid));
+}
+
+#ifdef _WIN32
+
+#include "Utils.h"
+
+//
+//  Child hit-test cache
+//
+//  During a finder drag FindBestChild would otherwise enumerate the whole
+//  subtree on every mouse move.  Instead, the children of the window being
+//  searched are captured once, and bucketed into a uniform grid over their
+//  bounding box, so that a mouse move only has to check the children whose
+//  rectangles overlap the grid cell under the mouse.
+//
+//  The children keep their enumeration order within each cell, so the same
+//  window wins as with EnumChildWindows when two are the same size.
+//
+//  The cache is rebuilt when a different window is searched, when that
+//  window moves or resizes, and after CHILDCACHE_MAX_AGE in case children
+//  have come and gone meanwhile.
+//
+//  After each hit the cache also works out whether the winning child is
+//  the only candidate anywhere inside its own rectangle, i.e. no other
+//  child of the same size or smaller overlaps it.  If so, any point in
+//  that rectangle gives the same result, as long as WindowFromPoint still
+//  leads to the same parent there, which the finder tool uses to skip
+//  hit-testing altogether (WindowFromPointEx_GetStableRect and
+//  WindowFromPointEx_CheckStable).
+//
+#define CHILDCACHE_MAX_AGE  1000
+
+typedef struct
+{
+    CHILDRECT   *rgChildren;
+    size_t       cChildren;
+    size_t       cChildrenAlloc;
+} ChildList;
+
+typedef struct
+{
+    BOOL         fEnabled;
+    HWND         hwndParent;
+    RECT         rcParent;
+    DWORD        dwBuildTime;
+
+    ChildList    children;
+    CHILDGRID    grid;
+
+    RECT         rcStable;          // Where the last result still holds
+    HWND         hwndStableParent;  // The window searched for that result
+} ChildCache;
+
+static ChildCache g_ChildCache;
+
+static BOOL CALLBACK CollectChildProc(HWND hwnd, LPARAM lParam)
+{
+    ChildList *pList = (ChildList *)lParam;
+    CHILDRECT *pChild;
+    RECT       rect;
+
+    GetWindowRect(hwnd, &rect);
+
+    if (pList->cChildren == pList->cChildrenAlloc)
+    {
+        size_t     cAlloc     = pList->cChildrenAlloc ? pList->cChildrenAlloc * 2 : 256;
+        CHILDRECT *rgChildren = (CHILDRECT *)realloc(pList->rgChildren, cAlloc * sizeof(CHILDRECT));
+
+        if (!rgChildren)
+            return FALSE;
+
+        pList->rgChildren     = rgChildren;
+        pList->cChildrenAlloc = cAlloc;
+    }
+
+    pChild = &pList->rgChildren[pList->cChildren++];
+
+    // Width and height of any screen rectangle are guaranteed to be <32K
+    // each, so their product is definitely much smaller than MAXINT
+    pChild->rect     = rect;
+    pChild->hwnd     = hwnd;
+    pChild->dwArea   = GetRectWidth(&rect) * GetRectHeight(&rect);
+    pChild->fVisible = IsWindowVisible(hwnd);
+
+    return TRUE;
+}
+
+static void CollectChildren(ChildList *pList, HWND hwndParent)
+{
+    pList->cChildren = 0;
+
+    EnumChildWindows(hwndParent, CollectChildProc, (LPARAM)pList);
+}
+
+static BOOL BuildChildCache(ChildCache *pCache, HWND hwndParent)
+{
+    pCache->hwndParent = NULL;
+
+    CollectChildren(&pCache->children, hwndParent);
+
+    if (!WindowFromPointEx_BuildGrid(&pCache->grid, pCache->children.rgChildren, pCache->children.cChildren))
+        return FALSE;
+
+    pCache->hwndParent  = hwndParent;
+    pCache->dwBuildTime = GetTickCount();
+    GetWindowRect(hwndParent, &pCache->rcParent);
+
+    return TRUE;
+}
+
+//
+//  Same as searching all the children, but from the cache.  Returns FALSE
+//  if the cache can't be used.
+//
+static BOOL FindBestChildCached(HWND hwnd, POINT pt, BOOL fAllowHidden, HWND *phwndBest)
+{
+    ChildCache *pCache = &g_ChildCache;
+    RECT        rcParent;
+    UINT        iBest;
+
+    GetWindowRect(hwnd, &rcParent);
+
+    if (hwnd != pCache->hwndParent ||
+        !EqualRect(&rcParent, &pCache->rcParent) ||
+        GetTickCount() - pCache->dwBuildTime > CHILDCACHE_MAX_AGE)
+    {
+        if (!BuildChildCache(pCache, hwnd))
+            return FALSE;
+    }
+
+    iBest = WindowFromPointEx_FindInGrid(&pCache->grid, pCache->children.rgChildren, pt, fAllowHidden);
+
+    if (iBest == MAXUINT)
+    {
+        *phwndBest = NULL;
+        return TRUE;
+    }
+
+    // The window may have gone since the cache was built.
+    if (!IsWindow(pCache->children.rgChildren[iBest].hwnd))
+    {
+        pCache->hwndParent = NULL;
+        return FALSE;
+    }
+
+    *phwndBest = pCache->children.rgChildren[iBest].hwnd;
+
+    if (WindowFromPointEx_IsAloneInGrid(&pCache->grid, pCache->children.rgChildren, iBest, fAllowHidden))
+    {
+        pCache->rcStable         = pCache->children.rgChildren[iBest].rect;
+        pCache->hwndStableParent = hwnd;
+    }
+
     return TRUE;
 }
 
+//
+//  Hit-testing caches the child windows between these calls.  Used for
+//  the duration of a finder drag.
+//
+void WindowFromPointEx_BeginCache()
+{
+    g_ChildCache.fEnabled   = TRUE;
+    g_ChildCache.hwndParent = NULL;
+}
+
+//
+//  Returns the rectangle (in screen coordinates) around the point last
+//  passed to WindowFromPointEx inside which the result is known not to
+//  change, or an empty rectangle.  Only available while caching.
+//
+void WindowFromPointEx_GetStableRect(RECT *prc)
+{
+    *prc = g_ChildCache.rcStable;
+}
+
+//
+//  The window whose children FindBestChild searches, for the window
+//  WindowFromPoint found.
+//
+static HWND GetSearchParent(HWND hwndFound)
+{
+    HWND hwnd = GetParent(hwndFound);
+
+    // The original window might already be a top-level window,
+    // so we don't want to start at *its* parent
+    if (hwnd == 0 || (GetWindowLong(hwndFound, GWL_STYLE) & WS_POPUP))
+        hwnd = hwndFound;
+
+    return hwnd;
+}
+
+//
+//  The stable rectangle only accounts for the children of one window.
+//  Another top-level window, popup or owned window can be in front of it
+//  at pt, or have moved there since, so this checks that WindowFromPoint
+//  still leads to the same window.  Returns FALSE if pt needs a full
+//  hit-test.
+//
+BOOL WindowFromPointEx_CheckStable(POINT pt)
+{
+    HWND hwndFound;
+
+    if (!PtInRect(&g_ChildCache.rcStable, pt))
+        return FALSE;
+
+    hwndFound = WindowFromPoint(pt);
+
+    return hwndFound && GetSearchParent(hwndFound) == g_ChildCache.hwndStableParent;
+}
+
+void WindowFromPointEx_EndCache()
+{
+    free(g_ChildCache.children.rgChildren);
+    WindowFromPointEx_FreeGrid(&g_ChildCache.grid);
+
+    ZeroMemory(&g_ChildCache, sizeof(g_ChildCache));
+}
+
 //
 //  The problem:
 //
@@ -87,25 +456,12 @@ static BOOL CALLBACK FindBestChildProc(HWND hwnd, LPARAM lParam)
 //
 static HWND FindBestChild(HWND hwndFound, POINT pt, BOOL fAllowHidden)
 {
-    HWND  hwnd;
-    DWORD dwStyle;
-
-    ChildSearchData data;
-    data.fAllowHidden = fAllowHidden;
-    data.dwArea = MAXUINT;
-    data.hwndBest = 0;
-    data.pt = pt;
-
-    hwnd = GetParent(hwndFound);
+    HWND hwnd;
+    HWND hwndBest = 0;
 
-    dwStyle = GetWindowLong(hwndFound, GWL_STYLE);
+    hwnd = GetSearchParent(hwndFound);
 
-    // The original window might already be a top-level window,
-    // so we don't want to start at *its* parent
-    if (hwnd == 0 || (dwStyle & WS_POPUP))
-        hwnd = hwndFound;
-
-    // Enumerate EVERY child window.
+    // Search EVERY child window.
     //
     //  Note to reader:
     //
@@ -114,12 +470,23 @@ static HWND FindBestChild(HWND hwndFound, POINT pt, BOOL fAllowHidden)
     //  fAllowHidden = TRUE
     //  ...experiment!!
     //
-    EnumChildWindows(hwnd, FindBestChildProc, (LPARAM)&data);
+    if (!g_ChildCache.fEnabled || !FindBestChildCached(hwnd, pt, fAllowHidden, &hwndBest))
+    {
+        ChildList list = { 0 };
+        UINT      iBest;
+
+        CollectChildren(&list, hwnd);
 
-    if (data.hwndBest == 0)
-        data.hwndBest = hwnd;
+        iBest    = WindowFromPointEx_FindInList(list.rgChildren, list.cChildren, pt, fAllowHidden);
+        hwndBest = (iBest != MAXUINT) ? list.rgChildren[iBest].hwnd : 0;
 
-    return data.hwndBest;
+        free(list.rgChildren);
+    }
+
+    if (hwndBest == 0)
+        hwndBest = hwnd;
+
+    return hwndBest;
 }
 
 //
@@ -133,6 +500,8 @@ HWND WindowFromPointEx(POINT pt, BOOL fTopLevel, BOOL fAllowHidden)
     // First of all find the parent window under the mouse
     // We are working in SCREEN coordinates
     //
+    SetRectEmpty(&g_ChildCache.rcStable);
+
     hWndPoint = WindowFromPoint(pt);
 
     if (hWndPoint == 0)
@@ -158,3 +527,5 @@ HWND WindowFromPointEx(POINT pt, BOOL fTopLevel, BOOL fAllowHidden)
 
     return hWndPoint;
 }
+
+#endif
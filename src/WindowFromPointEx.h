@@ -5,8 +5,66 @@
 extern "C" {
 #endif
 
+//
+// A child window as WindowFromPointEx sees it: its screen rectangle, with
+// the rectangle's area worked out once.
+//
+typedef struct
+{
+    RECT  rect;
+    HWND  hwnd;
+    DWORD dwArea;
+    BOOL  fVisible;
+}
+CHILDRECT;
+
+//
+// A uniform grid over the bounding box of a set of children, each cell
+// listing the children that overlap it in their original order.  Zero it
+// before the first build.
+//
+typedef struct
+{
+    RECT   rcBounds;            // Union of the child rectangles
+    int    cxCell;
+    int    cyCell;
+    int    cCols;
+    int    cRows;
+    UINT  *rgCellStart;         // [cCols * cRows + 1] Index into rgCellItems
+    UINT  *rgCellItems;         // Child indices, grouped by cell
+    size_t cCellItemsAlloc;
+}
+CHILDGRID;
+
+//
+// The index of the smallest child containing pt (the first of them if
+// several are that size), or MAXUINT.  Hidden children only count with
+// fAllowHidden.  FindInList checks every child; FindInGrid only the ones
+// in pt's cell, and gives the same answer.
+//
+UINT WindowFromPointEx_FindInList(const CHILDRECT *rgChildren, size_t cChildren, POINT pt, BOOL fAllowHidden);
+
+BOOL WindowFromPointEx_BuildGrid(CHILDGRID *pGrid, const CHILDRECT *rgChildren, size_t cChildren);
+UINT WindowFromPointEx_FindInGrid(const CHILDGRID *pGrid, const CHILDRECT *rgChildren, POINT pt, BOOL fAllowHidden);
+void WindowFromPointEx_FreeGrid(CHILDGRID *pGrid);
+
+//
+// TRUE if no other child that counts overlaps child iBest without being
+// larger, so that it's the answer for every point inside it.
+//
+BOOL WindowFromPointEx_IsAloneInGrid(const CHILDGRID *pGrid, const CHILDRECT *rgChildren, UINT iBest, BOOL fAllowHidden);
+
+#ifdef _WIN32
+
 HWND WindowFromPointEx(POINT pt, BOOL fTopLevel, BOOL fAllowHidden);
 
+void WindowFromPointEx_BeginCache();
+void WindowFromPointEx_EndCache();
+void WindowFromPointEx_GetStableRect(RECT *prc);
+BOOL WindowFromPointEx_CheckStable(POINT pt);
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,236 @@
+//
+//  WindowSnapshot.c
+//
+//  Gathers the metadata displayed in the window tree for a whole list of
+//  windows at once, spreading the queries over the system thread pool.
+//
+//  A refresh used to query each window in turn on the UI thread, so every
+//  hung app added the full WM_GETTEXT timeout to it.  Now the slow ones
+//  only hold up the worker that got them.
+//
+
+#include "WinSpy.h"
+
+#include "WindowSnapshot.h"
+
+//
+//  Windows are handed out to the workers in chunks of this many, and
+//  lists shorter than this are done on the calling thread.
+//
+#define QUERY_CHUNK         16
+
+#define MAX_QUERY_THREADS   16
+
+#ifdef _WIN32
+
+const WINDOWMETABACKEND g_LiveWindowMeta = { WindowMeta_QueryLive, NULL };
+
+void CALLBACK WindowMeta_QueryLive(WINDOWMETA *pMeta, void *pContext)
+{
+    HWND hwnd = pMeta->hwnd;
+
+    UNREFERENCED_PARAMETER(pContext);
+
+    pMeta->dwCloaked = 0;
+    DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &pMeta->dwCloaked, sizeof(pMeta->dwCloaked));
+
+    pMeta->dwStyle   = GetWindowLong(hwnd, GWL_STYLE);
+    pMeta->dwExStyle = GetWindowLong(hwnd, GWL_EXSTYLE);
+    pMeta->fVisible  = IsWindowVisible(hwnd);
+    pMeta->wAtom     = (WORD)GetClassLong(hwnd, GCW_ATOM);
+    pMeta->hModule   = (HINSTANCE)GetClassLongPtr(hwnd, GCLP_HMODULE);
+
+    if (!GetClassName(hwnd, pMeta->szClass, ARRAYSIZE(pMeta->szClass)))
+    {
+        pMeta->szClass[0] = L'\0';
+    }
+
+    pMeta->szCaption[0] = L'\0';
+
+    if (!SendMessageTimeout(
+        hwnd,
+        WM_GETTEXT,
+        ARRAYSIZE(pMeta->szCaption),
+        (LPARAM)pMeta->szCaption,
+        SMTO_ABORTIFHUNG, 100, NULL))
+    {
+        GetWindowText(hwnd, pMeta->szCaption, ARRAYSIZE(pMeta->szCaption));
+    }
+
+    // WM_GETTEXT does not guarantee null termination.
+
+    pMeta->szCaption[ARRAYSIZE(pMeta->szCaption) - 1] = L'\0';
+}
+
+#endif
+
+void CALLBACK WindowMeta_QueryFake(WINDOWMETA *pMeta, void *pContext)
+{
+    static const PCWSTR rgszClass[] =
+    {
+        L"#32770", L"Button", L"Edit", L"Static", L"ComboBox",
+        L"ListBox", L"SysListView32", L"SysTreeView32", L"msctls_progress32",
+    };
+
+    FAKEWINDOWMETA *pFake = (FAKEWINDOWMETA *)pContext;
+    UINT            id    = (UINT)(UINT_PTR)pMeta->hwnd;
+    UINT            hash  = id * 2654435761u;
+
+    pMeta->dwStyle   = WS_VISIBLE | ((id % 8) ? WS_CHILD : WS_OVERLAPPEDWINDOW);
+    pMeta->dwExStyle = (hash & 0x00080000) ? WS_EX_LAYERED : 0;
+    pMeta->fVisible  = (hash >> 28) != 0;
+    pMeta->dwCloaked = ((hash >> 24) == 0) ? DWM_CLOAKED_SHELL : 0;
+    pMeta->wAtom     = (WORD)(0xC000 + (id % ARRAYSIZE(rgszClass)));
+    pMeta->hModule   = NULL;
+
+    if (!pMeta->fVisible)
+    {
+        pMeta->dwStyle &= ~WS_VISIBLE;
+    }
+
+    wcscpy_s(pMeta->szClass, ARRAYSIZE(pMeta->szClass), rgszClass[id % ARRAYSIZE(rgszClass)]);
+    swprintf_s(pMeta->szCaption, ARRAYSIZE(pMeta->szCaption), L"Window %u", id);
+
+    if (pFake && pFake->cHungEvery && (id % pFake->cHungEvery) == 0)
+    {
+        Sleep(pFake->dwHungDelay);
+    }
+}
+
+//
+//  State shared by the workers of one WindowSnapshot_Query call.
+//
+typedef struct
+{
+    WINDOWMETA              *rgMeta;
+    size_t                   cMeta;
+    const WINDOWMETABACKEND *pBackend;
+    volatile LONG            iNext;         // Next unclaimed entry
+    volatile LONG            cRefs;         // Outstanding workers, plus one for the caller
+    HANDLE                   hDone;         // Set when the last worker finishes
+}
+QUERYJOB;
+
+static void QueryRange(const WINDOWMETABACKEND *pBackend, WINDOWMETA *rgMeta, size_t cMeta)
+{
+    for (size_t i = 0; i < cMeta; i++)
+    {
+        if (rgMeta[i].hwnd)
+        {
+            pBackend->pfnQuery(&rgMeta[i], pBackend->pContext);
+        }
+    }
+}
+
+static void CALLBACK QueryWorker(PTP_CALLBACK_INSTANCE pInstance, PVOID pv)
+{
+    QUERYJOB *pJob = (QUERYJOB *)pv;
+
+    UNREFERENCED_PARAMETER(pInstance);
+
+    for (;;)
+    {
+        size_t iFirst = (size_t)InterlockedExchangeAdd(&pJob->iNext, QUERY_CHUNK);
+
+        if (iFirst >= pJob->cMeta)
+        {
+            break;
+        }
+
+        QueryRange(pJob->pBackend, &pJob->rgMeta[iFirst], min((size_t)QUERY_CHUNK, pJob->cMeta - iFirst));
+    }
+
+    // The caller may free the job as soon as the event is set, so this
+    // must be the last thing that touches it.
+
+    if (InterlockedDecrement(&pJob->cRefs) == 0)
+    {
+        SetEvent(pJob->hDone);
+    }
+}
+
+void WindowSnapshot_Query(WINDOWMETA *rgMeta, size_t cMeta, const WINDOWMETABACKEND *pBackend, UINT cThreads)
+{
+    QUERYJOB job;
+    UINT     cSubmitted = 0;
+
+    if (cThreads == 0)
+    {
+        SYSTEM_INFO si;
+
+        // The workers mostly wait on other processes, so use more of them
+        // than there are processors.
+
+        GetSystemInfo(&si);
+        cThreads = min(si.dwNumberOfProcessors * 2, (DWORD)MAX_QUERY_THREADS);
+    }
+
+    cThreads = (UINT)min((size_t)cThreads, (cMeta + QUERY_CHUNK - 1) / QUERY_CHUNK);
+
+    if (cThreads <= 1 || cMeta > MAXLONG / 2)
+    {
+        QueryRange(pBackend, rgMeta, cMeta);
+        return;
+    }
+
+    job.rgMeta   = rgMeta;
+    job.cMeta    = cMeta;
+    job.pBackend = pBackend;
+    job.iNext    = 0;
+    job.cRefs    = 1;
+    job.hDone    = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    if (!job.hDone)
+    {
+        QueryRange(pBackend, rgMeta, cMeta);
+        return;
+    }
+
+    for (cSubmitted = 0; cSubmitted < cThreads; cSubmitted++)
+    {
+        InterlockedIncrement(&job.cRefs);
+
+        if (!TrySubmitThreadpoolCallback(QueryWorker, &job, NULL))
+        {
+            InterlockedDecrement(&job.cRefs);
+            break;
+        }
+    }
+
+    if (cSubmitted == 0)
+    {
+        // Couldn't get any workers, so do it all here.
+
+        job.iNext = (LONG)cMeta;
+        QueryRange(pBackend, rgMeta, cMeta);
+    }
+
+    // Drop the caller's reference.  If workers are still going, wait for
+    // them, dispatching any messages they send to our own windows.
+
+    if (InterlockedDecrement(&job.cRefs) != 0)
+    {
+        for (;;)
+        {
+            MSG   msg;
+            DWORD dwWait = MsgWaitForMultipleObjects(1, &job.hDone, FALSE, INFINITE, QS_SENDMESSAGE);
+
+            if (dwWait == WAIT_OBJECT_0 + 1)
+            {
+                PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+                continue;
+            }
+
+            // The workers still hold a pointer to the job.
+
+            if (dwWait != WAIT_OBJECT_0)
+            {
+                WaitForSingleObject(job.hDone, INFINITE);
+            }
+
+            break;
+        }
+    }
+
+    CloseHandle(job.hDone);
+}
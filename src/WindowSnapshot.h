@@ -0,0 +1,86 @@
+#ifndef WINDOWSNAPSHOT_INCLUDED
+#define WINDOWSNAPSHOT_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_CLASS_LEN   40
+#define MAX_WINTEXT_LEN 200
+
+//
+// WINDOWMETA
+//
+// Everything the window tree needs to know about a window to display it.
+// These are gathered in bulk by WindowSnapshot_Query, so that the slow
+// per-window calls (WM_GETTEXT to a hung app can take 100ms) overlap
+// instead of adding up.
+//
+
+typedef struct
+{
+    HWND      hwnd;                         // Set by the caller
+    DWORD     dwStyle;
+    DWORD     dwExStyle;
+    DWORD     dwCloaked;                    // DWMWA_CLOAKED
+    BOOL      fVisible;
+    WORD      wAtom;                        // GCW_ATOM
+    HINSTANCE hModule;                      // GCLP_HMODULE
+    WCHAR     szClass[MAX_CLASS_LEN];
+    WCHAR     szCaption[MAX_WINTEXT_LEN];
+}
+WINDOWMETA;
+
+//
+// Fills in the WINDOWMETA for pMeta->hwnd.  Called on worker threads, so
+// must not touch any global state.
+//
+typedef void (CALLBACK *WINDOWMETAPROC)(WINDOWMETA *pMeta, void *pContext);
+
+typedef struct
+{
+    WINDOWMETAPROC  pfnQuery;
+    void           *pContext;
+}
+WINDOWMETABACKEND;
+
+#ifdef _WIN32
+
+//
+// The live backend queries the real window.
+//
+void CALLBACK WindowMeta_QueryLive(WINDOWMETA *pMeta, void *pContext);
+
+extern const WINDOWMETABACKEND g_LiveWindowMeta;
+
+#endif
+
+//
+// The fake backend makes up the metadata from the handle value alone, so
+// any handle values can be used (e.g. 1..100000 for a synthetic hierarchy)
+// and the results are always the same.  Every cHungEvery'th window takes
+// dwHungDelay ms to answer, to stand in for hung apps.  The tests and
+// benchmarks run WindowSnapshot_Query over it (tests/WindowSnapshotTest.c).
+//
+typedef struct
+{
+    UINT    cHungEvery;                     // 0 for none
+    DWORD   dwHungDelay;
+}
+FAKEWINDOWMETA;
+
+void CALLBACK WindowMeta_QueryFake(WINDOWMETA *pMeta, void *pContext);
+
+//
+// Fills in rgMeta[0..cMeta) using up to cThreads thread pool workers (0 to
+// pick a default).  Entries with a NULL hwnd are skipped.  Sent messages
+// are dispatched while waiting, so windows belonging to the calling thread
+// can still answer WM_GETTEXT.
+//
+void WindowSnapshot_Query(WINDOWMETA *rgMeta, size_t cMeta, const WINDOWMETABACKEND *pBackend, UINT cThreads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
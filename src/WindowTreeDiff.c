@@ -0,0 +1,260 @@
+//
+//  WindowTreeDiff.c
+//
+//  Reconciles the window tree against a fresh snapshot of the window
+//  hierarchy, so that a refresh only has to touch the nodes that changed.
+//
+//  Nothing in here talks to the treeview, the caller applies the result.
+//
+
+#include "WinSpy.h"
+
+#include <malloc.h>
+
+#include "WindowTreeDiff.h"
+
+//
+// Open addressed hash table of old node indices, keyed by window/process.
+//
+
+typedef struct
+{
+    ptrdiff_t *rgSlots;
+    size_t     cMask;
+}
+NODEHASH;
+
+static size_t HashNodeKey(HWND hwnd, DWORD dwPID)
+{
+    ULONGLONG key = (ULONG_PTR)hwnd ^ ((ULONGLONG)dwPID << 32);
+
+    key *= 0x9E3779B97F4A7C15ull;
+
+    return (size_t)(key >> 17);
+}
+
+static BOOL NodeHash_Init(NODEHASH *pHash, size_t cItems)
+{
+    size_t cSlots = 16;
+
+    while (cSlots < cItems * 2)
+    {
+        cSlots *= 2;
+    }
+
+    pHash->rgSlots = (ptrdiff_t *)malloc(cSlots * sizeof(ptrdiff_t));
+    pHash->cMask   = cSlots - 1;
+
+    if (!pHash->rgSlots)
+    {
+        return FALSE;
+    }
+
+    for (size_t i = 0; i < cSlots; i++)
+    {
+        pHash->rgSlots[i] = -1;
+    }
+
+    return TRUE;
+}
+
+static void NodeHash_Add(NODEHASH *pHash, const TREENODE *rgNodes, ptrdiff_t index)
+{
+    size_t slot = HashNodeKey(rgNodes[index].hwnd, rgNodes[index].dwPID) & pHash->cMask;
+
+    while (pHash->rgSlots[slot] != -1)
+    {
+        slot = (slot + 1) & pHash->cMask;
+    }
+
+    pHash->rgSlots[slot] = index;
+}
+
+static ptrdiff_t NodeHash_Find(NODEHASH *pHash, const TREENODE *rgNodes, HWND hwnd, DWORD dwPID)
+{
+    size_t slot = HashNodeKey(hwnd, dwPID) & pHash->cMask;
+
+    while (pHash->rgSlots[slot] != -1)
+    {
+        const TREENODE *pNode = &rgNodes[pHash->rgSlots[slot]];
+
+        if (pNode->hwnd == hwnd && pNode->dwPID == dwPID)
+        {
+            return pHash->rgSlots[slot];
+        }
+
+        slot = (slot + 1) & pHash->cMask;
+    }
+
+    return -1;
+}
+
+//
+// Sort helper used to group the new nodes by parent.
+//
+
+typedef struct
+{
+    ptrdiff_t iParent;
+    LONG      lOrder;
+    ptrdiff_t index;
+}
+SIBLINGKEY;
+
+static int __cdecl CompareSiblingKeys(const void *p1, const void *p2)
+{
+    const SIBLINGKEY *pKey1 = (const SIBLINGKEY *)p1;
+    const SIBLINGKEY *pKey2 = (const SIBLINGKEY *)p2;
+
+    if (pKey1->iParent != pKey2->iParent)
+        return (pKey1->iParent < pKey2->iParent) ? -1 : 1;
+
+    if (pKey1->lOrder != pKey2->lOrder)
+        return (pKey1->lOrder < pKey2->lOrder) ? -1 : 1;
+
+    return (pKey1->index < pKey2->index) ? -1 : (pKey1->index > pKey2->index);
+}
+
+void WindowTreeDiff_Free(TREEDIFF *pDiff)
+{
+    free(pDiff->rgMatch);
+    free(pDiff->rgOldKept);
+    free(pDiff->rgOrder);
+    free(pDiff->rgResort);
+
+    ZeroMemory(pDiff, sizeof(*pDiff));
+}
+
+//
+// Computes the TREEDIFF for the two node arrays.
+//
+// rgOld may contain free slots, and its nodes can be in any order.
+// rgNew must not contain free slots, and every node must come after its
+// parent (which is how the snapshot is enumerated).
+//
+// Returns FALSE if out of memory, in which case the caller should fall
+// back to rebuilding the tree from scratch.
+//
+
+BOOL WindowTreeDiff_Compute(const TREENODE *rgOld, size_t cOld, const TREENODE *rgNew, size_t cNew, TREEDIFF *pDiff)
+{
+    NODEHASH    hash  = { 0 };
+    SIBLINGKEY *rgKey = NULL;
+    BOOL        fOK   = FALSE;
+
+    ZeroMemory(pDiff, sizeof(*pDiff));
+
+    pDiff->rgMatch   = (ptrdiff_t *)malloc((cNew + 1) * sizeof(ptrdiff_t));
+    pDiff->rgOldKept = (BOOL *)calloc((cOld + 1), sizeof(BOOL));
+    pDiff->rgOrder   = (ptrdiff_t *)malloc((cNew + 1) * sizeof(ptrdiff_t));
+    pDiff->rgResort  = (BOOL *)calloc((cNew + 1), sizeof(BOOL));
+    rgKey            = (SIBLINGKEY *)malloc((cNew + 1) * sizeof(SIBLINGKEY));
+
+    if (!pDiff->rgMatch || !pDiff->rgOldKept || !pDiff->rgOrder || !pDiff->rgResort || !rgKey)
+    {
+        goto Cleanup;
+    }
+
+    if (!NodeHash_Init(&hash, cOld))
+    {
+        goto Cleanup;
+    }
+
+    for (size_t j = 0; j < cOld; j++)
+    {
+        if (!IsTreeNodeFree(&rgOld[j]))
+        {
+            NodeHash_Add(&hash, rgOld, (ptrdiff_t)j);
+        }
+    }
+
+    // Match up the nodes.  Parents precede their children in rgNew, so the
+    // parent's match is always known by the time we get to the child.
+
+    for (size_t i = 0; i < cNew; i++)
+    {
+        const TREENODE *pNew = &rgNew[i];
+        ptrdiff_t       iOld = NodeHash_Find(&hash, rgOld, pNew->hwnd, pNew->dwPID);
+
+        if (iOld != -1)
+        {
+            ptrdiff_t iOldParent = (pNew->iParent == -1) ? -1 : pDiff->rgMatch[pNew->iParent];
+
+            // Moving to a different parent means delete + reinsert.  So
+            // does a window that EnumChildWindows reported twice.
+
+            if (pNew->iParent != -1 && iOldParent == -1)
+            {
+                iOld = -1;
+            }
+            else if (rgOld[iOld].iParent != iOldParent || pDiff->rgOldKept[iOld])
+            {
+                iOld = -1;
+            }
+        }
+
+        pDiff->rgMatch[i] = iOld;
+
+        if (iOld != -1)
+        {
+            pDiff->rgOldKept[iOld] = TRUE;
+        }
+
+        rgKey[i].iParent = pNew->iParent;
+        rgKey[i].lOrder  = pNew->lOrder;
+        rgKey[i].index   = (ptrdiff_t)i;
+    }
+
+    // Group the new nodes by parent, in display order.  Walking this list
+    // lets the caller insert each new node after its preceding sibling.
+
+    qsort(rgKey, cNew, sizeof(SIBLINGKEY), CompareSiblingKeys);
+
+    LONG lLastKeptOrder = 0;
+    BOOL fSeenKept      = FALSE;
+
+    for (size_t k = 0; k < cNew; k++)
+    {
+        ptrdiff_t i = rgKey[k].index;
+
+        pDiff->rgOrder[k] = i;
+
+        if (k == 0 || rgKey[k - 1].iParent != rgKey[k].iParent)
+        {
+            fSeenKept = FALSE;
+        }
+
+        // Kept nodes are not moved, so if they no longer appear in the same
+        // relative order as before then the parent needs re-sorting.
+
+        if (pDiff->rgMatch[i] != -1)
+        {
+            LONG lOldOrder = rgOld[pDiff->rgMatch[i]].lOrder;
+
+            if (fSeenKept && lOldOrder < lLastKeptOrder)
+            {
+                if (rgKey[k].iParent == -1)
+                    pDiff->fResortRoot = TRUE;
+                else
+                    pDiff->rgResort[rgKey[k].iParent] = TRUE;
+            }
+
+            lLastKeptOrder = lOldOrder;
+            fSeenKept      = TRUE;
+        }
+    }
+
+    fOK = TRUE;
+
+Cleanup:
+
+    free(hash.rgSlots);
+    free(rgKey);
+
+    if (!fOK)
+    {
+        WindowTreeDiff_Free(pDiff);
+    }
+
+    return fOK;
+}
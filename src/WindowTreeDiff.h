@@ -0,0 +1,71 @@
+#ifndef WINDOWTREEDIFF_INCLUDED
+#define WINDOWTREEDIFF_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// TREENODE
+//
+// Struct used to hold per tree item state.  The TVITEM::lParam for every
+// item in the tree is the index of one of these.  Different fields are
+// relevant for different types of items (process vs. window nodes).
+//
+// All TREENODE instances are allocated in a global pool (g_TreeNodes).
+// The same struct is used for the window hierarchy snapshot that the tree
+// is built from, in which case the fields marked "tree only" are not set.
+// The diff ignores those fields.
+//
+// Window items in the tree use LPSTR_TEXTCALLBACK, and their label is built
+// from the class/caption/atom/cloaked fields when the treeview asks for it.
+//
+// A node with neither hwnd nor dwPID set is a free slot.  For free slots
+// in the tree pool, iParent links to the next free slot.
+//
+
+typedef struct
+{
+    HWND        hwnd;               // Only set for window nodes
+    DWORD       dwPID;              // Only set for process nodes
+    HTREEITEM   hTreeItem;
+    ptrdiff_t   iParent;            // Index of the parent node, -1 for top-level nodes
+    LONG        lOrder;             // Siblings are displayed in ascending lOrder
+    ptrdiff_t   iSnap;              // Tree only: matching node in the current snapshot
+    BOOL        fChildrenPending;   // Tree only: children not added yet (lazy mode)
+    UINT        ichClass;           // Tree only: interned class name in the label pool
+    UINT        ichCaption;         // Tree only: caption in the label pool
+    WORD        wAtom;              // Tree only: class atom
+    BYTE        bCloaked;           // Tree only: DWMWA_CLOAKED
+}
+TREENODE;
+
+#define IsTreeNodeFree(pNode)   ((pNode)->hwnd == NULL && (pNode)->dwPID == 0)
+
+//
+// Result of reconciling the nodes currently in the tree (old) against a
+// fresh snapshot of the window hierarchy (new).
+//
+// An old node is kept if a new node has the same window/process, and the
+// parents of the two are themselves matched (or both are top-level).  Old
+// nodes that are not kept must be deleted along with their subtrees, and
+// new nodes that are not matched must be inserted.
+//
+typedef struct
+{
+    ptrdiff_t *rgMatch;         // [cNew] Matching old node, or -1 to insert
+    BOOL      *rgOldKept;       // [cOld] TRUE if the old node survives
+    ptrdiff_t *rgOrder;         // [cNew] New nodes grouped by parent, then sorted by lOrder
+    BOOL      *rgResort;        // [cNew] Kept children of this node are out of order
+    BOOL       fResortRoot;     // Kept top-level nodes are out of order
+}
+TREEDIFF;
+
+BOOL WindowTreeDiff_Compute(const TREENODE *rgOld, size_t cOld, const TREENODE *rgNew, size_t cNew, TREEDIFF *pDiff);
+void WindowTreeDiff_Free(TREEDIFF *pDiff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
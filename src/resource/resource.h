@@ -38,6 +38,8 @@
 #define IDD_POSTER                      166
 #define IDD_TAB_DPI                     167
 #define IDB_WINDOW_CLOAKED              168
+#define IDD_STYLEQUERY                  169
+#define IDD_TEXTVIEW                    170
 #define IDC_LIST1                       1000
 #define IDC_DRAGGER                     1001
 #define IDC_LIST2                       1001
@@ -146,6 +148,22 @@
 #define IDC_STYLEEXT_LABEL              1090
 #define IDC_STYLEEXT                    1091
 #define IDC_EDITSTYLEEXT                1092
+#define IDC_OPTIONS_INCREMENTAL         1093
+#define IDC_OPTIONS_LAZYTREE            1094
+#define IDC_OPTIONS_LIVETREE            1095
+#define IDC_TREESEARCH                  1096
+#define IDC_STYLEQUERY_TEXT             1097
+#define IDC_STYLEQUERY_FIND             1098
+#define IDC_STYLEQUERY_RESULTS          1099
+#define IDC_STYLEQUERY_STATUS           1100
+#define IDC_OPTIONS_REMOTEAGENT         1101
+#define IDC_TEXTVIEW_LINES              1102
+#define IDC_TEXTVIEW_PROGRESS           1103
+#define IDC_TEXTVIEW_STATUS             1104
+#define IDC_TEXTVIEW_COPY               1105
+#define IDC_PROCESS_INTEGRITY           1106
+#define IDC_OPTIONS_AUTOUPDATE_INTERVAL 1107
+#define IDC_OPTIONS_AUTOUPDATE_SPIN     1108
 #define IDM_GOTO_TAB_GENERAL            3001
 #define IDM_GOTO_TAB_STYLES             3002
 #define IDM_GOTO_TAB_PROPERTIES         3003
@@ -180,15 +198,18 @@
 #define IDM_BYTES_COPY                  40047
 #define IDM_POPUP_POSTER                40048
 #define IDM_WINSPY_BROADCASTER          40049
+#define IDM_WINSPY_FINDSTYLES           40050
+#define IDM_WINSPY_COPYWNDPROCS         40051
+#define IDM_POPUP_VIEWTEXT              40052
 
 // Next default values for new objects
 //
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
-#define _APS_NEXT_RESOURCE_VALUE        168
-#define _APS_NEXT_COMMAND_VALUE         40050
-#define _APS_NEXT_CONTROL_VALUE         1090
+#define _APS_NEXT_RESOURCE_VALUE        171
+#define _APS_NEXT_COMMAND_VALUE         40053
+#define _APS_NEXT_CONTROL_VALUE         1109
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
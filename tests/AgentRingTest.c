@@ -0,0 +1,230 @@
+//
+//  AgentRingTest.c
+//
+//  Checks the ring protocol from AgentRing.h: the full and empty cases on
+//  one thread, then WinSpy's side and a stand-in agent on threads of their
+//  own, over a ring on the heap instead of in a file mapping.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "AgentRing.h"
+#include "TestUtils.h"
+
+#define THREAD_REQUESTS 200000
+
+static HWND MakeHwnd(LONG iSeq)
+{
+    return (HWND)(ULONG_PTR)(0x10000 + (ULONG)iSeq * 4);
+}
+
+static void MakeRequest(AGENTSLOT *pSlot, LONG iSeq)
+{
+    pSlot->hwnd     = MakeHwnd(iSeq);
+    pSlot->atom     = (ATOM)(0xC000 + (iSeq & 0xFFF));
+    pSlot->fUnicode = iSeq & 1;
+    pSlot->fQuery   = 1 + (UINT)(iSeq % 7);
+}
+
+//
+//  What the stand-in agent answers: everything asked for, with the class
+//  and text worked out from the request, so WinSpy's side can tell whose
+//  answer it got.
+//
+static void AnswerRequest(AGENTSLOT *pSlot)
+{
+    pSlot->fAnswered        = pSlot->fQuery;
+    pSlot->wc.cbSize        = sizeof(pSlot->wc);
+    pSlot->wc.cbClsExtra    = pSlot->atom;
+    pSlot->wc.cbWndExtra    = pSlot->fUnicode;
+
+    swprintf(pSlot->szText, AGENT_MAX_TEXT, L"%p", (void *)pSlot->hwnd);
+}
+
+static BOOL IsAnswerFor(const AGENTSLOT *pSlot, LONG iSeq)
+{
+    WCHAR szText[AGENT_MAX_TEXT];
+
+    swprintf(szText, AGENT_MAX_TEXT, L"%p", (void *)MakeHwnd(iSeq));
+
+    return pSlot->hwnd == MakeHwnd(iSeq) &&
+           pSlot->fAnswered == pSlot->fQuery &&
+           pSlot->wc.cbClsExtra == pSlot->atom &&
+           pSlot->wc.cbWndExtra == pSlot->fUnicode &&
+           wcscmp(pSlot->szText, szText) == 0;
+}
+
+static void TestSingleThread(void)
+{
+    AGENTRING *pRing = (AGENTRING *)malloc(sizeof(AGENTRING));
+    AGENTSLOT *pSlot;
+
+    REQUIRE(pRing, );
+
+    AgentRing_Init(pRing);
+
+    CHECK(AgentRing_NextRequest(pRing) == NULL);
+
+    // Fill the ring.  The agent only sees a request once it's posted, and
+    // always sees the oldest first.
+
+    for (LONG i = 0; i < AGENT_RING_SLOTS; i++)
+    {
+        pSlot = AgentRing_BeginRequest(pRing);
+
+        REQUIRE(pSlot, );
+        CHECK(AgentRing_NextRequest(pRing) == (i ? AgentRing_GetSlot(pRing, 0) : NULL));
+
+        MakeRequest(pSlot, i);
+
+        CHECK(AgentRing_PostRequest(pRing) == i);
+        CHECK(AgentRing_GetSlot(pRing, i) == pSlot);
+    }
+
+    CHECK(AgentRing_BeginRequest(pRing) == NULL);
+
+    // The agent takes them in order, and each slot frees up once it's
+    // completed.
+
+    for (LONG i = 0; i < AGENT_RING_SLOTS; i++)
+    {
+        pSlot = AgentRing_NextRequest(pRing);
+
+        REQUIRE(pSlot, );
+        CHECK(pSlot->hwnd == MakeHwnd(i));
+        CHECK(!AgentRing_IsComplete(pRing, i));
+
+        AnswerRequest(pSlot);
+        AgentRing_CompleteRequest(pRing);
+
+        CHECK(AgentRing_IsComplete(pRing, i));
+        CHECK(!AgentRing_IsComplete(pRing, i + 1));
+        CHECK(AgentRing_BeginRequest(pRing) == AgentRing_GetSlot(pRing, AGENT_RING_SLOTS));
+        CHECK(IsAnswerFor(AgentRing_GetSlot(pRing, i), i));
+    }
+
+    CHECK(AgentRing_NextRequest(pRing) == NULL);
+
+    free(pRing);
+}
+
+//
+//  The stand-in agent.  The real one waits on an event between batches;
+//  this one just yields until there's something in the ring.
+//
+typedef struct
+{
+    AGENTRING  *pRing;
+    LONG        cServed;
+    LONG        cOutOfOrder;
+}
+AGENTTHREAD;
+
+static DWORD WINAPI AgentThreadProc(PVOID pParam)
+{
+    AGENTTHREAD *pAgent = (AGENTTHREAD *)pParam;
+
+    while (!ReadAcquire(&pAgent->pRing->fQuit))
+    {
+        AGENTSLOT *pSlot;
+
+        while ((pSlot = AgentRing_NextRequest(pAgent->pRing)) != NULL)
+        {
+            // The request has to have got here whole, and in order.
+            if (pSlot->hwnd != MakeHwnd(pAgent->cServed) || pSlot->atom != (ATOM)(0xC000 + (pAgent->cServed & 0xFFF)))
+                pAgent->cOutOfOrder++;
+
+            AnswerRequest(pSlot);
+            AgentRing_CompleteRequest(pAgent->pRing);
+
+            pAgent->cServed++;
+        }
+
+        SwitchToThread();
+    }
+
+    return 0;
+}
+
+//
+//  Batches of random sizes, each collected as soon as it's answered and
+//  before its slots can be reused.
+//
+static void TestThreads(void)
+{
+    AGENTTHREAD agent = { 0 };
+    HANDLE      hThread;
+    LONG        cPosted   = 0;
+    LONG        cVerified = 0;
+    LONG        cWrong    = 0;
+
+    agent.pRing = (AGENTRING *)malloc(sizeof(AGENTRING));
+
+    REQUIRE(agent.pRing, );
+
+    AgentRing_Init(agent.pRing);
+
+    hThread = CreateThread(NULL, 0, AgentThreadProc, &agent, 0, NULL);
+
+    REQUIRE(hThread, );
+
+    while (cVerified < THREAD_REQUESTS)
+    {
+        UINT cBatch = 1 + TestRandomBelow(AGENT_RING_SLOTS + AGENT_RING_SLOTS / 2);
+
+        for (UINT i = 0; i < cBatch && cPosted < THREAD_REQUESTS && cPosted - cVerified < AGENT_RING_SLOTS; i++)
+        {
+            AGENTSLOT *pSlot = AgentRing_BeginRequest(agent.pRing);
+
+            // Every slot this far ahead has been collected, so it's been
+            // completed too.
+            REQUIRE(pSlot, );
+
+            MakeRequest(pSlot, cPosted);
+            pSlot->fAnswered = 0;
+
+            CHECK(AgentRing_PostRequest(agent.pRing) == cPosted);
+            cPosted++;
+        }
+
+        // Collect what's been answered, only waiting when there's no room
+        // to post more.
+
+        while (cVerified < cPosted)
+        {
+            if (!AgentRing_IsComplete(agent.pRing, cVerified))
+            {
+                if (cPosted - cVerified < AGENT_RING_SLOTS && cPosted < THREAD_REQUESTS)
+                    break;
+
+                SwitchToThread();
+                continue;
+            }
+
+            cWrong += !IsAnswerFor(AgentRing_GetSlot(agent.pRing, cVerified), cVerified);
+            cVerified++;
+        }
+    }
+
+    WriteRelease(&agent.pRing->fQuit, TRUE);
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+
+    CHECK(cWrong == 0);
+    CHECK(agent.cOutOfOrder == 0);
+    CHECK(agent.cServed == THREAD_REQUESTS);
+    CHECK(AgentRing_NextRequest(agent.pRing) == NULL);
+
+    free(agent.pRing);
+}
+
+int main(void)
+{
+    TestSingleThread();
+    TestThreads();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,287 @@
+//
+//  HwndIndexTest.c
+//
+//  Checks HwndIndex against a plain array through random adds, removes
+//  and clears, with enough handles to grow the table several times and
+//  enough removals to shift entries back across the end of the table.
+//
+//  With --bench it times lookups, misses and add/remove churn in trees of
+//  1k, 10k and 100k windows instead, next to scanning the node pool.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "HwndIndex.h"
+#include "TestUtils.h"
+
+#define MAX_NODES   5000
+
+//
+//  Window handles are small multiples of 2 with the odd higher bit set, so
+//  that's what these look like.
+//
+static HWND MakeHwnd(UINT id)
+{
+    return (HWND)(ULONG_PTR)(0x10000 + id * 6 + ((id & 7) << 20));
+}
+
+static void TestEmpty(void)
+{
+    HWNDINDEX index = { 0 };
+
+    CHECK(HwndIndex_Find(&index, MakeHwnd(1)) == -1);
+
+    HwndIndex_Remove(&index, MakeHwnd(1), 0);
+    HwndIndex_Clear(&index);
+
+    CHECK(HwndIndex_Add(&index, MakeHwnd(1), 7));
+    CHECK(HwndIndex_Find(&index, MakeHwnd(1)) == 7);
+    CHECK(HwndIndex_Find(&index, MakeHwnd(2)) == -1);
+
+    HwndIndex_Remove(&index, MakeHwnd(1), 7);
+
+    CHECK(HwndIndex_Find(&index, MakeHwnd(1)) == -1);
+    CHECK(index.cUsed == 0);
+
+    HwndIndex_Free(&index);
+}
+
+//
+//  Node i holds window rgNodes[i], or NULL when it's free, as in the
+//  tree's pool.
+//
+static void TestRandomOperations(void)
+{
+    static HWND s_rgNodes[MAX_NODES];
+
+    HWNDINDEX index = { 0 };
+    UINT      idNext = 0;
+    size_t    cNodes = 0;
+    size_t    cWrong = 0;
+
+    for (UINT iOp = 0; iOp < 200000; iOp++)
+    {
+        UINT      r         = TestRandomBelow(100);
+        ptrdiff_t nodeIndex = (ptrdiff_t)TestRandomBelow(MAX_NODES);
+
+        if (r == 0 && TestRandomBelow(20) == 0)
+        {
+            HwndIndex_Clear(&index);
+            ZeroMemory(s_rgNodes, sizeof(s_rgNodes));
+            cNodes = 0;
+        }
+        else if (r < 50 && !s_rgNodes[nodeIndex])
+        {
+            s_rgNodes[nodeIndex] = MakeHwnd(idNext++);
+            cNodes++;
+
+            CHECK(HwndIndex_Add(&index, s_rgNodes[nodeIndex], nodeIndex));
+        }
+        else if (r < 90 && s_rgNodes[nodeIndex])
+        {
+            HwndIndex_Remove(&index, s_rgNodes[nodeIndex], nodeIndex);
+
+            s_rgNodes[nodeIndex] = NULL;
+            cNodes--;
+        }
+        else
+        {
+            // Look up a window that's in, one that was and one that never
+            // was.
+
+            HWND hwnd = MakeHwnd(TestRandomBelow(idNext + 1));
+
+            for (ptrdiff_t i = 0; i < MAX_NODES; i++)
+            {
+                if (s_rgNodes[i] == hwnd)
+                {
+                    nodeIndex = i;
+                    break;
+                }
+
+                nodeIndex = -1;
+            }
+
+            cWrong += HwndIndex_Find(&index, hwnd) != nodeIndex;
+        }
+
+        CHECK(index.cUsed == cNodes);
+        CHECK(index.cUsed * 2 <= index.cSlots);
+    }
+
+    for (ptrdiff_t i = 0; i < MAX_NODES; i++)
+    {
+        cWrong += s_rgNodes[i] && HwndIndex_Find(&index, s_rgNodes[i]) != i;
+    }
+
+    CHECK(cWrong == 0);
+
+    HwndIndex_Free(&index);
+}
+
+//
+//  Everything is removed again in a different order, which shifts entries
+//  back every way there is.
+//
+static void TestFillAndEmpty(void)
+{
+    HWNDINDEX index = { 0 };
+    UINT     *rgOrder = (UINT *)malloc(MAX_NODES * sizeof(UINT));
+    size_t    cWrong = 0;
+
+    REQUIRE(rgOrder, );
+
+    for (UINT i = 0; i < MAX_NODES; i++)
+    {
+        CHECK(HwndIndex_Add(&index, MakeHwnd(i), (ptrdiff_t)i));
+        rgOrder[i] = i;
+    }
+
+    for (UINT i = MAX_NODES - 1; i > 0; i--)
+    {
+        UINT j = TestRandomBelow(i + 1);
+        UINT t = rgOrder[i];
+
+        rgOrder[i] = rgOrder[j];
+        rgOrder[j] = t;
+    }
+
+    for (UINT i = 0; i < MAX_NODES; i++)
+    {
+        HwndIndex_Remove(&index, MakeHwnd(rgOrder[i]), (ptrdiff_t)rgOrder[i]);
+
+        cWrong += HwndIndex_Find(&index, MakeHwnd(rgOrder[i])) != -1;
+
+        if (i + 1 < MAX_NODES)
+            cWrong += HwndIndex_Find(&index, MakeHwnd(rgOrder[i + 1])) != (ptrdiff_t)rgOrder[i + 1];
+    }
+
+    CHECK(cWrong == 0);
+    CHECK(index.cUsed == 0);
+
+    free(rgOrder);
+    HwndIndex_Free(&index);
+}
+
+#define BENCH_LOOKUPS   1000
+
+//
+//  What FindTreeItemByHwnd would have to do without the index.
+//
+static ptrdiff_t ScanNodes(const HWND *rgNodes, size_t cNodes, HWND hwnd)
+{
+    for (size_t i = 0; i < cNodes; i++)
+    {
+        if (rgNodes[i] == hwnd)
+            return (ptrdiff_t)i;
+    }
+
+    return -1;
+}
+
+//
+//  Average nanoseconds per operation, over enough runs to take a while.
+//  iTest is 0 for lookups, 1 for misses, 2 for a remove and add, 3 for
+//  lookups by scanning.  Wrong answers are counted in *pcWrong.
+//
+static double TimeOperation(HWNDINDEX *pIndex, const HWND *rgNodes, size_t cNodes, const UINT *rgPicks, int iTest, size_t *pcWrong)
+{
+    clock_t tStart = clock();
+    UINT    cRuns  = 0;
+
+    do
+    {
+        for (UINT i = 0; i < BENCH_LOOKUPS; i++)
+        {
+            UINT id = rgPicks[i];
+
+            switch (iTest)
+            {
+            case 0:
+                *pcWrong += HwndIndex_Find(pIndex, rgNodes[id]) != (ptrdiff_t)id;
+                break;
+
+            case 1:
+                *pcWrong += HwndIndex_Find(pIndex, MakeHwnd((UINT)cNodes + id)) != -1;
+                break;
+
+            case 2:
+                HwndIndex_Remove(pIndex, rgNodes[id], (ptrdiff_t)id);
+                HwndIndex_Add(pIndex, rgNodes[id], (ptrdiff_t)id);
+                break;
+
+            default:
+                *pcWrong += ScanNodes(rgNodes, cNodes, rgNodes[id]) != (ptrdiff_t)id;
+                break;
+            }
+        }
+
+        cRuns++;
+    }
+    while (clock() - tStart < CLOCKS_PER_SEC / 2);
+
+    return (double)(clock() - tStart) * 1000000000 / CLOCKS_PER_SEC / cRuns / BENCH_LOOKUPS;
+}
+
+static void Benchmark(void)
+{
+    static const UINT s_rgcNodes[] = { 1000, 10000, 100000 };
+
+    HWND *rgNodes = (HWND *)malloc(100000 * sizeof(HWND));
+    UINT  rgPicks[BENCH_LOOKUPS];
+
+    REQUIRE(rgNodes, );
+
+    printf("%-10s %12s %12s %12s %12s\n", "windows", "find ns", "miss ns", "churn ns", "scan ns");
+
+    for (size_t i = 0; i < ARRAYSIZE(s_rgcNodes); i++)
+    {
+        HWNDINDEX index  = { 0 };
+        size_t    cWrong = 0;
+        double    rgns[4];
+
+        for (UINT id = 0; id < s_rgcNodes[i]; id++)
+        {
+            rgNodes[id] = MakeHwnd(id);
+            HwndIndex_Add(&index, rgNodes[id], (ptrdiff_t)id);
+        }
+
+        for (UINT j = 0; j < BENCH_LOOKUPS; j++)
+        {
+            rgPicks[j] = TestRandomBelow(s_rgcNodes[i]);
+        }
+
+        for (int iTest = 0; iTest < 4; iTest++)
+        {
+            rgns[iTest] = TimeOperation(&index, rgNodes, s_rgcNodes[i], rgPicks, iTest, &cWrong);
+        }
+
+        CHECK(cWrong == 0);
+        CHECK(index.cUsed == s_rgcNodes[i]);
+
+        printf("%-10u %12.1f %12.1f %12.1f %12.1f\n", s_rgcNodes[i], rgns[0], rgns[1], rgns[2], rgns[3]);
+
+        HwndIndex_Free(&index);
+    }
+
+    free(rgNodes);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        Benchmark();
+        return TEST_RESULT();
+    }
+
+    TestEmpty();
+    TestRandomOperations();
+    TestFillAndEmpty();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+//
+//  InjectBatchTest.c
+//
+//  Checks the batch block layout: aligned, non-overlapping areas of the
+//  right sizes, and the limits.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "InjectBatch.h"
+#include "TestUtils.h"
+
+static BOOL IsAligned(DWORD cb)
+{
+    return (cb % sizeof(LONG_PTR)) == 0;
+}
+
+static void CheckLayout(DWORD cbHeader, UINT cWindows, UINT cchText)
+{
+    INJBATCHLAYOUT layout;
+    BYTE          *pBlock;
+
+    REQUIRE(InjBatch_Layout(&layout, cbHeader, cWindows, cchText), );
+
+    CHECK(layout.cWindows == cWindows);
+    CHECK(layout.cchText == cchText);
+
+    CHECK(IsAligned(layout.cbRequests) && IsAligned(layout.cbResults) && IsAligned(layout.cbText) && IsAligned(layout.cbTotal));
+
+    CHECK(layout.cbRequests >= cbHeader);
+    CHECK(layout.cbResults >= layout.cbRequests + cWindows * sizeof(INJWINDOWREQUEST));
+    CHECK(layout.cbText >= layout.cbResults + cWindows * sizeof(INJWINDOWRESULT));
+    CHECK(layout.cbTotal >= layout.cbText + (size_t)cWindows * cchText * sizeof(WCHAR));
+
+    // Fill each area through the macros, then check nothing overwrote
+    // anything else.
+
+    pBlock = (BYTE *)malloc(layout.cbTotal + 1);
+    REQUIRE(pBlock != NULL, );
+
+    memset(pBlock, 0xEE, layout.cbTotal + 1);
+    memset(pBlock, 0x11, cbHeader);
+
+    for (UINT i = 0; i < cWindows; i++)
+    {
+        INJWINDOWREQUEST *pRequest = INJBATCH_REQUEST(pBlock, &layout, i);
+        INJWINDOWRESULT  *pResult  = INJBATCH_RESULT(pBlock, &layout, i);
+        WCHAR            *pszText  = INJBATCH_TEXT(pBlock, &layout, i);
+
+        CHECK((BYTE *)pRequest == pBlock + layout.cbRequests + i * sizeof(INJWINDOWREQUEST));
+
+        pRequest->hwnd   = (HWND)(ULONG_PTR)(i + 1);
+        pRequest->atom   = (ATOM)i;
+        pResult->wndproc = (WNDPROC)(ULONG_PTR)(i + 2);
+        pResult->clsproc = (WNDPROC)(ULONG_PTR)(i + 3);
+
+        for (UINT ich = 0; ich < cchText; ich++)
+        {
+            pszText[ich] = (WCHAR)(L'a' + i % 26);
+        }
+    }
+
+    for (UINT i = 0; i < cWindows; i++)
+    {
+        CHECK(INJBATCH_REQUEST(pBlock, &layout, i)->hwnd == (HWND)(ULONG_PTR)(i + 1));
+        CHECK(INJBATCH_REQUEST(pBlock, &layout, i)->atom == (ATOM)i);
+        CHECK(INJBATCH_RESULT(pBlock, &layout, i)->wndproc == (WNDPROC)(ULONG_PTR)(i + 2));
+        CHECK(INJBATCH_RESULT(pBlock, &layout, i)->clsproc == (WNDPROC)(ULONG_PTR)(i + 3));
+
+        for (UINT ich = 0; ich < cchText; ich++)
+        {
+            CHECK(INJBATCH_TEXT(pBlock, &layout, i)[ich] == (WCHAR)(L'a' + i % 26));
+        }
+    }
+
+    for (DWORD cb = 0; cb < cbHeader; cb++)
+    {
+        CHECK(pBlock[cb] == 0x11);
+    }
+
+    CHECK(pBlock[layout.cbTotal] == 0xEE);
+
+    free(pBlock);
+}
+
+static void TestLayouts(void)
+{
+    CheckLayout(0, 0, 0);
+    CheckLayout(1, 1, 0);
+    CheckLayout(13, 7, 1);
+    CheckLayout(64, 100, 64);
+    CheckLayout(0x10000, INJBATCH_MAX_WINDOWS, INJBATCH_MAX_TEXT);
+
+    for (UINT i = 0; i < 200; i++)
+    {
+        CheckLayout(TestRandomBelow(300), TestRandomBelow(300), TestRandomBelow(100));
+    }
+}
+
+static void TestLimits(void)
+{
+    INJBATCHLAYOUT layout;
+
+    CHECK(!InjBatch_Layout(&layout, 0, INJBATCH_MAX_WINDOWS + 1, 0));
+    CHECK(layout.cbTotal == 0);
+
+    CHECK(!InjBatch_Layout(&layout, 0, 1, INJBATCH_MAX_TEXT + 1));
+    CHECK(!InjBatch_Layout(&layout, 0x10001, 1, 1));
+}
+
+int main(void)
+{
+    TestLimits();
+    TestLayouts();
+
+    return TEST_RESULT();
+}
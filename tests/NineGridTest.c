@@ -0,0 +1,362 @@
+//
+//  NineGridTest.c
+//
+//  Checks NineGrid_ExpandBits pixel for pixel against a plain per-pixel
+//  nearest-neighbour expansion, and on Windows against NineGrid_ExpandGdi
+//  for the cases where GDI's stretching is exact.
+//
+//  With --bench it times the expansion instead, at the sizes the window
+//  finder uses.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "NineGrid.h"
+#include "TestUtils.h"
+
+//
+//  The source coordinate for output coordinate d, along one axis.
+//
+static int MapCoord(int d, int cDst, int cSrc, int cEdgeLo, int cEdgeHi)
+{
+    if (d < cEdgeLo)
+        return d;
+
+    if (d >= cDst - cEdgeHi)
+        return cSrc - (cDst - d);
+
+    return cEdgeLo + (int)((LONGLONG)(d - cEdgeLo) * (cSrc - cEdgeLo - cEdgeHi) / (cDst - cEdgeLo - cEdgeHi));
+}
+
+static void ExpandReference(DWORD *pDst, SIZE sizeDst, const DWORD *pSrc, SIZE sizeSrc, RECT edges)
+{
+    for (int y = 0; y < sizeDst.cy; y++)
+    {
+        int ySrc = MapCoord(y, sizeDst.cy, sizeSrc.cy, edges.top, edges.bottom);
+
+        for (int x = 0; x < sizeDst.cx; x++)
+        {
+            int xSrc = MapCoord(x, sizeDst.cx, sizeSrc.cx, edges.left, edges.right);
+
+            pDst[(size_t)y * sizeDst.cx + x] = pSrc[(size_t)ySrc * sizeSrc.cx + xSrc];
+        }
+    }
+}
+
+static DWORD *MakeRandomImage(SIZE size)
+{
+    DWORD *pBits = (DWORD *)malloc((size_t)size.cx * size.cy * sizeof(DWORD));
+
+    if (pBits)
+    {
+        for (size_t i = 0; i < (size_t)size.cx * size.cy; i++)
+        {
+            pBits[i] = TestRandom();
+        }
+    }
+
+    return pBits;
+}
+
+//
+//  Expands into a buffer at an offset of 0-3 pixels, so that every
+//  alignment of the rows is tried, and checks nothing is written past the
+//  end.
+//
+static void CheckExpand(SIZE sizeSrc, RECT edges, SIZE sizeDst)
+{
+    size_t  cPixels = (size_t)sizeDst.cx * sizeDst.cy;
+    size_t  iOffset = TestRandomBelow(4);
+    DWORD  *pSrc    = MakeRandomImage(sizeSrc);
+    DWORD  *pBuffer = (DWORD *)malloc((cPixels + 5) * sizeof(DWORD));
+    DWORD  *pExpect = (DWORD *)malloc(cPixels * sizeof(DWORD));
+
+    if (pSrc && pBuffer && pExpect)
+    {
+        DWORD *pDst = pBuffer + iOffset;
+
+        pDst[cPixels] = 0xDEADBEEF;
+
+        NineGrid_ExpandBits(pDst, sizeDst, pSrc, sizeSrc, edges);
+        ExpandReference(pExpect, sizeDst, pSrc, sizeSrc, edges);
+
+        if (memcmp(pDst, pExpect, cPixels * sizeof(DWORD)) != 0)
+        {
+            fprintf(stderr, "%dx%d -> %dx%d, edges %d,%d,%d,%d\n",
+                (int)sizeSrc.cx, (int)sizeSrc.cy, (int)sizeDst.cx, (int)sizeDst.cy,
+                (int)edges.left, (int)edges.top, (int)edges.right, (int)edges.bottom);
+            CHECK(FALSE);
+        }
+
+        CHECK(pDst[cPixels] == 0xDEADBEEF);
+    }
+    else
+    {
+        CHECK(FALSE);
+    }
+
+    free(pSrc);
+    free(pBuffer);
+    free(pExpect);
+}
+
+static void TestRandomSizes(void)
+{
+    for (UINT i = 0; i < 3000; i++)
+    {
+        RECT edges;
+        SIZE sizeSrc, sizeDst;
+
+        edges.left   = (LONG)TestRandomBelow(12);
+        edges.top    = (LONG)TestRandomBelow(12);
+        edges.right  = (LONG)TestRandomBelow(12);
+        edges.bottom = (LONG)TestRandomBelow(12);
+
+        // Mostly the single pixel interior the finder images have.
+
+        sizeSrc.cx = edges.left + edges.right + (TestRandomBelow(2) ? 1 : 1 + (LONG)TestRandomBelow(20));
+        sizeSrc.cy = edges.top + edges.bottom + (TestRandomBelow(2) ? 1 : 1 + (LONG)TestRandomBelow(20));
+
+        sizeDst.cx = edges.left + edges.right + 1 + (LONG)TestRandomBelow(200);
+        sizeDst.cy = edges.top + edges.bottom + 1 + (LONG)TestRandomBelow(100);
+
+        CheckExpand(sizeSrc, edges, sizeDst);
+    }
+}
+
+static void TestSameSize(void)
+{
+    SIZE   size  = { 37, 23 };
+    RECT   edges = { 5, 6, 7, 8 };
+    DWORD *pSrc  = MakeRandomImage(size);
+    DWORD *pDst  = (DWORD *)malloc((size_t)size.cx * size.cy * sizeof(DWORD));
+
+    REQUIRE(pSrc && pDst, );
+
+    NineGrid_ExpandBits(pDst, size, pSrc, size, edges);
+    CHECK(memcmp(pDst, pSrc, (size_t)size.cx * size.cy * sizeof(DWORD)) == 0);
+
+    free(pSrc);
+    free(pDst);
+}
+
+#ifdef _WIN32
+
+static HBITMAP CreateTopDownDib(SIZE size, DWORD **ppBits)
+{
+    BITMAPINFOHEADER bih = { sizeof(bih) };
+
+    bih.biWidth       = size.cx;
+    bih.biHeight      = -size.cy;
+    bih.biPlanes      = 1;
+    bih.biBitCount    = 32;
+    bih.biCompression = BI_RGB;
+
+    return CreateDIBSection(NULL, (BITMAPINFO *)&bih, DIB_RGB_COLORS, (void **)ppBits, NULL, 0);
+}
+
+//
+//  Compares with GDI where its StretchBlt is exact: a single pixel interior
+//  (every stretch is a fill), or interiors stretched by a whole number.
+//  GDI doesn't promise to keep the alpha byte, so only the colour is
+//  compared.
+//
+static void CheckAgainstGdi(SIZE sizeSrc, RECT edges, SIZE sizeDst)
+{
+    DWORD     *pSrcBits;
+    HBITMAP    hbmSrc  = CreateTopDownDib(sizeSrc, &pSrcBits);
+    HBITMAP    hbmGdi  = NULL;
+    DWORD     *pExpect = (DWORD *)malloc((size_t)sizeDst.cx * sizeDst.cy * sizeof(DWORD));
+    DIBSECTION ds;
+
+    REQUIRE(hbmSrc && pExpect, );
+
+    for (size_t i = 0; i < (size_t)sizeSrc.cx * sizeSrc.cy; i++)
+    {
+        pSrcBits[i] = TestRandom() & 0x00FFFFFF;
+    }
+
+    GdiFlush();
+
+    hbmGdi = NineGrid_ExpandGdi(sizeDst, hbmSrc, edges);
+    NineGrid_ExpandBits(pExpect, sizeDst, pSrcBits, sizeSrc, edges);
+
+    GdiFlush();
+
+    if (hbmGdi && GetObject(hbmGdi, sizeof(ds), &ds) == sizeof(ds))
+    {
+        const DWORD *pGdiBits = (const DWORD *)ds.dsBm.bmBits;
+        BOOL         fSame    = TRUE;
+
+        // The GDI result is bottom-up.
+
+        for (int y = 0; y < sizeDst.cy && fSame; y++)
+        {
+            const DWORD *pGdiRow = pGdiBits + (size_t)(sizeDst.cy - 1 - y) * sizeDst.cx;
+
+            for (int x = 0; x < sizeDst.cx && fSame; x++)
+            {
+                fSame = ((pGdiRow[x] ^ pExpect[(size_t)y * sizeDst.cx + x]) & 0x00FFFFFF) == 0;
+            }
+        }
+
+        CHECK(fSame);
+    }
+    else
+    {
+        CHECK(FALSE);
+    }
+
+    if (hbmGdi)
+        DeleteObject(hbmGdi);
+
+    DeleteObject(hbmSrc);
+    free(pExpect);
+}
+
+static void TestAgainstGdi(void)
+{
+    for (UINT i = 0; i < 300; i++)
+    {
+        RECT edges;
+        SIZE sizeSrc, sizeDst;
+        LONG cxInner = 1, cyInner = 1;
+        LONG nScaleX, nScaleY;
+
+        edges.left   = (LONG)TestRandomBelow(12);
+        edges.top    = (LONG)TestRandomBelow(12);
+        edges.right  = (LONG)TestRandomBelow(12);
+        edges.bottom = (LONG)TestRandomBelow(12);
+
+        if (TestRandomBelow(2))
+        {
+            cxInner = 1 + (LONG)TestRandomBelow(8);
+            cyInner = 1 + (LONG)TestRandomBelow(8);
+        }
+
+        nScaleX = 1 + (LONG)TestRandomBelow(cxInner > 1 ? 10 : 200);
+        nScaleY = 1 + (LONG)TestRandomBelow(cyInner > 1 ? 10 : 100);
+
+        sizeSrc.cx = edges.left + edges.right + cxInner;
+        sizeSrc.cy = edges.top + edges.bottom + cyInner;
+        sizeDst.cx = edges.left + edges.right + cxInner * nScaleX;
+        sizeDst.cy = edges.top + edges.bottom + cyInner * nScaleY;
+
+        CheckAgainstGdi(sizeSrc, edges, sizeDst);
+    }
+}
+
+#endif
+
+//
+//  Average milliseconds per expansion, over enough runs to take a while.
+//
+static double TimeExpand(void (*pfnExpand)(DWORD *, SIZE, const DWORD *, SIZE, RECT),
+                         DWORD *pDst, SIZE sizeDst, const DWORD *pSrc, SIZE sizeSrc, RECT edges)
+{
+    clock_t tStart = clock();
+    UINT    cRuns  = 0;
+
+    do
+    {
+        pfnExpand(pDst, sizeDst, pSrc, sizeSrc, edges);
+        cRuns++;
+    }
+    while (clock() - tStart < CLOCKS_PER_SEC / 2);
+
+    return (double)(clock() - tStart) * 1000 / CLOCKS_PER_SEC / cRuns;
+}
+
+#ifdef _WIN32
+
+static double TimeGdi(HBITMAP hbmSrc, SIZE sizeDst, RECT edges)
+{
+    clock_t tStart = clock();
+    UINT    cRuns  = 0;
+
+    do
+    {
+        DeleteObject(NineGrid_ExpandGdi(sizeDst, hbmSrc, edges));
+        GdiFlush();
+        cRuns++;
+    }
+    while (clock() - tStart < CLOCKS_PER_SEC / 2);
+
+    return (double)(clock() - tStart) * 1000 / CLOCKS_PER_SEC / cRuns;
+}
+
+#endif
+
+static void Benchmark(void)
+{
+    // The finder's frame images: small sources with a single pixel
+    // interior, stretched to the size of the window under the cursor.
+
+    static const SIZE s_rgSizes[] = { { 200, 30 }, { 800, 600 }, { 1920, 1080 }, { 3840, 2160 } };
+
+    SIZE   sizeSrc = { 33, 33 };
+    RECT   edges   = { 16, 16, 16, 16 };
+    DWORD *pSrc    = MakeRandomImage(sizeSrc);
+    DWORD *pDst    = (DWORD *)malloc((size_t)3840 * 2160 * sizeof(DWORD));
+
+#ifdef _WIN32
+    DWORD  *pSrcBits;
+    HBITMAP hbmSrc = CreateTopDownDib(sizeSrc, &pSrcBits);
+#endif
+
+    REQUIRE(pSrc && pDst, );
+
+#ifdef _WIN32
+    REQUIRE(hbmSrc, );
+    memcpy(pSrcBits, pSrc, (size_t)sizeSrc.cx * sizeSrc.cy * sizeof(DWORD));
+#endif
+
+    printf("%-12s %12s %12s", "size", "expand ms", "per-pixel ms");
+#ifdef _WIN32
+    printf(" %12s", "GDI ms");
+#endif
+    printf("\n");
+
+    for (size_t i = 0; i < ARRAYSIZE(s_rgSizes); i++)
+    {
+        char szSize[32];
+
+        sprintf(szSize, "%dx%d", (int)s_rgSizes[i].cx, (int)s_rgSizes[i].cy);
+
+        printf("%-12s %12.3f %12.3f", szSize,
+            TimeExpand(NineGrid_ExpandBits, pDst, s_rgSizes[i], pSrc, sizeSrc, edges),
+            TimeExpand(ExpandReference, pDst, s_rgSizes[i], pSrc, sizeSrc, edges));
+#ifdef _WIN32
+        printf(" %12.3f", TimeGdi(hbmSrc, s_rgSizes[i], edges));
+#endif
+        printf("\n");
+    }
+
+#ifdef _WIN32
+    DeleteObject(hbmSrc);
+#endif
+
+    free(pSrc);
+    free(pDst);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        Benchmark();
+        return TEST_RESULT();
+    }
+
+    TestSameSize();
+    TestRandomSizes();
+#ifdef _WIN32
+    TestAgainstGdi();
+#endif
+
+    return TEST_RESULT();
+}
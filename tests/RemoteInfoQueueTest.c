@@ -0,0 +1,222 @@
+//
+//  RemoteInfoQueueTest.c
+//
+//  Walks RemoteInfoQueue through the UI thread's sequences of requests,
+//  cancels and worker completions, and then runs it with real worker
+//  threads against a target that's slow to answer.
+//
+
+#include "WinSpy.h"
+
+#include "RemoteInfoQueue.h"
+#include "TestUtils.h"
+
+#define HWND1   ((HWND)(ULONG_PTR)0x1000)
+#define HWND2   ((HWND)(ULONG_PTR)0x2000)
+#define HWND3   ((HWND)(ULONG_PTR)0x3000)
+
+static void TestIdleRequest(void)
+{
+    REMOTEINFOQUEUE queue = { 0 };
+    BOOL            fStartNow, fStartNext;
+    HWND            hwndNext;
+    LONG            uSerialNext;
+
+    LONG uSerial = RemoteInfoQueue_Request(&queue, HWND1, &fStartNow);
+
+    CHECK(fStartNow);
+    CHECK(RemoteInfoQueue_IsCurrent(&queue, uSerial));
+
+    CHECK(RemoteInfoQueue_Complete(&queue, uSerial, &fStartNext, &hwndNext, &uSerialNext));
+    CHECK(!fStartNext);
+    CHECK(!queue.fBusy);
+}
+
+static void TestQueuedRequests(void)
+{
+    REMOTEINFOQUEUE queue = { 0 };
+    BOOL            fStartNow, fStartNext;
+    HWND            hwndNext = NULL;
+    LONG            uSerialNext = 0;
+
+    LONG uSerial1 = RemoteInfoQueue_Request(&queue, HWND1, &fStartNow);
+    CHECK(fStartNow);
+
+    // Requests made while the worker runs wait, and only the newest one is
+    // kept.
+
+    LONG uSerial2 = RemoteInfoQueue_Request(&queue, HWND2, &fStartNow);
+    CHECK(!fStartNow);
+
+    LONG uSerial3 = RemoteInfoQueue_Request(&queue, HWND3, &fStartNow);
+    CHECK(!fStartNow);
+
+    CHECK(!RemoteInfoQueue_IsCurrent(&queue, uSerial1));
+    CHECK(!RemoteInfoQueue_IsCurrent(&queue, uSerial2));
+    CHECK(RemoteInfoQueue_IsCurrent(&queue, uSerial3));
+
+    // The first result is stale, and the worker moves on to the newest
+    // request.
+
+    CHECK(!RemoteInfoQueue_Complete(&queue, uSerial1, &fStartNext, &hwndNext, &uSerialNext));
+    CHECK(fStartNext);
+    CHECK(hwndNext == HWND3);
+    CHECK(uSerialNext == uSerial3);
+    CHECK(queue.fBusy);
+
+    CHECK(RemoteInfoQueue_Complete(&queue, uSerialNext, &fStartNext, &hwndNext, &uSerialNext));
+    CHECK(!fStartNext);
+    CHECK(!queue.fBusy);
+}
+
+static void TestCancel(void)
+{
+    REMOTEINFOQUEUE queue = { 0 };
+    BOOL            fStartNow, fStartNext;
+    HWND            hwndNext;
+    LONG            uSerialNext;
+
+    LONG uSerial1 = RemoteInfoQueue_Request(&queue, HWND1, &fStartNow);
+    RemoteInfoQueue_Request(&queue, HWND2, &fStartNow);
+
+    RemoteInfoQueue_Cancel(&queue);
+
+    CHECK(!RemoteInfoQueue_IsCurrent(&queue, uSerial1));
+
+    // The running worker's result is dropped, and nothing else starts.
+
+    CHECK(!RemoteInfoQueue_Complete(&queue, uSerial1, &fStartNext, &hwndNext, &uSerialNext));
+    CHECK(!fStartNext);
+    CHECK(!queue.fBusy);
+
+    RemoteInfoQueue_Request(&queue, HWND3, &fStartNow);
+    CHECK(fStartNow);
+}
+
+//
+//  A worker as WinSpy.c runs them: it skips requests that are already
+//  stale, asks the target, and hands the result back to the UI thread,
+//  here by finishing.  A slow target doesn't answer until it's released.
+//
+typedef struct
+{
+    REMOTEINFOQUEUE    *pQueue;
+    HWND                hwnd;
+    LONG                uSerial;
+    BOOL                fSlowTarget;
+    volatile LONG       fInTarget;
+    volatile LONG       fRelease;
+    BOOL                fAsked;
+    HWND                hwndResult;
+}
+WORKER;
+
+static DWORD WINAPI WorkerProc(PVOID pParam)
+{
+    WORKER *pWorker = (WORKER *)pParam;
+
+    if (RemoteInfoQueue_IsCurrent(pWorker->pQueue, pWorker->uSerial))
+    {
+        WriteRelease(&pWorker->fInTarget, TRUE);
+
+        while (pWorker->fSlowTarget && !ReadAcquire(&pWorker->fRelease))
+        {
+            Sleep(1);
+        }
+
+        pWorker->fAsked     = TRUE;
+        pWorker->hwndResult = pWorker->hwnd;
+    }
+
+    return 0;
+}
+
+static HANDLE StartWorker(WORKER *pWorker, REMOTEINFOQUEUE *pQueue, HWND hwnd, LONG uSerial, BOOL fSlowTarget)
+{
+    ZeroMemory(pWorker, sizeof(*pWorker));
+
+    pWorker->pQueue      = pQueue;
+    pWorker->hwnd        = hwnd;
+    pWorker->uSerial     = uSerial;
+    pWorker->fSlowTarget = fSlowTarget;
+
+    return CreateThread(NULL, 0, WorkerProc, pWorker, 0, NULL);
+}
+
+//
+//  The UI thread's side of a result arriving (OnRemoteInfoReady): the
+//  result is only shown if it's current.
+//
+static BOOL ReceiveResult(REMOTEINFOQUEUE *pQueue, HANDLE hThread, const WORKER *pWorker, HWND *phwndShown,
+    BOOL *pfStartNext, HWND *phwndNext, LONG *puSerialNext)
+{
+    BOOL fCurrent;
+
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+
+    fCurrent = RemoteInfoQueue_Complete(pQueue, pWorker->uSerial, pfStartNext, phwndNext, puSerialNext);
+
+    if (fCurrent)
+        *phwndShown = pWorker->hwndResult;
+
+    return fCurrent;
+}
+
+//
+//  The user moves on to another window while the worker for the first one
+//  is stuck in its target.  When the target does answer, its result has
+//  to be dropped, and the newer request is the one that gets shown.
+//
+static void TestSlowTarget(void)
+{
+    REMOTEINFOQUEUE queue = { 0 };
+    WORKER          worker1, worker2;
+    HANDLE          hThread;
+    HWND            hwndShown = NULL;
+    HWND            hwndNext = NULL;
+    LONG            uSerialNext = 0;
+    BOOL            fStartNow, fStartNext;
+
+    LONG uSerial1 = RemoteInfoQueue_Request(&queue, HWND1, &fStartNow);
+
+    REQUIRE(fStartNow, );
+    REQUIRE((hThread = StartWorker(&worker1, &queue, HWND1, uSerial1, TRUE)) != NULL, );
+
+    while (!ReadAcquire(&worker1.fInTarget))
+    {
+        SwitchToThread();
+    }
+
+    LONG uSerial2 = RemoteInfoQueue_Request(&queue, HWND2, &fStartNow);
+
+    CHECK(!fStartNow);
+
+    WriteRelease(&worker1.fRelease, TRUE);
+
+    // The slow worker did get its answer, but it's too late.
+
+    CHECK(!ReceiveResult(&queue, hThread, &worker1, &hwndShown, &fStartNext, &hwndNext, &uSerialNext));
+    CHECK(worker1.fAsked && worker1.hwndResult == HWND1);
+    CHECK(hwndShown == NULL);
+
+    REQUIRE(fStartNext, );
+    CHECK(hwndNext == HWND2 && uSerialNext == uSerial2);
+
+    REQUIRE((hThread = StartWorker(&worker2, &queue, hwndNext, uSerialNext, FALSE)) != NULL, );
+
+    CHECK(ReceiveResult(&queue, hThread, &worker2, &hwndShown, &fStartNext, &hwndNext, &uSerialNext));
+    CHECK(hwndShown == HWND2);
+    CHECK(!fStartNext);
+    CHECK(!queue.fBusy);
+}
+
+int main(void)
+{
+    TestIdleRequest();
+    TestQueuedRequests();
+    TestCancel();
+    TestSlowTarget();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,376 @@
+//
+//  SearchIndexTest.c
+//
+//  Checks SearchIndex_Query against a plain substring search while
+//  documents are added, replaced and removed.
+//
+//  With --bench it times building an index of 100k made-up window labels
+//  and querying it instead, next to a plain scan of the same labels.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wctype.h>
+
+#include "SearchIndex.h"
+#include "TestUtils.h"
+
+#define MAX_DOCS    600
+#define MAX_DOC_LEN 40
+
+//
+//  What the index should hold: the original text of each document, or an
+//  empty string for none.
+//
+static WCHAR g_rgszDocs[MAX_DOCS][MAX_DOC_LEN + 1];
+static BOOL  g_rgfLive[MAX_DOCS];
+
+// Few letters, so that trigrams are shared between lots of documents.
+static void MakeRandomText(WCHAR *psz, size_t cch)
+{
+    static const WCHAR s_szChars[] = L"abcABC_ 0x";
+
+    for (size_t i = 0; i < cch; i++)
+    {
+        psz[i] = s_szChars[TestRandomBelow(ARRAYSIZE(s_szChars) - 1)];
+    }
+
+    psz[cch] = L'\0';
+}
+
+static BOOL ContainsNoCase(PCWSTR pszText, PCWSTR pszQuery)
+{
+    WCHAR szText[MAX_DOC_LEN + 1];
+    WCHAR szQuery[MAX_DOC_LEN + 1];
+    size_t i;
+
+    for (i = 0; pszText[i]; i++)
+        szText[i] = (WCHAR)towlower(pszText[i]);
+
+    szText[i] = L'\0';
+
+    for (i = 0; pszQuery[i] && i < MAX_DOC_LEN; i++)
+        szQuery[i] = (WCHAR)towlower(pszQuery[i]);
+
+    szQuery[i] = L'\0';
+
+    return wcsstr(szText, szQuery) != NULL;
+}
+
+static void CheckQuery(SEARCHINDEX *pIndex, PCWSTR pszQuery)
+{
+    const UINT *rgDocs;
+    size_t      cDocs    = SearchIndex_Query(pIndex, pszQuery, &rgDocs);
+    size_t      iResult  = 0;
+    BOOL        fCorrect = TRUE;
+
+    for (UINT iDoc = 0; iDoc < MAX_DOCS; iDoc++)
+    {
+        if (!g_rgfLive[iDoc] || pszQuery[0] == L'\0' || !ContainsNoCase(g_rgszDocs[iDoc], pszQuery))
+            continue;
+
+        if (iResult >= cDocs || rgDocs[iResult] != iDoc)
+        {
+            fCorrect = FALSE;
+            break;
+        }
+
+        iResult++;
+    }
+
+    if (!fCorrect || iResult != cDocs)
+    {
+        fprintf(stderr, "query \"%ls\" gave %u results\n", pszQuery, (unsigned)cDocs);
+        CHECK(FALSE);
+    }
+}
+
+static void CheckRandomQueries(SEARCHINDEX *pIndex)
+{
+    WCHAR szQuery[MAX_DOC_LEN + 1];
+
+    for (UINT i = 0; i < 50; i++)
+    {
+        UINT iDoc = TestRandomBelow(MAX_DOCS);
+
+        if (g_rgfLive[iDoc] && TestRandomBelow(2) == 0)
+        {
+            // Part of a document, with the case flipped.
+
+            size_t cch    = wcslen(g_rgszDocs[iDoc]);
+            size_t ich    = cch ? TestRandomBelow((UINT)cch) : 0;
+            size_t cchSub = TestRandomBelow((UINT)(cch - ich) + 1);
+
+            for (size_t j = 0; j < cchSub; j++)
+                szQuery[j] = (WCHAR)towupper(g_rgszDocs[iDoc][ich + j]);
+
+            szQuery[cchSub] = L'\0';
+        }
+        else
+        {
+            MakeRandomText(szQuery, 1 + TestRandomBelow(6));
+        }
+
+        CheckQuery(pIndex, szQuery);
+    }
+}
+
+static void TestRandomEdits(void)
+{
+    SEARCHINDEX index = { 0 };
+
+    for (UINT iStep = 0; iStep < 20000; iStep++)
+    {
+        UINT iDoc = TestRandomBelow(MAX_DOCS);
+
+        switch (TestRandomBelow(8))
+        {
+        case 0:
+            SearchIndex_Remove(&index, iDoc);
+            g_rgfLive[iDoc] = FALSE;
+            break;
+
+        case 1:
+            // The same text again.
+            if (g_rgfLive[iDoc])
+            {
+                CHECK(SearchIndex_Set(&index, iDoc, g_rgszDocs[iDoc]));
+                break;
+            }
+
+            // Fall through
+
+        default:
+            MakeRandomText(g_rgszDocs[iDoc], TestRandomBelow(MAX_DOC_LEN + 1));
+            CHECK(SearchIndex_Set(&index, iDoc, g_rgszDocs[iDoc]));
+            g_rgfLive[iDoc] = TRUE;
+            break;
+        }
+
+        CHECK(index.cLivePostings <= index.cPostings);
+
+        if (iStep % 500 == 0)
+        {
+            CheckRandomQueries(&index);
+        }
+    }
+
+    CheckRandomQueries(&index);
+
+    SearchIndex_Reset(&index);
+    ZeroMemory(g_rgfLive, sizeof(g_rgfLive));
+
+    CheckQuery(&index, L"abc");
+    CheckQuery(&index, L"a");
+
+    CHECK(SearchIndex_Set(&index, 7, L"Notepad"));
+    CHECK(SearchIndex_Set(&index, 3, L"Untitled - NOTEPAD"));
+    g_rgfLive[7] = g_rgfLive[3] = TRUE;
+    wcscpy(g_rgszDocs[7], L"Notepad");
+    wcscpy(g_rgszDocs[3], L"Untitled - NOTEPAD");
+
+    CheckQuery(&index, L"notepad");
+    CheckQuery(&index, L"No");
+    CheckQuery(&index, L"");
+
+    SearchIndex_Free(&index);
+}
+
+//
+//  Setting the same text again reuses the postings left at the end of the
+//  lists, which mustn't be taken off the live count twice.
+//
+static void TestLiveCount(void)
+{
+    SEARCHINDEX index = { 0 };
+    const UINT *rgDocs;
+
+    CHECK(SearchIndex_Set(&index, 1, L"Edit"));
+    CHECK(SearchIndex_Set(&index, 1, L"Edit"));
+    CHECK(SearchIndex_Set(&index, 2, L"ComboBox"));
+    CHECK(SearchIndex_Set(&index, 1, L"Edit"));
+    CHECK(index.cLivePostings <= index.cPostings);
+
+    CHECK(SearchIndex_Query(&index, L"edit", &rgDocs) == 1 && rgDocs[0] == 1);
+
+    SearchIndex_Remove(&index, 1);
+    SearchIndex_Remove(&index, 2);
+
+    CHECK(index.cLivePostings == 0);
+    CHECK(SearchIndex_Query(&index, L"edit", &rgDocs) == 0);
+
+    SearchIndex_Free(&index);
+}
+
+static void TestSparseIds(void)
+{
+    SEARCHINDEX index = { 0 };
+    const UINT *rgDocs;
+
+    CHECK(SearchIndex_Query(&index, L"anything", &rgDocs) == 0);
+
+    CHECK(SearchIndex_Set(&index, 100000, L"Chrome_WidgetWin_1"));
+    CHECK(SearchIndex_Set(&index, 5, L"Button"));
+
+    CHECK(SearchIndex_Query(&index, L"widget", &rgDocs) == 1 && rgDocs[0] == 100000);
+    CHECK(SearchIndex_Query(&index, L"t", &rgDocs) == 2 && rgDocs[0] == 5 && rgDocs[1] == 100000);
+
+    SearchIndex_Remove(&index, 100000);
+    SearchIndex_Remove(&index, 200000);
+
+    CHECK(SearchIndex_Query(&index, L"widget", &rgDocs) == 0);
+
+    SearchIndex_Free(&index);
+}
+
+#define BENCH_DOCS      100000
+#define BENCH_DOC_LEN   80
+
+static const PCWSTR s_rgpszBenchClasses[] =
+{
+    L"Button", L"Edit", L"Static", L"ComboBox", L"SysListView32", L"SysTreeView32",
+    L"ToolbarWindow32", L"msctls_statusbar32", L"Chrome_WidgetWin_1", L"#32770",
+    L"DirectUIHWND", L"CtrlNotifySink", L"IME", L"MSCTFIME UI", L"tooltips_class32",
+};
+
+static const PCWSTR s_rgpszBenchWords[] =
+{
+    L"File", L"Edit", L"View", L"Options", L"OK", L"Cancel", L"Apply", L"Help",
+    L"Default IME", L"Search", L"Address", L"Settings", L"Untitled", L"Notepad",
+    L"Document", L"Properties", L"Close", L"Open", L"Save", L"Task Switching",
+};
+
+//
+//  Labels like the tree's: handle, class and a caption of a few words
+//  (or none), in a window tree's proportions.
+//
+static void MakeBenchDoc(WCHAR *psz, UINT iDoc)
+{
+    size_t cch = swprintf(psz, BENCH_DOC_LEN, L"%08X  %ls  ", 0x10000 + iDoc * 6,
+        s_rgpszBenchClasses[TestRandomBelow(ARRAYSIZE(s_rgpszBenchClasses))]);
+
+    for (UINT cWords = TestRandomBelow(4); cWords > 0; cWords--)
+    {
+        cch += swprintf(psz + cch, BENCH_DOC_LEN - cch, L"%ls ",
+            s_rgpszBenchWords[TestRandomBelow(ARRAYSIZE(s_rgpszBenchWords))]);
+    }
+}
+
+//
+//  Average milliseconds per query, over enough runs to take a while.
+//  With rgszLower the query is a plain scan of every label instead.
+//
+static double TimeQuery(SEARCHINDEX *pIndex, WCHAR (*rgszLower)[BENCH_DOC_LEN], PCWSTR pszQuery, size_t *pcMatches)
+{
+    WCHAR   szQuery[BENCH_DOC_LEN];
+    clock_t tStart = clock();
+    UINT    cRuns  = 0;
+    size_t  i;
+
+    for (i = 0; pszQuery[i] && i < BENCH_DOC_LEN - 1; i++)
+        szQuery[i] = (WCHAR)towlower(pszQuery[i]);
+
+    szQuery[i] = L'\0';
+
+    do
+    {
+        const UINT *rgDocs;
+
+        if (rgszLower)
+        {
+            *pcMatches = 0;
+
+            for (UINT iDoc = 0; iDoc < BENCH_DOCS; iDoc++)
+            {
+                if (wcsstr(rgszLower[iDoc], szQuery))
+                    (*pcMatches)++;
+            }
+        }
+        else
+        {
+            *pcMatches = SearchIndex_Query(pIndex, pszQuery, &rgDocs);
+        }
+
+        cRuns++;
+    }
+    while (clock() - tStart < CLOCKS_PER_SEC / 2);
+
+    return (double)(clock() - tStart) * 1000 / CLOCKS_PER_SEC / cRuns;
+}
+
+static void Benchmark(void)
+{
+    static const PCWSTR s_rgpszQueries[] =
+    {
+        L"ok",                  // Too short for a trigram, checks everything
+        L"button",              // Common class
+        L"chrome_widget",       // Less common class
+        L"task switching",      // Caption
+        L"00011770",            // One handle
+        L"not there",
+    };
+
+    SEARCHINDEX index = { 0 };
+    WCHAR     (*rgszDocs)[BENCH_DOC_LEN] = (WCHAR (*)[BENCH_DOC_LEN])calloc(BENCH_DOCS, sizeof(*rgszDocs));
+    clock_t     tStart;
+
+    REQUIRE(rgszDocs, );
+
+    for (UINT iDoc = 0; iDoc < BENCH_DOCS; iDoc++)
+    {
+        MakeBenchDoc(rgszDocs[iDoc], iDoc);
+    }
+
+    tStart = clock();
+
+    for (UINT iDoc = 0; iDoc < BENCH_DOCS; iDoc++)
+    {
+        REQUIRE(SearchIndex_Set(&index, iDoc, rgszDocs[iDoc]), );
+    }
+
+    printf("Building the index of %u labels: %.1f ms\n\n", BENCH_DOCS,
+        (double)(clock() - tStart) * 1000 / CLOCKS_PER_SEC);
+
+    // The plain scan gets its labels in lower case already.
+
+    for (UINT iDoc = 0; iDoc < BENCH_DOCS; iDoc++)
+    {
+        for (WCHAR *pch = rgszDocs[iDoc]; *pch; pch++)
+            *pch = (WCHAR)towlower(*pch);
+    }
+
+    printf("%-18s %10s %12s %12s\n", "query", "matches", "index ms", "scan ms");
+
+    for (size_t i = 0; i < ARRAYSIZE(s_rgpszQueries); i++)
+    {
+        size_t cMatches;
+        size_t cScanMatches;
+        double msIndex = TimeQuery(&index, NULL, s_rgpszQueries[i], &cMatches);
+        double msScan  = TimeQuery(&index, rgszDocs, s_rgpszQueries[i], &cScanMatches);
+
+        CHECK(cMatches == cScanMatches);
+
+        printf("%-18ls %10u %12.3f %12.3f\n", s_rgpszQueries[i], (UINT)cMatches, msIndex, msScan);
+    }
+
+    SearchIndex_Free(&index);
+    free(rgszDocs);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        Benchmark();
+        return TEST_RESULT();
+    }
+
+    TestLiveCount();
+    TestSparseIds();
+    TestRandomEdits();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,80 @@
+//
+//  StringPoolTest.c
+//
+//  Checks that pooled strings come back intact as the pool grows, and
+//  that interning gives equal strings the same offset.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "StringPool.h"
+#include "TestUtils.h"
+
+#define NUM_STRINGS 5000
+
+static void MakeString(WCHAR *psz, UINT i)
+{
+    swprintf(psz, 32, L"String %u", i % (NUM_STRINGS / 4));
+}
+
+static void TestAddAndIntern(void)
+{
+    static UINT rgichAdded[NUM_STRINGS];
+    static UINT rgichInterned[NUM_STRINGS];
+
+    STRINGPOOL pool = { 0 };
+    WCHAR      sz[32];
+
+    CHECK(wcscmp(StringPool_Get(&pool, 0), L"") == 0);
+    CHECK(StringPool_Add(&pool, L"") == 0);
+    CHECK(StringPool_Intern(&pool, L"") == 0);
+
+    for (UINT i = 0; i < NUM_STRINGS; i++)
+    {
+        MakeString(sz, i);
+
+        rgichAdded[i]    = StringPool_Add(&pool, sz);
+        rgichInterned[i] = StringPool_Intern(&pool, sz);
+
+        CHECK(rgichAdded[i] != 0 && rgichInterned[i] != 0);
+    }
+
+    for (UINT i = 0; i < NUM_STRINGS; i++)
+    {
+        MakeString(sz, i);
+
+        CHECK(wcscmp(StringPool_Get(&pool, rgichAdded[i]), sz) == 0);
+        CHECK(wcscmp(StringPool_Get(&pool, rgichInterned[i]), sz) == 0);
+
+        // Added strings are always new copies, interned ones are shared.
+        CHECK(i < NUM_STRINGS / 4 || rgichInterned[i] == rgichInterned[i % (NUM_STRINGS / 4)]);
+        CHECK(i == 0 || rgichAdded[i] > rgichAdded[i - 1]);
+    }
+
+    CHECK(pool.cInterned == NUM_STRINGS / 4);
+
+    StringPool_Reset(&pool);
+
+    CHECK(pool.cInterned == 0);
+    CHECK(pool.cch == 1);
+
+    UINT ich = StringPool_Intern(&pool, L"again");
+
+    CHECK(ich == 1);
+    CHECK(StringPool_Intern(&pool, L"again") == ich);
+    CHECK(wcscmp(StringPool_Get(&pool, ich), L"again") == 0);
+
+    StringPool_Free(&pool);
+
+    CHECK(pool.rgch == NULL && pool.rgSlots == NULL);
+}
+
+int main(void)
+{
+    TestAddAndIntern();
+
+    return TEST_RESULT();
+}
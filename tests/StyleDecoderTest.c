@@ -0,0 +1,369 @@
+//
+//  StyleDecoderTest.c
+//
+//  Checks StyleDecoder_Decode against StyleApplicableAndPresent, entry by
+//  entry, along with the leftover bits AddStylesToList works out from it.
+//  The tables are copies of some of DisplayStyleInfo.c's (with the values
+//  spelled out) and made-up ones with overlapping masks, dependencies and
+//  duplicate values.
+//
+//  By default each table is tried on every combination of the bits it
+//  mentions, if there are few enough of them, and otherwise on a sample.
+//  With --exhaustive the copies of the real tables are tried on all 2^32
+//  values, which takes a long time.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "StyleDecoder.h"
+#include "TestUtils.h"
+
+#define ENTRY(value, extraMask, depValue, depExtraMask)  { L"style", value, extraMask, depValue, depExtraMask }
+
+// WindowStyles
+static StyleLookupEx g_rgWindowStyles[] =
+{
+    ENTRY(0x00CF0000, 0xC0000000, 0, 0),            // WS_OVERLAPPEDWINDOW
+    ENTRY(0x80880000, 0xC0000000, 0, 0),            // WS_POPUPWINDOW
+    ENTRY(0x00000000, 0xC0000000, 0, 0),            // WS_OVERLAPPED
+    ENTRY(0x80000000, 0xC0000000, 0, 0),            // WS_POPUP
+    ENTRY(0x40000000, 0xC0000000, 0, 0),            // WS_CHILD
+    ENTRY(0x20000000, 0, 0, 0),                     // WS_MINIMIZE
+    ENTRY(0x10000000, 0, 0, 0),                     // WS_VISIBLE
+    ENTRY(0x08000000, 0, 0, 0),                     // WS_DISABLED
+    ENTRY(0x04000000, 0, 0, 0),                     // WS_CLIPSIBLINGS
+    ENTRY(0x02000000, 0, 0, 0),                     // WS_CLIPCHILDREN
+    ENTRY(0x01000000, 0, 0, 0),                     // WS_MAXIMIZE
+    ENTRY(0x00C00000, 0, 0, 0),                     // WS_CAPTION
+    ENTRY(0x00800000, 0, 0, 0),                     // WS_BORDER
+    ENTRY(0x00400000, 0, 0, 0),                     // WS_DLGFRAME
+    ENTRY(0x00200000, 0, 0, 0),                     // WS_VSCROLL
+    ENTRY(0x00100000, 0, 0, 0),                     // WS_HSCROLL
+    ENTRY(0x00080000, 0, 0, 0),                     // WS_SYSMENU
+    ENTRY(0x00040000, 0, 0, 0),                     // WS_THICKFRAME
+    ENTRY(0x00020000, 0, 0x40000000, 0xC0000000),   // WS_GROUP
+    ENTRY(0x00010000, 0, 0x40000000, 0xC0000000),   // WS_TABSTOP
+    ENTRY(0x00020000, 0, 0x00080000, 0),            // WS_MINIMIZEBOX
+    ENTRY(0x00010000, 0, 0x00080000, 0),            // WS_MAXIMIZEBOX
+    { NULL }
+};
+
+// ButtonStyles
+static StyleLookupEx g_rgButtonStyles[] =
+{
+    ENTRY(0x0000, 0x000F, 0, 0),                    // BS_PUSHBUTTON
+    ENTRY(0x0001, 0x000F, 0, 0),
+    ENTRY(0x0002, 0x000F, 0, 0),
+    ENTRY(0x0003, 0x000F, 0, 0),
+    ENTRY(0x0004, 0x000F, 0, 0),
+    ENTRY(0x0005, 0x000F, 0, 0),
+    ENTRY(0x0006, 0x000F, 0, 0),
+    ENTRY(0x0007, 0x000F, 0, 0),
+    ENTRY(0x0008, 0x000F, 0, 0),
+    ENTRY(0x0009, 0x000F, 0, 0),
+    ENTRY(0x000B, 0x000F, 0, 0),
+    ENTRY(0x000C, 0x000F, 0, 0),
+    ENTRY(0x000D, 0x000F, 0, 0),
+    ENTRY(0x000E, 0x000F, 0, 0),
+    ENTRY(0x000F, 0x000F, 0, 0),                    // BS_DEFCOMMANDLINK
+    ENTRY(0x0020, 0, 0, 0),                         // BS_LEFTTEXT
+    ENTRY(0x0000, 0x00C0, 0, 0),                    // BS_TEXT
+    ENTRY(0x0040, 0x00C0, 0, 0),                    // BS_ICON
+    ENTRY(0x0080, 0x00C0, 0, 0),                    // BS_BITMAP
+    ENTRY(0x0300, 0, 0, 0),                         // BS_CENTER
+    ENTRY(0x0100, 0, 0, 0),                         // BS_LEFT
+    ENTRY(0x0200, 0, 0, 0),                         // BS_RIGHT
+    ENTRY(0x0C00, 0, 0, 0),                         // BS_VCENTER
+    ENTRY(0x0400, 0, 0, 0),                         // BS_TOP
+    ENTRY(0x0800, 0, 0, 0),                         // BS_BOTTOM
+    ENTRY(0x1000, 0, 0, 0),                         // BS_PUSHLIKE
+    ENTRY(0x2000, 0, 0, 0),                         // BS_MULTILINE
+    ENTRY(0x4000, 0, 0, 0),                         // BS_NOTIFY
+    ENTRY(0x8000, 0, 0, 0),                         // BS_FLAT
+    ENTRY(0x0020, 0, 0, 0),                         // BS_RIGHTBUTTON
+    { NULL }
+};
+
+// EditStyles, which start with a zero value under a two-bit mask
+static StyleLookupEx g_rgEditStyles[] =
+{
+    ENTRY(0x0000, 0x0003, 0, 0),                    // ES_LEFT
+    ENTRY(0x0001, 0, 0, 0),                         // ES_CENTER
+    ENTRY(0x0002, 0, 0, 0),                         // ES_RIGHT
+    ENTRY(0x0004, 0, 0, 0),                         // ES_MULTILINE
+    ENTRY(0x0008, 0, 0, 0),                         // ES_UPPERCASE
+    ENTRY(0x0010, 0, 0, 0),                         // ES_LOWERCASE
+    ENTRY(0x0020, 0, 0, 0),                         // ES_PASSWORD
+    ENTRY(0x0040, 0, 0, 0),                         // ES_AUTOVSCROLL
+    ENTRY(0x0080, 0, 0, 0),                         // ES_AUTOHSCROLL
+    ENTRY(0x0100, 0, 0, 0),                         // ES_NOHIDESEL
+    ENTRY(0x0400, 0, 0, 0),                         // ES_OEMCONVERT
+    ENTRY(0x0800, 0, 0, 0),                         // ES_READONLY
+    ENTRY(0x1000, 0, 0, 0),                         // ES_WANTRETURN
+    ENTRY(0x2000, 0, 0, 0),                         // ES_NUMBER
+    { NULL }
+};
+
+#define NUM_RANDOM_TABLES   48
+
+// Kept for the whole run, because decoders are cached by table address.
+static StyleLookupEx g_rgRandomTables[NUM_RANDOM_TABLES][MAX_DECODED_STYLES + 1];
+
+static BOOL g_fExhaustive;
+static int  g_cReported;
+
+static DWORD RandomBits(UINT cBits)
+{
+    DWORD dw = 0;
+
+    while (cBits-- > 0)
+    {
+        dw |= 1u << TestRandomBelow(32);
+    }
+
+    return dw;
+}
+
+static DWORD RandomSubset(DWORD dwMask)
+{
+    return dwMask & TestRandom();
+}
+
+//
+//  A table of cStyles entries of every kind: single bits (some repeated),
+//  groups of values under a shared mask, combinations, and entries that
+//  depend on another style.  Most of them share a few bits, like the real
+//  tables do.
+//
+static void MakeRandomTable(StyleLookupEx *pTable, UINT cStyles)
+{
+    DWORD dwGroupMask = RandomBits(2 + TestRandomBelow(3));
+    DWORD dwDepMask   = RandomBits(1 + TestRandomBelow(2));
+
+    for (UINT i = 0; i < cStyles; i++)
+    {
+        StyleLookupEx *pStyle = &pTable[i];
+
+        pStyle->name                = L"style";
+        pStyle->value               = 0;
+        pStyle->extraMask           = 0;
+        pStyle->dependencyValue     = 0;
+        pStyle->dependencyExtraMask = 0;
+
+        switch (TestRandomBelow(6))
+        {
+        case 0:
+        case 1:
+            pStyle->value = RandomBits(1);
+            break;
+
+        case 2:
+            pStyle->value     = RandomSubset(dwGroupMask);
+            pStyle->extraMask = dwGroupMask & ~pStyle->value;
+            break;
+
+        case 3:
+            pStyle->value = RandomBits(2 + TestRandomBelow(3));
+            break;
+
+        case 4:
+            pStyle->value               = RandomBits(1);
+            pStyle->dependencyValue     = RandomSubset(dwDepMask);
+            pStyle->dependencyExtraMask = dwDepMask & ~pStyle->dependencyValue;
+            break;
+
+        default:
+            pStyle->value               = RandomSubset(dwGroupMask);
+            pStyle->extraMask           = dwGroupMask & ~pStyle->value;
+            pStyle->dependencyValue     = RandomBits(1);
+            break;
+        }
+    }
+
+    pTable[cStyles].name = NULL;
+}
+
+static UINT CountStyles(const StyleLookupEx *pTable)
+{
+    UINT cStyles = 0;
+
+    while (pTable[cStyles].name)
+    {
+        cStyles++;
+    }
+
+    return cStyles;
+}
+
+static BOOL CheckValue(PCSTR pszTable, const StyleLookupEx *pTable, UINT cStyles, const STYLEDECODER *pDecoder, DWORD dwStyles)
+{
+    ULONGLONG fExpected     = 0;
+    DWORD     dwExpectLeft  = dwStyles;
+    DWORD     dwLeft;
+    ULONGLONG fMatches      = StyleDecoder_Decode(pDecoder, dwStyles, &dwLeft);
+
+    // This is what AddStylesToList did before it had the decoder.
+
+    for (UINT i = 0; i < cStyles; i++)
+    {
+        if (StyleApplicableAndPresent(dwStyles, &pTable[i]))
+        {
+            fExpected    |= 1ull << i;
+            dwExpectLeft &= ~pTable[i].value;
+        }
+    }
+
+    if (fMatches == fExpected && dwLeft == dwExpectLeft)
+        return TRUE;
+
+    if (g_cReported++ < 10)
+    {
+        fprintf(stderr, "%s: styles %08X decoded as %016llX left %08X, expected %016llX left %08X\n",
+            pszTable, (unsigned)dwStyles, (unsigned long long)fMatches, (unsigned)dwLeft,
+            (unsigned long long)fExpected, (unsigned)dwExpectLeft);
+    }
+
+    return FALSE;
+}
+
+static void CheckTable(PCSTR pszTable, const StyleLookupEx *pTable, BOOL fExhaustive)
+{
+    const STYLEDECODER *pDecoder = StyleDecoder_Get(pTable);
+    UINT                cStyles  = CountStyles(pTable);
+    DWORD               dwUsed   = 0;
+    UINT                cUsed    = 0;
+    size_t              cFailed  = 0;
+
+    REQUIRE(pDecoder != NULL, );
+    CHECK(pDecoder == StyleDecoder_Get(pTable));
+    CHECK(pDecoder->cStyles == cStyles);
+
+    for (UINT i = 0; i < cStyles; i++)
+    {
+        dwUsed |= pTable[i].value | pTable[i].extraMask | pTable[i].dependencyValue | pTable[i].dependencyExtraMask;
+    }
+
+    for (DWORD dw = dwUsed; dw; dw &= dw - 1)
+    {
+        cUsed++;
+    }
+
+    if (fExhaustive)
+    {
+        DWORD dwStyles = 0;
+
+        do
+        {
+            cFailed += !CheckValue(pszTable, pTable, cStyles, pDecoder, dwStyles);
+        }
+        while (++dwStyles != 0);
+    }
+    else if (cUsed <= 16)
+    {
+        // The other bits can only end up in the leftovers, so a few
+        // patterns of them will do.
+
+        DWORD dwSubset = 0;
+
+        do
+        {
+            cFailed += !CheckValue(pszTable, pTable, cStyles, pDecoder, dwSubset);
+            cFailed += !CheckValue(pszTable, pTable, cStyles, pDecoder, dwSubset | ~dwUsed);
+            cFailed += !CheckValue(pszTable, pTable, cStyles, pDecoder, dwSubset | (TestRandom() & ~dwUsed));
+
+            dwSubset = (dwSubset - dwUsed) & dwUsed;
+        }
+        while (dwSubset != 0);
+    }
+    else
+    {
+        // All values with up to three bits set, then random ones, half of
+        // them made to hit one of the entries.
+
+        for (UINT b1 = 0; b1 <= 32; b1++)
+        {
+            for (UINT b2 = b1; b2 <= 32; b2++)
+            {
+                for (UINT b3 = b2; b3 <= 32; b3++)
+                {
+                    DWORD dwStyles = (b1 < 32 ? 1u << b1 : 0) | (b2 < 32 ? 1u << b2 : 0) | (b3 < 32 ? 1u << b3 : 0);
+
+                    cFailed += !CheckValue(pszTable, pTable, cStyles, pDecoder, dwStyles);
+                }
+            }
+        }
+
+        for (UINT i = 0; i < 100000; i++)
+        {
+            DWORD dwStyles = TestRandom();
+
+            if (i & 1)
+            {
+                const StyleLookupEx *pStyle = &pTable[TestRandomBelow(cStyles)];
+
+                dwStyles &= ~(pStyle->value | pStyle->extraMask | pStyle->dependencyValue | pStyle->dependencyExtraMask);
+                dwStyles |= pStyle->value | pStyle->dependencyValue;
+            }
+
+            cFailed += !CheckValue(pszTable, pTable, cStyles, pDecoder, dwStyles);
+        }
+    }
+
+    CHECK(cFailed == 0);
+}
+
+static void TestRealTables(void)
+{
+    CheckTable("WindowStyles", g_rgWindowStyles, g_fExhaustive);
+    CheckTable("ButtonStyles", g_rgButtonStyles, g_fExhaustive);
+    CheckTable("EditStyles", g_rgEditStyles, g_fExhaustive);
+}
+
+static void TestRandomTables(void)
+{
+    for (UINT t = 0; t < NUM_RANDOM_TABLES; t++)
+    {
+        char szName[32];
+        UINT cStyles = (t == 0) ? MAX_DECODED_STYLES : 1 + TestRandomBelow(MAX_DECODED_STYLES);
+
+        MakeRandomTable(g_rgRandomTables[t], cStyles);
+
+        sprintf(szName, "random table %u", t);
+        CheckTable(szName, g_rgRandomTables[t], FALSE);
+    }
+}
+
+static void TestLimits(void)
+{
+    static StyleLookupEx rgEmpty[] = { { NULL } };
+    static StyleLookupEx rgTooBig[MAX_DECODED_STYLES + 2];
+
+    const STYLEDECODER *pDecoder = StyleDecoder_Get(rgEmpty);
+    DWORD               dwLeft;
+
+    REQUIRE(pDecoder != NULL, );
+    CHECK(StyleDecoder_Decode(pDecoder, 0x12345678, &dwLeft) == 0);
+    CHECK(dwLeft == 0x12345678);
+
+    for (UINT i = 0; i < MAX_DECODED_STYLES + 1; i++)
+    {
+        rgTooBig[i].name  = L"style";
+        rgTooBig[i].value = 1u << (i % 32);
+    }
+
+    CHECK(StyleDecoder_Get(rgTooBig) == NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    g_fExhaustive = (argc > 1 && strcmp(argv[1], "--exhaustive") == 0);
+
+    TestLimits();
+    TestRealTables();
+    TestRandomTables();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,329 @@
+//
+//  StyleQueryTest.c
+//
+//  Checks StyleQuery_Evaluate (including its SSE2 paths, where they're
+//  compiled in) against a plain loop over made-up snapshots.
+//
+//  With --bench it times evaluating queries over a million windows
+//  instead, next to the plain loop.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "StyleQuery.h"
+#include "TestUtils.h"
+
+#define MAX_WINDOWS 300
+
+static DWORD g_rgWords[STYLEQUERY_WORDS][MAX_WINDOWS];
+static BYTE  g_rgClass[MAX_WINDOWS];
+
+static BOOL TermMatches(const STYLEQUERYTERM *pTerm, DWORD dw, BYTE bClass)
+{
+    BOOL fPresent = (dw & pTerm->dwDepMask) == pTerm->dwDepValue && (dw & pTerm->dwMask) == pTerm->dwValue;
+
+    if (!((pTerm->fClasses >> bClass) & 1))
+        return FALSE;
+
+    return pTerm->fNegate ? !fPresent : fPresent;
+}
+
+static void MakeRandomTerm(STYLEQUERYTERM *pTerm)
+{
+    ZeroMemory(pTerm, sizeof(*pTerm));
+
+    pTerm->dwMask  = TestRandom() & TestRandom();
+    pTerm->dwValue = pTerm->dwMask & TestRandom();
+
+    if (TestRandomBelow(3) == 0)
+    {
+        pTerm->dwDepMask  = TestRandom() & TestRandom() & ~pTerm->dwMask;
+        pTerm->dwDepValue = pTerm->dwDepMask & TestRandom();
+    }
+
+    pTerm->iWord   = TestRandomBelow(STYLEQUERY_WORDS);
+    pTerm->fNegate = TestRandomBelow(3) == 0;
+
+    if (TestRandomBelow(2) == 0)
+        pTerm->fClasses = STYLEQUERY_ALLCLASSES;
+    else
+        pTerm->fClasses = ((ULONGLONG)TestRandom() << 32 | TestRandom()) & ((ULONGLONG)TestRandom() << 32 | TestRandom());
+}
+
+//
+//  Random windows, each made to satisfy each term three times out of four,
+//  so that queries with several terms still match something.
+//
+static void MakeRandomWindows(const STYLEQUERY *pQuery, size_t cWindows)
+{
+    for (size_t i = 0; i < cWindows; i++)
+    {
+        for (UINT iWord = 0; iWord < STYLEQUERY_WORDS; iWord++)
+        {
+            g_rgWords[iWord][i] = TestRandom();
+        }
+
+        g_rgClass[i] = (BYTE)TestRandomBelow(64);
+
+        for (UINT t = 0; t < pQuery->cTerms; t++)
+        {
+            const STYLEQUERYTERM *pTerm = &pQuery->rgTerms[t];
+            DWORD                *pdw   = &g_rgWords[pTerm->iWord][i];
+
+            if (TestRandomBelow(4) != 0)
+            {
+                *pdw = (*pdw & ~(pTerm->dwMask | pTerm->dwDepMask)) | pTerm->dwValue | pTerm->dwDepValue;
+            }
+        }
+    }
+}
+
+//
+//  The plain loop: one window at a time, every term in turn.  Each run of
+//  alternatives is one predicate: any of its terms (ignored ones included)
+//  will do.
+//
+static BOOL WindowMatches(const STYLEQUERY *pQuery, const STYLEQUERYDATA *pData, size_t i)
+{
+    BOOL fMatch = TRUE;
+
+    for (UINT t = 0; t < pQuery->cTerms; )
+    {
+        BOOL fRunMatch = FALSE;
+
+        do
+        {
+            const STYLEQUERYTERM *pTerm = &pQuery->rgTerms[t];
+
+            if (!pData->rgWords[pTerm->iWord] || TermMatches(pTerm, pData->rgWords[pTerm->iWord][i], pData->rgClass[i]))
+                fRunMatch = TRUE;
+
+            t++;
+        }
+        while (t < pQuery->cTerms && pQuery->rgTerms[t].fAlternative);
+
+        if (!fRunMatch)
+            fMatch = FALSE;
+    }
+
+    return fMatch;
+}
+
+static void CheckQuery(const STYLEQUERY *pQuery, const STYLEQUERYDATA *pData, size_t cWindows)
+{
+    BYTE   rgfMatch[MAX_WINDOWS + 1];
+    size_t cExpected = 0;
+    size_t cWrong    = 0;
+
+    rgfMatch[cWindows] = 0xCC;
+
+    size_t cMatches = StyleQuery_Evaluate(pQuery, pData, cWindows, rgfMatch);
+
+    for (size_t i = 0; i < cWindows; i++)
+    {
+        BOOL fMatch = WindowMatches(pQuery, pData, i);
+
+        cExpected += fMatch;
+        cWrong    += (rgfMatch[i] != (BYTE)fMatch);
+    }
+
+    CHECK(cWrong == 0);
+    CHECK(cMatches == cExpected);
+    CHECK(rgfMatch[cWindows] == 0xCC);
+}
+
+static void TestRandomQueries(void)
+{
+    for (UINT iRun = 0; iRun < 5000; iRun++)
+    {
+        STYLEQUERY     query = { 0 };
+        STYLEQUERYDATA data  = { 0 };
+        size_t         cWindows;
+
+        // Sizes that aren't a multiple of 16 leave a tail for the scalar
+        // loops.
+        cWindows     = TestRandomBelow(MAX_WINDOWS + 1);
+        query.cTerms = TestRandomBelow(MAX_STYLEQUERY_TERMS + 1);
+
+        for (UINT t = 0; t < query.cTerms; t++)
+        {
+            MakeRandomTerm(&query.rgTerms[t]);
+
+            query.rgTerms[t].fAlternative = t > 0 && TestRandomBelow(4) == 0;
+        }
+
+        MakeRandomWindows(&query, cWindows);
+
+        for (UINT iWord = 0; iWord < STYLEQUERY_WORDS; iWord++)
+        {
+            data.rgWords[iWord] = (TestRandomBelow(5) == 0) ? NULL : g_rgWords[iWord];
+        }
+
+        data.rgClass = g_rgClass;
+
+        CheckQuery(&query, &data, cWindows);
+    }
+}
+
+static void TestNoTerms(void)
+{
+    STYLEQUERY     query = { 0 };
+    STYLEQUERYDATA data  = { { g_rgWords[0], g_rgWords[1], g_rgWords[2] }, g_rgClass };
+    BYTE           rgfMatch[40];
+
+    CHECK(StyleQuery_Evaluate(&query, &data, 40, rgfMatch) == 40);
+    CHECK(StyleQuery_Evaluate(&query, &data, 0, rgfMatch) == 0);
+}
+
+static void TestUsesWord(void)
+{
+    STYLEQUERY query = { 0 };
+
+    CHECK(!StyleQuery_UsesWord(&query, STYLEQUERY_STYLE));
+
+    query.cTerms = 2;
+    query.rgTerms[0].iWord = STYLEQUERY_EXSTYLE;
+    query.rgTerms[1].iWord = STYLEQUERY_EXTRA;
+
+    CHECK(!StyleQuery_UsesWord(&query, STYLEQUERY_STYLE));
+    CHECK(StyleQuery_UsesWord(&query, STYLEQUERY_EXSTYLE));
+    CHECK(StyleQuery_UsesWord(&query, STYLEQUERY_EXTRA));
+}
+
+#define BENCH_WINDOWS   1000000
+
+//
+//  Average milliseconds per evaluation, over enough runs to take a while.
+//  With fPlain the evaluation is the plain loop instead.
+//
+static double TimeEvaluate(const STYLEQUERY *pQuery, const STYLEQUERYDATA *pData, BYTE *rgfMatch, BOOL fPlain, size_t *pcMatches)
+{
+    clock_t tStart = clock();
+    UINT    cRuns  = 0;
+
+    do
+    {
+        if (fPlain)
+        {
+            *pcMatches = 0;
+
+            for (size_t i = 0; i < BENCH_WINDOWS; i++)
+            {
+                rgfMatch[i] = (BYTE)WindowMatches(pQuery, pData, i);
+                *pcMatches += rgfMatch[i];
+            }
+        }
+        else
+        {
+            *pcMatches = StyleQuery_Evaluate(pQuery, pData, BENCH_WINDOWS, rgfMatch);
+        }
+
+        cRuns++;
+    }
+    while (clock() - tStart < CLOCKS_PER_SEC / 2);
+
+    return (double)(clock() - tStart) * 1000 / CLOCKS_PER_SEC / cRuns;
+}
+
+//
+//  Terms on one bit each, like most style names, with a class style now
+//  and then and every third term an alternative to the one before.
+//
+static void MakeBenchQuery(STYLEQUERY *pQuery, UINT cTerms, BOOL fAlternatives)
+{
+    ZeroMemory(pQuery, sizeof(*pQuery));
+
+    for (UINT t = 0; t < cTerms; t++)
+    {
+        STYLEQUERYTERM *pTerm = &pQuery->rgTerms[t];
+
+        pTerm->iWord        = (TestRandomBelow(8) == 0) ? STYLEQUERY_EXTRA : TestRandomBelow(STYLEQUERY_EXTRA);
+        pTerm->dwMask       = 1u << TestRandomBelow(32);
+        pTerm->dwValue      = pTerm->dwMask;
+        pTerm->fNegate      = TestRandomBelow(4) == 0;
+        pTerm->fAlternative = fAlternatives && t % 3 == 2;
+        pTerm->fClasses     = (pTerm->iWord == STYLEQUERY_EXTRA) ? (1ull << TestRandomBelow(64)) : STYLEQUERY_ALLCLASSES;
+    }
+
+    pQuery->cTerms = cTerms;
+}
+
+static void Benchmark(void)
+{
+    static const UINT s_rgcTerms[] = { 1, 4, MAX_STYLEQUERY_TERMS };
+
+    STYLEQUERYDATA data;
+    DWORD         *rgWords  = (DWORD *)malloc((size_t)STYLEQUERY_WORDS * BENCH_WINDOWS * sizeof(DWORD));
+    BYTE          *rgClass  = (BYTE *)malloc(BENCH_WINDOWS);
+    BYTE          *rgfMatch = (BYTE *)malloc(BENCH_WINDOWS);
+
+    REQUIRE(rgWords && rgClass && rgfMatch, );
+
+    for (size_t i = 0; i < (size_t)STYLEQUERY_WORDS * BENCH_WINDOWS; i++)
+    {
+        rgWords[i] = TestRandom();
+    }
+
+    for (size_t i = 0; i < BENCH_WINDOWS; i++)
+    {
+        rgClass[i] = (BYTE)TestRandomBelow(64);
+    }
+
+    for (UINT iWord = 0; iWord < STYLEQUERY_WORDS; iWord++)
+    {
+        data.rgWords[iWord] = rgWords + (size_t)iWord * BENCH_WINDOWS;
+    }
+
+    data.rgClass = rgClass;
+
+    printf("%-20s %10s %12s %12s\n", "terms", "matches", "evaluate ms", "plain ms");
+
+    for (size_t i = 0; i < ARRAYSIZE(s_rgcTerms); i++)
+    {
+        for (int fAlternatives = 0; fAlternatives <= 1; fAlternatives++)
+        {
+            STYLEQUERY query;
+            char       szTerms[32];
+            size_t     cMatches;
+            size_t     cPlainMatches;
+            double     msEvaluate;
+            double     msPlain;
+
+            if (fAlternatives && s_rgcTerms[i] < 3)
+                continue;
+
+            MakeBenchQuery(&query, s_rgcTerms[i], fAlternatives);
+
+            msEvaluate = TimeEvaluate(&query, &data, rgfMatch, FALSE, &cMatches);
+            msPlain    = TimeEvaluate(&query, &data, rgfMatch, TRUE, &cPlainMatches);
+
+            CHECK(cMatches == cPlainMatches);
+
+            sprintf(szTerms, "%u%s", s_rgcTerms[i], fAlternatives ? " (alternatives)" : "");
+            printf("%-20s %10u %12.3f %12.3f\n", szTerms, (UINT)cMatches, msEvaluate, msPlain);
+        }
+    }
+
+    free(rgWords);
+    free(rgClass);
+    free(rgfMatch);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        Benchmark();
+        return TEST_RESULT();
+    }
+
+    TestNoTerms();
+    TestUsesWord();
+    TestRandomQueries();
+
+    return TEST_RESULT();
+}
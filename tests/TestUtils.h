@@ -0,0 +1,57 @@
+#ifndef TESTUTILS_INCLUDED
+#define TESTUTILS_INCLUDED
+
+//
+//  Minimal checks for the unit tests.  Each test is a program whose main
+//  runs its cases and returns TEST_RESULT(), so a failed check is reported
+//  with its line but the remaining cases still run.
+//
+
+#include <stdio.h>
+
+static int g_cTestFailures;
+
+#define CHECK(expr)                                                         \
+    do {                                                                    \
+        if (!(expr))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            g_cTestFailures++;                                              \
+        }                                                                   \
+    } while (0)
+
+// Like CHECK, but gives up on the current case, which returns rc.
+#define REQUIRE(expr, rc)                                                   \
+    do {                                                                    \
+        if (!(expr))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s(%d): REQUIRE(%s) failed\n", __FILE__, __LINE__, #expr); \
+            g_cTestFailures++;                                              \
+            return rc;                                                      \
+        }                                                                   \
+    } while (0)
+
+#define TEST_RESULT()   (g_cTestFailures ? (fprintf(stderr, "%d check(s) failed\n", g_cTestFailures), 1) : 0)
+
+//
+//  Deterministic generator for made-up data (xorshift64*), so failures can
+//  be reproduced.
+//
+static unsigned long long g_ullTestRandom = 0x2545F4914F6CDD1Dull;
+
+static __inline unsigned int TestRandom(void)
+{
+    g_ullTestRandom ^= g_ullTestRandom >> 12;
+    g_ullTestRandom ^= g_ullTestRandom << 25;
+    g_ullTestRandom ^= g_ullTestRandom >> 27;
+
+    return (unsigned int)((g_ullTestRandom * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// Uniform enough in [0, n) for test data.
+static __inline unsigned int TestRandomBelow(unsigned int n)
+{
+    return (unsigned int)(((unsigned long long)TestRandom() * n) >> 32);
+}
+
+#endif
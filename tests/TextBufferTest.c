@@ -0,0 +1,100 @@
+//
+//  TextBufferTest.c
+//
+//  Checks TEXTBUFFER growth and that LINEINDEX splits lines the way an
+//  edit control counts them.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "TextBuffer.h"
+#include "TestUtils.h"
+
+static void SetText(TEXTBUFFER *pText, PCWSTR psz)
+{
+    size_t cch = wcslen(psz);
+
+    pText->cchText = 0;
+
+    if (TextBuffer_Reserve(pText, cch))
+    {
+        memcpy(pText->pszText, psz, (cch + 1) * sizeof(WCHAR));
+        pText->cchText = cch;
+    }
+}
+
+//
+//  rgpszLines lists the lines the text should split into, then NULL.
+//
+static void CheckLines(PCWSTR pszText, PCWSTR *rgpszLines)
+{
+    TEXTBUFFER text  = { 0 };
+    LINEINDEX  index = { 0 };
+    size_t     cLines = 0;
+
+    SetText(&text, pszText);
+
+    REQUIRE(LineIndex_Build(&index, &text), );
+
+    while (rgpszLines[cLines])
+    {
+        const WCHAR *pch;
+        size_t       cch = LineIndex_GetLine(&index, &text, cLines, &pch);
+
+        CHECK(cch == wcslen(rgpszLines[cLines]) && wcsncmp(pch, rgpszLines[cLines], cch) == 0);
+        cLines++;
+    }
+
+    CHECK(index.cLines == cLines);
+
+    LineIndex_Free(&index);
+    TextBuffer_Free(&text);
+}
+
+static void TestLines(void)
+{
+    PCWSTR rgEmpty[]    = { L"", NULL };
+    PCWSTR rgOne[]      = { L"one", NULL };
+    PCWSTR rgMixed[]    = { L"a", L"b", L"c", L"", L"d", NULL };
+    PCWSTR rgTrailing[] = { L"a", L"", NULL };
+    PCWSTR rgCrCr[]     = { L"a", L"", L"b", NULL };
+
+    CheckLines(L"", rgEmpty);
+    CheckLines(L"one", rgOne);
+    CheckLines(L"a\r\nb\nc\r\rd", rgMixed);
+    CheckLines(L"a\r\n", rgTrailing);
+    CheckLines(L"a\r\rb", rgCrCr);
+}
+
+static void TestGrowth(void)
+{
+    TEXTBUFFER text = { 0 };
+
+    for (UINT i = 0; i < 100000; i++)
+    {
+        REQUIRE(TextBuffer_Reserve(&text, 1), );
+
+        text.pszText[text.cchText++] = (WCHAR)(L'a' + i % 26);
+        text.pszText[text.cchText]   = L'\0';
+    }
+
+    CHECK(wcslen(text.pszText) == 100000);
+    CHECK(text.cchAlloc < 2 * 100000 + 2);
+
+    CHECK(!TextBuffer_Reserve(&text, TEXTBUFFER_MAX_TEXT));
+
+    TextBuffer_Free(&text);
+
+    CHECK(text.pszText == NULL && text.cchAlloc == 0);
+}
+
+int main(void)
+{
+    TestLines();
+    TestGrowth();
+
+    return TEST_RESULT();
+}
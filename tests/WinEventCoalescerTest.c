@@ -0,0 +1,240 @@
+//
+//  WinEventCoalescerTest.c
+//
+//  Checks that events are merged per window, that batches keep the order
+//  windows were first seen in, and the overflow handling.
+//
+//  With --bench it times a second's worth of events at 100k events/sec
+//  instead, taken in batches at the tree's update rate.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "WinEventCoalescer.h"
+#include "TestUtils.h"
+
+#define MAX_WINDOWS 64
+
+static HWND MakeHwnd(UINT id)
+{
+    return (HWND)(ULONG_PTR)(0x10000 + id * 4);
+}
+
+static void TestMerge(void)
+{
+    WINEVENTCOALESCER   coalescer;
+    const WINEVENTITEM *rgItems;
+    BOOL                fOverflow;
+
+    REQUIRE(WinEventCoalescer_Init(&coalescer, MAX_WINDOWS), );
+
+    CHECK(WinEventCoalescer_Add(&coalescer, MakeHwnd(3), 1));
+    CHECK(!WinEventCoalescer_Add(&coalescer, MakeHwnd(1), 2));
+    CHECK(!WinEventCoalescer_Add(&coalescer, MakeHwnd(3), 4));
+    CHECK(!WinEventCoalescer_Add(&coalescer, MakeHwnd(2), 1));
+    CHECK(!WinEventCoalescer_Add(&coalescer, MakeHwnd(1), 2));
+
+    CHECK(WinEventCoalescer_TakeBatch(&coalescer, &rgItems, &fOverflow) == 3);
+    CHECK(!fOverflow);
+
+    CHECK(rgItems[0].hwnd == MakeHwnd(3) && rgItems[0].fEvents == 5);
+    CHECK(rgItems[1].hwnd == MakeHwnd(1) && rgItems[1].fEvents == 2);
+    CHECK(rgItems[2].hwnd == MakeHwnd(2) && rgItems[2].fEvents == 1);
+
+    // Events that come in while the batch is worked through start the
+    // next one, and leave the batch alone.
+
+    CHECK(WinEventCoalescer_Add(&coalescer, MakeHwnd(3), 8));
+
+    CHECK(rgItems[0].hwnd == MakeHwnd(3) && rgItems[0].fEvents == 5);
+
+    CHECK(WinEventCoalescer_TakeBatch(&coalescer, &rgItems, &fOverflow) == 1);
+    CHECK(rgItems[0].hwnd == MakeHwnd(3) && rgItems[0].fEvents == 8);
+
+    CHECK(WinEventCoalescer_TakeBatch(&coalescer, &rgItems, &fOverflow) == 0);
+
+    CHECK(coalescer.cEvents == 6);
+    CHECK(coalescer.cBatches == 3);
+
+    WinEventCoalescer_Free(&coalescer);
+}
+
+static void TestOverflow(void)
+{
+    WINEVENTCOALESCER   coalescer;
+    const WINEVENTITEM *rgItems;
+    BOOL                fOverflow;
+
+    REQUIRE(WinEventCoalescer_Init(&coalescer, MAX_WINDOWS), );
+
+    for (UINT i = 0; i <= MAX_WINDOWS; i++)
+    {
+        WinEventCoalescer_Add(&coalescer, MakeHwnd(i), 1);
+    }
+
+    // Windows already in the batch still take events.
+    WinEventCoalescer_Add(&coalescer, MakeHwnd(0), 2);
+
+    CHECK(WinEventCoalescer_TakeBatch(&coalescer, &rgItems, &fOverflow) == MAX_WINDOWS);
+    CHECK(fOverflow);
+    CHECK(rgItems[0].fEvents == 3);
+
+    WinEventCoalescer_Add(&coalescer, MakeHwnd(0), 1);
+
+    CHECK(WinEventCoalescer_TakeBatch(&coalescer, &rgItems, &fOverflow) == 1);
+    CHECK(!fOverflow);
+
+    WinEventCoalescer_Free(&coalescer);
+}
+
+//
+//  Random streams against a plain list, with batches small and large
+//  enough to take both ways of clearing the hash.
+//
+static void TestRandomStreams(void)
+{
+    WINEVENTCOALESCER coalescer;
+    WINEVENTITEM      rgExpected[MAX_WINDOWS];
+
+    REQUIRE(WinEventCoalescer_Init(&coalescer, MAX_WINDOWS), );
+
+    for (UINT iBatch = 0; iBatch < 2000; iBatch++)
+    {
+        const WINEVENTITEM *rgItems;
+        size_t              cExpected = 0;
+        BOOL                fExpectOverflow = FALSE;
+        BOOL                fOverflow;
+        UINT                cEvents = TestRandomBelow(3) ? TestRandomBelow(10) : TestRandomBelow(200);
+        UINT                cIds    = 1 + TestRandomBelow(MAX_WINDOWS + 10);
+
+        for (UINT e = 0; e < cEvents; e++)
+        {
+            HWND   hwnd   = MakeHwnd(TestRandomBelow(cIds));
+            UINT   fEvent = 1u << TestRandomBelow(8);
+            size_t i;
+
+            for (i = 0; i < cExpected && rgExpected[i].hwnd != hwnd; i++)
+            {
+            }
+
+            if (i < cExpected)
+            {
+                rgExpected[i].fEvents |= fEvent;
+            }
+            else if (cExpected < MAX_WINDOWS)
+            {
+                rgExpected[cExpected].hwnd    = hwnd;
+                rgExpected[cExpected].fEvents = fEvent;
+                cExpected++;
+            }
+            else
+            {
+                fExpectOverflow = TRUE;
+            }
+
+            CHECK(!WinEventCoalescer_Add(&coalescer, hwnd, fEvent) == !(e == 0));
+        }
+
+        CHECK(WinEventCoalescer_TakeBatch(&coalescer, &rgItems, &fOverflow) == cExpected);
+        CHECK(!fOverflow == !fExpectOverflow);
+
+        for (size_t i = 0; i < cExpected; i++)
+        {
+            CHECK(rgItems[i].hwnd == rgExpected[i].hwnd && rgItems[i].fEvents == rgExpected[i].fEvents);
+        }
+    }
+
+    WinEventCoalescer_Free(&coalescer);
+}
+
+//
+//  The tree takes a batch every 50 ms (LIVE_UPDATE_INTERVAL) and holds at
+//  most 2048 windows in one (LIVE_MAX_WINDOWS).
+//
+#define BENCH_EVENTS        100000
+#define BENCH_BATCHES       20
+#define BENCH_MAX_WINDOWS   2048
+
+//
+//  Average milliseconds to coalesce BENCH_EVENTS events, over enough runs
+//  to take a while.
+//
+static double TimeEvents(WINEVENTCOALESCER *pCoalescer, const HWND *rgHwnds)
+{
+    clock_t tStart = clock();
+    UINT    cRuns  = 0;
+
+    do
+    {
+        for (UINT iBatch = 0; iBatch < BENCH_BATCHES; iBatch++)
+        {
+            const WINEVENTITEM *rgItems;
+            BOOL                fOverflow;
+            UINT                iFirst = iBatch * (BENCH_EVENTS / BENCH_BATCHES);
+
+            for (UINT e = iFirst; e < iFirst + BENCH_EVENTS / BENCH_BATCHES; e++)
+            {
+                WinEventCoalescer_Add(pCoalescer, rgHwnds[e], 1u << (e & 7));
+            }
+
+            WinEventCoalescer_TakeBatch(pCoalescer, &rgItems, &fOverflow);
+        }
+
+        cRuns++;
+    }
+    while (clock() - tStart < CLOCKS_PER_SEC / 2);
+
+    return (double)(clock() - tStart) * 1000 / CLOCKS_PER_SEC / cRuns;
+}
+
+static void Benchmark(void)
+{
+    // From a few windows being hammered (a progress bar, a text field
+    // updating) to more windows than a batch can hold.
+
+    static const UINT s_rgcWindows[] = { 16, 256, 2048, 20000 };
+
+    WINEVENTCOALESCER coalescer;
+    HWND             *rgHwnds = (HWND *)malloc(BENCH_EVENTS * sizeof(HWND));
+
+    REQUIRE(rgHwnds, );
+    REQUIRE(WinEventCoalescer_Init(&coalescer, BENCH_MAX_WINDOWS), );
+
+    printf("%-10s %14s %14s\n", "windows", "ms per 100k", "ns per event");
+
+    for (size_t i = 0; i < ARRAYSIZE(s_rgcWindows); i++)
+    {
+        double ms;
+
+        for (UINT e = 0; e < BENCH_EVENTS; e++)
+        {
+            rgHwnds[e] = MakeHwnd(TestRandomBelow(s_rgcWindows[i]));
+        }
+
+        ms = TimeEvents(&coalescer, rgHwnds);
+
+        printf("%-10u %14.3f %14.1f\n", s_rgcWindows[i], ms, ms * 1000000 / BENCH_EVENTS);
+    }
+
+    WinEventCoalescer_Free(&coalescer);
+    free(rgHwnds);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        Benchmark();
+        return TEST_RESULT();
+    }
+
+    TestMerge();
+    TestOverflow();
+    TestRandomStreams();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,205 @@
+//
+//  WindowFromPointExTest.c
+//
+//  Checks the child grid the finder hit-tests with during a drag against
+//  the plain search over every child, on made-up sets of child rectangles.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "WindowFromPointEx.h"
+#include "TestUtils.h"
+
+#define MAX_CHILDREN    400
+
+static void SetChild(CHILDRECT *pChild, UINT i, LONG x, LONG y, LONG cx, LONG cy, BOOL fVisible)
+{
+    pChild->rect.left   = x;
+    pChild->rect.top    = y;
+    pChild->rect.right  = x + cx;
+    pChild->rect.bottom = y + cy;
+    pChild->hwnd        = (HWND)(ULONG_PTR)(0x10000 + i * 4);
+    pChild->dwArea      = (DWORD)(cx * cy);
+    pChild->fVisible    = fVisible;
+}
+
+static POINT MakePoint(LONG x, LONG y)
+{
+    POINT pt = { x, y };
+
+    return pt;
+}
+
+static void TestFixedCases(void)
+{
+    CHILDRECT rgChildren[5];
+    CHILDGRID grid = { 0 };
+
+    SetChild(&rgChildren[0], 0, 0, 0, 100, 100, TRUE);      // Group box
+    SetChild(&rgChildren[1], 1, 10, 10, 20, 10, TRUE);      // Check box
+    SetChild(&rgChildren[2], 2, 10, 10, 10, 20, TRUE);      // Same area, later
+    SetChild(&rgChildren[3], 3, 50, 50, 5, 5, FALSE);       // Hidden
+    SetChild(&rgChildren[4], 4, 60, 60, 0, 10, TRUE);       // Empty
+
+    REQUIRE(WindowFromPointEx_BuildGrid(&grid, rgChildren, ARRAYSIZE(rgChildren)), );
+
+    // Of two the same size, the first wins.
+    CHECK(WindowFromPointEx_FindInList(rgChildren, ARRAYSIZE(rgChildren), MakePoint(15, 15), FALSE) == 1);
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(15, 15), FALSE) == 1);
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(15, 25), FALSE) == 2);
+
+    // Hidden children only count when asked for.
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(52, 52), FALSE) == 0);
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(52, 52), TRUE) == 3);
+
+    // The left and top edges are inside, the right and bottom ones aren't.
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(50, 50), TRUE) == 3);
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(55, 54), TRUE) == 0);
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(100, 50), TRUE) == MAXUINT);
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(-1, 50), TRUE) == MAXUINT);
+
+    // Empty rectangles never contain anything.
+    CHECK(WindowFromPointEx_FindInGrid(&grid, rgChildren, MakePoint(60, 65), TRUE) == 0);
+
+    // The check boxes overlap each other, the hidden one only overlaps
+    // the group box.
+    CHECK(!WindowFromPointEx_IsAloneInGrid(&grid, rgChildren, 1, FALSE));
+    CHECK(WindowFromPointEx_IsAloneInGrid(&grid, rgChildren, 3, TRUE));
+    CHECK(!WindowFromPointEx_IsAloneInGrid(&grid, rgChildren, 0, FALSE));
+
+    WindowFromPointEx_FreeGrid(&grid);
+}
+
+//
+//  Children crowded into a small area, so that plenty of them overlap,
+//  with sizes from a short list, so that plenty of them are the same size
+//  (and some are the same size one way up and the other).  A few are
+//  hidden, and a few are empty.
+//
+static size_t MakeRandomChildren(CHILDRECT *rgChildren)
+{
+    static const LONG s_rgSizes[] = { 0, 5, 10, 20, 40, 80, 160 };
+
+    size_t cChildren = TestRandomBelow(MAX_CHILDREN + 1);
+    LONG   cxArea    = 50 + (LONG)TestRandomBelow(600);
+    LONG   cyArea    = 50 + (LONG)TestRandomBelow(600);
+
+    for (size_t i = 0; i < cChildren; i++)
+    {
+        LONG cx = s_rgSizes[TestRandomBelow(ARRAYSIZE(s_rgSizes))];
+        LONG cy = s_rgSizes[TestRandomBelow(ARRAYSIZE(s_rgSizes))];
+
+        SetChild(&rgChildren[i], (UINT)i, (LONG)TestRandomBelow(cxArea) - 100, (LONG)TestRandomBelow(cyArea) - 100, cx, cy, TestRandomBelow(5) != 0);
+    }
+
+    return cChildren;
+}
+
+//
+//  Points on, just inside and just outside a random child's edges, and
+//  anywhere around the children at all.
+//
+static POINT MakeRandomPoint(const CHILDRECT *rgChildren, size_t cChildren)
+{
+    POINT pt;
+
+    if (cChildren > 0 && TestRandomBelow(3) != 0)
+    {
+        const RECT *prc = &rgChildren[TestRandomBelow((UINT)cChildren)].rect;
+        LONG        d   = (LONG)TestRandomBelow(3) - 1;
+
+        pt.x = TestRandomBelow(2) ? prc->left + d : prc->right + d;
+        pt.y = TestRandomBelow(2) ? prc->top + d : prc->bottom + d;
+
+        if (TestRandomBelow(2))
+            pt.x = prc->left + (LONG)TestRandomBelow((UINT)(prc->right - prc->left) + 1);
+    }
+    else
+    {
+        pt.x = (LONG)TestRandomBelow(900) - 150;
+        pt.y = (LONG)TestRandomBelow(900) - 150;
+    }
+
+    return pt;
+}
+
+static BOOL IsAloneReference(const CHILDRECT *rgChildren, size_t cChildren, UINT iBest, BOOL fAllowHidden)
+{
+    RECT rect;
+
+    for (size_t i = 0; i < cChildren; i++)
+    {
+        if (i != iBest &&
+            rgChildren[i].dwArea <= rgChildren[iBest].dwArea &&
+            (fAllowHidden || rgChildren[i].fVisible) &&
+            IntersectRect(&rect, &rgChildren[i].rect, &rgChildren[iBest].rect))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void TestRandomChildren(void)
+{
+    static CHILDRECT s_rgChildren[MAX_CHILDREN];
+
+    CHILDGRID grid = { 0 };
+    size_t    cWrong = 0;
+    size_t    cWrongAlone = 0;
+    size_t    cWrongStable = 0;
+
+    for (UINT iRun = 0; iRun < 1000; iRun++)
+    {
+        size_t cChildren = MakeRandomChildren(s_rgChildren);
+
+        REQUIRE(WindowFromPointEx_BuildGrid(&grid, s_rgChildren, cChildren), );
+
+        for (UINT iPoint = 0; iPoint < 200; iPoint++)
+        {
+            POINT pt           = MakeRandomPoint(s_rgChildren, cChildren);
+            BOOL  fAllowHidden = TestRandomBelow(2);
+            UINT  iBest        = WindowFromPointEx_FindInList(s_rgChildren, cChildren, pt, fAllowHidden);
+
+            cWrong += WindowFromPointEx_FindInGrid(&grid, s_rgChildren, pt, fAllowHidden) != iBest;
+
+            if (iBest == MAXUINT)
+                continue;
+
+            BOOL fAlone = WindowFromPointEx_IsAloneInGrid(&grid, s_rgChildren, iBest, fAllowHidden);
+
+            cWrongAlone += fAlone != IsAloneReference(s_rgChildren, cChildren, iBest, fAllowHidden);
+
+            // A child that's alone is the answer all over itself, which
+            // is what lets the finder skip hit-testing inside it.
+            if (fAlone)
+            {
+                const RECT *prc = &s_rgChildren[iBest].rect;
+                POINT       ptInside;
+
+                ptInside.x = prc->left + (LONG)TestRandomBelow((UINT)(prc->right - prc->left));
+                ptInside.y = prc->top + (LONG)TestRandomBelow((UINT)(prc->bottom - prc->top));
+
+                cWrongStable += WindowFromPointEx_FindInList(s_rgChildren, cChildren, ptInside, fAllowHidden) != iBest;
+            }
+        }
+    }
+
+    CHECK(cWrong == 0);
+    CHECK(cWrongAlone == 0);
+    CHECK(cWrongStable == 0);
+
+    WindowFromPointEx_FreeGrid(&grid);
+}
+
+int main(void)
+{
+    TestFixedCases();
+    TestRandomChildren();
+
+    return TEST_RESULT();
+}
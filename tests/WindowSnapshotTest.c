@@ -0,0 +1,166 @@
+//
+//  WindowSnapshotTest.c
+//
+//  Runs WindowSnapshot_Query over the fake backend and checks every entry
+//  against querying it directly, for lists around the chunk size and
+//  several thread counts, and that hung windows overlap instead of adding
+//  up.
+//
+//  With --bench it times snapshots of 100k windows, and of 2000 with some
+//  of them hung, on one thread and on the default number of workers.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "WindowSnapshot.h"
+#include "TestUtils.h"
+
+//
+//  Entry i is window i + 1, except that every 7th is NULL and is filled
+//  with a pattern that must survive.
+//
+static void FillList(WINDOWMETA *rgMeta, size_t cMeta)
+{
+    for (size_t i = 0; i < cMeta; i++)
+    {
+        memset(&rgMeta[i], 0xA5, sizeof(rgMeta[i]));
+        rgMeta[i].hwnd = (i % 7 == 6) ? NULL : (HWND)(ULONG_PTR)(i + 1);
+    }
+}
+
+//
+//  The number of entries that aren't what querying them one at a time
+//  gives (or, for the NULL ones, aren't left alone).
+//
+static size_t CountWrong(const WINDOWMETA *rgMeta, size_t cMeta)
+{
+    size_t cWrong = 0;
+
+    for (size_t i = 0; i < cMeta; i++)
+    {
+        WINDOWMETA meta;
+
+        memset(&meta, 0xA5, sizeof(meta));
+        meta.hwnd = rgMeta[i].hwnd;
+
+        if (meta.hwnd)
+            WindowMeta_QueryFake(&meta, NULL);
+
+        cWrong += memcmp(&meta, &rgMeta[i], sizeof(meta)) != 0;
+    }
+
+    return cWrong;
+}
+
+static void TestQuery(void)
+{
+    static const size_t s_rgcMeta[] = { 0, 1, 15, 16, 17, 33, 1000, 5000 };
+    static const UINT   s_rgcThreads[] = { 0, 1, 3, 64 };
+
+    WINDOWMETABACKEND backend = { WindowMeta_QueryFake, NULL };
+    WINDOWMETA       *rgMeta  = (WINDOWMETA *)malloc(5000 * sizeof(WINDOWMETA));
+
+    REQUIRE(rgMeta, );
+
+    for (size_t i = 0; i < ARRAYSIZE(s_rgcMeta); i++)
+    {
+        for (size_t j = 0; j < ARRAYSIZE(s_rgcThreads); j++)
+        {
+            FillList(rgMeta, s_rgcMeta[i]);
+            WindowSnapshot_Query(rgMeta, s_rgcMeta[i], &backend, s_rgcThreads[j]);
+
+            CHECK(CountWrong(rgMeta, s_rgcMeta[i]) == 0);
+        }
+    }
+
+    free(rgMeta);
+}
+
+//
+//  Eight windows that take 50ms each, two to a chunk, over four workers,
+//  take 100ms rather than 400ms.
+//
+static void TestHungWindows(void)
+{
+    FAKEWINDOWMETA    fake    = { 8, 50 };
+    WINDOWMETABACKEND backend = { WindowMeta_QueryFake, &fake };
+    WINDOWMETA        rgMeta[64];
+    DWORD             dwStart;
+    DWORD             dwElapsed;
+
+    FillList(rgMeta, ARRAYSIZE(rgMeta));
+
+    dwStart = GetTickCount();
+    WindowSnapshot_Query(rgMeta, ARRAYSIZE(rgMeta), &backend, 4);
+    dwElapsed = GetTickCount() - dwStart;
+
+    CHECK(CountWrong(rgMeta, ARRAYSIZE(rgMeta)) == 0);
+    CHECK(dwElapsed >= 100);
+    CHECK(dwElapsed < 300);
+}
+
+#define BENCH_WINDOWS   100000
+
+//
+//  Average milliseconds per snapshot, by the wall clock since the work is
+//  spread over threads.  Wrong entries are counted in *pcWrong.
+//
+static double TimeSnapshot(WINDOWMETA *rgMeta, size_t cMeta, const WINDOWMETABACKEND *pBackend, UINT cThreads, size_t *pcWrong)
+{
+    DWORD dwStart = GetTickCount();
+    UINT  cRuns   = 0;
+
+    do
+    {
+        FillList(rgMeta, cMeta);
+        WindowSnapshot_Query(rgMeta, cMeta, pBackend, cThreads);
+        cRuns++;
+    }
+    while (GetTickCount() - dwStart < 500);
+
+    *pcWrong += CountWrong(rgMeta, cMeta);
+
+    return (double)(GetTickCount() - dwStart) / cRuns;
+}
+
+static void Benchmark(void)
+{
+    FAKEWINDOWMETA    fakeHung = { 100, 20 };
+    WINDOWMETABACKEND backend  = { WindowMeta_QueryFake, NULL };
+    WINDOWMETABACKEND hung     = { WindowMeta_QueryFake, &fakeHung };
+    WINDOWMETA       *rgMeta   = (WINDOWMETA *)malloc(BENCH_WINDOWS * sizeof(WINDOWMETA));
+    size_t            cWrong   = 0;
+
+    REQUIRE(rgMeta, );
+
+    printf("%-24s %12s %12s\n", "snapshot", "1 thread ms", "default ms");
+
+    printf("%-24s %12.1f %12.1f\n", "100000 windows",
+           TimeSnapshot(rgMeta, BENCH_WINDOWS, &backend, 1, &cWrong),
+           TimeSnapshot(rgMeta, BENCH_WINDOWS, &backend, 0, &cWrong));
+
+    printf("%-24s %12.1f %12.1f\n", "2000, 1 in 100 hung",
+           TimeSnapshot(rgMeta, 2000, &hung, 1, &cWrong),
+           TimeSnapshot(rgMeta, 2000, &hung, 0, &cWrong));
+
+    CHECK(cWrong == 0);
+
+    free(rgMeta);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        Benchmark();
+        return TEST_RESULT();
+    }
+
+    TestQuery();
+    TestHungWindows();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,314 @@
+//
+//  WindowTreeDiffTest.c
+//
+//  Checks WindowTreeDiff_Compute on made-up trees: the old tree is a node
+//  pool with free slots in it, and the new one is the old one with
+//  windows added, removed, moved to other parents, reordered and listed
+//  twice.
+//
+
+#include "WinSpy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "WindowTreeDiff.h"
+#include "TestUtils.h"
+
+#define MAX_NODES   400
+
+static TREENODE g_rgOld[MAX_NODES];
+static TREENODE g_rgNew[MAX_NODES];
+
+static HWND MakeHwnd(UINT id)
+{
+    return (HWND)(ULONG_PTR)(0x10000 + id * 4);
+}
+
+//
+//  A snapshot: process nodes at the top, windows under them, each node
+//  after its parent.  Window ids come from *pidNext so they are unique.
+//
+static size_t MakeRandomSnapshot(TREENODE *rgNodes, size_t cMax, UINT *pidNext)
+{
+    size_t cNodes = 0;
+
+    while (cNodes < cMax)
+    {
+        TREENODE *pNode  = &rgNodes[cNodes];
+        ptrdiff_t iParent = cNodes ? (ptrdiff_t)TestRandomBelow((UINT)cNodes + 1) - 1 : -1;
+
+        ZeroMemory(pNode, sizeof(*pNode));
+
+        if (iParent == -1 && TestRandomBelow(2) == 0)
+            pNode->dwPID = 1000 + (*pidNext)++;
+        else
+            pNode->hwnd = MakeHwnd((*pidNext)++);
+
+        pNode->iParent = iParent;
+        pNode->lOrder  = (LONG)TestRandomBelow(50);
+
+        cNodes++;
+    }
+
+    return cNodes;
+}
+
+//
+//  Scatters a snapshot into a pool the way the tree keeps its nodes: in no
+//  particular order, with free slots between them.
+//
+static size_t MakePool(const TREENODE *rgSnap, size_t cSnap, TREENODE *rgPool)
+{
+    ptrdiff_t rgWhere[MAX_NODES];
+    size_t    cPool = 0;
+
+    ZeroMemory(rgPool, MAX_NODES * sizeof(TREENODE));
+
+    for (size_t i = 0; i < cSnap; i++)
+    {
+        rgWhere[i] = -1;
+    }
+
+    // Every snapshot node gets a slot, most of them in a random place.
+
+    for (size_t i = 0; i < cSnap; i++)
+    {
+        size_t slot;
+
+        do
+        {
+            slot = TestRandomBelow((UINT)min(cSnap * 2, MAX_NODES));
+        }
+        while (!IsTreeNodeFree(&rgPool[slot]));
+
+        rgPool[slot] = rgSnap[i];
+        rgWhere[i]   = (ptrdiff_t)slot;
+        cPool        = max(cPool, slot + 1);
+    }
+
+    for (size_t slot = 0; slot < cPool; slot++)
+    {
+        if (!IsTreeNodeFree(&rgPool[slot]) && rgPool[slot].iParent != -1)
+        {
+            rgPool[slot].iParent = rgWhere[rgPool[slot].iParent];
+        }
+    }
+
+    return cPool;
+}
+
+//
+//  The new snapshot: starts from the old one, drops some windows (and
+//  their subtrees), moves some, renumbers the sibling order, adds new ones
+//  and repeats a few, like EnumChildWindows can.
+//
+static size_t MakeChangedSnapshot(const TREENODE *rgSnap, size_t cSnap, TREENODE *rgNew, UINT *pidNext)
+{
+    ptrdiff_t rgNewIndex[MAX_NODES];
+    size_t    cNew = 0;
+
+    for (size_t i = 0; i < cSnap && cNew < MAX_NODES; i++)
+    {
+        const TREENODE *pOld    = &rgSnap[i];
+        ptrdiff_t       iParent = (pOld->iParent == -1) ? -1 : rgNewIndex[pOld->iParent];
+
+        rgNewIndex[i] = -1;
+
+        if (pOld->iParent != -1 && iParent == -1)
+            continue;
+
+        if (TestRandomBelow(10) == 0)
+            continue;
+
+        if (pOld->hwnd && cNew && TestRandomBelow(10) == 0)
+            iParent = (ptrdiff_t)TestRandomBelow((UINT)cNew + 1) - 1;
+
+        rgNew[cNew] = *pOld;
+        rgNew[cNew].iParent = iParent;
+
+        if (TestRandomBelow(4) == 0)
+            rgNew[cNew].lOrder = (LONG)TestRandomBelow(50);
+
+        rgNewIndex[i] = (ptrdiff_t)cNew++;
+
+        if (pOld->hwnd && cNew < MAX_NODES && TestRandomBelow(30) == 0)
+        {
+            rgNew[cNew] = rgNew[cNew - 1];
+            rgNew[cNew].iParent = (ptrdiff_t)TestRandomBelow((UINT)cNew + 1) - 1;
+            cNew++;
+        }
+
+        if (cNew < MAX_NODES && TestRandomBelow(8) == 0)
+        {
+            ZeroMemory(&rgNew[cNew], sizeof(TREENODE));
+
+            rgNew[cNew].hwnd    = MakeHwnd((*pidNext)++);
+            rgNew[cNew].iParent = (ptrdiff_t)TestRandomBelow((UINT)cNew + 1) - 1;
+            rgNew[cNew].lOrder  = (LONG)TestRandomBelow(50);
+            cNew++;
+        }
+    }
+
+    return cNew;
+}
+
+static BOOL SameKey(const TREENODE *pNode1, const TREENODE *pNode2)
+{
+    return pNode1->hwnd == pNode2->hwnd && pNode1->dwPID == pNode2->dwPID;
+}
+
+static void CheckDiff(const TREENODE *rgOld, size_t cOld, const TREENODE *rgNew, size_t cNew, const TREEDIFF *pDiff)
+{
+    BOOL rgSeen[MAX_NODES + 1] = { 0 };
+    BOOL rgKept[MAX_NODES + 1] = { 0 };
+
+    // Matches: same window, same (matched) parent, each old node once.
+    // A new node is only left unmatched if it can't be matched, or its old
+    // node was taken by an earlier duplicate.
+
+    for (size_t i = 0; i < cNew; i++)
+    {
+        ptrdiff_t iMatch     = pDiff->rgMatch[i];
+        ptrdiff_t iNewParent = rgNew[i].iParent;
+        ptrdiff_t iOldParent = (iNewParent == -1) ? -1 : pDiff->rgMatch[iNewParent];
+        BOOL      fParentOK  = (iNewParent == -1) || (iOldParent != -1);
+
+        if (iMatch != -1)
+        {
+            REQUIRE(iMatch >= 0 && (size_t)iMatch < cOld, );
+            CHECK(SameKey(&rgOld[iMatch], &rgNew[i]));
+            CHECK(fParentOK && rgOld[iMatch].iParent == iOldParent);
+            CHECK(!rgKept[iMatch]);
+
+            rgKept[iMatch] = TRUE;
+        }
+        else
+        {
+            for (size_t j = 0; j < cOld; j++)
+            {
+                if (!IsTreeNodeFree(&rgOld[j]) && SameKey(&rgOld[j], &rgNew[i]) &&
+                    fParentOK && rgOld[j].iParent == iOldParent)
+                {
+                    CHECK(rgKept[j]);
+                }
+            }
+        }
+    }
+
+    for (size_t j = 0; j < cOld; j++)
+    {
+        CHECK(!pDiff->rgOldKept[j] == !rgKept[j]);
+    }
+
+    // The order: every new node once, grouped by parent, by lOrder within
+    // a parent.  A parent is marked for resorting exactly when the kept
+    // children are out of their old order.
+
+    for (size_t k = 0; k < cNew; k++)
+    {
+        ptrdiff_t i = pDiff->rgOrder[k];
+
+        REQUIRE(i >= 0 && (size_t)i < cNew && !rgSeen[i], );
+        rgSeen[i] = TRUE;
+
+        if (k > 0)
+        {
+            const TREENODE *pPrev = &rgNew[pDiff->rgOrder[k - 1]];
+
+            CHECK(pPrev->iParent < rgNew[i].iParent ||
+                  (pPrev->iParent == rgNew[i].iParent && pPrev->lOrder <= rgNew[i].lOrder));
+        }
+    }
+
+    for (ptrdiff_t iParent = -1; iParent < (ptrdiff_t)cNew; iParent++)
+    {
+        BOOL fOutOfOrder = FALSE;
+        BOOL fSeenKept   = FALSE;
+        LONG lLastOrder  = 0;
+
+        for (size_t k = 0; k < cNew; k++)
+        {
+            ptrdiff_t i = pDiff->rgOrder[k];
+
+            if (rgNew[i].iParent != iParent || pDiff->rgMatch[i] == -1)
+                continue;
+
+            if (fSeenKept && rgOld[pDiff->rgMatch[i]].lOrder < lLastOrder)
+                fOutOfOrder = TRUE;
+
+            lLastOrder = rgOld[pDiff->rgMatch[i]].lOrder;
+            fSeenKept  = TRUE;
+        }
+
+        if (iParent == -1)
+            CHECK(!pDiff->fResortRoot == !fOutOfOrder);
+        else
+            CHECK(!pDiff->rgResort[iParent] == !fOutOfOrder);
+    }
+}
+
+static void TestRandomTrees(void)
+{
+    static TREENODE rgSnap[MAX_NODES];
+
+    for (UINT iRun = 0; iRun < 2000; iRun++)
+    {
+        UINT     idNext = 0;
+        size_t   cSnap  = TestRandomBelow(MAX_NODES / 2);
+        size_t   cOld, cNew;
+        TREEDIFF diff;
+
+        cSnap = MakeRandomSnapshot(rgSnap, cSnap, &idNext);
+        cOld  = MakePool(rgSnap, cSnap, g_rgOld);
+        cNew  = MakeChangedSnapshot(rgSnap, cSnap, g_rgNew, &idNext);
+
+        REQUIRE(WindowTreeDiff_Compute(g_rgOld, cOld, g_rgNew, cNew, &diff), );
+
+        CheckDiff(g_rgOld, cOld, g_rgNew, cNew, &diff);
+
+        WindowTreeDiff_Free(&diff);
+        CHECK(diff.rgMatch == NULL);
+    }
+}
+
+static void TestUnchangedTree(void)
+{
+    static TREENODE rgSnap[MAX_NODES];
+
+    UINT     idNext = 0;
+    size_t   cSnap  = MakeRandomSnapshot(rgSnap, 100, &idNext);
+    TREEDIFF diff;
+
+    // Straight from the snapshot, so the indices are the same.
+
+    REQUIRE(WindowTreeDiff_Compute(rgSnap, cSnap, rgSnap, cSnap, &diff), );
+
+    for (size_t i = 0; i < cSnap; i++)
+    {
+        CHECK(diff.rgMatch[i] == (ptrdiff_t)i);
+        CHECK(!diff.rgResort[i]);
+    }
+
+    CHECK(!diff.fResortRoot);
+
+    WindowTreeDiff_Free(&diff);
+}
+
+static void TestEmpty(void)
+{
+    TREEDIFF diff;
+
+    REQUIRE(WindowTreeDiff_Compute(NULL, 0, NULL, 0, &diff), );
+    CHECK(!diff.fResortRoot);
+    WindowTreeDiff_Free(&diff);
+}
+
+int main(void)
+{
+    TestEmpty();
+    TestUnchangedTree();
+    TestRandomTrees();
+
+    return TEST_RESULT();
+}
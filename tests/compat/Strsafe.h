@@ -0,0 +1,2 @@
+// See windows.h.  Nothing from strsafe.h is needed off Windows.
+#include "windows.h"
@@ -0,0 +1,13 @@
+#ifndef COMPAT_COMMCTRL_INCLUDED
+#define COMPAT_COMMCTRL_INCLUDED
+
+// See windows.h.  Only the types that WinSpy.h and WindowTreeDiff.h use.
+
+#include "windows.h"
+
+typedef struct _TREEITEM *HTREEITEM;
+
+typedef struct tagNMHDR         NMHDR;
+typedef struct tagLVDISPINFOW   NMLVDISPINFO;
+
+#endif
@@ -0,0 +1,2 @@
+// See windows.h.  Nothing from dwmapi.h is needed off Windows.
+#include "windows.h"
@@ -0,0 +1,2 @@
+// See windows.h.  The modules include malloc.h for malloc and friends.
+#include <stdlib.h>
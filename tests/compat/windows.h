@@ -0,0 +1,499 @@
+#ifndef COMPAT_WINDOWS_INCLUDED
+#define COMPAT_WINDOWS_INCLUDED
+
+//
+//  Just enough of the Windows headers to compile WinSpy.h and the modules
+//  that don't call into Windows (StyleDecoder.c, SearchIndex.c, ...) with
+//  other compilers, so their tests can run anywhere.  Only used when the
+//  tests are built off Windows; see tests/CMakeLists.txt.
+//
+//  The types have the sizes they have on Windows, except WCHAR, which is
+//  wchar_t so that L"" literals and the C library's wide string functions
+//  can be used on it.
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Code that keys off the MSVC architecture macros takes the same paths.
+#if defined(__x86_64__) && !defined(_M_X64)
+#define _M_X64 100
+#endif
+
+#define WINAPI
+#define CALLBACK
+#define __cdecl
+#define __forceinline   inline __attribute__((always_inline))
+
+#define TRUE    1
+#define FALSE   0
+
+typedef int                 BOOL;
+typedef int                 INT;
+typedef unsigned int        UINT;
+typedef int32_t             LONG;
+typedef uint32_t            ULONG;
+typedef uint32_t            DWORD;
+typedef uint16_t            WORD;
+typedef uint8_t             BYTE;
+typedef int64_t             LONGLONG;
+typedef uint64_t            ULONGLONG;
+typedef intptr_t            INT_PTR;
+typedef uintptr_t           UINT_PTR;
+typedef intptr_t            LONG_PTR;
+typedef uintptr_t           ULONG_PTR;
+typedef uintptr_t           DWORD_PTR;
+typedef void               *PVOID;
+typedef void               *HANDLE;
+typedef WORD                ATOM;
+
+typedef wchar_t             WCHAR;
+typedef WCHAR              *PWSTR;
+typedef const WCHAR        *PCWSTR;
+typedef char               *PSTR;
+typedef const char         *PCSTR;
+
+typedef UINT_PTR            WPARAM;
+typedef LONG_PTR            LPARAM;
+typedef LONG_PTR            LRESULT;
+
+#define DECLARE_HANDLE(name) typedef struct name##__ { int unused; } *name
+
+DECLARE_HANDLE(HWND);
+DECLARE_HANDLE(HINSTANCE);
+DECLARE_HANDLE(HMENU);
+DECLARE_HANDLE(HICON);
+DECLARE_HANDLE(HBRUSH);
+
+typedef HICON               HCURSOR;
+
+typedef LRESULT (CALLBACK *WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+typedef INT_PTR (CALLBACK *DLGPROC)(HWND, UINT, WPARAM, LPARAM);
+
+typedef struct tagPOINT
+{
+    LONG x;
+    LONG y;
+}
+POINT;
+
+typedef struct tagRECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+}
+RECT;
+
+typedef struct tagSIZE
+{
+    LONG cx;
+    LONG cy;
+}
+SIZE;
+
+typedef struct tagMSG
+{
+    HWND    hwnd;
+    UINT    message;
+    WPARAM  wParam;
+    LPARAM  lParam;
+    DWORD   time;
+    POINT   pt;
+}
+MSG, *LPMSG;
+
+// Only ever used through pointers by the code that gets compiled here.
+typedef struct tagWINDOWPOS         WINDOWPOS;
+typedef struct tagMEASUREITEMSTRUCT MEASUREITEMSTRUCT;
+typedef struct tagDRAWITEMSTRUCT    DRAWITEMSTRUCT;
+
+typedef struct tagWNDCLASSEXW
+{
+    UINT        cbSize;
+    UINT        style;
+    WNDPROC     lpfnWndProc;
+    int         cbClsExtra;
+    int         cbWndExtra;
+    HINSTANCE   hInstance;
+    HICON       hIcon;
+    HCURSOR     hCursor;
+    HBRUSH      hbrBackground;
+    PCWSTR      lpszMenuName;
+    PCWSTR      lpszClassName;
+    HICON       hIconSm;
+}
+WNDCLASSEXW, WNDCLASSEX;
+
+#define MAXUINT     ((UINT)~((UINT)0))
+#define MAXLONG     0x7FFFFFFF
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#ifndef max
+#define max(a, b)   (((a) > (b)) ? (a) : (b))
+#endif
+
+#ifndef min
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+#endif
+
+#define ZeroMemory(p, cb)   memset((p), 0, (cb))
+
+static inline BOOL IsRectEmpty(const RECT *prc)
+{
+    return prc->left >= prc->right || prc->top >= prc->bottom;
+}
+
+static inline BOOL SetRectEmpty(RECT *prc)
+{
+    memset(prc, 0, sizeof(RECT));
+    return TRUE;
+}
+
+static inline BOOL PtInRect(const RECT *prc, POINT pt)
+{
+    return pt.x >= prc->left && pt.x < prc->right && pt.y >= prc->top && pt.y < prc->bottom;
+}
+
+static inline BOOL IntersectRect(RECT *prcDst, const RECT *prc1, const RECT *prc2)
+{
+    RECT rc = { max(prc1->left, prc2->left), max(prc1->top, prc2->top), min(prc1->right, prc2->right), min(prc1->bottom, prc2->bottom) };
+
+    if (IsRectEmpty(&rc))
+    {
+        SetRectEmpty(prcDst);
+        return FALSE;
+    }
+
+    *prcDst = rc;
+    return TRUE;
+}
+
+static inline BOOL UnionRect(RECT *prcDst, const RECT *prc1, const RECT *prc2)
+{
+    RECT rc;
+
+    if (IsRectEmpty(prc1))
+        rc = *prc2;
+    else if (IsRectEmpty(prc2))
+        rc = *prc1;
+    else
+    {
+        rc.left   = min(prc1->left, prc2->left);
+        rc.top    = min(prc1->top, prc2->top);
+        rc.right  = max(prc1->right, prc2->right);
+        rc.bottom = max(prc1->bottom, prc2->bottom);
+    }
+
+    if (IsRectEmpty(&rc))
+    {
+        SetRectEmpty(prcDst);
+        return FALSE;
+    }
+
+    *prcDst = rc;
+    return TRUE;
+}
+
+#define WM_APP  0x8000
+
+#define WS_OVERLAPPEDWINDOW 0x00CF0000
+#define WS_VISIBLE          0x10000000
+#define WS_CHILD            0x40000000
+#define WS_EX_LAYERED       0x00080000
+
+// From the CRT, which has these with MSVC.
+
+#define swprintf_s  swprintf
+
+static inline int wcscpy_s(WCHAR *pszDst, size_t cchDst, const WCHAR *pszSrc)
+{
+    size_t cch = wcslen(pszSrc);
+
+    if (cch >= cchDst)
+    {
+        if (cchDst)
+            pszDst[0] = L'\0';
+
+        return 34;      // ERANGE
+    }
+
+    memcpy(pszDst, pszSrc, (cch + 1) * sizeof(WCHAR));
+    return 0;
+}
+
+static inline BOOL BitScanForward(DWORD *pIndex, DWORD dwMask)
+{
+    if (dwMask == 0)
+        return FALSE;
+
+    *pIndex = (DWORD)__builtin_ctz(dwMask);
+    return TRUE;
+}
+
+static inline LONG InterlockedIncrement(volatile LONG *pl)
+{
+    return __atomic_add_fetch(pl, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedDecrement(volatile LONG *pl)
+{
+    return __atomic_sub_fetch(pl, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedExchange(volatile LONG *pl, LONG l)
+{
+    return __atomic_exchange_n(pl, l, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedExchangeAdd(volatile LONG *pl, LONG l)
+{
+    return __atomic_fetch_add(pl, l, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG ReadAcquire(const volatile LONG *pl)
+{
+    return __atomic_load_n(pl, __ATOMIC_ACQUIRE);
+}
+
+static inline void WriteRelease(volatile LONG *pl, LONG l)
+{
+    __atomic_store_n(pl, l, __ATOMIC_RELEASE);
+}
+
+//
+//  Threads, events and the thread pool, for the tests that run both sides
+//  of something at once, and the modules that use them.  Events are always
+//  manual-reset and waits are always INFINITE.  A thread handle can only
+//  be waited on until it finishes, and only once.  There are no messages
+//  off Windows, so waiting for them only ever waits for the object.
+//
+
+#define INFINITE        0xFFFFFFFF
+#define WAIT_OBJECT_0   0
+
+#define QS_SENDMESSAGE      0x0040
+#define PM_NOREMOVE         0x0000
+#define PM_QS_SENDMESSAGE   (QS_SENDMESSAGE << 16)
+
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(PVOID);
+
+typedef struct _TP_CALLBACK_INSTANCE   *PTP_CALLBACK_INSTANCE;
+typedef struct _TP_CALLBACK_ENVIRON_V3 *PTP_CALLBACK_ENVIRON;
+
+typedef void (CALLBACK *PTP_SIMPLE_CALLBACK)(PTP_CALLBACK_INSTANCE, PVOID);
+
+typedef struct
+{
+    BOOL                    fThread;
+    pthread_t               thread;
+    LPTHREAD_START_ROUTINE  pfn;
+    PVOID                   pParam;
+
+    pthread_mutex_t         mutex;      // Events
+    pthread_cond_t          cond;
+    BOOL                    fSignaled;
+}
+COMPATHANDLE;
+
+static inline void *CompatThreadProc(void *pv)
+{
+    COMPATHANDLE *pThread = (COMPATHANDLE *)pv;
+
+    pThread->pfn(pThread->pParam);
+    return NULL;
+}
+
+static inline HANDLE CreateThread(PVOID psa, size_t cbStack, LPTHREAD_START_ROUTINE pfn, PVOID pParam, DWORD dwFlags, DWORD *pdwThreadId)
+{
+    COMPATHANDLE *pThread = (COMPATHANDLE *)calloc(1, sizeof(COMPATHANDLE));
+
+    (void)psa; (void)cbStack; (void)dwFlags; (void)pdwThreadId;
+
+    if (!pThread)
+        return NULL;
+
+    pThread->fThread = TRUE;
+    pThread->pfn     = pfn;
+    pThread->pParam  = pParam;
+
+    if (pthread_create(&pThread->thread, NULL, CompatThreadProc, pThread) != 0)
+    {
+        free(pThread);
+        return NULL;
+    }
+
+    return pThread;
+}
+
+static inline HANDLE CreateEvent(PVOID psa, BOOL fManualReset, BOOL fInitialState, PCWSTR pszName)
+{
+    COMPATHANDLE *pEvent = (COMPATHANDLE *)calloc(1, sizeof(COMPATHANDLE));
+
+    (void)psa; (void)fManualReset; (void)pszName;
+
+    if (!pEvent)
+        return NULL;
+
+    pthread_mutex_init(&pEvent->mutex, NULL);
+    pthread_cond_init(&pEvent->cond, NULL);
+    pEvent->fSignaled = fInitialState;
+
+    return pEvent;
+}
+
+static inline BOOL SetEvent(HANDLE hEvent)
+{
+    COMPATHANDLE *pEvent = (COMPATHANDLE *)hEvent;
+
+    pthread_mutex_lock(&pEvent->mutex);
+    pEvent->fSignaled = TRUE;
+    pthread_cond_broadcast(&pEvent->cond);
+    pthread_mutex_unlock(&pEvent->mutex);
+
+    return TRUE;
+}
+
+static inline DWORD WaitForSingleObject(HANDLE h, DWORD dwTimeout)
+{
+    COMPATHANDLE *p = (COMPATHANDLE *)h;
+
+    (void)dwTimeout;
+
+    if (p->fThread)
+    {
+        pthread_join(p->thread, NULL);
+        return WAIT_OBJECT_0;
+    }
+
+    pthread_mutex_lock(&p->mutex);
+
+    while (!p->fSignaled)
+        pthread_cond_wait(&p->cond, &p->mutex);
+
+    pthread_mutex_unlock(&p->mutex);
+
+    return WAIT_OBJECT_0;
+}
+
+static inline DWORD MsgWaitForMultipleObjects(DWORD cHandles, const HANDLE *rgHandles, BOOL fWaitAll, DWORD dwTimeout, DWORD dwWakeMask)
+{
+    (void)cHandles; (void)fWaitAll; (void)dwWakeMask;
+
+    return WaitForSingleObject(rgHandles[0], dwTimeout);
+}
+
+static inline BOOL PeekMessage(LPMSG pMsg, HWND hwnd, UINT uMsgFilterMin, UINT uMsgFilterMax, UINT uRemove)
+{
+    (void)pMsg; (void)hwnd; (void)uMsgFilterMin; (void)uMsgFilterMax; (void)uRemove;
+
+    return FALSE;
+}
+
+static inline BOOL CloseHandle(HANDLE h)
+{
+    COMPATHANDLE *p = (COMPATHANDLE *)h;
+
+    if (!p->fThread)
+    {
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+    }
+
+    free(p);
+    return TRUE;
+}
+
+typedef struct
+{
+    PTP_SIMPLE_CALLBACK pfn;
+    PVOID               pv;
+}
+COMPATWORKITEM;
+
+static inline void *CompatWorkItemProc(void *pv)
+{
+    COMPATWORKITEM item = *(COMPATWORKITEM *)pv;
+
+    free(pv);
+    item.pfn(NULL, item.pv);
+
+    return NULL;
+}
+
+// Each callback gets a thread of its own.
+static inline BOOL TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK pfn, PVOID pv, PTP_CALLBACK_ENVIRON pcbe)
+{
+    COMPATWORKITEM *pItem = (COMPATWORKITEM *)malloc(sizeof(COMPATWORKITEM));
+    pthread_t       thread;
+
+    (void)pcbe;
+
+    if (!pItem)
+        return FALSE;
+
+    pItem->pfn = pfn;
+    pItem->pv  = pv;
+
+    if (pthread_create(&thread, NULL, CompatWorkItemProc, pItem) != 0)
+    {
+        free(pItem);
+        return FALSE;
+    }
+
+    pthread_detach(thread);
+    return TRUE;
+}
+
+static inline void Sleep(DWORD dwMilliseconds)
+{
+    struct timespec ts = { (time_t)(dwMilliseconds / 1000), (long)(dwMilliseconds % 1000) * 1000000 };
+
+    nanosleep(&ts, NULL);
+}
+
+static inline BOOL SwitchToThread(void)
+{
+    return sched_yield() == 0;
+}
+
+static inline DWORD GetTickCount(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (DWORD)((ULONGLONG)ts.tv_sec * 1000 + (ULONGLONG)ts.tv_nsec / 1000000);
+}
+
+// Only the fields the modules use.
+typedef struct
+{
+    DWORD dwNumberOfProcessors;
+}
+SYSTEM_INFO;
+
+static inline void GetSystemInfo(SYSTEM_INFO *psi)
+{
+    long cProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+
+    psi->dwNumberOfProcessors = (cProcessors > 0) ? (DWORD)cProcessors : 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif